@@ -0,0 +1,203 @@
+/*
+   Micro-benchmark of the memory allocations the layout resolver makes for a
+   line break. The benchmark resolves the layout of a document of words
+   separated by <nl> commands and of the same document with spaces instead of
+   the commands, and reports the difference in the calls of the allocator
+   functions per <nl>. The allocator functions are wrapped by the linker (see
+   bench_layout_newline_LDFLAGS in the Makefile), only the calls made while
+   resolving the layout are counted.
+
+   Usage: bench_layout_newline [lines [repetitions]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/ast_node.h"
+#include "../src/bool.h"
+#include "../src/layout_resolver.h"
+#include "../src/parser.h"
+#include "../src/string.h"
+#include "../src/tokenizer.h"
+
+/* The calls of the allocator functions made while counting */
+typedef struct AllocatorCalls {
+	unsigned long allocations;
+	unsigned long frees;
+} AllocatorCalls;
+
+static bool isCounting = false;
+static AllocatorCalls calls;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void __real_free(void *pointer);
+
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t count, size_t size);
+void *__wrap_realloc(void *pointer, size_t size);
+void __wrap_free(void *pointer);
+
+int main(int argc, char **argv);
+
+static string *createDocument(unsigned long lines, const char *separator);
+
+static AllocatorCalls runBenchmark(char *name, string * document,
+				   unsigned long lines,
+				   unsigned long repetitions);
+
+int main(argc, argv)
+int argc;
+char **argv;
+{
+	unsigned long lines = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+	unsigned long repetitions =
+	    argc > 2 ? strtoul(argv[2], NULL, 10) : 20;
+	string *lineBreaks = createDocument(lines, "<nl>");
+	string *spaces = createDocument(lines, " ");
+	AllocatorCalls lineBreakCalls, spaceCalls;
+
+	if (lines == 0 || repetitions == 0 || lineBreaks == NULL
+	    || spaces == NULL) {
+		fprintf(stderr, "Cannot prepare the input\n");
+		return 1;
+	}
+
+	printf("Input: %lu words separated by <nl> or by spaces, x %lu\n",
+	       lines, repetitions);
+	lineBreakCalls = runBenchmark("<nl>", lineBreaks, lines, repetitions);
+	spaceCalls = runBenchmark("spaces", spaces, lines, repetitions);
+	printf("per <nl>:   %8.2f allocations %8.2f frees\n",
+	       ((double)lineBreakCalls.allocations - spaceCalls.allocations) /
+	       lines,
+	       ((double)lineBreakCalls.frees - spaceCalls.frees) / lines);
+
+	string_free(lineBreaks);
+	string_free(spaces);
+	return 0;
+}
+
+static string *createDocument(lines, separator)
+unsigned long lines;
+const char *separator;
+{
+	const char *word = "word";
+	unsigned long lineLength = strlen(word) + strlen(separator);
+	string *document = string_new(lines * lineLength);
+	unsigned long i;
+
+	if (document == NULL || lines == 0) {
+		string_free(document);
+		return NULL;
+	}
+
+	for (i = 0; i < lines; i++) {
+		memcpy(document->content + i * lineLength, word, strlen(word));
+		memcpy(document->content + i * lineLength + strlen(word),
+		       separator, strlen(separator));
+	}
+	return document;
+}
+
+/*
+   Returns the allocator calls made by a single resolving of the layout.
+ */
+static AllocatorCalls runBenchmark(name, document, lines, repetitions)
+char *name;
+string *document;
+unsigned long lines;
+unsigned long repetitions;
+{
+	TokenizerResult *tokenizerResult;
+	ParserResult *parserResult;
+	LayoutResolverResult *layoutResult;
+	AllocatorCalls totalCalls;
+	clock_t duration = 0;
+	clock_t start;
+	unsigned long i;
+
+	totalCalls.allocations = 0;
+	totalCalls.frees = 0;
+	tokenizerResult = tokenize(document, true, true);
+	if (tokenizerResult == NULL
+	    || tokenizerResult->type != TokenizerResultType_SUCCESS) {
+		fprintf(stderr, "Cannot tokenize the input\n");
+		exit(1);
+	}
+	parserResult = parse(tokenizerResult->result.tokens, true);
+	if (parserResult == NULL
+	    || parserResult->type != ParserResultType_SUCCESS) {
+		fprintf(stderr, "Cannot parse the input\n");
+		exit(1);
+	}
+
+	for (i = 0; i < repetitions; i++) {
+		calls.allocations = 0;
+		calls.frees = 0;
+		isCounting = true;
+		start = clock();
+		layoutResult =
+		    resolveLayout(parserResult->result.nodes, NULL, true);
+		duration += clock() - start;
+		isCounting = false;
+		if (layoutResult == NULL
+		    || layoutResult->type != LayoutResolverResultType_SUCCESS) {
+			fprintf(stderr, "Cannot resolve the layout\n");
+			exit(1);
+		}
+		LayoutResolverResult_free(layoutResult);
+		totalCalls.allocations += calls.allocations;
+		totalCalls.frees += calls.frees;
+	}
+
+	ParserResult_free(parserResult);
+	TokenizerResult_free(tokenizerResult);
+
+	totalCalls.allocations /= repetitions;
+	totalCalls.frees /= repetitions;
+	printf("%-8s %8.3f s %8.2f allocations %8.2f frees per line\n",
+	       name, (double)duration / CLOCKS_PER_SEC,
+	       (double)totalCalls.allocations / lines,
+	       (double)totalCalls.frees / lines);
+	return totalCalls;
+}
+
+void *__wrap_malloc(size)
+size_t size;
+{
+	if (isCounting) {
+		calls.allocations++;
+	}
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(count, size)
+size_t count;
+size_t size;
+{
+	if (isCounting) {
+		calls.allocations++;
+	}
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(pointer, size)
+void *pointer;
+size_t size;
+{
+	if (isCounting) {
+		calls.allocations++;
+	}
+	return __real_realloc(pointer, size);
+}
+
+void __wrap_free(pointer)
+void *pointer;
+{
+	if (isCounting && pointer != NULL) {
+		calls.frees++;
+	}
+	__real_free(pointer);
+}
@@ -0,0 +1,253 @@
+/*
+   Micro-benchmark of the table-driven whitespace recognizer against the
+   nested switch it has replaced in the tokenizer. The benchmark scans a
+   richtext document (demo/features.richtext by default) repeated many times,
+   recognizing whitespace at every byte like the tokenizer does outside
+   commands, optionally skipping the bytes rejected by the block pre-filter
+   first.
+
+   Usage: bench_whitespace [file [repetitions]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/bool.h"
+#include "../src/byte_scanner.h"
+#include "../src/string.h"
+#include "../src/whitespace.h"
+
+typedef unsigned long (*WhitespaceRecognizer) (const unsigned char *bytes,
+					       unsigned long length,
+					       bool isUtf8);
+
+int main(int argc, char **argv);
+
+static unsigned long getWhitespaceLengthUsingSwitch(const unsigned char *bytes,
+						    unsigned long length,
+						    bool isUtf8);
+
+static void runBenchmark(char *name, WhitespaceRecognizer recognizer,
+			 bool usePrefilter, string *input);
+
+static unsigned long countWhitespace(string *input,
+				     WhitespaceRecognizer recognizer,
+				     bool usePrefilter);
+
+int main(argc, argv)
+int argc;
+char **argv;
+{
+	char *fileName = argc > 1 ? argv[1] : "demo/features.richtext";
+	unsigned long repetitions =
+	    argc > 2 ? strtoul(argv[2], NULL, 10) : 2000;
+	FILE *file = fopen(fileName, "rb");
+	unsigned char buffer[4096];
+	unsigned long documentLength = 0;
+	unsigned long readLength;
+	unsigned long i;
+	string input;
+
+	if (file == NULL) {
+		fprintf(stderr, "Cannot open %s\n", fileName);
+		return 1;
+	}
+
+	input.content = NULL;
+	while ((readLength = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		input.content = realloc(input.content,
+					documentLength + readLength);
+		if (input.content == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		memcpy(input.content + documentLength, buffer, readLength);
+		documentLength += readLength;
+	}
+	fclose(file);
+
+	input.length = documentLength * repetitions;
+	input.content = realloc(input.content, input.length);
+	if (input.content == NULL || documentLength == 0) {
+		fprintf(stderr, "Cannot prepare the input\n");
+		return 1;
+	}
+	for (i = 1; i < repetitions; i++) {
+		memcpy(input.content + i * documentLength, input.content,
+		       documentLength);
+	}
+
+	printf("Input: %s x %lu (%lu bytes)\n", fileName, repetitions,
+	       input.length);
+	runBenchmark("switch", getWhitespaceLengthUsingSwitch, false, &input);
+	runBenchmark("table", getWhitespaceLength, false, &input);
+	runBenchmark("pre-filter + switch", getWhitespaceLengthUsingSwitch,
+		     true, &input);
+	runBenchmark("pre-filter + table", getWhitespaceLength, true, &input);
+
+	free(input.content);
+	return 0;
+}
+
+static void runBenchmark(name, recognizer, usePrefilter, input)
+char *name;
+WhitespaceRecognizer recognizer;
+bool usePrefilter;
+string *input;
+{
+	clock_t start = clock();
+	unsigned long whitespaceCount =
+	    countWhitespace(input, recognizer, usePrefilter);
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	printf("%-20s %8.3f s %10.1f MB/s (%lu whitespace characters)\n",
+	       name, seconds,
+	       seconds > 0 ? input->length / seconds / 1000000 : 0.0,
+	       whitespaceCount);
+}
+
+/*
+   Both recognizers are called through a pointer, so that neither of them
+   gets inlined into the loop.
+ */
+static unsigned long countWhitespace(input, recognizer, usePrefilter)
+string *input;
+WhitespaceRecognizer recognizer;
+bool usePrefilter;
+{
+	unsigned long whitespaceCount = 0;
+	unsigned long whitespaceLength;
+	unsigned long index;
+
+	for (index = 0; index < input->length; index++) {
+		if (usePrefilter) {
+			index += getPlainTextLength(input->content + index,
+						    input->length - index);
+			if (index == input->length) {
+				break;
+			}
+		}
+		whitespaceLength = recognizer(input->content + index,
+					      input->length - index, true);
+		if (whitespaceLength > 0) {
+			whitespaceCount++;
+			index += whitespaceLength - 1;
+		}
+	}
+
+	return whitespaceCount;
+}
+
+/* The recognizer previously used by the tokenizer, kept for comparison */
+static unsigned long getWhitespaceLengthUsingSwitch(bytes, length, isUtf8)
+const unsigned char *bytes;
+unsigned long length;
+bool isUtf8;
+{
+	unsigned char byte1, byte2, byte3;
+
+	if (length == 0) {
+		return 0;
+	}
+
+	byte1 = bytes[0];
+	byte2 = length > 1 ? bytes[1] : 0;
+	byte3 = length > 2 ? bytes[2] : 0;
+
+	switch (byte1) {
+	case ' ':
+	case '\t':		/* horizontal tab */
+	case '\n':		/* newline */
+	case '\v':		/* vertical tab */
+	case '\f':		/* form feed, use <np> instead in richtext */
+		return 1;
+	case '\r':		/* carriage return */
+		/*
+		 * Treat for CRLF as a single whitespace token because it is
+		 * meant to be formatted as a single space character.
+		 */
+		return byte2 == '\n' ? 2 : 1;
+	}
+
+	if (!isUtf8) {
+		/* ISO-8859-* has only one extra white-space above 127 */
+		if (byte1 == 160) {	/* Non-breaking space */
+			return 1;
+		}
+		return 0;
+	}
+
+	/* See https://en.wikipedia.org/wiki/Whitespace_character#Unicode */
+
+	if (byte1 < 128) {
+		/* single-byte UTF-8 codepoints */
+		return 0;
+	} else if (byte1 <= 192) {
+		/* unexpected continuation byte */
+		return 0;
+	} else if (byte1 <= 223) {
+		/* Two-byte UTF-8 codepoints */
+		if (byte1 == 194) {
+			switch (byte2) {
+			case 133:	/* next line */
+			case 160:	/* no-break space */
+				return 2;
+			}
+		}
+	} else if (byte1 <= 239) {
+		/* Three-byte UTF-8 codepoints */
+		switch (byte1) {
+		case 225:
+			switch (byte2) {
+			case 154:
+				/* ogham space mark */
+				return byte3 == 128 ? 3 : 0;
+			}
+			break;
+		case 226:
+			switch (byte2) {
+			case 128:
+				switch (byte3) {
+				case 128:	/* en quad */
+				case 129:	/* em quad */
+				case 130:	/* en space */
+				case 131:	/* em space */
+				case 132:	/* three-per-em space */
+				case 133:	/* four-per-em space */
+				case 134:	/* six-per-em space */
+				case 135:	/* figure space */
+				case 136:	/* punctuation space */
+				case 137:	/* thin space */
+				case 138:	/* hair space */
+				case 168:	/* line separator, use <nl> instead in richtext */
+				case 169:	/* paragraph separator,use <Paragraph> instead in richtext */
+				case 175:	/* narrow no-break space */
+					return 3;
+				}
+				break;
+			case 129:
+				switch (byte3) {
+				case 159:	/* medium mathematical space */
+					return 3;
+				}
+				break;
+			}
+			break;
+		case 227:
+			switch (byte2) {
+			case 128:
+				switch (byte3) {
+				case 128:	/* ideographic space */
+					return 3;
+				}
+				break;
+			}
+			break;
+		}
+	}
+	/* There are no four-byte UTF-8 codepoints for whitespace */
+	/* We also ignore invalid UTF-8 characters (byte1 > 247) here */
+
+	return 0;
+}
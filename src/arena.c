@@ -0,0 +1,129 @@
+#include <stdlib.h>
+#include "arena.h"
+
+#define ARENA_DEFAULT_BLOCK_SIZE 65536
+
+/* Allocations are aligned to the size of the strictest of these types */
+typedef union ArenaAlignment {
+	long longValue;
+	double doubleValue;
+	void *pointer;
+	void (*function) (void);
+} ArenaAlignment;
+
+typedef struct ArenaBlock {
+	struct ArenaBlock *previous;
+	unsigned long capacity;
+	unsigned long length;
+} ArenaBlock;
+
+struct Arena {
+	/* The block the memory is currently allocated from, or NULL */
+	ArenaBlock *block;
+	unsigned long blockSize;
+};
+
+#define ARENA_ALIGNED(size)\
+	(((size) + sizeof(ArenaAlignment) - 1) / sizeof(ArenaAlignment)\
+	 * sizeof(ArenaAlignment))
+
+/* Guards the size computations against overflow */
+#define ARENA_MAX_ALLOCATION_SIZE\
+	((unsigned long) -1 / 2)
+
+#define ARENA_BLOCK_CONTENT(block)\
+	((char *) (block) + ARENA_ALIGNED(sizeof(ArenaBlock)))
+
+static ArenaBlock *newBlock(unsigned long capacity, ArenaBlock * previous);
+
+Arena *Arena_new(blockSize)
+unsigned long blockSize;
+{
+	Arena *arena = malloc(sizeof(Arena));
+	if (arena == NULL) {
+		return NULL;
+	}
+
+	arena->block = NULL;
+	arena->blockSize = ARENA_ALIGNED(blockSize > 0 ? blockSize :
+					 ARENA_DEFAULT_BLOCK_SIZE);
+	return arena;
+}
+
+void *Arena_allocate(arena, size)
+Arena *arena;
+unsigned long size;
+{
+	ArenaBlock *block;
+	ArenaBlock *largeBlock;
+	void *memory;
+
+	if (arena == NULL || size > ARENA_MAX_ALLOCATION_SIZE) {
+		return NULL;
+	}
+
+	size = ARENA_ALIGNED(size > 0 ? size : 1);
+	block = arena->block;
+	if (block != NULL && block->capacity - block->length >= size) {
+		memory = ARENA_BLOCK_CONTENT(block) + block->length;
+		block->length += size;
+		return memory;
+	}
+
+	/*
+	 * Allocations larger than a quarter of a block get a block of their
+	 * own, placed behind the current block, so that the rest of the current
+	 * block is not wasted.
+	 */
+	if (block != NULL && size > arena->blockSize / 4) {
+		largeBlock = newBlock(size, block->previous);
+		if (largeBlock == NULL) {
+			return NULL;
+		}
+		block->previous = largeBlock;
+		largeBlock->length = size;
+		return ARENA_BLOCK_CONTENT(largeBlock);
+	}
+
+	block = newBlock(size > arena->blockSize ? size : arena->blockSize,
+			 block);
+	if (block == NULL) {
+		return NULL;
+	}
+	arena->block = block;
+	block->length = size;
+	return ARENA_BLOCK_CONTENT(block);
+}
+
+void Arena_free(arena)
+Arena *arena;
+{
+	ArenaBlock *block;
+	ArenaBlock *previous;
+
+	if (arena == NULL) {
+		return;
+	}
+
+	for (block = arena->block; block != NULL; block = previous) {
+		previous = block->previous;
+		free(block);
+	}
+	free(arena);
+}
+
+static ArenaBlock *newBlock(capacity, previous)
+unsigned long capacity;
+ArenaBlock *previous;
+{
+	ArenaBlock *block =
+	    malloc(ARENA_ALIGNED(sizeof(ArenaBlock)) + capacity);
+	if (block == NULL) {
+		return NULL;
+	}
+
+	block->previous = previous;
+	block->capacity = capacity;
+	block->length = 0;
+	return block;
+}
@@ -0,0 +1,30 @@
+#ifndef ARENA_HEADER_FILE
+#define ARENA_HEADER_FILE 1
+
+/*
+ * A region allocator handing out memory from large blocks by bumping a
+ * pointer. The memory cannot be freed piecewise, it is freed all at once,
+ * along with the arena. The allocations made one after another are placed
+ * next to each other (unless they are too large to share a block).
+ */
+typedef struct Arena Arena;
+
+/*
+ * Creates an arena allocating blocks of the provided size, or of a default
+ * size if the size is 0. The first block is allocated on first allocation.
+ * Returns NULL if the memory for the arena could not be allocated.
+ */
+Arena *Arena_new(unsigned long blockSize);
+
+/*
+ * Returns the memory of the provided size, suitably aligned for any type, or
+ * NULL if the memory could not be allocated. The memory is not initialized.
+ */
+void *Arena_allocate(Arena *arena, unsigned long size);
+
+/*
+ * Frees the arena, including all memory allocated from it.
+ */
+void Arena_free(Arena *arena);
+
+#endif
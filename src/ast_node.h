@@ -2,6 +2,8 @@
 #define AST_NODE_HEADER_FILE 1
 
 #include "ast_node_type.h"
+#include "bool.h"
+#include "command_id.h"
 #include "string.h"
 
 struct ASTNode;
@@ -15,8 +17,27 @@ struct ASTNode {
 	unsigned long tokenIndex;
 	ASTNodeType type;
 	string *value;
+	/*
+	 * Set if the value is not owned by the node, but shared with a token
+	 * referencing the tokenized input (see parseAndConsumeTokens) or with
+	 * a flat AST (see FlatAST_toNodes). Such values must not be freed using
+	 * string_free.
+	 */
+	bool isValueView;
+	/*
+	 * The identifier of the command for command nodes, CommandId_NONE for
+	 * the other nodes.
+	 */
+	CommandId commandId;
 	ASTNode *parent;
 	ASTNodePointerVector *children;
+	/*
+	 * The index of the node in its parent's children, or in the root nodes,
+	 * so that the node's siblings are found in constant time. The index is
+	 * set by the parser and by FlatAST_toNodes, nodes created by other
+	 * means may leave it unset, so it is verified before it is relied on.
+	 */
+	unsigned long siblingIndex;
 };
 
 #endif
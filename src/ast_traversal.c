@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#include "ast_node.h"
+#include "ast_node_pointer_vector.h"
+#include "ast_traversal.h"
+#include "bool.h"
+
+#define AST_TRAVERSAL_INITIAL_CAPACITY 16
+
+struct ASTTraversal {
+	/* The frames of the current node's siblings and of its ancestors' */
+	ASTTraversalFrameVector *stack;
+	ASTNode *node;
+	/* The last step, the traversal starts as if a node was left */
+	ASTTraversalStep step;
+	bool skipChildren;
+};
+
+static bool pushFrame(ASTTraversal * traversal, ASTNode * parent);
+
+ASTTraversal *ASTTraversal_new()
+{
+	ASTTraversal *traversal = malloc(sizeof(ASTTraversal));
+	if (traversal == NULL) {
+		return NULL;
+	}
+
+	traversal->stack =
+	    ASTTraversalFrameVector_new(0, AST_TRAVERSAL_INITIAL_CAPACITY);
+	if (traversal->stack == NULL) {
+		free(traversal);
+		return NULL;
+	}
+	traversal->node = NULL;
+	traversal->step = ASTTraversalStep_END;
+	traversal->skipChildren = false;
+	return traversal;
+}
+
+void ASTTraversal_start(traversal, nodes)
+ASTTraversal *traversal;
+ASTNodePointerVector *nodes;
+{
+	ASTTraversalFrame *frame;
+
+	if (traversal == NULL) {
+		return;
+	}
+
+	/* The stack always has room for the frame of the root nodes */
+	frame = traversal->stack->items;
+	frame->parent = NULL;
+	frame->nodes = nodes;
+	frame->next = 0;
+	traversal->stack->size.length = 1;
+	traversal->node = NULL;
+	traversal->step = ASTTraversalStep_LEAVE;
+	traversal->skipChildren = false;
+}
+
+ASTTraversalStep ASTTraversal_next(traversal, node)
+ASTTraversal *traversal;
+ASTNode **node;
+{
+	ASTTraversalFrameVector *stack;
+	ASTTraversalFrame *frame;
+	ASTNode *current;
+
+	if (traversal == NULL) {
+		*node = NULL;
+		return ASTTraversalStep_END;
+	}
+
+	stack = traversal->stack;
+	current = traversal->node;
+	if (traversal->step == ASTTraversalStep_ENTER) {
+		if (!traversal->skipChildren && current != NULL
+		    && current->children != NULL
+		    && current->children->size.length > 0) {
+			if (!pushFrame(traversal, current)) {
+				*node = current;
+				return ASTTraversalStep_OUT_OF_MEMORY;
+			}
+			traversal->node = *current->children->items;
+			*node = traversal->node;
+			return ASTTraversalStep_ENTER;
+		}
+
+		traversal->skipChildren = false;
+		traversal->step = ASTTraversalStep_LEAVE;
+		*node = current;
+		return ASTTraversalStep_LEAVE;
+	}
+
+	if (stack->size.length == 0) {
+		traversal->node = NULL;
+		traversal->step = ASTTraversalStep_END;
+		*node = NULL;
+		return ASTTraversalStep_END;
+	}
+
+	frame = stack->items + stack->size.length - 1;
+	if (frame->nodes != NULL && frame->next < frame->nodes->size.length) {
+		traversal->node = frame->nodes->items[frame->next];
+		traversal->step = ASTTraversalStep_ENTER;
+		frame->next++;
+	} else {
+		/* All siblings have been left, so their parent is left too */
+		traversal->node = frame->parent;
+		stack->size.length--;
+		traversal->step = stack->size.length > 0 ?
+		    ASTTraversalStep_LEAVE : ASTTraversalStep_END;
+	}
+
+	*node = traversal->node;
+	return traversal->step;
+}
+
+void ASTTraversal_skipChildren(traversal)
+ASTTraversal *traversal;
+{
+	if (traversal != NULL && traversal->step == ASTTraversalStep_ENTER) {
+		traversal->skipChildren = true;
+	}
+}
+
+ASTNode *ASTTraversal_getParent(traversal)
+ASTTraversal *traversal;
+{
+	ASTTraversalFrameVector *stack;
+
+	if (traversal == NULL || traversal->stack->size.length == 0) {
+		return NULL;
+	}
+
+	stack = traversal->stack;
+	return stack->items[stack->size.length - 1].parent;
+}
+
+unsigned long ASTTraversal_getDepth(traversal)
+ASTTraversal *traversal;
+{
+	if (traversal == NULL || traversal->stack->size.length == 0) {
+		return 0;
+	}
+
+	return traversal->stack->size.length - 1;
+}
+
+void ASTTraversal_free(traversal)
+ASTTraversal *traversal;
+{
+	if (traversal == NULL) {
+		return;
+	}
+
+	ASTTraversalFrameVector_free(traversal->stack);
+	free(traversal);
+}
+
+/*
+ * Pushes the frame of the parent's children, whose first child is entered
+ * right away. The stack grows exponentially, since deep trees are expected.
+ */
+static bool pushFrame(traversal, parent)
+ASTTraversal *traversal;
+ASTNode *parent;
+{
+	ASTTraversalFrameVector *stack = traversal->stack;
+	ASTTraversalFrame *frame;
+
+	if (stack->size.length == stack->size.capacity
+	    && ASTTraversalFrameVector_grow(stack,
+					    stack->size.capacity * 2) == NULL) {
+		return false;
+	}
+
+	frame = stack->items + stack->size.length;
+	frame->parent = parent;
+	frame->nodes = parent->children;
+	frame->next = 1;
+	stack->size.length++;
+	return true;
+}
+
+Vector_ofTypeImplementation(ASTTraversalFrame)
@@ -0,0 +1,78 @@
+#ifndef AST_TRAVERSAL_HEADER_FILE
+#define AST_TRAVERSAL_HEADER_FILE 1
+
+#include "ast_node.h"
+#include "ast_node_pointer_vector.h"
+#include "typed_vector.h"
+
+typedef enum ASTTraversalStep {
+	/* The node is entered, its children (if any) are visited next */
+	ASTTraversalStep_ENTER,
+	/* The node is left, all of its children have been visited */
+	ASTTraversalStep_LEAVE,
+	/* All nodes have been left */
+	ASTTraversalStep_END,
+	/* The stack could not be grown, the step may be retried */
+	ASTTraversalStep_OUT_OF_MEMORY
+} ASTTraversalStep;
+
+/* The siblings being visited at one level of the tree */
+typedef struct ASTTraversalFrame {
+	/* The node the siblings are the children of, NULL for the root nodes */
+	ASTNode *parent;
+	ASTNodePointerVector *nodes;
+	/* The index of the sibling to enter next */
+	unsigned long next;
+} ASTTraversalFrame;
+
+Vector_ofType(ASTTraversalFrame)
+
+/*
+ * A depth-first traversal of a tree of nodes, visiting every node twice, on
+ * entering and on leaving it. The traversal keeps the path from the root to
+ * the current node in an explicit stack instead of recursing, so the depth of
+ * the tree is limited only by the available memory. The stack is kept between
+ * traversals, so a traversal can be reused for many trees without allocating
+ * memory again.
+ */
+typedef struct ASTTraversal ASTTraversal;
+
+/*
+ * Returns NULL if the memory for the traversal could not be allocated.
+ */
+ASTTraversal *ASTTraversal_new(void);
+
+/*
+ * Starts a traversal of the provided nodes and their descendants, abandoning
+ * the traversal in progress, if any.
+ */
+void ASTTraversal_start(ASTTraversal *traversal, ASTNodePointerVector *nodes);
+
+/*
+ * Moves to the next step of the traversal and stores the node the step
+ * applies to, which is NULL for the END step, or for a NULL item of the
+ * traversed vectors. The traversal stays at the entered node if the
+ * OUT_OF_MEMORY step is returned, so the call may be repeated.
+ */
+ASTTraversalStep ASTTraversal_next(ASTTraversal *traversal, ASTNode **node);
+
+/*
+ * Makes the traversal leave the node that has just been entered without
+ * visiting its children.
+ */
+void ASTTraversal_skipChildren(ASTTraversal *traversal);
+
+/*
+ * Returns the parent of the current node, which is NULL for a root node, or
+ * if there is no current node.
+ */
+ASTNode *ASTTraversal_getParent(ASTTraversal *traversal);
+
+/*
+ * Returns the number of ancestors of the current node.
+ */
+unsigned long ASTTraversal_getDepth(ASTTraversal *traversal);
+
+void ASTTraversal_free(ASTTraversal *traversal);
+
+#endif
@@ -0,0 +1,1075 @@
+#include <string.h>
+#include "bool.h"
+#include "byte_scanner.h"
+#include "whitespace.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BYTE_SCANNER_BLOCK_SIZE 32
+#else
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BYTE_SCANNER_BLOCK_SIZE 16
+#else
+#define BYTE_SCANNER_BLOCK_SIZE sizeof(unsigned long)
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#endif
+
+/*
+ * The lengths of the UTF-8 sequences started by the individual bytes, 0 for
+ * the bytes that cannot start a well-formed character.
+ */
+static const unsigned char SEQUENCE_LENGTHS[256] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x00-0x0F */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x10-0x1F */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x20-0x2F */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x30-0x3F */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x40-0x4F */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x50-0x5F */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x60-0x6F */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x70-0x7F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x80-0x8F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x90-0x9F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0xA0-0xAF */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0xB0-0xBF */
+	0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,	/* 0xC0-0xCF */
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,	/* 0xD0-0xDF */
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,	/* 0xE0-0xEF */
+	4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0	/* 0xF0-0xFF */
+};
+
+static bool isPlainTextBlock(const unsigned char *block);
+
+static bool isPlainTextByte(unsigned char byte);
+
+static bool isAsciiBlock(const unsigned char *block);
+
+static unsigned long getUtf8TextBlockLength(const unsigned char *block,
+					    unsigned long *codepointCount);
+
+static unsigned long countBoundaryBytesInBlocks(const unsigned char *bytes,
+						unsigned long blockCount);
+
+static bool isBoundaryByte(unsigned char byte);
+
+unsigned long getPlainTextLength(bytes, length)
+const unsigned char *bytes;
+unsigned long length;
+{
+	unsigned long index = 0;
+	unsigned long blockEnd;
+
+	if (bytes == NULL) {
+		return 0;
+	}
+
+	for (;;) {
+		while (length - index >= BYTE_SCANNER_BLOCK_SIZE
+		       && isPlainTextBlock(bytes + index)) {
+			index += BYTE_SCANNER_BLOCK_SIZE;
+		}
+
+		/*
+		 * The block tests are conservative, so we locate the first
+		 * special byte exactly, and resume the block scanning if the
+		 * block contained none.
+		 */
+		blockEnd = length - index >= BYTE_SCANNER_BLOCK_SIZE ?
+		    index + BYTE_SCANNER_BLOCK_SIZE : length;
+		while (index < blockEnd && isPlainTextByte(bytes[index])) {
+			index++;
+		}
+
+		if (index < blockEnd || index == length) {
+			return index;
+		}
+	}
+}
+
+unsigned long getAsciiLength(bytes, length)
+const unsigned char *bytes;
+unsigned long length;
+{
+	unsigned long index = 0;
+
+	if (bytes == NULL) {
+		return 0;
+	}
+
+	while (length - index >= BYTE_SCANNER_BLOCK_SIZE
+	       && isAsciiBlock(bytes + index)) {
+		index += BYTE_SCANNER_BLOCK_SIZE;
+	}
+	while (index < length && bytes[index] < 128) {
+		index++;
+	}
+
+	return index;
+}
+
+unsigned long getUtf8TextLength(bytes, length, codepointCount)
+const unsigned char *bytes;
+unsigned long length;
+unsigned long *codepointCount;
+{
+	unsigned long index = 0;
+	unsigned long count = 0;
+	unsigned long blockEnd;
+	unsigned long blockLength;
+	unsigned long blockCodepointCount = 0;
+	unsigned long *blockCount =
+	    codepointCount != NULL ? &blockCodepointCount : NULL;
+	unsigned long sequenceLength;
+	bool isWellFormed;
+
+	if (codepointCount != NULL) {
+		*codepointCount = 0;
+	}
+	if (bytes == NULL) {
+		return 0;
+	}
+
+	for (;;) {
+		/*
+		 * The block tests accept the leading well-formed characters
+		 * but the one ending beyond the block, so we continue with the
+		 * next block unless some of the preceding bytes were rejected.
+		 */
+		while (length - index >= BYTE_SCANNER_BLOCK_SIZE) {
+			blockLength =
+			    getUtf8TextBlockLength(bytes + index, blockCount);
+			index += blockLength;
+			count += blockCodepointCount;
+			if (blockLength + 3 < BYTE_SCANNER_BLOCK_SIZE) {
+				break;
+			}
+		}
+
+		/*
+		 * The block tests are conservative about the Unicode
+		 * whitespace and may stop before the character preceding an
+		 * ill-formed sequence, so the rest of the block is rescanned a
+		 * character at a time, possibly crossing its end.
+		 */
+		blockEnd = length - index >= BYTE_SCANNER_BLOCK_SIZE ?
+		    index + BYTE_SCANNER_BLOCK_SIZE : length;
+		while (index < blockEnd) {
+			if (bytes[index] < 128) {
+				if (!isPlainTextByte(bytes[index])) {
+					break;
+				}
+				index++;
+				count++;
+				continue;
+			}
+
+			sequenceLength =
+			    getUtf8SequenceLength(bytes + index, length - index,
+						  &isWellFormed);
+			if (!isWellFormed
+			    || getWhitespaceLength(bytes + index,
+						   sequenceLength, true) > 0) {
+				break;
+			}
+			index += sequenceLength;
+			count++;
+		}
+
+		if (index < blockEnd || index == length) {
+			if (codepointCount != NULL) {
+				*codepointCount = count;
+			}
+			return index;
+		}
+	}
+}
+
+unsigned long getUtf8SequenceLength(bytes, length, isWellFormed)
+const unsigned char *bytes;
+unsigned long length;
+bool *isWellFormed;
+{
+	unsigned long sequenceLength;
+	unsigned long index;
+	unsigned char lowerBound = 0x80;
+	unsigned char upperBound = 0xBF;
+
+	*isWellFormed = false;
+	if (bytes == NULL || length == 0) {
+		return 0;
+	}
+
+	sequenceLength = SEQUENCE_LENGTHS[bytes[0]];
+	if (sequenceLength == 0) {
+		return 1;
+	}
+
+	/* Excludes overlong encodings, surrogates and codepoints > 0x10FFFF */
+	switch (bytes[0]) {
+	case 0xE0:
+		lowerBound = 0xA0;
+		break;
+	case 0xED:
+		upperBound = 0x9F;
+		break;
+	case 0xF0:
+		lowerBound = 0x90;
+		break;
+	case 0xF4:
+		upperBound = 0x8F;
+		break;
+	}
+
+	for (index = 1; index < sequenceLength; index++) {
+		if (index == length || bytes[index] < lowerBound
+		    || bytes[index] > upperBound) {
+			return index;
+		}
+		lowerBound = 0x80;
+		upperBound = 0xBF;
+	}
+
+	*isWellFormed = true;
+	return sequenceLength;
+}
+
+unsigned long countBoundaryBytes(bytes, length)
+const unsigned char *bytes;
+unsigned long length;
+{
+	unsigned long blockCount;
+	unsigned long count;
+	unsigned long index;
+
+	if (bytes == NULL) {
+		return 0;
+	}
+
+	blockCount = length / BYTE_SCANNER_BLOCK_SIZE;
+	count = countBoundaryBytesInBlocks(bytes, blockCount);
+	for (index = blockCount * BYTE_SCANNER_BLOCK_SIZE; index < length;
+	     index++) {
+		if (isBoundaryByte(bytes[index])) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+#if defined(__AVX2__)
+
+static bool isPlainTextBlock(block)
+const unsigned char *block;
+{
+	__m256i bytes = _mm256_loadu_si256((const __m256i *)block);
+	/*
+	 * The comparison is signed, so bytes above 127 are "lower" than 14 as
+	 * well.
+	 */
+	__m256i special = _mm256_cmpgt_epi8(_mm256_set1_epi8(14), bytes);
+	special =
+	    _mm256_or_si256(special,
+			    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')));
+	special =
+	    _mm256_or_si256(special,
+			    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('<')));
+	special =
+	    _mm256_or_si256(special,
+			    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('>')));
+	return _mm256_movemask_epi8(special) == 0;
+}
+
+static bool isAsciiBlock(block)
+const unsigned char *block;
+{
+	__m256i bytes = _mm256_loadu_si256((const __m256i *)block);
+	return _mm256_movemask_epi8(bytes) == 0;
+}
+
+static unsigned long countBoundaryBytesInBlocks(bytes, blockCount)
+const unsigned char *bytes;
+unsigned long blockCount;
+{
+	__m256i counters = _mm256_setzero_si256();
+	__m256i sums;
+	__m256i block;
+	__m256i offset;
+	__m256i matches;
+	unsigned long count = 0;
+	unsigned long blockIndex;
+
+	for (blockIndex = 0; blockIndex < blockCount; blockIndex++) {
+		block =
+		    _mm256_loadu_si256((const __m256i *)(bytes +
+							 blockIndex * 32));
+		/* Unsigned range checks: '\t' - '\r' and 0xE1 - 0xE3 */
+		offset = _mm256_sub_epi8(block, _mm256_set1_epi8(9));
+		matches =
+		    _mm256_cmpeq_epi8(_mm256_min_epu8
+				      (offset, _mm256_set1_epi8(4)), offset);
+		offset = _mm256_sub_epi8(block, _mm256_set1_epi8((char)0xE1));
+		matches =
+		    _mm256_or_si256(matches,
+				    _mm256_cmpeq_epi8(_mm256_min_epu8
+						      (offset,
+						       _mm256_set1_epi8(2)),
+						      offset));
+		matches =
+		    _mm256_or_si256(matches,
+				    _mm256_cmpeq_epi8(block,
+						      _mm256_set1_epi8(' ')));
+		matches =
+		    _mm256_or_si256(matches,
+				    _mm256_cmpeq_epi8(block,
+						      _mm256_set1_epi8('<')));
+		matches =
+		    _mm256_or_si256(matches,
+				    _mm256_cmpeq_epi8(block,
+						      _mm256_set1_epi8((char)
+								       0xA0)));
+		matches =
+		    _mm256_or_si256(matches,
+				    _mm256_cmpeq_epi8(block,
+						      _mm256_set1_epi8((char)
+								       0xC2)));
+		/* Matches are -1, so subtracting them increments counters */
+		counters = _mm256_sub_epi8(counters, matches);
+
+		/* Flush the 8-bit counters before they can overflow */
+		if (blockIndex % 255 == 254 || blockIndex + 1 == blockCount) {
+			sums =
+			    _mm256_sad_epu8(counters, _mm256_setzero_si256());
+			count +=
+			    (unsigned long)_mm256_extract_epi64(sums, 0) +
+			    (unsigned long)_mm256_extract_epi64(sums, 1) +
+			    (unsigned long)_mm256_extract_epi64(sums, 2) +
+			    (unsigned long)_mm256_extract_epi64(sums, 3);
+			counters = _mm256_setzero_si256();
+		}
+	}
+
+	return count;
+}
+
+#else
+#if defined(__SSE2__)
+
+static bool isPlainTextBlock(block)
+const unsigned char *block;
+{
+	__m128i bytes = _mm_loadu_si128((const __m128i *)block);
+	/*
+	 * The comparison is signed, so bytes above 127 are "lower" than 14 as
+	 * well.
+	 */
+	__m128i special = _mm_cmplt_epi8(bytes, _mm_set1_epi8(14));
+	special =
+	    _mm_or_si128(special, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')));
+	special =
+	    _mm_or_si128(special, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('<')));
+	special =
+	    _mm_or_si128(special, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('>')));
+	return _mm_movemask_epi8(special) == 0;
+}
+
+static bool isAsciiBlock(block)
+const unsigned char *block;
+{
+	__m128i bytes = _mm_loadu_si128((const __m128i *)block);
+	return _mm_movemask_epi8(bytes) == 0;
+}
+
+static unsigned long countBoundaryBytesInBlocks(bytes, blockCount)
+const unsigned char *bytes;
+unsigned long blockCount;
+{
+	__m128i counters = _mm_setzero_si128();
+	__m128i sums;
+	__m128i block;
+	__m128i offset;
+	__m128i matches;
+	unsigned long count = 0;
+	unsigned long blockIndex;
+
+	for (blockIndex = 0; blockIndex < blockCount; blockIndex++) {
+		block = _mm_loadu_si128((const __m128i *)(bytes +
+							  blockIndex * 16));
+		/* Unsigned range checks: '\t' - '\r' and 0xE1 - 0xE3 */
+		offset = _mm_sub_epi8(block, _mm_set1_epi8(9));
+		matches =
+		    _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(4)),
+				   offset);
+		offset = _mm_sub_epi8(block, _mm_set1_epi8((char)0xE1));
+		matches =
+		    _mm_or_si128(matches,
+				 _mm_cmpeq_epi8(_mm_min_epu8
+						(offset, _mm_set1_epi8(2)),
+						offset));
+		matches =
+		    _mm_or_si128(matches,
+				 _mm_cmpeq_epi8(block, _mm_set1_epi8(' ')));
+		matches =
+		    _mm_or_si128(matches,
+				 _mm_cmpeq_epi8(block, _mm_set1_epi8('<')));
+		matches =
+		    _mm_or_si128(matches,
+				 _mm_cmpeq_epi8(block,
+						_mm_set1_epi8((char)0xA0)));
+		matches =
+		    _mm_or_si128(matches,
+				 _mm_cmpeq_epi8(block,
+						_mm_set1_epi8((char)0xC2)));
+		/* Matches are -1, so subtracting them increments counters */
+		counters = _mm_sub_epi8(counters, matches);
+
+		/* Flush the 8-bit counters before they can overflow */
+		if (blockIndex % 255 == 254 || blockIndex + 1 == blockCount) {
+			sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+			count += (unsigned long)_mm_cvtsi128_si32(sums) +
+			    (unsigned long)
+			    _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+			counters = _mm_setzero_si128();
+		}
+	}
+
+	return count;
+}
+
+#else
+
+/*
+ * See https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord and
+ * https://graphics.stanford.edu/~seander/bithacks.html#HasLessInWord
+ */
+#define SWAR_ONES ((unsigned long) -1 / 255)
+#define SWAR_HIGHS (SWAR_ONES * 128)
+#define SWAR_HAS_LESS(word, n) \
+	(((word) - SWAR_ONES * (n)) & ~(word) & SWAR_HIGHS)
+#define SWAR_HAS_BYTE(word, n) SWAR_HAS_LESS((word) ^ (SWAR_ONES * (n)), 1)
+
+/*
+ * Unlike the macros above, the following ones set the high bit of exactly the
+ * matching bytes.
+ */
+#define SWAR_LOWS (SWAR_ONES * 127)
+#define SWAR_ZERO_BYTES(word) \
+	(~((((word) & SWAR_LOWS) + SWAR_LOWS) | (word)) & SWAR_HIGHS)
+#define SWAR_BYTES_EQUAL(word, n) SWAR_ZERO_BYTES((word) ^ (SWAR_ONES * (n)))
+/* n must be at most 128 */
+#define SWAR_BYTES_LESS(word, n) \
+	(~(((word) | SWAR_HIGHS) - SWAR_ONES * (n)) & ~(word) & SWAR_HIGHS)
+
+static bool isPlainTextBlock(block)
+const unsigned char *block;
+{
+	unsigned long word;
+
+	/* memcpy is the only portable way to do an unaligned load */
+	memcpy(&word, block, sizeof(unsigned long));
+
+	if (word & SWAR_HIGHS) {
+		return false;
+	}
+
+	/* All whitespace except for ' ' is in the 9-13 range */
+	return !(SWAR_HAS_LESS(word, 14) || SWAR_HAS_BYTE(word, ' ')
+		 || SWAR_HAS_BYTE(word, '<') || SWAR_HAS_BYTE(word, '>'));
+}
+
+static bool isAsciiBlock(block)
+const unsigned char *block;
+{
+	unsigned long word;
+
+	memcpy(&word, block, sizeof(unsigned long));
+	return (word & SWAR_HIGHS) == 0;
+}
+
+static unsigned long countBoundaryBytesInBlocks(bytes, blockCount)
+const unsigned char *bytes;
+unsigned long blockCount;
+{
+	unsigned long word;
+	unsigned long matches;
+	unsigned long count = 0;
+	unsigned long blockIndex;
+
+	for (blockIndex = 0; blockIndex < blockCount; blockIndex++) {
+		memcpy(&word, bytes + blockIndex * sizeof(unsigned long),
+		       sizeof(unsigned long));
+		matches = SWAR_BYTES_LESS(word, 14) & ~SWAR_BYTES_LESS(word, 9);
+		matches |= SWAR_BYTES_EQUAL(word, ' ');
+		matches |= SWAR_BYTES_EQUAL(word, '<');
+		matches |= SWAR_BYTES_EQUAL(word, 0xA0);
+		matches |= SWAR_BYTES_EQUAL(word, 0xC2);
+		matches |= SWAR_BYTES_EQUAL(word, 0xE1);
+		matches |= SWAR_BYTES_EQUAL(word, 0xE2);
+		matches |= SWAR_BYTES_EQUAL(word, 0xE3);
+		/* Sums the matches (0 or 1 per byte) into the highest byte */
+		count += ((matches >> 7) * SWAR_ONES) >>
+		    ((sizeof(unsigned long) - 1) * 8);
+	}
+
+	return count;
+}
+
+#undef SWAR_BYTES_LESS
+#undef SWAR_BYTES_EQUAL
+#undef SWAR_ZERO_BYTES
+#undef SWAR_LOWS
+#undef SWAR_HAS_BYTE
+#undef SWAR_HAS_LESS
+#undef SWAR_HIGHS
+#undef SWAR_ONES
+
+#endif
+#endif
+
+/*
+ * The UTF-8 block tests reject the blocks containing ASCII special bytes,
+ * ill-formed sequences, Unicode whitespace, or ending within a character.
+ * The blocks are tested independently: a block starts at a character boundary
+ * (as the preceding block has been accepted or rescanned in full), so the
+ * bytes preceding it are treated as ASCII.
+ *
+ * The vectorized validation using byte shuffles follows J. Keiser,
+ * D. Lemire: Validating UTF-8 In Less Than One Instruction Per Byte, see
+ * https://arxiv.org/abs/2010.03090 . Each error is reported by three lookup
+ * tables, indexed by the high and the low nibble of the preceding byte and
+ * the high nibble of the current byte, as the common bit of their entries.
+ * The missing or excess continuation bytes of three- and four-byte characters
+ * are detected by comparing the bytes two and three positions back with the
+ * lead byte ranges instead. Without byte shuffles (SSE2), the lead bytes and
+ * the restricted second byte ranges are compared with the individual bytes.
+ */
+#if defined(__SSSE3__)
+
+#define TOO_SHORT 1		/* 11______ 0_______ or 11______ 11______ */
+#define TOO_LONG 2		/* 0_______ 10______ */
+#define OVERLONG_3 4		/* 11100000 100_____ */
+#define TOO_LARGE 8		/* 11110100 1001____ or 11110100 101_____ */
+#define SURROGATE 16		/* 11101101 101_____ */
+#define OVERLONG_2 32		/* 1100000_ 10______ */
+#define TOO_LARGE_1000 64	/* 11110101+ 1000____ */
+#define OVERLONG_4 64		/* 11110000 1000____ */
+#define TWO_CONTINUATIONS 128	/* 10______ 10______ */
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTINUATIONS)
+
+/* Indexed by the high nibble of the preceding byte */
+static const unsigned char PRECEDING_BYTE_HIGH_ERRORS[16] = {
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	TWO_CONTINUATIONS, TWO_CONTINUATIONS,
+	TWO_CONTINUATIONS, TWO_CONTINUATIONS,
+	TOO_SHORT | OVERLONG_2,
+	TOO_SHORT,
+	TOO_SHORT | OVERLONG_3 | SURROGATE,
+	TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+};
+
+/* Indexed by the low nibble of the preceding byte */
+static const unsigned char PRECEDING_BYTE_LOW_ERRORS[16] = {
+	CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+	CARRY | OVERLONG_2,
+	CARRY,
+	CARRY,
+	CARRY | TOO_LARGE,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000
+};
+
+/* Indexed by the high nibble of the current byte */
+static const unsigned char CURRENT_BYTE_HIGH_ERRORS[16] = {
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | OVERLONG_3 |
+	    TOO_LARGE_1000 | OVERLONG_4,
+	TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | OVERLONG_3 | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | SURROGATE | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTINUATIONS | SURROGATE | TOO_LARGE,
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+};
+
+#undef CARRY
+#undef TWO_CONTINUATIONS
+#undef OVERLONG_4
+#undef TOO_LARGE_1000
+#undef OVERLONG_2
+#undef SURROGATE
+#undef TOO_LARGE
+#undef OVERLONG_3
+#undef TOO_LONG
+#undef TOO_SHORT
+
+#endif
+
+#if defined(__SSE2__)
+
+/*
+ * The bytes that must not be the last, second to last and third to last byte
+ * of a block are those above the respective entries at the block's end.
+ */
+static const unsigned char INCOMPLETE_CHARACTER_LIMITS[32] = {
+	255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 0xEF, 0xDF, 0xBF
+};
+
+static unsigned long getAcceptedBlockLength(unsigned long errorMask,
+					    unsigned long stopMask,
+					    unsigned long characterStartMask,
+					    unsigned long *codepointCount);
+
+static unsigned long countTrailingZeros(unsigned long mask);
+
+static unsigned long countBits(unsigned long mask);
+
+/*
+ * See
+ * https://graphics.stanford.edu/~seander/bithacks.html#ZerosOnRightMultLookup
+ */
+static const unsigned char DE_BRUIJN_BIT_POSITIONS[32] = {
+	0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+	31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+};
+
+/*
+ * Returns the length of the leading part of a block that consists of the
+ * well-formed characters, given the bit masks of the block's bytes that
+ * report an error (ill-formed sequences and Unicode whitespace), that stop
+ * the text (ASCII special bytes and the start of the incomplete trailing
+ * character), and that start a character.
+ *
+ * An error is reported up to three bytes after the start of the character
+ * it affects, while no character may contain a byte starting a character,
+ * so only the characters before the last character start preceding the
+ * first error are known to be well-formed.
+ */
+static unsigned long getAcceptedBlockLength(errorMask, stopMask,
+					    characterStartMask, codepointCount)
+unsigned long errorMask;
+unsigned long stopMask;
+unsigned long characterStartMask;
+unsigned long *codepointCount;
+{
+	unsigned long acceptedLength = stopMask == 0 ?
+	    BYTE_SCANNER_BLOCK_SIZE : countTrailingZeros(stopMask);
+	unsigned long errorIndex;
+	unsigned long acceptedMask;
+
+	if (errorMask != 0) {
+		errorIndex = countTrailingZeros(errorMask);
+		if (errorIndex <= acceptedLength) {
+			acceptedMask = characterStartMask &
+			    (((unsigned long)1 << errorIndex) - 1);
+			acceptedMask |= acceptedMask >> 1;
+			acceptedMask |= acceptedMask >> 2;
+			acceptedMask |= acceptedMask >> 4;
+			acceptedMask |= acceptedMask >> 8;
+			acceptedMask |= acceptedMask >> 16;
+			acceptedLength =
+			    acceptedMask == 0 ? 0 : countBits(acceptedMask) - 1;
+		}
+	}
+
+	if (codepointCount != NULL) {
+		acceptedMask = acceptedLength == BYTE_SCANNER_BLOCK_SIZE ?
+		    characterStartMask : characterStartMask &
+		    (((unsigned long)1 << acceptedLength) - 1);
+		*codepointCount = countBits(acceptedMask);
+	}
+	return acceptedLength;
+}
+
+static unsigned long countTrailingZeros(mask)
+unsigned long mask;
+{
+	/* The multiplication moves a unique 5-bit pattern to the top bits */
+	return DE_BRUIJN_BIT_POSITIONS[(((mask & (~mask + 1)) * 0x077CB531) &
+					0xFFFFFFFF) >> 27];
+}
+
+static unsigned long countBits(mask)
+unsigned long mask;
+{
+	mask = mask - ((mask >> 1) & 0x55555555);
+	mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+	mask = (mask + (mask >> 4)) & 0x0F0F0F0F;
+	return ((mask * 0x01010101) & 0xFFFFFFFF) >> 24;
+}
+
+#endif
+
+#if defined(__AVX2__)
+
+#define EQ(bytes, n) _mm256_cmpeq_epi8((bytes), _mm256_set1_epi8((char)(n)))
+#define AT_MOST(bytes, n) \
+	_mm256_cmpeq_epi8(_mm256_min_epu8((bytes), \
+		_mm256_set1_epi8((char)(n))), (bytes))
+#define MASK_OF_ZEROS(bytes) \
+	((unsigned long)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8( \
+		(bytes), _mm256_setzero_si256())))
+
+static unsigned long getUtf8TextBlockLength(block, codepointCount)
+const unsigned char *block;
+unsigned long *codepointCount;
+{
+	__m256i bytes = _mm256_loadu_si256((const __m256i *)block);
+	__m256i lowNibbles = _mm256_set1_epi8(0x0F);
+	__m256i special;
+	__m256i shifted;
+	__m256i preceding1;
+	__m256i preceding2;
+	__m256i preceding3;
+	__m256i errors;
+	__m256i continuations;
+	__m256i limits;
+	unsigned long blockMask = 0xFFFFFFFF;
+	unsigned long stopMask;
+	unsigned long characterStartMask;
+	unsigned long acceptedLength;
+
+	/* '\0' - '\r' (conservatively), ' ', '<' and '>' */
+	special = AT_MOST(bytes, 13);
+	special = _mm256_or_si256(special, EQ(bytes, ' '));
+	special = _mm256_or_si256(special, EQ(bytes, '<'));
+	special = _mm256_or_si256(special, EQ(bytes, '>'));
+	stopMask = (unsigned int)_mm256_movemask_epi8(special);
+	if (_mm256_movemask_epi8(bytes) == 0) {
+		acceptedLength = stopMask == 0 ? BYTE_SCANNER_BLOCK_SIZE :
+		    countTrailingZeros(stopMask);
+		if (codepointCount != NULL) {
+			*codepointCount = acceptedLength;
+		}
+		return acceptedLength;
+	}
+
+	/* The low lane of the block preceded by zeros, i.e. ASCII */
+	shifted = _mm256_permute2x128_si256(bytes, bytes, 0x08);
+	preceding1 = _mm256_alignr_epi8(bytes, shifted, 15);
+	preceding2 = _mm256_alignr_epi8(bytes, shifted, 14);
+	preceding3 = _mm256_alignr_epi8(bytes, shifted, 13);
+
+	errors =
+	    _mm256_shuffle_epi8(_mm256_broadcastsi128_si256
+				(_mm_loadu_si128
+				 ((const __m128i *)PRECEDING_BYTE_HIGH_ERRORS)),
+				_mm256_and_si256(_mm256_srli_epi16
+						 (preceding1, 4), lowNibbles));
+	errors =
+	    _mm256_and_si256(errors,
+			     _mm256_shuffle_epi8(_mm256_broadcastsi128_si256
+						 (_mm_loadu_si128
+						  ((const __m128i *)
+						   PRECEDING_BYTE_LOW_ERRORS)),
+						 _mm256_and_si256(preceding1,
+								  lowNibbles)));
+	errors =
+	    _mm256_and_si256(errors,
+			     _mm256_shuffle_epi8(_mm256_broadcastsi128_si256
+						 (_mm_loadu_si128
+						  ((const __m128i *)
+						   CURRENT_BYTE_HIGH_ERRORS)),
+						 _mm256_and_si256
+						 (_mm256_srli_epi16(bytes, 4),
+						  lowNibbles)));
+
+	/* The bytes two or three positions after a 3- or 4-byte lead */
+	continuations =
+	    _mm256_or_si256(_mm256_subs_epu8
+			    (preceding2, _mm256_set1_epi8((char)(0xE0 - 1))),
+			    _mm256_subs_epu8(preceding3,
+					     _mm256_set1_epi8((char)(0xF0 -
+								     1))));
+	continuations =
+	    _mm256_and_si256(_mm256_cmpgt_epi8
+			     (continuations, _mm256_setzero_si256()),
+			     _mm256_set1_epi8((char)0x80));
+	errors = _mm256_xor_si256(errors, continuations);
+
+	/*
+	 * The last bytes of the Unicode whitespace, conservatively for the
+	 * rarely used 0xE1 0x9A and 0xE2 0x81 prefixes.
+	 */
+	errors =
+	    _mm256_or_si256(errors,
+			    _mm256_and_si256(EQ(preceding1, 0xC2),
+					     _mm256_or_si256(EQ(bytes, 0x85),
+							     EQ(bytes, 0xA0))));
+	errors =
+	    _mm256_or_si256(errors,
+			    _mm256_and_si256(EQ(preceding1, 0xE1),
+					     EQ(bytes, 0x9A)));
+	errors =
+	    _mm256_or_si256(errors,
+			    _mm256_and_si256(EQ(preceding1, 0xE2),
+					     EQ(bytes, 0x81)));
+	continuations =
+	    _mm256_or_si256(_mm256_or_si256(AT_MOST(bytes, 0x8A),
+					    EQ(bytes, 0xA8)),
+			    _mm256_or_si256(EQ(bytes, 0xA9), EQ(bytes, 0xAF)));
+	errors =
+	    _mm256_or_si256(errors,
+			    _mm256_and_si256(_mm256_and_si256
+					     (EQ(preceding2, 0xE2),
+					      EQ(preceding1, 0x80)),
+					     continuations));
+	errors =
+	    _mm256_or_si256(errors,
+			    _mm256_and_si256(_mm256_and_si256
+					     (EQ(preceding2, 0xE3),
+					      EQ(preceding1, 0x80)),
+					     EQ(bytes, 0x80)));
+
+	limits =
+	    _mm256_loadu_si256((const __m256i *)INCOMPLETE_CHARACTER_LIMITS);
+	stopMask |= ~MASK_OF_ZEROS(_mm256_subs_epu8(bytes, limits)) & blockMask;
+
+	/* Bytes 0x80 - 0xBF are below -64 as signed */
+	characterStartMask =
+	    MASK_OF_ZEROS(_mm256_cmpgt_epi8(_mm256_set1_epi8(-64), bytes));
+	return getAcceptedBlockLength(~MASK_OF_ZEROS(errors) & blockMask,
+				      stopMask, characterStartMask,
+				      codepointCount);
+}
+
+#undef MASK_OF_ZEROS
+#undef AT_MOST
+#undef EQ
+
+#else
+#if defined(__SSE2__)
+
+#define EQ(bytes, n) _mm_cmpeq_epi8((bytes), _mm_set1_epi8((char)(n)))
+#define AT_MOST(bytes, n) \
+	_mm_cmpeq_epi8(_mm_min_epu8((bytes), _mm_set1_epi8((char)(n))), \
+		(bytes))
+#define AT_LEAST(bytes, n) \
+	_mm_cmpeq_epi8(_mm_max_epu8((bytes), _mm_set1_epi8((char)(n))), \
+		(bytes))
+#define MASK_OF_ZEROS(bytes) \
+	((unsigned long)_mm_movemask_epi8(_mm_cmpeq_epi8((bytes), \
+		_mm_setzero_si128())))
+
+static unsigned long getUtf8TextBlockLength(block, codepointCount)
+const unsigned char *block;
+unsigned long *codepointCount;
+{
+	__m128i bytes = _mm_loadu_si128((const __m128i *)block);
+	__m128i special;
+	__m128i preceding1;
+	__m128i preceding2;
+	__m128i preceding3;
+	__m128i errors;
+	__m128i continuations;
+	__m128i limits;
+	unsigned long blockMask = 0xFFFF;
+	unsigned long stopMask;
+	unsigned long characterStartMask;
+	unsigned long acceptedLength;
+
+	/* '\0' - '\r' (conservatively), ' ', '<' and '>' */
+	special = AT_MOST(bytes, 13);
+	special = _mm_or_si128(special, EQ(bytes, ' '));
+	special = _mm_or_si128(special, EQ(bytes, '<'));
+	special = _mm_or_si128(special, EQ(bytes, '>'));
+	stopMask = (unsigned long)_mm_movemask_epi8(special);
+	if (_mm_movemask_epi8(bytes) == 0) {
+		acceptedLength = stopMask == 0 ? BYTE_SCANNER_BLOCK_SIZE :
+		    countTrailingZeros(stopMask);
+		if (codepointCount != NULL) {
+			*codepointCount = acceptedLength;
+		}
+		return acceptedLength;
+	}
+
+	/* The block preceded by zeros, i.e. ASCII */
+	preceding1 = _mm_slli_si128(bytes, 1);
+	preceding2 = _mm_slli_si128(bytes, 2);
+	preceding3 = _mm_slli_si128(bytes, 3);
+
+#if defined(__SSSE3__)
+	errors =
+	    _mm_shuffle_epi8(_mm_loadu_si128
+			     ((const __m128i *)PRECEDING_BYTE_HIGH_ERRORS),
+			     _mm_and_si128(_mm_srli_epi16(preceding1, 4),
+					   _mm_set1_epi8(0x0F)));
+	errors =
+	    _mm_and_si128(errors,
+			  _mm_shuffle_epi8(_mm_loadu_si128
+					   ((const __m128i *)
+					    PRECEDING_BYTE_LOW_ERRORS),
+					   _mm_and_si128(preceding1,
+							 _mm_set1_epi8(0x0F))));
+	errors =
+	    _mm_and_si128(errors,
+			  _mm_shuffle_epi8(_mm_loadu_si128
+					   ((const __m128i *)
+					    CURRENT_BYTE_HIGH_ERRORS),
+					   _mm_and_si128(_mm_srli_epi16
+							 (bytes, 4),
+							 _mm_set1_epi8(0x0F))));
+
+	/* The bytes two or three positions after a 3- or 4-byte lead */
+	continuations =
+	    _mm_or_si128(_mm_subs_epu8(preceding2,
+				       _mm_set1_epi8((char)(0xE0 - 1))),
+			 _mm_subs_epu8(preceding3,
+				       _mm_set1_epi8((char)(0xF0 - 1))));
+	continuations =
+	    _mm_and_si128(_mm_cmpgt_epi8(continuations, _mm_setzero_si128()),
+			  _mm_set1_epi8((char)0x80));
+	errors = _mm_xor_si128(errors, continuations);
+#else
+	/* Bytes 0x80 - 0xBF are below -64 as signed */
+	continuations = _mm_cmplt_epi8(bytes, _mm_set1_epi8(-64));
+	errors =
+	    _mm_or_si128(_mm_or_si128(AT_LEAST(preceding1, 0xC0),
+				      AT_LEAST(preceding2, 0xE0)),
+			 AT_LEAST(preceding3, 0xF0));
+	errors = _mm_xor_si128(errors, continuations);
+
+	/* Lead bytes of overlong encodings and codepoints above U+10FFFF */
+	errors =
+	    _mm_or_si128(errors,
+			 _mm_or_si128(EQ(bytes, 0xC0), EQ(bytes, 0xC1)));
+	errors = _mm_or_si128(errors, AT_LEAST(bytes, 0xF5));
+
+	/* The restricted second byte ranges */
+	errors =
+	    _mm_or_si128(errors,
+			 _mm_and_si128(EQ(preceding1, 0xE0),
+				       AT_MOST(bytes, 0x9F)));
+	errors =
+	    _mm_or_si128(errors,
+			 _mm_and_si128(EQ(preceding1, 0xED),
+				       AT_LEAST(bytes, 0xA0)));
+	errors =
+	    _mm_or_si128(errors,
+			 _mm_and_si128(EQ(preceding1, 0xF0),
+				       AT_MOST(bytes, 0x8F)));
+	errors =
+	    _mm_or_si128(errors,
+			 _mm_and_si128(EQ(preceding1, 0xF4),
+				       AT_LEAST(bytes, 0x90)));
+#endif
+
+	/*
+	 * The last bytes of the Unicode whitespace, conservatively for the
+	 * rarely used 0xE1 0x9A and 0xE2 0x81 prefixes.
+	 */
+	errors =
+	    _mm_or_si128(errors,
+			 _mm_and_si128(EQ(preceding1, 0xC2),
+				       _mm_or_si128(EQ(bytes, 0x85),
+						    EQ(bytes, 0xA0))));
+	errors =
+	    _mm_or_si128(errors,
+			 _mm_and_si128(EQ(preceding1, 0xE1), EQ(bytes, 0x9A)));
+	errors =
+	    _mm_or_si128(errors,
+			 _mm_and_si128(EQ(preceding1, 0xE2), EQ(bytes, 0x81)));
+	continuations =
+	    _mm_or_si128(_mm_or_si128(AT_MOST(bytes, 0x8A), EQ(bytes, 0xA8)),
+			 _mm_or_si128(EQ(bytes, 0xA9), EQ(bytes, 0xAF)));
+	errors =
+	    _mm_or_si128(errors,
+			 _mm_and_si128(_mm_and_si128(EQ(preceding2, 0xE2),
+						     EQ(preceding1, 0x80)),
+				       continuations));
+	errors =
+	    _mm_or_si128(errors,
+			 _mm_and_si128(_mm_and_si128(EQ(preceding2, 0xE3),
+						     EQ(preceding1, 0x80)),
+				       EQ(bytes, 0x80)));
+
+	limits =
+	    _mm_loadu_si128((const __m128i *)(INCOMPLETE_CHARACTER_LIMITS +
+					      16));
+	stopMask |= ~MASK_OF_ZEROS(_mm_subs_epu8(bytes, limits)) & blockMask;
+
+	/* Bytes 0x80 - 0xBF are below -64 as signed */
+	characterStartMask =
+	    MASK_OF_ZEROS(_mm_cmplt_epi8(bytes, _mm_set1_epi8(-64)));
+	return getAcceptedBlockLength(~MASK_OF_ZEROS(errors) & blockMask,
+				      stopMask, characterStartMask,
+				      codepointCount);
+}
+
+#undef MASK_OF_ZEROS
+#undef AT_LEAST
+#undef AT_MOST
+#undef EQ
+
+#else
+
+static unsigned long getUtf8TextBlockLength(block, codepointCount)
+const unsigned char *block;
+unsigned long *codepointCount;
+{
+	/* Only the ASCII blocks are accepted at once */
+	unsigned long acceptedLength =
+	    isPlainTextBlock(block) ? BYTE_SCANNER_BLOCK_SIZE : 0;
+
+	if (codepointCount != NULL) {
+		*codepointCount = acceptedLength;
+	}
+	return acceptedLength;
+}
+
+#endif
+#endif
+
+static bool isPlainTextByte(byte)
+unsigned char byte;
+{
+	switch (byte) {
+	case '<':
+	case '>':
+	case ' ':
+	case '\t':
+	case '\n':
+	case '\v':
+	case '\f':
+	case '\r':
+		return false;
+	default:
+		return byte < 128;
+	}
+}
+
+static bool isBoundaryByte(byte)
+unsigned char byte;
+{
+	switch (byte) {
+	case '<':
+	case ' ':
+	case '\t':
+	case '\n':
+	case '\v':
+	case '\f':
+	case '\r':
+	case 0xA0:
+	case 0xC2:
+	case 0xE1:
+	case 0xE2:
+	case 0xE3:
+		return true;
+	default:
+		return false;
+	}
+}
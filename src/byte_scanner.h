@@ -0,0 +1,64 @@
+#ifndef BYTE_SCANNER_HEADER_FILE
+#define BYTE_SCANNER_HEADER_FILE 1
+
+#include "bool.h"
+
+/*
+ * Scanning kernels used to skip over the parts of the input that require no
+ * special handling by the tokenizer or the transcoder. The kernels process
+ * the input in blocks
+ * using the SSE2 or AVX2 instructions if the compiler targets a CPU
+ * supporting them, or a portable word-at-a-time (SWAR) implementation
+ * otherwise.
+ */
+
+/*
+ * Returns the number of leading bytes of the provided input that are ASCII
+ * characters that cannot start a command, end a command or form whitespace,
+ * that is all ASCII characters except for '<', '>', ' ', '\t', '\n', '\v',
+ * '\f' and '\r'. Every such byte is a single codepoint in all supported
+ * encodings.
+ */
+unsigned long getPlainTextLength(const unsigned char *bytes,
+				 unsigned long length);
+
+/*
+ * Returns the number of leading bytes of the provided input that are ASCII
+ * characters, that is bytes below 128.
+ */
+unsigned long getAsciiLength(const unsigned char *bytes, unsigned long length);
+
+/*
+ * Returns the number of leading bytes of the provided UTF-8 input that form
+ * well-formed characters that cannot start a command, end a command or form
+ * whitespace, and stores the number of these characters in codepointCount.
+ * Scanning is stopped at the first ill-formed or incomplete sequence, the
+ * block implementations validate and count the characters of a whole block
+ * at once. The characters are not counted if codepointCount is NULL.
+ */
+unsigned long getUtf8TextLength(const unsigned char *bytes,
+				unsigned long length,
+				unsigned long *codepointCount);
+
+/*
+ * Returns the length of the UTF-8 sequence at the start of the provided
+ * input and sets isWellFormed to indicate whether the sequence is a
+ * well-formed character (see the Table 3-7 of the Unicode Standard). An
+ * ill-formed sequence is the lead byte followed by the continuation bytes
+ * that may follow it in a well-formed character (the maximal subpart), or
+ * just the first byte if it cannot start a character.
+ */
+unsigned long getUtf8SequenceLength(const unsigned char *bytes,
+				    unsigned long length, bool *isWellFormed);
+
+/*
+ * Returns the number of bytes of the provided input that may start a command
+ * or a whitespace character in any of the supported encodings, that is '<',
+ * '\t' - '\r', ' ', 0xA0, 0xC2 and 0xE1 - 0xE3. Every token boundary starts
+ * with such a byte, so this provides an upper bound for the number of tokens
+ * (see estimateTokenCount).
+ */
+unsigned long countBoundaryBytes(const unsigned char *bytes,
+				 unsigned long length);
+
+#endif
@@ -1,6 +1,205 @@
-int main(void);
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../bool.h"
+#include "../input_file.h"
+#include "../processor.h"
+#include "../string.h"
+#include "../text_renderer.h"
 
-int main()
+#define STANDARD_INPUT_FILE_DESCRIPTOR 0
+
+#define EXIT_CODE_PROCESSING_FAILURE 1
+#define EXIT_CODE_USAGE_OR_INPUT_FAILURE 2
+
+int main(int argc, char *argv[]);
+
+static void printUsage(FILE * stream, char *programName);
+
+static void reportError(char *programName, ProcessorResult * result);
+
+static unsigned long countWarnings(ProcessorResult * result);
+
+static void freeProcessorResult(ProcessorResult * result);
+
+int main(argc, argv)
+int argc;
+char *argv[];
 {
+	char *programName = argc > 0 ? argv[0] : "richtext";
+	char *path = NULL;
+	bool isUtf8 = true;
+	bool caseInsensitiveCommands = true;
+	InputFile *file;
+	ProcessorOptions options;
+	ProcessorResult *result;
+	unsigned long warningCount;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-a") == 0) {
+			isUtf8 = false;
+		} else if (strcmp(argv[i], "-c") == 0) {
+			caseInsensitiveCommands = false;
+		} else if (strcmp(argv[i], "-h") == 0) {
+			printUsage(stdout, programName);
+			return 0;
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			printUsage(stderr, programName);
+			return EXIT_CODE_USAGE_OR_INPUT_FAILURE;
+		} else if (path == NULL) {
+			path = argv[i];
+		} else {
+			printUsage(stderr, programName);
+			return EXIT_CODE_USAGE_OR_INPUT_FAILURE;
+		}
+	}
+
+	if (path == NULL || strcmp(path, "-") == 0) {
+		path = "standard input";
+		file = InputFile_fromDescriptor(STANDARD_INPUT_FILE_DESCRIPTOR);
+	} else {
+		file = InputFile_open(path);
+	}
+	if (file == NULL) {
+		fprintf(stderr, "%s: out of memory\n", programName);
+		return EXIT_CODE_USAGE_OR_INPUT_FAILURE;
+	}
+	if (file->errorCode != InputFileErrorCode_OK) {
+		fprintf(stderr, "%s: cannot %s %s: %s\n", programName,
+			file->errorCode == InputFileErrorCode_CANNOT_OPEN_FILE ?
+			"open" : "read", path,
+			file->systemErrorCode != 0 ?
+			strerror(file->systemErrorCode) : "out of memory");
+		InputFile_free(file);
+		return EXIT_CODE_USAGE_OR_INPUT_FAILURE;
+	}
+
+	/* Binary input may trigger a warning for nearly every byte */
+	options.warningPolicy.type = WarningPolicyType_COALESCE_RUNS;
+	options.warningPolicy.limit = 0;
+	options.maxNestingDepth = 0;
+	/* The text renderer does not use the codepoint indexes of the nodes */
+	options.lazyCodepointIndexes = true;
+	result = processWithOptions(&file->content, isUtf8,
+				    caseInsensitiveCommands, NULL, NULL,
+				    renderText, &caseInsensitiveCommands,
+				    &options);
+	if (result == NULL) {
+		fprintf(stderr, "%s: out of memory\n", programName);
+		InputFile_free(file);
+		return EXIT_CODE_PROCESSING_FAILURE;
+	}
+
+	warningCount = countWarnings(result);
+	if (warningCount > 0) {
+		fprintf(stderr, "%s: %s: %lu warning(s)\n", programName, path,
+			warningCount);
+	}
+	if (result->type != ProcessorResultType_SUCCESS) {
+		reportError(programName, result);
+		freeProcessorResult(result);
+		InputFile_free(file);
+		return EXIT_CODE_PROCESSING_FAILURE;
+	}
+
+	if (fwrite(result->result.output->content, 1,
+		   result->result.output->length,
+		   stdout) != result->result.output->length
+	    || fflush(stdout) != 0) {
+		fprintf(stderr, "%s: cannot write the output\n", programName);
+		freeProcessorResult(result);
+		InputFile_free(file);
+		return EXIT_CODE_PROCESSING_FAILURE;
+	}
+
+	freeProcessorResult(result);
+	InputFile_free(file);
 	return 0;
 }
+
+static void printUsage(stream, programName)
+FILE *stream;
+char *programName;
+{
+	fprintf(stream, "Usage: %s [-a] [-c] [-h] [FILE]\n", programName);
+	fprintf(stream, "Converts the text/richtext FILE (or the standard ");
+	fprintf(stream, "input if FILE is - or\nmissing) to plain text.\n\n");
+	fprintf(stream, "  -a  the input is US-ASCII outside of encoding ");
+	fprintf(stream, "commands, not UTF-8\n");
+	fprintf(stream, "  -c  command names are case-sensitive\n");
+	fprintf(stream, "  -h  print this help and exit\n");
+}
+
+static void reportError(programName, result)
+char *programName;
+ProcessorResult *result;
+{
+	switch (result->type) {
+	case ProcessorResultType_TOKENIZER_ERROR:
+		fprintf(stderr,
+			"%s: tokenizer error %d at byte %lu (codepoint %lu)\n",
+			programName, (int)result->result.tokenizerError.code,
+			result->result.tokenizerError.byteIndex,
+			result->result.tokenizerError.codepointIndex);
+		break;
+	case ProcessorResultType_PARSER_ERROR:
+		fprintf(stderr,
+			"%s: parser error %d at byte %lu (codepoint %lu)\n",
+			programName, (int)result->result.parserError.code,
+			result->result.parserError.byteIndex,
+			result->result.parserError.codepointIndex);
+		break;
+	case ProcessorResultType_LAYOUT_RESOLVER_ERROR:
+		/* The node causing the error has been freed already */
+		fprintf(stderr, "%s: layout resolver error %d\n", programName,
+			(int)result->result.layoutResolverError.code);
+		break;
+	case ProcessorResultType_POST_PROCESSOR_ERROR:
+		fprintf(stderr, "%s: layout post-processor error %u\n",
+			programName,
+			result->result.layoutPostProcessorError.code);
+		break;
+	case ProcessorResultType_OUTPUT_RENDERER_ERROR:
+		fprintf(stderr, "%s: output renderer error %u\n", programName,
+			result->result.outputRendererError.code);
+		break;
+	default:
+		fprintf(stderr, "%s: processor error %d\n", programName,
+			(int)result->result.processorError);
+		break;
+	}
+}
+
+/* The text renderer reports no warnings and no post-processor is used */
+static unsigned long countWarnings(result)
+ProcessorResult *result;
+{
+	unsigned long count = 0;
+	unsigned long i;
+
+	for (i = 0; result->tokenizerWarnings != NULL
+	     && i < result->tokenizerWarnings->size.length; i++) {
+		count += result->tokenizerWarnings->items[i].count;
+	}
+	for (i = 0; result->layoutResolverWarnings != NULL
+	     && i < result->layoutResolverWarnings->size.length; i++) {
+		count += result->layoutResolverWarnings->items[i].count;
+	}
+
+	return count;
+}
+
+static void freeProcessorResult(result)
+ProcessorResult *result;
+{
+	if (result->type == ProcessorResultType_SUCCESS) {
+		string_free(result->result.output);
+	}
+	TokenizerWarningVector_free(result->tokenizerWarnings);
+	LayoutResolverWarningVector_free(result->layoutResolverWarnings);
+	LayoutPostProcessorWarningVector_free
+	    (result->layoutPostProcessorWarnings);
+	OutputRendererWarningVector_free(result->outputRendererWarnings);
+	free(result);
+}
@@ -0,0 +1,319 @@
+#include <stdlib.h>
+#include "bool.h"
+#include "byte_scanner.h"
+#include "codepoint_index.h"
+#include "typed_vector.h"
+
+typedef struct CodepointCheckpoint {
+	unsigned long byteIndex;
+	unsigned long codepointIndex;
+} CodepointCheckpoint;
+
+Vector_ofType(CodepointCheckpoint)
+typedef struct EncodingChange {
+	unsigned long byteIndex;
+	bool isUtf8;
+} EncodingChange;
+
+Vector_ofType(EncodingChange)
+struct CodepointIndex {
+	const unsigned char *input;
+	unsigned long length;
+	/* Ordered by the byte index, the first change is at the start */
+	EncodingChangeVector *encodingChanges;
+	/* Ordered by the byte index, the first checkpoint is at the start */
+	CodepointCheckpointVector *checkpoints;
+};
+
+static void addCheckpoints(CodepointIndex *index, unsigned long byteIndex);
+
+static unsigned long countCodepoints(CodepointIndex *index,
+				     unsigned long from, unsigned long to,
+				     unsigned long *end);
+
+static unsigned long countUtf8Codepoints(const unsigned char *bytes,
+					 unsigned long length,
+					 unsigned long limit,
+					 unsigned long *end);
+
+static EncodingChange *getEncodingChange(CodepointIndex *index,
+					 unsigned long byteIndex);
+
+CodepointIndex *CodepointIndex_new(input, length, isUtf8)
+const unsigned char *input;
+unsigned long length;
+bool isUtf8;
+{
+	CodepointIndex *index = malloc(sizeof(CodepointIndex));
+	EncodingChange encodingChange;
+	CodepointCheckpoint checkpoint;
+
+	if (index == NULL) {
+		return NULL;
+	}
+
+	index->input = input;
+	index->length = length;
+	encodingChange.byteIndex = 0;
+	encodingChange.isUtf8 = isUtf8;
+	index->encodingChanges = EncodingChangeVector_of1(encodingChange);
+	checkpoint.byteIndex = 0;
+	checkpoint.codepointIndex = 0;
+	index->checkpoints = CodepointCheckpointVector_of1(checkpoint);
+	if (index->encodingChanges == NULL || index->checkpoints == NULL) {
+		CodepointIndex_free(index);
+		return NULL;
+	}
+
+	return index;
+}
+
+bool CodepointIndex_setEncoding(index, byteIndex, isUtf8)
+CodepointIndex *index;
+unsigned long byteIndex;
+bool isUtf8;
+{
+	EncodingChangeVector *encodingChanges;
+	EncodingChange encodingChange;
+	CodepointCheckpointVector *checkpoints;
+	CodepointCheckpoint removedCheckpoint;
+
+	if (index == NULL) {
+		return false;
+	}
+
+	encodingChanges = index->encodingChanges;
+	if (encodingChanges->items[encodingChanges->size.length - 1].isUtf8 ==
+	    isUtf8) {
+		return true;
+	}
+
+	/* The following checkpoints were counted in the previous encoding */
+	checkpoints = index->checkpoints;
+	while (checkpoints->size.length > 1 &&
+	       checkpoints->items[checkpoints->size.length - 1].byteIndex >
+	       byteIndex) {
+		CodepointCheckpointVector_pop(checkpoints, &removedCheckpoint);
+	}
+
+	encodingChange.byteIndex = byteIndex;
+	encodingChange.isUtf8 = isUtf8;
+	encodingChanges =
+	    EncodingChangeVector_append(encodingChanges, &encodingChange);
+	if (encodingChanges == NULL) {
+		return false;
+	}
+	index->encodingChanges = encodingChanges;
+
+	return true;
+}
+
+bool CodepointIndex_merge(index, other, byteIndex)
+CodepointIndex *index;
+CodepointIndex *other;
+unsigned long byteIndex;
+{
+	EncodingChange *encodingChange;
+	unsigned long i;
+
+	if (index == NULL || other == NULL) {
+		return false;
+	}
+
+	encodingChange = other->encodingChanges->items;
+	for (i = 0; i < other->encodingChanges->size.length;
+	     i++, encodingChange++) {
+		if (!CodepointIndex_setEncoding(index,
+						i == 0 ? byteIndex :
+						encodingChange->byteIndex,
+						encodingChange->isUtf8)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+unsigned long CodepointIndex_of(index, byteIndex)
+CodepointIndex *index;
+unsigned long byteIndex;
+{
+	CodepointCheckpoint *checkpoints;
+	unsigned long low = 0;
+	unsigned long high;
+	unsigned long middle;
+	unsigned long end;
+
+	if (index == NULL) {
+		return 0;
+	}
+	if (byteIndex > index->length) {
+		byteIndex = index->length;
+	}
+
+	addCheckpoints(index, byteIndex);
+
+	checkpoints = index->checkpoints->items;
+	high = index->checkpoints->size.length;
+	while (high - low > 1) {
+		middle = low + (high - low) / 2;
+		if (checkpoints[middle].byteIndex <= byteIndex) {
+			low = middle;
+		} else {
+			high = middle;
+		}
+	}
+
+	return checkpoints[low].codepointIndex +
+	    countCodepoints(index, checkpoints[low].byteIndex, byteIndex, &end);
+}
+
+void CodepointIndex_free(index)
+CodepointIndex *index;
+{
+	if (index == NULL) {
+		return;
+	}
+
+	EncodingChangeVector_free(index->encodingChanges);
+	CodepointCheckpointVector_free(index->checkpoints);
+	free(index);
+}
+
+/*
+ * Adds the checkpoints preceding the provided byte index that have not been
+ * counted yet.
+ */
+static void addCheckpoints(index, byteIndex)
+CodepointIndex *index;
+unsigned long byteIndex;
+{
+	CodepointCheckpointVector *checkpoints = index->checkpoints;
+	CodepointCheckpoint checkpoint;
+	unsigned long distance = CODEPOINT_INDEX_CHECKPOINT_DISTANCE;
+
+	checkpoint = checkpoints->items[checkpoints->size.length - 1];
+	while (checkpoint.byteIndex + distance <= byteIndex) {
+		checkpoint.codepointIndex +=
+		    countCodepoints(index, checkpoint.byteIndex,
+				    checkpoint.byteIndex + distance,
+				    &checkpoint.byteIndex);
+		checkpoints =
+		    CodepointCheckpointVector_append(checkpoints, &checkpoint);
+		if (checkpoints == NULL) {
+			/* The queries will count from the last checkpoint */
+			return;
+		}
+		index->checkpoints = checkpoints;
+	}
+}
+
+/*
+ * Returns the number of characters starting at the byte indexes from - to
+ * (exclusive), and sets end to the byte index following the last of them.
+ * The from byte index must be a character boundary.
+ */
+static unsigned long countCodepoints(index, from, to, end)
+CodepointIndex *index;
+unsigned long from;
+unsigned long to;
+unsigned long *end;
+{
+	EncodingChange *encodingChange = getEncodingChange(index, from);
+	EncodingChange *lastEncodingChange = index->encodingChanges->items +
+	    index->encodingChanges->size.length - 1;
+	unsigned long segmentEnd;
+	unsigned long limit;
+	unsigned long length;
+	unsigned long count = 0;
+
+	while (from < to) {
+		segmentEnd = encodingChange < lastEncodingChange ?
+		    (encodingChange + 1)->byteIndex : index->length;
+		limit = to < segmentEnd ? to : segmentEnd;
+		if (encodingChange->isUtf8) {
+			count +=
+			    countUtf8Codepoints(index->input + from,
+						segmentEnd - from, limit - from,
+						&length);
+		} else {
+			/* Every byte is a codepoint in single-byte encodings */
+			length = limit - from;
+			count += length;
+		}
+
+		from += length;
+		if (from >= segmentEnd) {
+			encodingChange++;
+		}
+	}
+
+	*end = from;
+	return count;
+}
+
+/*
+ * Counts the UTF-8 characters starting before the limit, the same way the
+ * tokenizer does, and sets end to the length of these characters.
+ */
+static unsigned long countUtf8Codepoints(bytes, length, limit, end)
+const unsigned char *bytes;
+unsigned long length;
+unsigned long limit;
+unsigned long *end;
+{
+	unsigned long index = 0;
+	unsigned long count = 0;
+	unsigned long textCodepoints;
+	bool isWellFormed;
+
+	while (index < limit) {
+		index += getUtf8TextLength(bytes + index, limit - index,
+					   &textCodepoints);
+		count += textCodepoints;
+		if (index >= limit) {
+			break;
+		}
+
+		/*
+		 * Whitespace, a command delimiter, an unexpected continuation
+		 * byte, an ill-formed sequence or a character crossing the
+		 * limit.
+		 */
+		if (bytes[index] <= 192) {
+			index++;
+		} else {
+			index += getUtf8SequenceLength(bytes + index,
+						       length - index,
+						       &isWellFormed);
+		}
+		count++;
+	}
+
+	*end = index;
+	return count;
+}
+
+static EncodingChange *getEncodingChange(index, byteIndex)
+CodepointIndex *index;
+unsigned long byteIndex;
+{
+	EncodingChange *encodingChanges = index->encodingChanges->items;
+	unsigned long low = 0;
+	unsigned long high = index->encodingChanges->size.length;
+	unsigned long middle;
+
+	while (high - low > 1) {
+		middle = low + (high - low) / 2;
+		if (encodingChanges[middle].byteIndex <= byteIndex) {
+			low = middle;
+		} else {
+			high = middle;
+		}
+	}
+
+	return encodingChanges + low;
+}
+
+Vector_ofTypeImplementation(CodepointCheckpoint)
+    Vector_ofTypeImplementation(EncodingChange)
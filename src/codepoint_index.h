@@ -0,0 +1,68 @@
+#ifndef CODEPOINT_INDEX_HEADER_FILE
+#define CODEPOINT_INDEX_HEADER_FILE 1
+
+#include "bool.h"
+
+/*
+ * The approximate distance (in bytes of the input) between two consecutive
+ * checkpoints of a codepoint index. The checkpoints are placed at character
+ * boundaries, so the actual distance may be up to 3 bytes longer.
+ */
+#define CODEPOINT_INDEX_CHECKPOINT_DISTANCE 4096
+
+/*
+ * A sparse index mapping the byte indexes of a tokenized input to codepoint
+ * indexes, used when the tokenizer does not count the codepoints itself (see
+ * TokenizerOptions.lazyCodepointIndexes).
+ *
+ * The index records the byte indexes at which the input switches between
+ * UTF-8 and a single-byte encoding, and the codepoint index of a character
+ * boundary every CODEPOINT_INDEX_CHECKPOINT_DISTANCE bytes. The checkpoints
+ * are computed on demand, only up to the greatest queried byte index, so a
+ * query counts the codepoints of at most a few kilobytes of the input once
+ * the preceding checkpoints are known.
+ *
+ * The codepoints are counted the same way the tokenizer counts them, that is
+ * an ill-formed UTF-8 sequence (see getUtf8SequenceLength) and an unexpected
+ * continuation byte count as a single codepoint each.
+ */
+typedef struct CodepointIndex CodepointIndex;
+
+/*
+ * Creates an index of the provided input, which is referenced by the index
+ * instead of being copied, so it must not be modified or freed before the
+ * index is freed. Returns NULL if the memory for the index could not be
+ * allocated.
+ */
+CodepointIndex *CodepointIndex_new(const unsigned char *input,
+				   unsigned long length, bool isUtf8);
+
+/*
+ * Records that the input is encoded in UTF-8 (or a single-byte encoding)
+ * from the provided byte index on, which must be a character boundary not
+ * preceding any of the previously recorded byte indexes. Returns false if
+ * the memory for the record could not be allocated.
+ */
+bool CodepointIndex_setEncoding(CodepointIndex *index, unsigned long byteIndex,
+				bool isUtf8);
+
+/*
+ * Records the encoding changes recorded by another index of the same input,
+ * the other index's initial encoding being used from the provided byte index
+ * on. The indexes of consecutive parts of the input can be combined this way.
+ * Returns false if the memory for the records could not be allocated.
+ */
+bool CodepointIndex_merge(CodepointIndex *index, CodepointIndex *other,
+			  unsigned long byteIndex);
+
+/*
+ * Returns the number of codepoints preceding the provided byte index of the
+ * input, that is the codepoint index of the character starting at it. Byte
+ * indexes beyond the end of the input are treated as its length. Returns 0
+ * if the index is NULL.
+ */
+unsigned long CodepointIndex_of(CodepointIndex *index, unsigned long byteIndex);
+
+void CodepointIndex_free(CodepointIndex *index);
+
+#endif
@@ -0,0 +1,148 @@
+#include <stddef.h>
+#include "bool.h"
+#include "command_id.h"
+#include "string.h"
+
+/*
+ * The standard command names are looked up using a perfect hash of the
+ * second and the last (lowercased) character and the length of the name,
+ * see getNameHash. Since the hash is only used to pick the single candidate
+ * name, the candidate is then compared with the provided name.
+ */
+#define MIN_NAME_LENGTH 2
+#define MAX_NAME_LENGTH 12
+#define HASH_TABLE_SIZE 128
+
+static const unsigned char HASH_TABLE[HASH_TABLE_SIZE] = {
+	0, 34, 0, 0, 0, 0, 39, 0, 43, 0, 0, 0, 0, 0, 21, 0,	/* 0-15 */
+	0, 0, 0, 0, 0, 0, 0, 0, 16, 30, 2, 35, 0, 0, 4, 0,	/* 16-31 */
+	24, 28, 3, 14, 26, 0, 0, 10, 0, 0, 15, 0, 0, 0, 27, 0,	/* 32-47 */
+	0, 0, 0, 31, 22, 36, 0, 13, 0, 0, 40, 17, 0, 0, 0, 0,	/* 48-63 */
+	0, 0, 18, 0, 0, 0, 0, 0, 0, 0, 0, 9, 0, 32, 0, 37,	/* 64-79 */
+	11, 20, 25, 0, 41, 0, 0, 0, 7, 0, 0, 0, 0, 0, 12, 23,	/* 80-95 */
+	0, 0, 0, 0, 0, 19, 8, 33, 0, 0, 0, 0, 38, 0, 42, 5,	/* 96-111 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 0, 0, 29	/* 112-127 */
+};
+
+/* Indexed by CommandId */
+static const char *const COMMAND_NAMES[] = {
+	NULL,
+	NULL,
+	"lt",
+	"nl",
+	"np",
+	"Bold",
+	"Italic",
+	"Fixed",
+	"Smaller",
+	"Bigger",
+	"Underline",
+	"Subscript",
+	"Superscript",
+	"Center",
+	"FlushLeft",
+	"FlushRight",
+	"Indent",
+	"IndentRight",
+	"Outdent",
+	"OutdentRight",
+	"Excerpt",
+	"Signature",
+	"Paragraph",
+	"SamePage",
+	"Heading",
+	"Footing",
+	"Comment",
+	"No-op",
+	"US-ASCII",
+	"ISO-8859-1",
+	"ISO-8859-2",
+	"ISO-8859-3",
+	"ISO-8859-4",
+	"ISO-8859-5",
+	"ISO-8859-6",
+	"ISO-8859-7",
+	"ISO-8859-8",
+	"ISO-8859-9",
+	"ISO-8859-10",
+	"ISO-8859-11",
+	"ISO-8859-13",
+	"ISO-8859-14",
+	"ISO-8859-15",
+	"ISO-8859-16"
+};
+
+static unsigned long getNameHash(const unsigned char *name,
+				 unsigned long length);
+
+static unsigned char toLowerCase(unsigned char character);
+
+CommandId CommandId_fromName(name)
+const string *name;
+{
+	const unsigned char *nameCharacter;
+	const char *canonicalName;
+	unsigned long i;
+	CommandId id;
+	bool isCaseMismatched = false;
+
+	if (name == NULL || name->length < MIN_NAME_LENGTH
+	    || name->length > MAX_NAME_LENGTH) {
+		return CommandId_CUSTOM;
+	}
+
+	id = HASH_TABLE[getNameHash(name->content, name->length)];
+	if (id == CommandId_NONE) {
+		return CommandId_CUSTOM;
+	}
+
+	canonicalName = COMMAND_NAMES[id];
+	nameCharacter = name->content;
+	for (i = 0; i < name->length; i++, canonicalName++, nameCharacter++) {
+		if (*canonicalName == '\0') {
+			return CommandId_CUSTOM;
+		}
+		if (*nameCharacter == (unsigned char)*canonicalName) {
+			continue;
+		}
+		if (toLowerCase(*nameCharacter) !=
+		    toLowerCase((unsigned char)*canonicalName)) {
+			return CommandId_CUSTOM;
+		}
+		isCaseMismatched = true;
+	}
+	if (*canonicalName != '\0') {
+		return CommandId_CUSTOM;
+	}
+
+	return isCaseMismatched ? id | CommandId_CASE_MISMATCH : id;
+}
+
+CommandId CommandId_resolve(id, caseInsensitive)
+CommandId id;
+bool caseInsensitive;
+{
+	if ((id & CommandId_CASE_MISMATCH) == 0) {
+		return id;
+	}
+
+	return caseInsensitive ? id & ~CommandId_CASE_MISMATCH :
+	    CommandId_CUSTOM;
+}
+
+static unsigned long getNameHash(name, length)
+const unsigned char *name;
+unsigned long length;
+{
+	return (toLowerCase(name[1]) * 5 + toLowerCase(name[length - 1]) * 26 +
+		length * 7) % HASH_TABLE_SIZE;
+}
+
+static unsigned char toLowerCase(character)
+unsigned char character;
+{
+	if (character >= 65 /* A */  && character <= 90 /* Z */ ) {
+		return character + 32;
+	}
+	return character;
+}
@@ -0,0 +1,80 @@
+#ifndef COMMAND_ID_HEADER_FILE
+#define COMMAND_ID_HEADER_FILE 1
+
+#include "bool.h"
+#include "string.h"
+
+/*
+ * Identifies the command represented by a token or an AST node, so that the
+ * processing stages can compare small integers instead of command names.
+ *
+ * Command names are resolved once (see CommandId_fromName) and
+ * case-insensitively. The CommandId_CASE_MISMATCH flag is added to the
+ * identifier of a command whose name does not match its canonical spelling
+ * exactly, use CommandId_resolve to obtain the identifier valid for the
+ * caseInsensitiveCommands setting in effect.
+ */
+typedef enum CommandId {
+	CommandId_NONE,		/* The token or node is not a command */
+	CommandId_CUSTOM,	/* The command is not defined by RFC 1341 */
+	CommandId_LT,
+	CommandId_NL,
+	CommandId_NP,
+	CommandId_BOLD,
+	CommandId_ITALIC,
+	CommandId_FIXED,
+	CommandId_SMALLER,
+	CommandId_BIGGER,
+	CommandId_UNDERLINE,
+	CommandId_SUBSCRIPT,
+	CommandId_SUPERSCRIPT,
+	CommandId_CENTER,
+	CommandId_FLUSH_LEFT,
+	CommandId_FLUSH_RIGHT,
+	CommandId_INDENT,
+	CommandId_INDENT_RIGHT,
+	CommandId_OUTDENT,
+	CommandId_OUTDENT_RIGHT,
+	CommandId_EXCERPT,
+	CommandId_SIGNATURE,
+	CommandId_PARAGRAPH,
+	CommandId_SAME_PAGE,
+	CommandId_HEADING,
+	CommandId_FOOTING,
+	CommandId_COMMENT,
+	CommandId_NO_OP,
+	CommandId_US_ASCII,
+	CommandId_ISO_8859_1,
+	CommandId_ISO_8859_2,
+	CommandId_ISO_8859_3,
+	CommandId_ISO_8859_4,
+	CommandId_ISO_8859_5,
+	CommandId_ISO_8859_6,
+	CommandId_ISO_8859_7,
+	CommandId_ISO_8859_8,
+	CommandId_ISO_8859_9,
+	CommandId_ISO_8859_10,
+	CommandId_ISO_8859_11,
+	CommandId_ISO_8859_13,
+	CommandId_ISO_8859_14,
+	CommandId_ISO_8859_15,
+	CommandId_ISO_8859_16,
+	CommandId_CASE_MISMATCH = 64
+} CommandId;
+
+/*
+ * Returns the identifier of the command of the provided name, or
+ * CommandId_CUSTOM if the name does not match any of the standard commands
+ * (case-insensitively) or is NULL.
+ */
+CommandId CommandId_fromName(const string * name);
+
+/*
+ * Returns the provided command identifier with the CommandId_CASE_MISMATCH
+ * flag cleared if the command names are case-insensitive, or
+ * CommandId_CUSTOM if the flag is set and the command names are
+ * case-sensitive.
+ */
+CommandId CommandId_resolve(CommandId id, bool caseInsensitive);
+
+#endif
@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include "arena.h"
+#include "ast_node.h"
+#include "bool.h"
+#include "custom_command_cache.h"
+#include "custom_command_layout_interpretation.h"
+#include "string.h"
+
+#define CUSTOM_COMMAND_CACHE_INITIAL_CAPACITY 16
+#define CUSTOM_COMMAND_CACHE_BLOCK_SIZE 1024
+/* The cache is cleared when full, so that its memory stays bounded */
+#define CUSTOM_COMMAND_CACHE_MAX_LENGTH 65536
+
+typedef struct CachedInterpretation {
+	/* The command name, in lower case if caseInsensitive is set */
+	string name;
+	bool caseInsensitive;
+	CustomCommandLayoutInterpretation interpretation;
+} CachedInterpretation;
+
+struct CustomCommandCache {
+	/*
+	 * Holds the cached interpretations and their names, NULL if the arena
+	 * could not be recreated when the cache was cleared.
+	 */
+	Arena *arena;
+	/* The number of bytes allocated from the arena */
+	unsigned long arenaSize;
+	CustomCommandLayoutInterpretation(*customCommandInterpreter) (ASTNode *,
+								       bool);
+	unsigned long length;
+	unsigned long capacity;
+	/*
+	 * The interpretations by the hashes of their names, using linear
+	 * probing. There are twice as many slots as the capacity, which is a
+	 * power of two, so at least half of the slots are empty (NULL).
+	 */
+	CachedInterpretation **slots;
+};
+
+static unsigned long getNameHash(string * name, bool caseInsensitive);
+
+static unsigned char foldCase(unsigned char character, bool caseInsensitive);
+
+static CachedInterpretation **findSlot(CachedInterpretation ** slots,
+				       unsigned long slotCount, string * name,
+				       bool caseInsensitive);
+
+static bool grow(CustomCommandCache * cache);
+
+static void clear(CustomCommandCache * cache);
+
+CustomCommandCache *CustomCommandCache_new()
+{
+	CustomCommandCache *cache;
+
+	cache = malloc(sizeof(CustomCommandCache));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	cache->arena = Arena_new(CUSTOM_COMMAND_CACHE_BLOCK_SIZE);
+	cache->arenaSize = 0;
+	cache->customCommandInterpreter = NULL;
+	cache->length = 0;
+	cache->capacity = 0;
+	cache->slots = NULL;
+	if (cache->arena == NULL || !grow(cache)) {
+		CustomCommandCache_free(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+void CustomCommandCache_bind(cache, customCommandInterpreter)
+CustomCommandCache *cache;
+CustomCommandLayoutInterpretation customCommandInterpreter(ASTNode *, bool);
+{
+	if (cache == NULL
+	    || cache->customCommandInterpreter == customCommandInterpreter) {
+		return;
+	}
+
+	if (cache->customCommandInterpreter != NULL) {
+		clear(cache);
+	}
+	cache->customCommandInterpreter = customCommandInterpreter;
+}
+
+bool CustomCommandCache_get(cache, name, caseInsensitive, interpretation)
+CustomCommandCache *cache;
+string *name;
+bool caseInsensitive;
+CustomCommandLayoutInterpretation *interpretation;
+{
+	CachedInterpretation *cached;
+
+	if (cache == NULL || name == NULL) {
+		return false;
+	}
+
+	cached =
+	    *findSlot(cache->slots, cache->capacity * 2, name, caseInsensitive);
+	if (cached == NULL) {
+		return false;
+	}
+
+	*interpretation = cached->interpretation;
+	return true;
+}
+
+bool CustomCommandCache_put(cache, name, caseInsensitive, interpretation)
+CustomCommandCache *cache;
+string *name;
+bool caseInsensitive;
+CustomCommandLayoutInterpretation interpretation;
+{
+	CachedInterpretation **slot;
+	CachedInterpretation *cached;
+	unsigned long i;
+
+	if (cache == NULL || name == NULL) {
+		return false;
+	}
+
+	slot = findSlot(cache->slots, cache->capacity * 2, name,
+			caseInsensitive);
+	if (*slot != NULL) {
+		(*slot)->interpretation = interpretation;
+		return true;
+	}
+
+	if (cache->length == CUSTOM_COMMAND_CACHE_MAX_LENGTH) {
+		clear(cache);
+		slot = findSlot(cache->slots, cache->capacity * 2, name,
+				caseInsensitive);
+	}
+	if (cache->length == cache->capacity) {
+		if (!grow(cache)) {
+			return false;
+		}
+		slot = findSlot(cache->slots, cache->capacity * 2, name,
+				caseInsensitive);
+	}
+
+	cached = Arena_allocate(cache->arena, sizeof(CachedInterpretation));
+	if (cached == NULL) {
+		return false;
+	}
+	cached->name.length = name->length;
+	cached->name.content = NULL;
+	if (name->length > 0) {
+		cached->name.content = Arena_allocate(cache->arena,
+						      name->length);
+		if (cached->name.content == NULL) {
+			return false;
+		}
+		for (i = 0; i < name->length; i++) {
+			cached->name.content[i] =
+			    foldCase(name->content[i], caseInsensitive);
+		}
+	}
+	cached->caseInsensitive = caseInsensitive;
+	cached->interpretation = interpretation;
+	cache->arenaSize += sizeof(CachedInterpretation) + name->length;
+	cache->length++;
+	*slot = cached;
+	return true;
+}
+
+unsigned long CustomCommandCache_getLength(cache)
+CustomCommandCache *cache;
+{
+	return cache != NULL ? cache->length : 0;
+}
+
+unsigned long CustomCommandCache_getMemorySize(cache)
+CustomCommandCache *cache;
+{
+	if (cache == NULL) {
+		return 0;
+	}
+
+	return cache->capacity * 2 * sizeof(CachedInterpretation *) +
+	    cache->arenaSize;
+}
+
+void CustomCommandCache_free(cache)
+CustomCommandCache *cache;
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	if (cache->slots != NULL) {
+		free(cache->slots);
+	}
+	Arena_free(cache->arena);
+	free(cache);
+}
+
+static unsigned long getNameHash(name, caseInsensitive)
+string *name;
+bool caseInsensitive;
+{
+	unsigned long hash = caseInsensitive ? 1 : 0;
+	unsigned long i;
+
+	for (i = 0; i < name->length; i++) {
+		hash = hash * 31 + foldCase(name->content[i], caseInsensitive);
+	}
+	return hash ^ (hash >> 16);
+}
+
+/*
+ * Converts ASCII letters to lower case like string_caseInsensitiveCompare if
+ * the names are case insensitive.
+ */
+static unsigned char foldCase(character, caseInsensitive)
+unsigned char character;
+bool caseInsensitive;
+{
+	if (caseInsensitive && character >= 65 /* A */
+	    && character <= 90 /* Z */ ) {
+		/* convert to lowercase */
+		return (unsigned char)(character + 32);
+	}
+	return character;
+}
+
+/*
+ * Returns the slot of the interpretation of the name, or the empty slot the
+ * interpretation would be stored in.
+ */
+static CachedInterpretation **findSlot(slots, slotCount, name, caseInsensitive)
+CachedInterpretation **slots;
+unsigned long slotCount;
+string *name;
+bool caseInsensitive;
+{
+	unsigned long index = getNameHash(name, caseInsensitive) &
+	    (slotCount - 1);
+	CachedInterpretation *cached;
+	unsigned long i;
+
+	for (; slots[index] != NULL; index = (index + 1) & (slotCount - 1)) {
+		cached = slots[index];
+		if (cached->caseInsensitive != caseInsensitive
+		    || cached->name.length != name->length) {
+			continue;
+		}
+		for (i = 0; i < name->length; i++) {
+			if (cached->name.content[i] !=
+			    foldCase(name->content[i], caseInsensitive)) {
+				break;
+			}
+		}
+		if (i == name->length) {
+			break;
+		}
+	}
+	return slots + index;
+}
+
+/*
+ * Doubles the capacity of the cache (or sets the initial one), rehashing the
+ * interpretations into new slots.
+ */
+static bool grow(cache)
+CustomCommandCache *cache;
+{
+	unsigned long capacity = cache->capacity > 0 ? cache->capacity * 2 :
+	    CUSTOM_COMMAND_CACHE_INITIAL_CAPACITY;
+	CachedInterpretation **slots;
+	CachedInterpretation *cached;
+	unsigned long i;
+
+	slots = malloc(capacity * 2 * sizeof(CachedInterpretation *));
+	if (slots == NULL) {
+		return false;
+	}
+
+	for (i = 0; i < capacity * 2; i++) {
+		slots[i] = NULL;
+	}
+	for (i = 0; i < cache->capacity * 2; i++) {
+		cached = cache->slots[i];
+		if (cached != NULL) {
+			*findSlot(slots, capacity * 2, &cached->name,
+				  cached->caseInsensitive) = cached;
+		}
+	}
+	if (cache->slots != NULL) {
+		free(cache->slots);
+	}
+	cache->slots = slots;
+	cache->capacity = capacity;
+	return true;
+}
+
+/*
+ * Drops all cached interpretations, releasing the memory of their names and
+ * shrinking the slots to the initial capacity. The cache stays usable if the
+ * memory for the smaller slots or the new arena could not be allocated, the
+ * interpretations are just not cached in the latter case.
+ */
+static void clear(cache)
+CustomCommandCache *cache;
+{
+	CachedInterpretation **slots;
+	unsigned long i;
+
+	slots = malloc(CUSTOM_COMMAND_CACHE_INITIAL_CAPACITY * 2 *
+		       sizeof(CachedInterpretation *));
+	if (slots != NULL) {
+		free(cache->slots);
+		cache->slots = slots;
+		cache->capacity = CUSTOM_COMMAND_CACHE_INITIAL_CAPACITY;
+	}
+	for (i = 0; i < cache->capacity * 2; i++) {
+		cache->slots[i] = NULL;
+	}
+	cache->length = 0;
+
+	Arena_free(cache->arena);
+	cache->arena = Arena_new(CUSTOM_COMMAND_CACHE_BLOCK_SIZE);
+	cache->arenaSize = 0;
+}
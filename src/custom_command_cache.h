@@ -0,0 +1,64 @@
+#ifndef CUSTOM_COMMAND_CACHE_HEADER_FILE
+#define CUSTOM_COMMAND_CACHE_HEADER_FILE 1
+
+#include "ast_node.h"
+#include "bool.h"
+#include "custom_command_layout_interpretation.h"
+#include "string.h"
+
+/*
+ * A cache of the interpretations returned by a custom command interpreter,
+ * keyed by the command names. The names of the commands interpreted case
+ * insensitively are compared ignoring the case of ASCII letters, and never
+ * match the names of the commands interpreted case sensitively. The cache may
+ * be used only with an interpreter whose interpretation of a command depends
+ * on nothing but the command's name (see LayoutResolverOptions), and is bound
+ * to the first interpreter it is used with.
+ */
+typedef struct CustomCommandCache CustomCommandCache;
+
+/*
+ * Returns NULL if the memory for the cache could not be allocated.
+ */
+CustomCommandCache *CustomCommandCache_new(void);
+
+/*
+ * Binds the cache to the provided interpreter, clearing the cache and
+ * releasing the memory of its names if it has been bound to another one.
+ */
+void CustomCommandCache_bind(CustomCommandCache *cache,
+			     CustomCommandLayoutInterpretation
+			     customCommandInterpreter(ASTNode *, bool));
+
+/*
+ * Stores the cached interpretation of the command name and returns true, or
+ * returns false if the name has not been cached yet.
+ */
+bool CustomCommandCache_get(CustomCommandCache *cache, string *name,
+			    bool caseInsensitive,
+			    CustomCommandLayoutInterpretation *interpretation);
+
+/*
+ * Caches the interpretation of the command name, copying the name. A full
+ * cache (of 65536 names) is cleared first, so that a long-lived cache seeing
+ * ever new names does not grow without bound. Returns false if the memory for
+ * the cached name could not be allocated.
+ */
+bool CustomCommandCache_put(CustomCommandCache *cache, string *name,
+			    bool caseInsensitive,
+			    CustomCommandLayoutInterpretation interpretation);
+
+/*
+ * Returns the number of the cached command names.
+ */
+unsigned long CustomCommandCache_getLength(CustomCommandCache *cache);
+
+/*
+ * Returns the number of bytes of the memory used by the cached names and the
+ * hash table slots, excluding the constant overhead of the cache.
+ */
+unsigned long CustomCommandCache_getMemorySize(CustomCommandCache *cache);
+
+void CustomCommandCache_free(CustomCommandCache *cache);
+
+#endif
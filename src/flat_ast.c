@@ -0,0 +1,317 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "ast_node.h"
+#include "ast_node_pointer_vector.h"
+#include "ast_node_type.h"
+#include "ast_traversal.h"
+#include "bool.h"
+#include "flat_ast.h"
+#include "string.h"
+
+/* Covers the alignment of the few allocations of a node tree */
+#define FLAT_AST_TREE_SIZE_RESERVE 64
+
+static bool countNodes(ASTTraversal * traversal, ASTNodePointerVector * nodes,
+		       unsigned long *count, unsigned long *contentLength);
+
+static bool fillNodes(FlatAST * ast, ASTTraversal * traversal,
+		      ASTNodePointerVector * nodes);
+
+static ASTNodePointerVector *newChildren(Arena * arena, FlatAST * ast,
+					 unsigned long firstChild,
+					 ASTNode *** items);
+
+FlatAST *FlatAST_fromNodes(nodes)
+ASTNodePointerVector *nodes;
+{
+	FlatAST *ast;
+	ASTTraversal *traversal;
+	unsigned long contentLength = 0;
+
+	if (nodes == NULL) {
+		return NULL;
+	}
+
+	ast = malloc(sizeof(FlatAST));
+	traversal = ASTTraversal_new();
+	if (ast == NULL || traversal == NULL) {
+		if (ast != NULL) {
+			free(ast);
+		}
+		ASTTraversal_free(traversal);
+		return NULL;
+	}
+
+	ast->length = 0;
+	ast->nodes = NULL;
+	ast->values = NULL;
+	ast->valueContent = NULL;
+	ast->nodeTree = NULL;
+	ast->treeNodes = NULL;
+	ast->rootNodes = NULL;
+	if (!countNodes(traversal, nodes, &ast->length, &contentLength)) {
+		ASTTraversal_free(traversal);
+		FlatAST_free(ast);
+		return NULL;
+	}
+
+	/* One more item each, so that an empty AST is not a special case */
+	ast->nodes = malloc(sizeof(FlatASTNode) * (ast->length + 1));
+	ast->values = malloc(sizeof(string) * (ast->length + 1));
+	ast->valueContent = malloc(contentLength + 1);
+	if (ast->nodes == NULL || ast->values == NULL
+	    || ast->valueContent == NULL
+	    || !fillNodes(ast, traversal, nodes)) {
+		ASTTraversal_free(traversal);
+		FlatAST_free(ast);
+		return NULL;
+	}
+
+	ASTTraversal_free(traversal);
+	return ast;
+}
+
+ASTNodePointerVector *FlatAST_toNodes(ast)
+FlatAST *ast;
+{
+	Arena *arena;
+	ASTNode *treeNodes;
+	ASTNode *node;
+	ASTNode **items;
+	ASTNodePointerVector *rootNodes;
+	ASTNodePointerVector *siblings;
+	FlatASTNode *flatNode;
+	unsigned long commandCount = 0;
+	unsigned long i;
+
+	if (ast == NULL || ast->rootNodes != NULL) {
+		return ast == NULL ? NULL : ast->rootNodes;
+	}
+
+	for (i = 0; i < ast->length; i++) {
+		if (ast->nodes[i].type == ASTNodeType_COMMAND) {
+			commandCount++;
+		}
+	}
+
+	/* The whole tree fits into a single block of the arena */
+	arena = Arena_new(ast->length * (sizeof(ASTNode) + sizeof(ASTNode *)) +
+			  (commandCount + 1) * sizeof(ASTNodePointerVector) +
+			  FLAT_AST_TREE_SIZE_RESERVE);
+	treeNodes = Arena_allocate(arena, ast->length * sizeof(ASTNode));
+	items = Arena_allocate(arena, ast->length * sizeof(ASTNode *));
+	if (treeNodes == NULL || items == NULL) {
+		Arena_free(arena);
+		return NULL;
+	}
+	rootNodes = newChildren(arena, ast, ast->length > 0 ? 0 :
+				FLAT_AST_NO_NODE, &items);
+	if (rootNodes == NULL) {
+		Arena_free(arena);
+		return NULL;
+	}
+
+	for (i = 0; i < ast->length; i++) {
+		flatNode = ast->nodes + i;
+		node = treeNodes + i;
+		node->byteIndex = flatNode->byteIndex;
+		node->codepointIndex = flatNode->codepointIndex;
+		node->tokenIndex = flatNode->tokenIndex;
+		node->type = flatNode->type;
+		node->value = ast->values + i;
+		node->isValueView = true;
+		node->commandId = flatNode->commandId;
+		node->children = NULL;
+		if (flatNode->type == ASTNodeType_COMMAND) {
+			node->children = newChildren(arena, ast,
+						     flatNode->firstChild,
+						     &items);
+			if (node->children == NULL) {
+				Arena_free(arena);
+				return NULL;
+			}
+		}
+
+		if (flatNode->parent == FLAT_AST_NO_NODE) {
+			node->parent = NULL;
+			siblings = rootNodes;
+		} else {
+			node->parent = treeNodes + flatNode->parent;
+			siblings = node->parent->children;
+		}
+		node->siblingIndex = siblings->size.length;
+		siblings->items[siblings->size.length] = node;
+		siblings->size.length++;
+	}
+
+	ast->nodeTree = arena;
+	ast->treeNodes = treeNodes;
+	ast->rootNodes = rootNodes;
+	return rootNodes;
+}
+
+unsigned long FlatAST_indexOf(ast, node)
+FlatAST *ast;
+ASTNode *node;
+{
+	if (ast == NULL || ast->treeNodes == NULL || node < ast->treeNodes
+	    || node >= ast->treeNodes + ast->length) {
+		return FLAT_AST_NO_NODE;
+	}
+
+	return (unsigned long)(node - ast->treeNodes);
+}
+
+void FlatAST_free(ast)
+FlatAST *ast;
+{
+	if (ast == NULL) {
+		return;
+	}
+
+	if (ast->nodes != NULL) {
+		free(ast->nodes);
+	}
+	if (ast->values != NULL) {
+		free(ast->values);
+	}
+	if (ast->valueContent != NULL) {
+		free(ast->valueContent);
+	}
+	Arena_free(ast->nodeTree);
+	free(ast);
+}
+
+/*
+ * Counts the nodes and the length of their values. Returns false if the
+ * memory for the traversal could not be allocated.
+ */
+static bool countNodes(traversal, nodes, count, contentLength)
+ASTTraversal *traversal;
+ASTNodePointerVector *nodes;
+unsigned long *count;
+unsigned long *contentLength;
+{
+	ASTTraversalStep step;
+	ASTNode *node;
+
+	ASTTraversal_start(traversal, nodes);
+	for (step = ASTTraversal_next(traversal, &node);
+	     step == ASTTraversalStep_ENTER || step == ASTTraversalStep_LEAVE;
+	     step = ASTTraversal_next(traversal, &node)) {
+		if (step == ASTTraversalStep_ENTER) {
+			(*count)++;
+			if (node->value != NULL) {
+				*contentLength += node->value->length;
+			}
+		}
+	}
+
+	return step == ASTTraversalStep_END;
+}
+
+/*
+ * Stores the nodes and their descendants in document order, and copies their
+ * values. Returns false if the memory for the traversal could not be
+ * allocated.
+ */
+static bool fillNodes(ast, traversal, nodes)
+FlatAST *ast;
+ASTTraversal *traversal;
+ASTNodePointerVector *nodes;
+{
+	ASTTraversalStep step;
+	ASTNode *node;
+	FlatASTNode *flatNode;
+	string *value;
+	/* The parent of the entered nodes and their last entered sibling */
+	unsigned long parent = FLAT_AST_NO_NODE;
+	unsigned long previousSibling = FLAT_AST_NO_NODE;
+	unsigned long nextIndex = 0;
+	unsigned long contentOffset = 0;
+	unsigned long index;
+
+	ASTTraversal_start(traversal, nodes);
+	for (step = ASTTraversal_next(traversal, &node);
+	     step == ASTTraversalStep_ENTER || step == ASTTraversalStep_LEAVE;
+	     step = ASTTraversal_next(traversal, &node)) {
+		if (step == ASTTraversalStep_LEAVE) {
+			if (node->children != NULL
+			    && node->children->size.length > 0) {
+				index = parent;
+				parent = ast->nodes[parent].parent;
+			} else {
+				index = nextIndex - 1;
+			}
+			ast->nodes[index].subtreeEnd = nextIndex;
+			previousSibling = index;
+			continue;
+		}
+
+		index = nextIndex;
+		nextIndex++;
+
+		flatNode = ast->nodes + index;
+		flatNode->byteIndex = node->byteIndex;
+		flatNode->codepointIndex = node->codepointIndex;
+		flatNode->tokenIndex = node->tokenIndex;
+		flatNode->type = node->type;
+		flatNode->commandId = node->commandId;
+		flatNode->parent = parent;
+		flatNode->firstChild = FLAT_AST_NO_NODE;
+		flatNode->nextSibling = FLAT_AST_NO_NODE;
+		if (previousSibling != FLAT_AST_NO_NODE) {
+			ast->nodes[previousSibling].nextSibling = index;
+		}
+
+		value = ast->values + index;
+		value->content = ast->valueContent + contentOffset;
+		value->length = node->value != NULL ? node->value->length : 0;
+		if (value->length > 0) {
+			memcpy(value->content, node->value->content,
+			       value->length);
+			contentOffset += value->length;
+		}
+
+		previousSibling = FLAT_AST_NO_NODE;
+		if (node->children != NULL && node->children->size.length > 0) {
+			flatNode->firstChild = index + 1;
+			parent = index;
+		}
+	}
+
+	return step == ASTTraversalStep_END;
+}
+
+/*
+ * Creates the children vector of a node, its items taken from the items
+ * array, which is advanced past them.
+ */
+static ASTNodePointerVector *newChildren(arena, ast, firstChild, items)
+Arena *arena;
+FlatAST *ast;
+unsigned long firstChild;
+ASTNode ***items;
+{
+	ASTNodePointerVector *children;
+	unsigned long child;
+	unsigned long count = 0;
+
+	children = Arena_allocate(arena, sizeof(ASTNodePointerVector));
+	if (children == NULL) {
+		return NULL;
+	}
+
+	for (child = firstChild; child != FLAT_AST_NO_NODE;
+	     child = ast->nodes[child].nextSibling) {
+		count++;
+	}
+
+	children->size.itemSize = sizeof(ASTNode *);
+	children->size.length = 0;
+	children->size.capacity = count;
+	children->items = *items;
+	*items += count;
+	return children;
+}
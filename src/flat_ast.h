@@ -0,0 +1,90 @@
+#ifndef FLAT_AST_HEADER_FILE
+#define FLAT_AST_HEADER_FILE 1
+
+#include "arena.h"
+#include "ast_node.h"
+#include "ast_node_pointer_vector.h"
+#include "ast_node_type.h"
+#include "command_id.h"
+#include "string.h"
+
+/* The index used by the flat AST nodes to refer to no node at all */
+#define FLAT_AST_NO_NODE ((unsigned long) -1)
+
+/*
+ * A node of a flat AST, referring to the related nodes by their indexes in
+ * the flat AST. A node has children only if it is a command node.
+ */
+typedef struct FlatASTNode {
+	unsigned long byteIndex;
+	unsigned long codepointIndex;
+	unsigned long tokenIndex;
+	ASTNodeType type;
+	CommandId commandId;
+	/* The parent node, FLAT_AST_NO_NODE for the root nodes */
+	unsigned long parent;
+	/*
+	 * The first child node, which always directly follows the node, or
+	 * FLAT_AST_NO_NODE if the node has no children.
+	 */
+	unsigned long firstChild;
+	/* The following sibling node, FLAT_AST_NO_NODE for the last sibling */
+	unsigned long nextSibling;
+	/*
+	 * The index following the last descendant of the node, which is the
+	 * index of the node that follows the node's subtree in document order.
+	 */
+	unsigned long subtreeEnd;
+} FlatASTNode;
+
+/*
+ * An AST stored as a single array of nodes in document (depth-first) order.
+ * Traversing the AST in document order is a scan of the array, and skipping
+ * a subtree is a jump to the subtree's end.
+ */
+typedef struct FlatAST {
+	unsigned long length;
+	FlatASTNode *nodes;
+	/*
+	 * The values of the nodes, the value of a node is at the node's index.
+	 * The contents of all values are stored in valueContent.
+	 */
+	string *values;
+	unsigned char *valueContent;
+	/*
+	 * The arena holding the tree of ASTNodes created by FlatAST_toNodes,
+	 * the array of its nodes in document order and its root nodes, all
+	 * NULL until then.
+	 */
+	Arena *nodeTree;
+	ASTNode *treeNodes;
+	ASTNodePointerVector *rootNodes;
+} FlatAST;
+
+/*
+ * Creates a flat AST of the provided tree of nodes (see parse), copying the
+ * values of the nodes. The tree may be freed independently of the flat AST.
+ * Returns NULL if the nodes are NULL or the memory could not be allocated.
+ */
+FlatAST *FlatAST_fromNodes(ASTNodePointerVector *nodes);
+
+/*
+ * Returns the root nodes of a tree of ASTNodes equal to the flat AST, which
+ * can be passed to resolveLayout. The tree is created on the first call and
+ * owned by the flat AST, the nodes must not be modified or freed, and share
+ * their values with the flat AST (see ASTNode.isValueView). The nodes are
+ * stored in a single array in document order, so the index of a node in the
+ * flat AST is known in constant time (see FlatAST_indexOf). Returns NULL if
+ * the memory for the tree could not be allocated.
+ */
+ASTNodePointerVector *FlatAST_toNodes(FlatAST *ast);
+
+/*
+ * Returns the index of the node of the tree returned by FlatAST_toNodes, or
+ * FLAT_AST_NO_NODE if the node is not a part of the tree.
+ */
+unsigned long FlatAST_indexOf(FlatAST *ast, ASTNode *node);
+
+void FlatAST_free(FlatAST *ast);
+
+#endif
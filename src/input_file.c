@@ -0,0 +1,231 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "bool.h"
+#include "input_file.h"
+#include "string.h"
+
+#if defined(_POSIX_MAPPED_FILES) && _POSIX_MAPPED_FILES > 0
+#include <sys/mman.h>
+#define INPUT_FILE_MMAP 1
+#endif
+
+/* The initial size of the buffer for files of unknown size */
+#define INPUT_FILE_BUFFER_SIZE 65536
+
+static bool mapFile(InputFile * file, int fileDescriptor, off_t offset,
+		    unsigned long length);
+
+static void readFile(InputFile * file, int fileDescriptor,
+		     unsigned long length);
+
+InputFile *InputFile_open(path)
+const char *path;
+{
+	InputFile *file;
+	int fileDescriptor;
+	int openErrorCode;
+
+	do {
+		fileDescriptor = open(path, O_RDONLY);
+	} while (fileDescriptor == -1 && errno == EINTR);
+
+	if (fileDescriptor == -1) {
+		/* The allocation may change errno even if it succeeds */
+		openErrorCode = errno;
+		file = malloc(sizeof(InputFile));
+		if (file == NULL) {
+			return NULL;
+		}
+		file->errorCode = InputFileErrorCode_CANNOT_OPEN_FILE;
+		file->systemErrorCode = openErrorCode;
+		file->isMapped = false;
+		file->content.length = 0;
+		file->content.content = NULL;
+		return file;
+	}
+
+	/* The mapping, if any, outlives the file descriptor */
+	file = InputFile_fromDescriptor(fileDescriptor);
+	close(fileDescriptor);
+	return file;
+}
+
+InputFile *InputFile_fromDescriptor(fileDescriptor)
+int fileDescriptor;
+{
+	InputFile *file = malloc(sizeof(InputFile));
+	struct stat status;
+	off_t offset;
+	off_t restLength;
+	unsigned long length = 0;
+
+	if (file == NULL) {
+		return NULL;
+	}
+
+	file->errorCode = InputFileErrorCode_OK;
+	file->systemErrorCode = 0;
+	file->isMapped = false;
+	file->content.length = 0;
+	file->content.content = NULL;
+
+	if (fstat(fileDescriptor, &status) == -1) {
+		file->errorCode = InputFileErrorCode_CANNOT_READ_FILE;
+		file->systemErrorCode = errno;
+		return file;
+	}
+
+	/*
+	 * The size of other files is not known up front, and some special
+	 * files (e.g. in /proc) report a size of 0 despite having content.
+	 * The file may have been read partially already (e.g. a redirected
+	 * standard input), so only the rest of it is loaded.
+	 */
+	offset = S_ISREG(status.st_mode) ? lseek(fileDescriptor, 0, SEEK_CUR) :
+	    -1;
+	restLength = status.st_size - offset;
+	if (offset != -1 && restLength > 0
+	    && (off_t) (size_t) restLength == restLength) {
+		length = (unsigned long)restLength;
+		if (mapFile(file, fileDescriptor, offset, length)) {
+			return file;
+		}
+	}
+
+	readFile(file, fileDescriptor, length);
+	return file;
+}
+
+void InputFile_free(file)
+InputFile *file;
+{
+	if (file == NULL) {
+		return;
+	}
+
+#if defined(INPUT_FILE_MMAP)
+	if (file->isMapped) {
+		munmap(file->content.content, file->content.length);
+		free(file);
+		return;
+	}
+#endif
+
+	if (file->content.content != NULL) {
+		free(file->content.content);
+	}
+	free(file);
+}
+
+/*
+ * Maps the provided length of the regular file from the offset into memory,
+ * and moves the file offset to the end of the file, as if the file was read.
+ * Returns false if the file could not be mapped (the offset must be a
+ * multiple of the page size), in which case it should be read instead.
+ */
+static bool mapFile(file, fileDescriptor, offset, length)
+InputFile *file;
+int fileDescriptor;
+off_t offset;
+unsigned long length;
+{
+#if defined(INPUT_FILE_MMAP)
+	long pageSize = sysconf(_SC_PAGESIZE);
+	void *mapping;
+
+	if (pageSize <= 0 || offset % pageSize != 0) {
+		return false;
+	}
+
+	mapping =
+	    mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileDescriptor, offset);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+	lseek(fileDescriptor, 0, SEEK_END);
+
+	/*
+	 * The tokenizer reads the input front to back exactly once, so the
+	 * kernel may read ahead aggressively and drop the pages read already.
+	 * The advice is only a hint, its failure is of no consequence.
+	 */
+#if defined(POSIX_MADV_SEQUENTIAL)
+	posix_madvise(mapping, length, POSIX_MADV_SEQUENTIAL);
+#endif
+
+	file->isMapped = true;
+	file->content.length = length;
+	file->content.content = mapping;
+	return true;
+#else
+	(void)file;
+	(void)fileDescriptor;
+	(void)offset;
+	(void)length;
+	return false;
+#endif
+}
+
+/*
+ * Reads the rest of the file into a buffer, expecting the provided length,
+ * which is 0 if the length is unknown. The buffer is grown as needed.
+ */
+static void readFile(file, fileDescriptor, length)
+InputFile *file;
+int fileDescriptor;
+unsigned long length;
+{
+	unsigned char *buffer;
+	unsigned char *grownBuffer;
+	unsigned long bufferSize;
+	unsigned long readLength = 0;
+	ssize_t chunkLength;
+	InputFileErrorCode OUT_OF_MEMORY =
+	    InputFileErrorCode_OUT_OF_MEMORY_FOR_CONTENT;
+
+	/* One more byte, so that the end of the file is read without growing */
+	bufferSize = length > 0 ? length + 1 : INPUT_FILE_BUFFER_SIZE;
+	buffer = malloc(bufferSize);
+	if (buffer == NULL) {
+		file->errorCode = OUT_OF_MEMORY;
+		return;
+	}
+
+	for (;;) {
+		if (readLength == bufferSize) {
+			grownBuffer = realloc(buffer, bufferSize * 2);
+			if (grownBuffer == NULL) {
+				free(buffer);
+				file->errorCode = OUT_OF_MEMORY;
+				return;
+			}
+			buffer = grownBuffer;
+			bufferSize *= 2;
+		}
+
+		chunkLength = read(fileDescriptor, buffer + readLength,
+				   bufferSize - readLength);
+		if (chunkLength == 0) {
+			break;
+		}
+		if (chunkLength == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			free(buffer);
+			file->errorCode = InputFileErrorCode_CANNOT_READ_FILE;
+			file->systemErrorCode = errno;
+			return;
+		}
+		readLength += (unsigned long)chunkLength;
+	}
+
+	file->content.length = readLength;
+	file->content.content = buffer;
+}
@@ -0,0 +1,53 @@
+#ifndef INPUT_FILE_HEADER_FILE
+#define INPUT_FILE_HEADER_FILE 1
+
+#include "bool.h"
+#include "string.h"
+
+typedef enum InputFileErrorCode {
+	InputFileErrorCode_OK,
+	InputFileErrorCode_CANNOT_OPEN_FILE,
+	InputFileErrorCode_CANNOT_READ_FILE,
+	InputFileErrorCode_OUT_OF_MEMORY_FOR_CONTENT
+} InputFileErrorCode;
+
+/*
+ * The whole content of a file to process.
+ *
+ * Regular files are memory-mapped read-only where the platform supports it,
+ * so the content is paged in on demand as the tokenizer reads it instead of
+ * being copied into a buffer first. Other files (pipes, terminals, and
+ * regular files that cannot be mapped) are read into a buffer.
+ *
+ * The content string does not own its bytes, it must not be modified or
+ * freed, and it is valid until the input file is freed. A mapped file must
+ * not be truncated while it is mapped.
+ */
+typedef struct InputFile {
+	InputFileErrorCode errorCode;
+	/* The errno value of the failed system call, 0 if there was none */
+	int systemErrorCode;
+	bool isMapped;
+	string content;
+} InputFile;
+
+/*
+ * Opens and loads the file at the provided path. The file descriptor is
+ * closed before the function returns. Returns NULL only if the memory for
+ * the input file could not be allocated, the errorCode is set otherwise.
+ */
+InputFile *InputFile_open(const char *path);
+
+/*
+ * Loads the rest of the file referenced by the provided file descriptor,
+ * starting at the descriptor's current offset, which is moved to the end of
+ * the file. The descriptor is left open. A regular file is mapped only if the
+ * offset is a multiple of the page size, and read otherwise. Returns NULL
+ * only if the memory for the input file could not be allocated, the errorCode
+ * is set otherwise.
+ */
+InputFile *InputFile_fromDescriptor(int fileDescriptor);
+
+void InputFile_free(InputFile * file);
+
+#endif
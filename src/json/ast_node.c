@@ -1,6 +1,7 @@
 #include "../ast_node.h"
 #include "../ast_node_type.h"
 #include "../ast_node_pointer_vector.h"
+#include "../ast_traversal.h"
 #include "ast_node.h"
 #include "json_value.h"
 
@@ -17,6 +18,8 @@ static const char *typeWHITESPACEContent = "WHITESPACE";
 
 static JSONValue *getNodeTypeAsJson(ASTNodeType type);
 
+static JSONValue *addChildrenArray(JSONValue * nodeJson);
+
 JSONValue *ASTNode_toJSON(node)
 ASTNode *node;
 {
@@ -156,29 +159,88 @@ ASTNode *node;
 	return nodeJson;
 }
 
+/*
+ * The nodes are traversed using an explicit stack, and so is the stack of the
+ * children arrays of the entered nodes, so that the depth of the tree is not
+ * limited by the call stack.
+ */
 JSONValue *ASTNodePointerVector_toJSON(nodes)
 ASTNodePointerVector *nodes;
 {
-	JSONValue *array = JSONValue_newArray();
-	ASTNode **nodePointer = NULL;
-	unsigned long i = 0;
+	JSONValue *array;
+	JSONValue *nodeJson;
+	JSONValue *childrenArray;
+	JSONValuePointerVector *arrays;
+	JSONValuePointerVector *changedArrays;
+	ASTTraversal *traversal;
+	ASTTraversalStep step;
+	ASTNode *node;
+
+	if (nodes == NULL) {
+		return NULL;
+	}
 
-	if (nodes == NULL || array == NULL) {
+	array = JSONValue_newArray();
+	arrays = JSONValuePointerVector_new(0, 1);
+	traversal = ASTTraversal_new();
+	changedArrays = JSONValuePointerVector_append(arrays, &array);
+	if (array == NULL || traversal == NULL || changedArrays == NULL) {
+		JSONValue_free(array);
+		JSONValuePointerVector_free(arrays);
+		ASTTraversal_free(traversal);
 		return NULL;
 	}
+	arrays = changedArrays;
+
+	ASTTraversal_start(traversal, nodes);
+	for (step = ASTTraversal_next(traversal, &node);
+	     step == ASTTraversalStep_ENTER || step == ASTTraversalStep_LEAVE;
+	     step = ASTTraversal_next(traversal, &node)) {
+		if (step == ASTTraversalStep_LEAVE) {
+			if (node != NULL && node->children != NULL) {
+				arrays->size.length--;
+			}
+			continue;
+		}
+
+		nodeJson = ASTNode_toFlatJSON(node);
+		if (nodeJson == NULL) {
+			break;
+		}
+		if (JSONValue_pushToArray(arrays->items[arrays->size.length - 1],
+					  nodeJson) == NULL) {
+			JSONValue_freeRecursive(nodeJson);
+			break;
+		}
+		if (node == NULL || node->children == NULL) {
+			continue;
+		}
 
-	nodePointer = nodes->items;
-	for (i = 0; i < nodes->size.length; i++, nodePointer++) {
-		JSONValue *childJson = ASTNode_toJSON(*nodePointer);
-		if (childJson == NULL) {
-			JSONValue_freeRecursive(array);
-			return NULL;
+		/* The children are added to the array on top of the stack */
+		childrenArray = addChildrenArray(nodeJson);
+		if (childrenArray == NULL) {
+			break;
+		}
+		/* The stack grows exponentially for deep trees */
+		changedArrays = arrays;
+		if (arrays->size.length == arrays->size.capacity) {
+			changedArrays =
+			    JSONValuePointerVector_grow(arrays,
+							arrays->size.capacity *
+							2);
 		}
-		if (JSONValue_pushToArray(array, childJson) == NULL) {
-			JSONValue_freeRecursive(childJson);
-			JSONValue_freeRecursive(array);
-			return NULL;
+		if (changedArrays == NULL) {
+			break;
 		}
+		arrays = JSONValuePointerVector_append(changedArrays,
+						       &childrenArray);
+	}
+
+	JSONValuePointerVector_free(arrays);
+	ASTTraversal_free(traversal);
+	if (step != ASTTraversalStep_END) {
+		JSONValue_freeRecursive(array);
+		return NULL;
 	}
 
 	return array;
@@ -201,3 +263,24 @@ ASTNodeType nodeType;
 		return NULL;
 	}
 }
+
+/*
+ * Sets the children property of the node JSON to a new empty array, and
+ * returns the array, or NULL if the memory could not be allocated.
+ */
+static JSONValue *addChildrenArray(nodeJson)
+JSONValue *nodeJson;
+{
+	string *childrenKey = string_from(childrenKeyContent);
+	JSONValue *childrenArray = JSONValue_newArray();
+
+	if (childrenKey == NULL || childrenArray == NULL
+	    || JSONValue_setObjectProperty(nodeJson, childrenKey,
+					   childrenArray) == NULL) {
+		string_free(childrenKey);
+		JSONValue_free(childrenArray);
+		return NULL;
+	}
+
+	return childrenArray;
+}
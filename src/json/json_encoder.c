@@ -2,8 +2,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../bool.h"
 #include "../string.h"
-#include "../typed_pointer_vector.h"
+#include "../typed_vector.h"
 #include "json_encoder.h"
 
 static const char *STRINGIFIED_NULL_VALUE = "null";
@@ -15,450 +16,293 @@ static const double MIN_SAFE_INTEGER = -9007199254740991;
 /* pow(2, 53) - 1 */
 static const double MAX_SAFE_INTEGER = 9007199254740991;
 
-Vector_ofPointer(string)
-static string *encodeString(JSONValue *value);
+/* An array or object being encoded */
+typedef struct JSONEncoderFrame {
+	JSONValue *value;
+	/* The index of the item or property to encode next */
+	unsigned long next;
+} JSONEncoderFrame;
 
-static string *encodeArray(JSONValue *value);
+Vector_ofType(JSONEncoderFrame)
+static bool pushFrame(JSONEncoderFrameVector ** stack, JSONValue * value);
 
-static string *encodeObject(JSONValue *value);
+static bool moveToNextItem(string * output, unsigned long *capacity,
+			   JSONEncoderFrameVector * stack, JSONValue ** value);
 
-static string *createCompositeValueResult(stringPointerVector *items,
-					  string *prefix, string *separator,
-					  string *suffix);
+static bool encodeScalar(string * output, unsigned long *capacity,
+			 JSONValue * value);
 
-static unsigned long getJoinedStringLength(stringPointerVector *strings,
-					   unsigned long separatorLength);
+static bool encodeNumber(string * output, unsigned long *capacity,
+			 double number);
 
-static void joinStrings(unsigned char *destination,
-			stringPointerVector *strings, string *separator);
+static bool encodeString(string * output, unsigned long *capacity,
+			 string * value);
 
-static void freeStrings(stringPointerVector *strings);
+static bool appendBytes(string * output, unsigned long *capacity,
+			const char *bytes, unsigned long length);
 
+/*
+ * The values are encoded right into a single output buffer, and the arrays and
+ * objects being encoded are kept in an explicit stack, so that neither the
+ * call stack nor the copying of the encoded values grows with the depth of the
+ * encoded value.
+ */
 string *JSON_encode(value)
 JSONValue *value;
 {
-	string *result = NULL;
-	double number = 0;
-	char *stringifiedNumber = NULL;
+	string *output;
+	unsigned long capacity = 0;
+	JSONEncoderFrameVector *stack;
+	bool isSuccess = true;
 
 	if (value == NULL) {
 		return NULL;
 	}
 
-	switch (value->type) {
-	case JSONValueType_NULL:
-		return string_from(STRINGIFIED_NULL_VALUE);
-
-	case JSONValueType_BOOLEAN:
-		return string_from(value->value.boolean ?
-				   STRINGIFIED_TRUE_VALUE :
-				   STRINGIFIED_FALSE_VALUE);
-
-	case JSONValueType_NUMBER:
-		stringifiedNumber = malloc(sizeof(char) * 21);
-		if (stringifiedNumber == NULL) {
-			return NULL;
-		}
+	output = string_new(0);
+	stack = JSONEncoderFrameVector_new(0, 16);
+	if (output == NULL || stack == NULL) {
+		string_free(output);
+		JSONEncoderFrameVector_free(stack);
+		return NULL;
+	}
 
-		number = value->value.number;
-		if ((long)number == number && number >= MIN_SAFE_INTEGER
-		    && number <= MAX_SAFE_INTEGER) {
-			if (sprintf(stringifiedNumber, "%.0f", number) < 0) {
-				free(stringifiedNumber);
-				return NULL;
-			}
+	while (isSuccess) {
+		if (value->type == JSONValueType_ARRAY
+		    || value->type == JSONValueType_OBJECT) {
+			isSuccess = appendBytes(output, &capacity,
+						value->type ==
+						JSONValueType_ARRAY ? "[" : "{",
+						1)
+			    && pushFrame(&stack, value);
 		} else {
-			/*
-			 * This does not preserve as many decimal places as we
-			 * would like, however, floats are not used in the
-			 * structures we are going to encode, so this is not
-			 * really an issue.
-			 */
-			if (sprintf(stringifiedNumber, "%g", number) < 0) {
-				free(stringifiedNumber);
-				return NULL;
-			}
+			isSuccess = encodeScalar(output, &capacity, value);
 		}
 
-		result = string_from(stringifiedNumber);
-		free(stringifiedNumber);
-		return result;
-
-	case JSONValueType_STRING:
-		return encodeString(value);
-
-	case JSONValueType_ARRAY:
-		return encodeArray(value);
-
-	case JSONValueType_OBJECT:
-		return encodeObject(value);
+		value = NULL;
+		while (isSuccess && value == NULL && stack->size.length > 0) {
+			isSuccess = moveToNextItem(output, &capacity, stack,
+						   &value);
+		}
+		if (stack->size.length == 0) {
+			break;
+		}
+	}
 
-	default:
+	JSONEncoderFrameVector_free(stack);
+	if (!isSuccess) {
+		string_free(output);
 		return NULL;
 	}
+
+	return output;
 }
 
-static string *encodeString(value)
+/*
+ * Starts encoding the items of the array or object, the stack grows
+ * exponentially for deep values.
+ */
+static bool pushFrame(stack, value)
+JSONEncoderFrameVector **stack;
 JSONValue *value;
 {
-	string *stringValue = NULL;
-	unsigned long length = 0;
-	unsigned char *currentChar = NULL;
-	unsigned long i = 0;
-	string *result = NULL;
-	unsigned char *currentOutputChar = NULL;
-	char *codepointHexDigits = NULL;
-	char codepoint = 0;
-
-	if (value == NULL || value->type != JSONValueType_STRING) {
-		return NULL;
-	}
-
-	length = 2;		/* starting and ending quotes */
-	stringValue = value->value.string;
-	currentChar = stringValue->content;
-	for (i = 0; i < stringValue->length; i++, currentChar++) {
-		if (*currentChar == '"' || *currentChar == '/') {
-			if (ULONG_MAX - length < 2) {
-				return NULL;
-			}
-			length += 2;
-		} else if (*currentChar <= 31) {
-			if (ULONG_MAX - length < 6) {
-				return NULL;
-			}
-			length += 6;	/* \uXXXX */
-		} else {
-			if (ULONG_MAX - length < 1) {
-				return NULL;
-			}
-			length++;
+	JSONEncoderFrameVector *changedStack = *stack;
+	JSONEncoderFrame frame;
+
+	if (changedStack->size.length == changedStack->size.capacity) {
+		changedStack =
+		    JSONEncoderFrameVector_grow(*stack,
+						(*stack)->size.capacity * 2);
+		if (changedStack == NULL) {
+			return false;
 		}
 	}
 
-	result = string_new(length);
-	if (result == NULL) {
-		return NULL;
+	frame.value = value;
+	frame.next = 0;
+	changedStack = JSONEncoderFrameVector_append(changedStack, &frame);
+	if (changedStack == NULL) {
+		return false;
 	}
-
-	currentChar = stringValue->content;
-	currentOutputChar = result->content;
-	codepointHexDigits = malloc(sizeof(char) * 5);
-	if (codepointHexDigits == NULL) {
-		string_free(result);
-		return NULL;
-	}
-
-	*currentOutputChar = '"';
-	currentOutputChar++;
-	for (i = 0; i < stringValue->length; i++, currentChar++) {
-		if (*currentChar == '"' || *currentChar == '/') {
-			*currentOutputChar = '\\';
-			currentOutputChar++;
-			*currentOutputChar = *currentChar;
-			currentOutputChar++;
-		} else if (*currentChar <= 31) {
-			codepoint = *currentChar;
-			sprintf(codepointHexDigits, "%04x", codepoint);
-			*currentOutputChar = '\\';
-			currentOutputChar++;
-			*currentOutputChar = 'u';
-			currentOutputChar++;
-			*currentOutputChar = *codepointHexDigits;
-			currentOutputChar++;
-			*currentOutputChar = *(codepointHexDigits + 1);
-			currentOutputChar++;
-			*currentOutputChar = *(codepointHexDigits + 2);
-			currentOutputChar++;
-			*currentOutputChar = *(codepointHexDigits + 3);
-			currentOutputChar++;
-		} else {
-			*currentOutputChar = *currentChar;
-			currentOutputChar++;
-		}
-	}
-	*currentOutputChar = '"';
-
-	free(codepointHexDigits);
-
-	return result;
+	*stack = changedStack;
+	return true;
 }
 
-static string *encodeArray(value)
-JSONValue *value;
+/*
+ * Encodes the separator (and the key) preceding the next item of the array or
+ * object on top of the stack and stores the item, or closes the array or
+ * object and pops it from the stack if all of its items have been encoded.
+ */
+static bool moveToNextItem(output, capacity, stack, value)
+string *output;
+unsigned long *capacity;
+JSONEncoderFrameVector *stack;
+JSONValue **value;
 {
-	JSONValuePointerVector *items = NULL;
-	JSONValue **itemPointer = NULL;
-	stringPointerVector *encodedItems = NULL;
-	unsigned long i = 0;
-	string *result = NULL;
-	string *prefix = NULL;
-	string *itemSeparator = NULL;
-	string *suffix = NULL;
-
-	if (value == NULL || value->type != JSONValueType_ARRAY) {
-		return NULL;
+	JSONEncoderFrame *top = stack->items + stack->size.length - 1;
+	JSONValue *container = top->value;
+	bool isArray = container->type == JSONValueType_ARRAY;
+	JSONObjectProperty *property;
+
+	if (top->next == (isArray ? container->value.array->size.length :
+			  container->value.object->size.length)) {
+		stack->size.length--;
+		return appendBytes(output, capacity, isArray ? "]" : "}", 1);
 	}
 
-	items = value->value.array;
-	encodedItems = stringPointerVector_new(0, items->size.length);
-	if (encodedItems == NULL) {
-		return NULL;
+	if (top->next > 0 && !appendBytes(output, capacity, ",", 1)) {
+		return false;
 	}
-
-	itemPointer = items->items;
-	for (i = 0; i < items->size.length; i++, itemPointer++) {
-		string *encodedItem = JSON_encode(*itemPointer);
-		stringPointerVector *grownItems;
-		if (encodedItem == NULL) {
-			freeStrings(encodedItems);
-			return NULL;
-		}
-
-		grownItems =
-		    stringPointerVector_append(encodedItems, &encodedItem);
-		if (grownItems == NULL) {
-			string_free(encodedItem);
-			freeStrings(encodedItems);
-			return NULL;
+	if (isArray) {
+		*value = container->value.array->items[top->next];
+	} else {
+		property = container->value.object->items + top->next;
+		if (!encodeString(output, capacity, property->key)
+		    || !appendBytes(output, capacity, ":", 1)) {
+			return false;
 		}
-		encodedItems = grownItems;
+		*value = property->value;
 	}
+	top->next++;
 
-	prefix = string_from("[");
-	itemSeparator = string_from(",");
-	suffix = string_from("]");
-
-	if (prefix != NULL && itemSeparator != NULL && suffix != NULL) {
-		result =
-		    createCompositeValueResult(encodedItems, prefix,
-					       itemSeparator, suffix);
-	}
-
-	string_free(prefix);
-	string_free(itemSeparator);
-	string_free(suffix);
-	freeStrings(encodedItems);
-
-	return result;
+	/* A NULL item cannot be encoded */
+	return *value != NULL;
 }
 
-static string *encodeObject(value)
+static bool encodeScalar(output, capacity, value)
+string *output;
+unsigned long *capacity;
 JSONValue *value;
 {
-	JSONObjectPropertyVector *properties = NULL;
-	JSONObjectProperty *property = NULL;
-	JSONValue *keyWrapper = NULL;
-	stringPointerVector *encodedItems = NULL;
-	unsigned char *currentOutputChar = NULL;
-	unsigned long i = 0;
-	string *result = NULL;
-	string *prefix = NULL;
-	string *propertySeparator = NULL;
-	string *suffix = NULL;
-
-	if (value == NULL || value->type != JSONValueType_OBJECT) {
-		return NULL;
-	}
+	const char *stringifiedValue;
 
-	properties = value->value.object;
-	encodedItems = stringPointerVector_new(0, properties->size.length);
-	if (encodedItems == NULL) {
-		return NULL;
-	}
-
-	property = properties->items;
-	keyWrapper = JSONValue_newString(string_from(""));
-	if (keyWrapper == NULL) {
-		return NULL;
-	}
-	string_free(keyWrapper->value.string);
-	keyWrapper->value.string = NULL;
-
-	for (i = 0; i < properties->size.length; i++, property++) {
-		string *encodedKey, *encodedValue, *encodedProperty;
-		stringPointerVector *grownItems;
-		keyWrapper->value.string = property->key;
-		encodedKey = encodeString(keyWrapper);
-		if (encodedKey == NULL) {
-			freeStrings(encodedItems);
-			return NULL;
-		}
-		encodedValue = JSON_encode(property->value);
-		if (encodedValue == NULL) {
-			string_free(encodedKey);
-			freeStrings(encodedItems);
-			return NULL;
-		}
+	switch (value->type) {
+	case JSONValueType_NULL:
+		stringifiedValue = STRINGIFIED_NULL_VALUE;
+		return appendBytes(output, capacity, stringifiedValue,
+				   strlen(stringifiedValue));
 
-		if (ULONG_MAX - encodedKey->length < 1
-		    || ULONG_MAX - encodedKey->length - 1 <
-		    encodedValue->length) {
-			string_free(encodedKey);
-			string_free(encodedValue);
-			freeStrings(encodedItems);
-			return NULL;
-		}
+	case JSONValueType_BOOLEAN:
+		stringifiedValue = value->value.boolean ?
+		    STRINGIFIED_TRUE_VALUE : STRINGIFIED_FALSE_VALUE;
+		return appendBytes(output, capacity, stringifiedValue,
+				   strlen(stringifiedValue));
 
-		encodedProperty =
-		    string_new(encodedKey->length + 1 + encodedValue->length);
-		if (encodedProperty == NULL) {
-			string_free(encodedKey);
-			string_free(encodedValue);
-			freeStrings(encodedItems);
-			return NULL;
-		}
-		memcpy(encodedProperty->content, encodedKey->content,
-		       encodedKey->length);
-		*(encodedProperty->content + encodedKey->length) = ':';
-		currentOutputChar =
-		    encodedProperty->content + encodedKey->length + 1;
-		memcpy(currentOutputChar, encodedValue->content,
-		       encodedValue->length);
-
-		string_free(encodedKey);
-		string_free(encodedValue);
-
-		grownItems =
-		    stringPointerVector_append(encodedItems, &encodedProperty);
-		if (grownItems == NULL) {
-			string_free(encodedProperty);
-			freeStrings(encodedItems);
-			return NULL;
-		}
-		encodedItems = grownItems;
-	}
+	case JSONValueType_NUMBER:
+		return encodeNumber(output, capacity, value->value.number);
 
-	prefix = string_from("{");
-	propertySeparator = string_from(",");
-	suffix = string_from("}");
+	case JSONValueType_STRING:
+		return encodeString(output, capacity, value->value.string);
 
-	if (prefix != NULL && propertySeparator != NULL && suffix != NULL) {
-		result =
-		    createCompositeValueResult(encodedItems, prefix,
-					       propertySeparator, suffix);
+	default:
+		return false;
 	}
-
-	string_free(prefix);
-	string_free(propertySeparator);
-	string_free(suffix);
-	freeStrings(encodedItems);
-
-	return result;
 }
 
-static string *createCompositeValueResult(items, prefix, separator, suffix)
-stringPointerVector *items;
-string *prefix;
-string *separator;
-string *suffix;
+static bool encodeNumber(output, capacity, number)
+string *output;
+unsigned long *capacity;
+double number;
 {
-	unsigned long length;
-	string *result;
-	unsigned char *currentOutputChar;
-
-	if (prefix == NULL || items == NULL || separator == NULL
-	    || suffix == NULL) {
-		return NULL;
-	}
-
-	length = getJoinedStringLength(items, separator->length);
-	if (length == 0 && items->size.length > 0) {
-		return NULL;
-	}
-
-	if (ULONG_MAX - length < prefix->length) {
-		return NULL;
-	}
-	length += prefix->length;
-	if (ULONG_MAX - length < suffix->length) {
-		return NULL;
-	}
-	length += suffix->length;
+	char stringifiedNumber[21];
 
-	result = string_new(length);
-	if (result == NULL) {
-		return NULL;
+	if ((long)number == number && number >= MIN_SAFE_INTEGER
+	    && number <= MAX_SAFE_INTEGER) {
+		if (sprintf(stringifiedNumber, "%.0f", number) < 0) {
+			return false;
+		}
+	} else {
+		/*
+		 * This does not preserve as many decimal places as we would
+		 * like, however, floats are not used in the structures we are
+		 * going to encode, so this is not really an issue.
+		 */
+		if (sprintf(stringifiedNumber, "%g", number) < 0) {
+			return false;
+		}
 	}
 
-	currentOutputChar = result->content;
-	memcpy(currentOutputChar, prefix->content, prefix->length);
-	joinStrings(currentOutputChar + prefix->length, items, separator);
-	memcpy(currentOutputChar + length - suffix->length, suffix->content,
-	       suffix->length);
-
-	return result;
+	return appendBytes(output, capacity, stringifiedNumber,
+			   strlen(stringifiedNumber));
 }
 
-static unsigned long getJoinedStringLength(strings, separatorLength)
-stringPointerVector *strings;
-unsigned long separatorLength;
+static bool encodeString(output, capacity, value)
+string *output;
+unsigned long *capacity;
+string *value;
 {
-	unsigned long length = 0;
-	string **itemPointer = NULL;
-	unsigned long i = 0;
+	unsigned char *currentChar;
+	unsigned long start;
+	unsigned long i;
+	char escapedChar[7];
 
-	if (strings == NULL) {
-		return 0;
+	if (value == NULL || !appendBytes(output, capacity, "\"", 1)) {
+		return false;
 	}
 
-	itemPointer = strings->items;
-	for (i = 0; i < strings->size.length; i++, itemPointer++) {
-		if (*itemPointer == NULL) {
-			return 0;
-		}
-
-		if (i > 0) {
-			if (ULONG_MAX - length < separatorLength) {
-				return 0;
-			}
-			length += separatorLength;
+	/* The runs of characters that need no escaping are copied at once */
+	currentChar = value->content;
+	for (start = 0, i = 0; i < value->length; i++, currentChar++) {
+		if (*currentChar == '"' || *currentChar == '/') {
+			escapedChar[0] = '\\';
+			escapedChar[1] = (char)*currentChar;
+			escapedChar[2] = '\0';
+		} else if (*currentChar <= 31) {
+			sprintf(escapedChar, "\\u%04x", (char)*currentChar);
+		} else {
+			continue;
 		}
 
-		if (ULONG_MAX - length < (*itemPointer)->length) {
-			return 0;
+		if (!appendBytes(output, capacity,
+				 (char *)value->content + start, i - start)
+		    || !appendBytes(output, capacity, escapedChar,
+				    strlen(escapedChar))) {
+			return false;
 		}
-
-		length += (*itemPointer)->length;
+		start = i + 1;
 	}
 
-	return length;
+	return appendBytes(output, capacity, (char *)value->content + start,
+			   value->length - start)
+	    && appendBytes(output, capacity, "\"", 1);
 }
 
-static void joinStrings(destination, strings, separator)
-unsigned char *destination;
-stringPointerVector *strings;
-string *separator;
+static bool appendBytes(output, capacity, bytes, length)
+string *output;
+unsigned long *capacity;
+const char *bytes;
+unsigned long length;
 {
-	unsigned long i;
+	unsigned long grownCapacity = *capacity;
+	unsigned char *grownContent;
 
-	if (destination == NULL || strings == NULL || separator == NULL) {
-		return;
+	if (length == 0) {
+		return true;
 	}
 
-	for (i = 0; i < strings->size.length; i++) {
-		string *item;
-
-		if (i > 0) {
-			memcpy(destination, separator->content,
-			       separator->length);
-			destination += separator->length;
+	if (ULONG_MAX - output->length < length) {
+		return false;
+	}
+	if (output->length + length > grownCapacity) {
+		grownCapacity = grownCapacity < 64 ? 64 : grownCapacity;
+		while (output->length + length > grownCapacity) {
+			if (grownCapacity > ULONG_MAX / 2) {
+				grownCapacity = ULONG_MAX;
+				break;
+			}
+			grownCapacity *= 2;
 		}
-
-		item = *(strings->items + i);
-		memcpy(destination, item->content, item->length);
-		destination += item->length;
+		grownContent = realloc(output->content, grownCapacity);
+		if (grownContent == NULL) {
+			return false;
+		}
+		output->content = grownContent;
+		*capacity = grownCapacity;
 	}
-}
 
-static void freeStrings(strings)
-stringPointerVector *strings;
-{
-	unsigned long i;
-	for (i = 0; i < strings->size.length; i++) {
-		string_free(*(strings->items + i));
-	}
-	stringPointerVector_free(strings);
+	memcpy(output->content + output->length, bytes, length);
+	output->length += length;
+	return true;
 }
 
-Vector_ofPointerImplementation(string)
+Vector_ofTypeImplementation(JSONEncoderFrame)
@@ -237,45 +237,63 @@ JSONValue *value;
 	free(value);
 }
 
+/*
+ * The values are freed without recursion and without allocating memory: the
+ * path to the value being freed is kept in the vectors of its ancestors, each
+ * of which stores its own parent in the slot of the item that is being freed.
+ */
 void JSONValue_freeRecursive(value)
 JSONValue *value;
 {
-	JSONValue **itemPointer = NULL;
-	JSONObjectProperty *property = NULL;
-	unsigned long i;
-
-	if (value == NULL) {
-		return;
-	}
-
-	switch (value->type) {
-	case JSONValueType_STRING:
-		string_free(value->value.string);
-		value->value.string = NULL;
-		break;
+	JSONValue *parent = NULL;
+	JSONValue *item;
+	JSONValuePointerVector *array;
+	JSONObjectProperty *property;
+
+	while (value != NULL) {
+		if (value->type == JSONValueType_ARRAY
+		    && value->value.array->size.length > 0) {
+			array = value->value.array;
+			array->size.length--;
+			item = array->items[array->size.length];
+			array->items[array->size.length] = parent;
+		} else if (value->type == JSONValueType_OBJECT
+			   && value->value.object->size.length > 0) {
+			value->value.object->size.length--;
+			property = value->value.object->items +
+			    value->value.object->size.length;
+			string_free(property->key);
+			property->key = NULL;
+			item = property->value;
+			property->value = parent;
+		} else {
+			if (value->type == JSONValueType_STRING) {
+				string_free(value->value.string);
+				value->value.string = NULL;
+			}
+			JSONValue_free(value);
 
-	case JSONValueType_ARRAY:
-		itemPointer = value->value.array->items;
-		for (i = 0; i < value->value.array->size.length; i++) {
-			JSONValue_freeRecursive(*itemPointer);
-			itemPointer++;
+			/* Continue with the remaining items of the parent */
+			value = parent;
+			if (value == NULL) {
+				break;
+			}
+			if (value->type == JSONValueType_ARRAY) {
+				array = value->value.array;
+				parent = array->items[array->size.length];
+			} else {
+				property = value->value.object->items +
+				    value->value.object->size.length;
+				parent = property->value;
+			}
+			continue;
 		}
-		break;
 
-	case JSONValueType_OBJECT:
-		property = value->value.object->items;
-		for (i = 0; i < value->value.object->size.length; i++) {
-			string_free(property->key);
-			JSONValue_freeRecursive(property->value);
-			property++;
+		if (item != NULL) {
+			parent = value;
+			value = item;
 		}
-		break;
-
-	default:
-		break;
 	}
-
-	JSONValue_free(value);
 }
 
 Vector_ofPointerImplementation(JSONValue)
@@ -1,5 +1,6 @@
 #include "../layout_line_segment.h"
 #include "../layout_line_segment_vector.h"
+#include "../layout_segment_style.h"
 #include "ast_node.h"
 #include "layout_content_alignment.h"
 #include "layout_line_segment.h"
@@ -39,13 +40,16 @@ LayoutLineSegment *segment;
 	string *fontFixedLevelKey;
 	JSONValue *fontFixedLevelValue;
 	string *otherSegmentMarkersKey;
+	ASTNodePointerVector *otherSegmentMarkers;
 	JSONValue *otherSegmentMarkersValue;
 	string *contentKey;
 	JSONValue *contentValue;
+	const LayoutSegmentStyle *style;
 
 	if (segment == NULL) {
 		return JSONValue_newNull();
 	}
+	style = segment->style;
 
 	segmentJson = JSONValue_newObject();
 	if (segmentJson == NULL) {
@@ -89,19 +93,21 @@ LayoutLineSegment *segment;
 
 	causingCommandValue = ASTNode_toJSON(segment->causingCommand);
 	contentAlignmentValue =
-	    LayoutContentAlignment_toJSON(segment->contentAlignment);
+	    LayoutContentAlignment_toJSON(style->contentAlignment);
 	leftIndentationLevelValue =
-	    JSONValue_newNumber(segment->leftIndentationLevel);
+	    JSONValue_newNumber(style->leftIndentationLevel);
 	rightIndentationLevelValue =
-	    JSONValue_newNumber(segment->rightIndentationLevel);
-	fontSizeChangeValue = JSONValue_newNumber(segment->fontSizeChange);
-	fontBoldLevelValue = JSONValue_newNumber(segment->fontBoldLevel);
-	fontItalicLevelValue = JSONValue_newNumber(segment->fontItalicLevel);
+	    JSONValue_newNumber(style->rightIndentationLevel);
+	fontSizeChangeValue = JSONValue_newNumber(style->fontSizeChange);
+	fontBoldLevelValue = JSONValue_newNumber(style->fontBoldLevel);
+	fontItalicLevelValue = JSONValue_newNumber(style->fontItalicLevel);
 	fontUnderlinedLevelValue =
-	    JSONValue_newNumber(segment->fontUnderlinedLevel);
-	fontFixedLevelValue = JSONValue_newNumber(segment->fontFixedLevel);
-	otherSegmentMarkersValue =
-	    ASTNodePointerVector_toJSON(segment->otherSegmentMarkers);
+	    JSONValue_newNumber(style->fontUnderlinedLevel);
+	fontFixedLevelValue = JSONValue_newNumber(style->fontFixedLevel);
+	otherSegmentMarkers = LayoutLineSegment_getOtherSegmentMarkers(segment);
+	otherSegmentMarkersValue = otherSegmentMarkers != NULL ?
+	    ASTNodePointerVector_toJSON(otherSegmentMarkers) : NULL;
+	ASTNodePointerVector_free(otherSegmentMarkers);
 	contentValue = ASTNodePointerVector_toJSON(segment->content);
 
 	if (causingCommandKey == NULL
@@ -0,0 +1,13 @@
+#include "ast_node.h"
+#include "ast_node_pointer_vector.h"
+#include "layout_line_segment.h"
+#include "layout_segment_marker_stack.h"
+
+ASTNodePointerVector *LayoutLineSegment_getOtherSegmentMarkers(segment)
+LayoutLineSegment *segment;
+{
+	LayoutSegmentMarkerStack *markers;
+
+	markers = segment->style->otherSegmentMarkers;
+	return LayoutSegmentMarkerStack_toVector(markers);
+}
@@ -3,24 +3,26 @@
 
 #include "ast_node.h"
 #include "ast_node_pointer_vector.h"
-#include "layout_content_alignment.h"
+#include "layout_segment_style.h"
 
 typedef struct LayoutLineSegment {
 	ASTNode *causingCommand;
-	LayoutContentAlignment contentAlignment;
-	signed short leftIndentationLevel;
-	signed short rightIndentationLevel;
-	signed short fontSizeChange;
-	unsigned short fontBoldLevel;
-	unsigned short fontItalicLevel;
-	unsigned short fontUnderlinedLevel;
-	unsigned short fontFixedLevel;
 	/*
-	 * Used for the <Subscript>, <Superscript>, <Excerpt>, <Signature> and
-	 * new line segment-causing custom commands.
+	 * The formatting of the segment, interned in the style table of the
+	 * segment's document (see LayoutResolverResult.styles), so comparing
+	 * the pointers is enough to tell whether the styles of two segments
+	 * differ.
 	 */
-	ASTNodePointerVector *otherSegmentMarkers;
+	const LayoutSegmentStyle *style;
 	ASTNodePointerVector *content;
 } LayoutLineSegment;
 
+/*
+ * Returns a new vector of the other segment markers of the segment's style,
+ * from the outermost to the innermost one, which must be freed by the caller,
+ * or NULL if the memory could not be allocated.
+ */
+ASTNodePointerVector *LayoutLineSegment_getOtherSegmentMarkers(LayoutLineSegment
+							       *segment);
+
 #endif
@@ -1,6 +1,9 @@
 #include <stdlib.h>
+#include "bool.h"
 #include "layout_post_processor.h"
 
+static bool mergeWarnings(void *recordedWarning, const void *warning);
+
 void LayoutPostProcessorResult_free(result)
 LayoutPostProcessorResult *result;
 {
@@ -15,3 +18,34 @@ LayoutPostProcessorResult *result;
 	LayoutPostProcessorWarningVector_free(result->warnings);
 	free(result);
 }
+
+LayoutPostProcessorWarningVector *
+LayoutPostProcessorWarningVector_record(warnings, warning, policy)
+LayoutPostProcessorWarningVector *warnings;
+LayoutPostProcessorWarning *warning;
+const WarningPolicy *policy;
+{
+	warning->count = 1;
+	warning->lastNode = warning->node;
+	return (LayoutPostProcessorWarningVector *)
+	    WarningPolicy_record(policy, (Vector *) warnings, warning,
+				 mergeWarnings);
+}
+
+static bool mergeWarnings(recordedWarning, warning)
+void *recordedWarning;
+const void *warning;
+{
+	LayoutPostProcessorWarning *recorded = recordedWarning;
+	const LayoutPostProcessorWarning *merged = warning;
+
+	if (recorded->code != merged->code) {
+		return false;
+	}
+
+	recorded->count += merged->count;
+	recorded->lastNode = merged->lastNode;
+	return true;
+}
+
+Vector_ofTypeImplementation(LayoutPostProcessorWarning)
@@ -8,6 +8,7 @@
 #include "layout_line_segment.h"
 #include "layout_paragraph.h"
 #include "typed_vector.h"
+#include "warning_policy.h"
 
 typedef unsigned int LayoutPostProcessorWarningCode;
 
@@ -18,10 +19,25 @@ typedef struct LayoutPostProcessorWarning {
 	LayoutLineSegment *segment;
 	ASTNode *node;
 	LayoutPostProcessorWarningCode code;
+	/*
+	 * The number of warnings represented by this one and the node of the
+	 * last of them, see LayoutPostProcessorWarningVector_record.
+	 */
+	unsigned long count;
+	ASTNode *lastNode;
 } LayoutPostProcessorWarning;
 
 Vector_ofType(LayoutPostProcessorWarning);
 
+/*
+ * Records the warning, setting its count and lastNode, according to the
+ * warning policy (see WarningPolicy_record). Returns the possibly reallocated
+ * vector, or NULL if the memory for the warning could not be allocated.
+ */
+LayoutPostProcessorWarningVector *LayoutPostProcessorWarningVector_record
+    (LayoutPostProcessorWarningVector * warnings,
+     LayoutPostProcessorWarning * warning, const WarningPolicy * policy);
+
 typedef unsigned int LayoutPostProcessorErrorCode;
 
 typedef struct LayoutPostProcessorError {
@@ -4,6 +4,9 @@
 #include "ast_node.h"
 #include "ast_node_pointer_vector.h"
 #include "ast_node_type.h"
+#include "ast_traversal.h"
+#include "command_id.h"
+#include "custom_command_cache.h"
 #include "custom_command_layout_interpretation.h"
 #include "layout_block.h"
 #include "layout_block_type.h"
@@ -15,6 +18,9 @@
 #include "layout_paragraph.h"
 #include "layout_paragraph_vector.h"
 #include "layout_resolver.h"
+#include "layout_segment_marker_stack.h"
+#include "layout_segment_style.h"
+#include "layout_segment_style_table.h"
 #include "string.h"
 #include "vector.h"
 
@@ -131,29 +137,86 @@ typedef enum CommandLayoutInterpretation {
 
 Vector_ofType(LayoutContentAlignment)
     Vector_ofType(LayoutBlockType)
+    Vector_ofType(CommandLayoutInterpretation)
+/* The property of a line segment affected by a command */
+typedef enum SegmentStyle {
+	SegmentStyle_NONE,
+	SegmentStyle_CONTENT_ALIGNMENT,
+	SegmentStyle_LEFT_INDENTATION_LEVEL,
+	SegmentStyle_RIGHT_INDENTATION_LEVEL,
+	SegmentStyle_FONT_SIZE_CHANGE,
+	SegmentStyle_FONT_BOLD_LEVEL,
+	SegmentStyle_FONT_ITALIC_LEVEL,
+	SegmentStyle_FONT_UNDERLINED_LEVEL,
+	SegmentStyle_FONT_FIXED_LEVEL,
+	/* The command is pushed to the segment's otherSegmentMarkers */
+	SegmentStyle_OTHER_SEGMENT_MARKER
+} SegmentStyle;
+
+/* How a command is processed, see COMMAND_DISPATCH */
+typedef struct CommandDispatch {
+	CommandLayoutInterpretation layout;
+	SegmentStyle style;
+	/*
+	 * The change of the style's level at the command's start, reverted at
+	 * its end, or the LayoutContentAlignment for the CONTENT_ALIGNMENT
+	 * style.
+	 */
+	int argument;
+} CommandDispatch;
+
 typedef struct LayoutResolverState {
 	CustomCommandLayoutInterpretation(*customCommandInterpreter) (ASTNode *,
 								      bool);
 	bool caseInsensitiveCommands;
+	/* The cached interpretations of custom commands, NULL if not cached */
+	CustomCommandCache *customCommandCache;
 	ASTNodePointerVector *rootNodes;
+	ASTTraversal *traversal;
+	/* The layout interpretations of the commands being processed */
+	CommandLayoutInterpretationVector *layoutStack;
+	/*
+	 * The number of the commands being processed, i.e. of the ancestors of
+	 * the current node, by their resolved identifiers (see
+	 * CommandId_resolve), which are all lower than the case mismatch flag.
+	 */
+	unsigned long openCommands[CommandId_CASE_MISMATCH];
 	LayoutBlockTypeVector *blockTypeStack;
 	LayoutContentAlignmentVector *contentAlignmentStack;
+	/* The completed blocks, which stay empty if passed to the block sink */
 	LayoutBlockVector *blocks;
-	LayoutParagraphVector *paragraphs;
-	LayoutLineVector *lines;
-	LayoutLineSegmentVector *segments;
+	bool (*blockSink) (LayoutBlock *, void *);
+	void *blockSinkContext;
 	LayoutResolverWarningVector *warnings;
+	/* NULL for the default warning policy */
+	const WarningPolicy *warningPolicy;
+	/*
+	 * The items being built. The completed segments, lines and paragraphs
+	 * are appended right to the vectors of the current line, paragraph and
+	 * block respectively, which are replaced by new ones once their owner
+	 * is completed.
+	 */
 	LayoutBlock *block;
 	LayoutParagraph *paragraph;
 	LayoutLine *line;
 	LayoutLineSegment *segment;
+	/* The style of the current segment, interned once it is completed */
+	LayoutSegmentStyle *style;
+	LayoutSegmentStyleTable *styles;
 	ASTNode *errorLocation;
 } LayoutResolverState;
 
+static LayoutResolverResult *resolve(ASTNodePointerVector *nodes,
+				     CustomCommandLayoutInterpretation
+				     customCommandInterpreter(ASTNode *, bool),
+				     bool caseInsensitiveCommands,
+				     LayoutResolverOptions *options,
+				     bool blockSink(LayoutBlock *, void *),
+				     void *blockSinkContext);
+
 static void freeLayoutBlocks(LayoutBlockVector *blocks);
 
 static LayoutResolverErrorCode processCommands(LayoutResolverState *state,
-					       ASTNode *parent,
 					       ASTNodePointerVector *nodes);
 
 static LayoutResolverErrorCode
@@ -192,13 +255,19 @@ static LayoutResolverErrorCode updateSegmentOnCommandEnd(LayoutResolverState
 							 *state,
 							 ASTNode *commandNode);
 
-static bool nodeHasParentOfType(ASTNode *node, string *type,
-				bool caseInsensitive);
+static LayoutResolverErrorCode addWarning(LayoutResolverState *state,
+					  ASTNode *cause,
+					  LayoutResolverWarningCode code);
+
+static bool mergeWarnings(void *recordedWarning, const void *warning);
+
+static bool isInsideCommand(LayoutResolverState *state, CommandId command);
 
 static CommandLayoutInterpretation
 getCommandLayoutInterpretation(ASTNode *command,
 			       CustomCommandLayoutInterpretation
 			       customCommandInterpreter(ASTNode *, bool),
+			       CustomCommandCache *customCommandCache,
 			       bool caseInsensitive);
 
 static CommandLayoutInterpretation getLayoutInterpretation(LayoutResolverState
@@ -206,8 +275,12 @@ static CommandLayoutInterpretation getLayoutInterpretation(LayoutResolverState
 							   ASTNode
 							   *commandNode);
 
-static CommandLayoutInterpretation
-getStandardCommandLayoutInterpretation(string *command, bool caseInsensitive);
+static const CommandDispatch *getCommandDispatch(CommandId command);
+
+static LayoutResolverErrorCode changeSegmentLevel(LayoutSegmentStyle *
+						  segmentStyle,
+						  SegmentStyle style,
+						  int change);
 
 static ASTNode *nextDFSNode(ASTNodePointerVector *rootNodes, ASTNode *node,
 			    bool leaveCurrentNode);
@@ -217,35 +290,169 @@ static ASTNode *nextSibling(ASTNodePointerVector *rootNodes, ASTNode *node);
 static bool string_equals(string *string1, string *string2,
 			  bool caseInsensitive);
 
-static string *COMMAND_Comment = NULL;	/* The rest is declared bellow */
+#define DISPATCH(layout, style, argument)\
+	{CommandLayoutInterpretation_##layout, SegmentStyle_##style, argument}
+
+#define SEGMENT_STYLE(style, argument)\
+	DISPATCH(NEW_LINE_SEGMENT, style, argument)
+
+/*
+ * The processing of the standard commands, indexed by the resolved command
+ * identifiers (see CommandId_resolve). The table is constant, so looking a
+ * command up needs neither an initialization nor any locking. The commands
+ * not listed here are interpreted as custom commands.
+ */
+static const CommandDispatch COMMAND_DISPATCH[] = {
+	DISPATCH(CUSTOM, OTHER_SEGMENT_MARKER, 0),	/* NONE */
+	DISPATCH(CUSTOM, OTHER_SEGMENT_MARKER, 0),	/* CUSTOM */
+	DISPATCH(INLINE_CONTENT, NONE, 0),	/* LT */
+	DISPATCH(NEW_LINE, NONE, 0),	/* NL */
+	DISPATCH(NEW_PAGE, NONE, 0),	/* NP */
+	SEGMENT_STYLE(FONT_BOLD_LEVEL, 1),	/* BOLD */
+	SEGMENT_STYLE(FONT_ITALIC_LEVEL, 1),	/* ITALIC */
+	SEGMENT_STYLE(FONT_FIXED_LEVEL, 1),	/* FIXED */
+	SEGMENT_STYLE(FONT_SIZE_CHANGE, -1),	/* SMALLER */
+	SEGMENT_STYLE(FONT_SIZE_CHANGE, 1),	/* BIGGER */
+	SEGMENT_STYLE(FONT_UNDERLINED_LEVEL, 1),	/* UNDERLINE */
+	SEGMENT_STYLE(OTHER_SEGMENT_MARKER, 0),	/* SUBSCRIPT */
+	SEGMENT_STYLE(OTHER_SEGMENT_MARKER, 0),	/* SUPERSCRIPT */
+	SEGMENT_STYLE(CONTENT_ALIGNMENT, LayoutContentAlignment_CENTER),
+	SEGMENT_STYLE(CONTENT_ALIGNMENT, LayoutContentAlignment_JUSTIFY_LEFT),
+	SEGMENT_STYLE(CONTENT_ALIGNMENT, LayoutContentAlignment_JUSTIFY_RIGHT),
+	SEGMENT_STYLE(LEFT_INDENTATION_LEVEL, 1),	/* INDENT */
+	SEGMENT_STYLE(RIGHT_INDENTATION_LEVEL, 1),	/* INDENT_RIGHT */
+	SEGMENT_STYLE(LEFT_INDENTATION_LEVEL, -1),	/* OUTDENT */
+	SEGMENT_STYLE(RIGHT_INDENTATION_LEVEL, -1),	/* OUTDENT_RIGHT */
+	SEGMENT_STYLE(OTHER_SEGMENT_MARKER, 0),	/* EXCERPT */
+	SEGMENT_STYLE(OTHER_SEGMENT_MARKER, 0),	/* SIGNATURE */
+	DISPATCH(NEW_ISOLATED_PARAGRAPH, NONE, 0),	/* PARAGRAPH */
+	DISPATCH(SAME_PAGE, NONE, 0),	/* SAME_PAGE */
+	DISPATCH(HEADING_BLOCK, NONE, 0),	/* HEADING */
+	DISPATCH(FOOTING_BLOCK, NONE, 0),	/* FOOTING */
+	DISPATCH(COMMENT, NONE, 0),	/* COMMENT */
+	DISPATCH(NO_OP, NONE, 0),	/* NO_OP */
+	DISPATCH(NO_OP, NONE, 0),	/* US_ASCII */
+	DISPATCH(NO_OP, NONE, 0),	/* ISO_8859_1 */
+	DISPATCH(NO_OP, NONE, 0),	/* ISO_8859_2 */
+	DISPATCH(NO_OP, NONE, 0),	/* ISO_8859_3 */
+	DISPATCH(NO_OP, NONE, 0),	/* ISO_8859_4 */
+	DISPATCH(NO_OP, NONE, 0),	/* ISO_8859_5 */
+	DISPATCH(NO_OP, NONE, 0),	/* ISO_8859_6 */
+	DISPATCH(NO_OP, NONE, 0),	/* ISO_8859_7 */
+	DISPATCH(NO_OP, NONE, 0),	/* ISO_8859_8 */
+	DISPATCH(NO_OP, NONE, 0)	/* ISO_8859_9 */
+};
+
+static unsigned char COMMAND_Comment_content[] = "Comment";
+
+static string COMMAND_Comment = { 7, COMMAND_Comment_content };
 
 LayoutResolverResult *resolveLayout(nodes, customCommandInterpreter,
 				    caseInsensitiveCommands)
 ASTNodePointerVector *nodes;
 CustomCommandLayoutInterpretation customCommandInterpreter(ASTNode *, bool);
 bool caseInsensitiveCommands;
+{
+	return resolveLayoutWithOptions(nodes, customCommandInterpreter,
+					caseInsensitiveCommands, NULL);
+}
+
+LayoutResolverResult *resolveLayoutWithOptions(nodes, customCommandInterpreter,
+					       caseInsensitiveCommands, options)
+ASTNodePointerVector *nodes;
+CustomCommandLayoutInterpretation customCommandInterpreter(ASTNode *, bool);
+bool caseInsensitiveCommands;
+LayoutResolverOptions *options;
+{
+	return resolve(nodes, customCommandInterpreter, caseInsensitiveCommands,
+		       options, NULL, NULL);
+}
+
+LayoutResolverResult *resolveLayoutStreaming(nodes, customCommandInterpreter,
+					     caseInsensitiveCommands, options,
+					     blockSink, blockSinkContext)
+ASTNodePointerVector *nodes;
+CustomCommandLayoutInterpretation customCommandInterpreter(ASTNode *, bool);
+bool caseInsensitiveCommands;
+LayoutResolverOptions *options;
+bool blockSink(LayoutBlock *, void *);
+void *blockSinkContext;
+{
+	if (blockSink == NULL) {
+		return NULL;
+	}
+
+	return resolve(nodes, customCommandInterpreter, caseInsensitiveCommands,
+		       options, blockSink, blockSinkContext);
+}
+
+void LayoutBlock_freeContent(block)
+LayoutBlock *block;
+{
+	LayoutParagraph *paragraph;
+	LayoutLine *line;
+	LayoutLineSegment *segment;
+	unsigned long paragraphIndex, lineIndex, segmentIndex;
+
+	if (block == NULL || block->paragraphs == NULL) {
+		return;
+	}
+
+	for (paragraphIndex = 0, paragraph = block->paragraphs->items;
+	     paragraphIndex < block->paragraphs->size.length;
+	     paragraphIndex++, paragraph++) {
+		for (lineIndex = 0, line = paragraph->lines->items;
+		     lineIndex < paragraph->lines->size.length;
+		     lineIndex++, line++) {
+			for (segmentIndex = 0, segment = line->segments->items;
+			     segmentIndex < line->segments->size.length;
+			     segmentIndex++, segment++) {
+				ASTNodePointerVector_free(segment->content);
+			}
+			LayoutLineSegmentVector_free(line->segments);
+		}
+		LayoutLineVector_free(paragraph->lines);
+	}
+	LayoutParagraphVector_free(block->paragraphs);
+	block->paragraphs = NULL;
+}
+
+static LayoutResolverResult *resolve(nodes, customCommandInterpreter,
+				     caseInsensitiveCommands, options,
+				     blockSink, blockSinkContext)
+ASTNodePointerVector *nodes;
+CustomCommandLayoutInterpretation customCommandInterpreter(ASTNode *, bool);
+bool caseInsensitiveCommands;
+LayoutResolverOptions *options;
+bool blockSink(LayoutBlock *, void *);
+void *blockSinkContext;
 {
 	LayoutResolverState state;
 	LayoutResolverResult *result;
 	LayoutContentAlignmentVector *contentAlignmentStack = NULL;
 	LayoutBlockTypeVector *blockTypeStack = NULL;
+	ASTTraversal *traversal = NULL;
+	CommandLayoutInterpretationVector *layoutStack = NULL;
 	LayoutBlockVector *blocks = NULL;
-	LayoutParagraphVector *paragraphs = NULL;
-	LayoutLineVector *lines = NULL;
-	LayoutLineSegmentVector *segments = NULL;
 	LayoutResolverWarningVector *warnings = NULL;
 	LayoutBlock block;
 	LayoutParagraph paragraph;
 	LayoutLine line;
 	LayoutLineSegment segment;
+	LayoutSegmentStyle style;
+	LayoutSegmentStyleTable *styles = NULL;
+	CustomCommandCache *customCommandCache = NULL;
+	CustomCommandCache *ownCustomCommandCache = NULL;
 	LayoutResolverErrorCode errorCode = LayoutResolverErrorCode_OK;
 	ASTNode *errorLocation = NULL;
+	unsigned long commandId;
 
 	result = malloc(sizeof(LayoutResolverResult));
 	if (result == NULL) {
 		return NULL;
 	}
 	result->type = LayoutResolverResultType_SUCCESS;
+	result->styles = NULL;
 
 	block.causingCommand = NULL;
 	block.paragraphs = NULL;
@@ -259,17 +466,21 @@ bool caseInsensitiveCommands;
 	line.segments = NULL;
 
 	segment.causingCommand = NULL;
-	segment.contentAlignment = LayoutContentAlignment_DEFAULT;
-	segment.leftIndentationLevel = 0;
-	segment.rightIndentationLevel = 0;
-	segment.fontSizeChange = 0;
-	segment.fontBoldLevel = 0;
-	segment.fontItalicLevel = 0;
-	segment.fontUnderlinedLevel = 0;
-	segment.fontFixedLevel = 0;
-	segment.otherSegmentMarkers = NULL;
+	segment.style = NULL;
 	segment.content = NULL;
 
+	style.id = 0;
+	style.contentAlignment = LayoutContentAlignment_DEFAULT;
+	style.leftIndentationLevel = 0;
+	style.rightIndentationLevel = 0;
+	style.fontSizeChange = 0;
+	style.fontBoldLevel = 0;
+	style.fontItalicLevel = 0;
+	style.fontUnderlinedLevel = 0;
+	style.fontFixedLevel = 0;
+	/* The empty stack of other segment markers is NULL */
+	style.otherSegmentMarkers = NULL;
+
 	do {
 		ASTNode **nodePointer;
 		unsigned long i;
@@ -313,28 +524,9 @@ bool caseInsensitiveCommands;
 			break;
 		}
 
-		paragraphs = LayoutParagraphVector_new(0, 0);
-		errorCode =
-		    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_PARAGRAPHS;
-		if (paragraphs == NULL) {
-			break;
-		}
-		errorCode = LayoutResolverErrorCode_OK;
-
-		lines = LayoutLineVector_new(0, 0);
-		if (lines == NULL) {
-			errorCode =
-			    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_LINES;
-			break;
-		}
-
-		segments = LayoutLineSegmentVector_new(0, 0);
+		contentAlignmentStack = LayoutContentAlignmentVector_new(0, 0);
 		errorCode =
 		    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_LINE_SEGMENTS;
-		if (segments == NULL) {
-			break;
-		}
-		contentAlignmentStack = LayoutContentAlignmentVector_new(0, 0);
 		if (contentAlignmentStack == NULL) {
 			break;
 		}
@@ -347,6 +539,14 @@ bool caseInsensitiveCommands;
 			break;
 		}
 
+		traversal = ASTTraversal_new();
+		layoutStack = CommandLayoutInterpretationVector_new(0, 16);
+		if (traversal == NULL || layoutStack == NULL) {
+			errorCode =
+			    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_TRAVERSAL;
+			break;
+		}
+
 		block.paragraphs = LayoutParagraphVector_new(0, 0);
 		if (block.paragraphs == NULL) {
 			errorCode =
@@ -369,22 +569,11 @@ bool caseInsensitiveCommands;
 			break;
 		}
 
-		segment.contentAlignment = LayoutContentAlignment_DEFAULT;
-		segment.leftIndentationLevel = 0;
-		segment.rightIndentationLevel = 0;
-		segment.fontSizeChange = 0;
-		segment.fontBoldLevel = 0;
-		segment.fontItalicLevel = 0;
-		segment.fontUnderlinedLevel = 0;
-		segment.fontFixedLevel = 0;
-		segment.otherSegmentMarkers = ASTNodePointerVector_new(0, 0);
+		segment.content = ASTNodePointerVector_new(0, 0);
+		styles = LayoutSegmentStyleTable_new();
 		errorCode =
 		    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_LINE_SEGMENTS;
-		if (segment.otherSegmentMarkers == NULL) {
-			break;
-		}
-		segment.content = ASTNodePointerVector_new(0, 0);
-		if (segment.content == NULL) {
+		if (segment.content == NULL || styles == NULL) {
 			break;
 		}
 		errorCode = LayoutResolverErrorCode_OK;
@@ -396,19 +585,33 @@ bool caseInsensitiveCommands;
 		result->result.error.location = errorLocation;
 		result->warnings = warnings;
 		LayoutBlockTypeVector_free(blockTypeStack);
+		ASTTraversal_free(traversal);
+		CommandLayoutInterpretationVector_free(layoutStack);
 		LayoutContentAlignmentVector_free(contentAlignmentStack);
 		freeLayoutBlocks(blocks);
-		LayoutParagraphVector_free(paragraphs);
-		LayoutLineVector_free(lines);
-		LayoutLineSegmentVector_free(segments);
 		LayoutParagraphVector_free(block.paragraphs);
 		LayoutLineVector_free(paragraph.lines);
 		LayoutLineSegmentVector_free(line.segments);
-		ASTNodePointerVector_free(segment.otherSegmentMarkers);
 		ASTNodePointerVector_free(segment.content);
+		LayoutSegmentStyleTable_free(styles);
 		return result;
 	}
 
+	/*
+	 * The commands are interpreted without the cache if the memory for it
+	 * could not be allocated.
+	 */
+	if (options != NULL && options->interpretsCustomCommandsByName
+	    && customCommandInterpreter != NULL) {
+		customCommandCache = options->customCommandCache;
+		if (customCommandCache == NULL) {
+			ownCustomCommandCache = CustomCommandCache_new();
+			customCommandCache = ownCustomCommandCache;
+		}
+		CustomCommandCache_bind(customCommandCache,
+					customCommandInterpreter);
+	}
+
 	if (nodes->size.length > 0) {
 		block.causingCommand = *nodes->items;
 		paragraph.causingCommand = *nodes->items;
@@ -418,21 +621,29 @@ bool caseInsensitiveCommands;
 
 	state.customCommandInterpreter = customCommandInterpreter;
 	state.caseInsensitiveCommands = caseInsensitiveCommands;
+	state.customCommandCache = customCommandCache;
 	state.rootNodes = nodes;
+	state.traversal = traversal;
+	state.layoutStack = layoutStack;
+	for (commandId = 0; commandId < CommandId_CASE_MISMATCH; commandId++) {
+		state.openCommands[commandId] = 0;
+	}
 	state.blockTypeStack = blockTypeStack;
 	state.contentAlignmentStack = contentAlignmentStack;
 	state.blocks = blocks;
-	state.paragraphs = paragraphs;
-	state.lines = lines;
-	state.segments = segments;
+	state.blockSink = blockSink;
+	state.blockSinkContext = blockSinkContext;
 	state.warnings = warnings;
+	state.warningPolicy = options != NULL ? &options->warningPolicy : NULL;
 	state.block = &block;
 	state.paragraph = &paragraph;
 	state.line = &line;
 	state.segment = &segment;
+	state.style = &style;
+	state.styles = styles;
 	state.errorLocation = NULL;
 
-	errorCode = processCommands(&state, NULL, nodes);
+	errorCode = processCommands(&state, nodes);
 
 	if (errorCode == LayoutResolverErrorCode_OK) {
 		/* Add the current remaining content to completed blocks */
@@ -442,28 +653,41 @@ bool caseInsensitiveCommands;
 		node.tokenIndex = 0;
 		node.parent = NULL;
 		node.type = ASTNodeType_COMMAND;
-		node.value = COMMAND_Comment;
+		node.value = &COMMAND_Comment;
+		node.commandId = CommandId_COMMENT;
 		node.children = NULL;
-		newBlock(&state, &node, CommandLayoutInterpretation_COMMENT,
-			 NULL);
+		node.siblingIndex = 0;
+		errorCode = newBlock(&state, &node,
+				     CommandLayoutInterpretation_COMMENT, NULL);
+	}
+
+	if (errorCode == LayoutResolverErrorCode_OK) {
 		result->result.blocks = state.blocks;
+		result->styles = styles;
 	} else {
 		result->type = LayoutResolverResultType_ERROR;
 		result->result.error.code = errorCode;
 		result->result.error.location = state.errorLocation;
 		freeLayoutBlocks(state.blocks);
+		if (blockSink != NULL) {
+			/* The segments of the sunk blocks refer to the styles */
+			result->styles = styles;
+		} else {
+			LayoutSegmentStyleTable_free(styles);
+		}
 	}
 	result->warnings = state.warnings;
 
 	LayoutBlockTypeVector_free(blockTypeStack);
+	ASTTraversal_free(traversal);
+	CommandLayoutInterpretationVector_free(state.layoutStack);
 	LayoutContentAlignmentVector_free(contentAlignmentStack);
-	LayoutParagraphVector_free(paragraphs);
-	LayoutLineVector_free(lines);
-	LayoutLineSegmentVector_free(segments);
+	CustomCommandCache_free(ownCustomCommandCache);
+	/* The vectors are replaced by new ones whenever their items are used */
 	LayoutParagraphVector_free(state.block->paragraphs);
 	LayoutLineVector_free(state.paragraph->lines);
 	LayoutLineSegmentVector_free(state.line->segments);
-	ASTNodePointerVector_free(state.segment->otherSegmentMarkers);
+	LayoutSegmentMarkerStack_release(style.otherSegmentMarkers);
 	ASTNodePointerVector_free(state.segment->content);
 
 	return result;
@@ -486,6 +710,7 @@ LayoutResolverResult *result;
 		break;
 	}
 
+	LayoutSegmentStyleTable_free(result->styles);
 	LayoutResolverWarningVector_free(result->warnings);
 	free(result);
 }
@@ -494,11 +719,7 @@ static void freeLayoutBlocks(blocks)
 LayoutBlockVector *blocks;
 {
 	LayoutBlock *block;
-	LayoutParagraph *paragraph;
-	LayoutLine *line;
-	LayoutLineSegment *segment;
-	ASTNodePointerVector *nodes;
-	unsigned long blockIndex, paragraphIndex, lineIndex, segmentIndex;
+	unsigned long blockIndex;
 
 	if (blocks == NULL) {
 		return;
@@ -507,122 +728,100 @@ LayoutBlockVector *blocks;
 	for (blockIndex = 0, block = blocks->items;
 	     blockIndex < blocks->size.length && block != NULL;
 	     blockIndex++, block++) {
-		for (paragraphIndex = 0, paragraph = block->paragraphs->items;
-		     paragraphIndex < block->paragraphs->size.length &&
-		     paragraph != NULL; paragraphIndex++, paragraph++) {
-			for (lineIndex = 0, line = paragraph->lines->items;
-			     lineIndex < paragraph->lines->size.length &&
-			     line != NULL; lineIndex++, line++) {
-				for (segmentIndex = 0,
-				     segment = line->segments->items;
-				     segmentIndex < line->segments->size.length
-				     && segment != NULL;
-				     segmentIndex++, segment++) {
-					nodes = segment->otherSegmentMarkers;
-					ASTNodePointerVector_free(nodes);
-					nodes = segment->content;
-					ASTNodePointerVector_free(nodes);
-				}
-				LayoutLineSegmentVector_free(line->segments);
-			}
-			LayoutLineVector_free(paragraph->lines);
-		}
-		LayoutParagraphVector_free(block->paragraphs);
+		LayoutBlock_freeContent(block);
 	}
 	LayoutBlockVector_free(blocks);
 }
 
-static string *COMMAND_lt = NULL;
-static string *COMMAND_Bold = NULL;
-static string *COMMAND_Italic = NULL;
-static string *COMMAND_Fixed = NULL;
-static string *COMMAND_Smaller = NULL;
-static string *COMMAND_Bigger = NULL;
-static string *COMMAND_Underline = NULL;
-static string *COMMAND_Subscript = NULL;
-static string *COMMAND_Superscript = NULL;
-static string *COMMAND_Center = NULL;
-static string *COMMAND_FlushLeft = NULL;
-static string *COMMAND_FlushRight = NULL;
-static string *COMMAND_Indent = NULL;
-static string *COMMAND_IndentRight = NULL;
-static string *COMMAND_Outdent = NULL;
-static string *COMMAND_OutdentRight = NULL;
-static string *COMMAND_Excerpt = NULL;
-static string *COMMAND_Signature = NULL;
-static string *COMMAND_Paragraph = NULL;
-static string *COMMAND_SamePage = NULL;
-static string *COMMAND_Heading = NULL;
-static string *COMMAND_Footing = NULL;
-static string *COMMAND_ISO_8859_1 = NULL;
-static string *COMMAND_ISO_8859_2 = NULL;
-static string *COMMAND_ISO_8859_3 = NULL;
-static string *COMMAND_ISO_8859_4 = NULL;
-static string *COMMAND_ISO_8859_5 = NULL;
-static string *COMMAND_ISO_8859_6 = NULL;
-static string *COMMAND_ISO_8859_7 = NULL;
-static string *COMMAND_ISO_8859_8 = NULL;
-static string *COMMAND_ISO_8859_9 = NULL;
-static string *COMMAND_US_ASCII = NULL;
-static string *COMMAND_No_op = NULL;
-static string *COMMAND_nl = NULL;
-static string *COMMAND_np = NULL;
-
-static LayoutResolverErrorCode processCommands(state, parent, nodes)
+/*
+ * Processes the nodes and their descendants in document order. The nodes are
+ * traversed using an explicit stack, so the depth of the tree is not limited
+ * by the call stack.
+ */
+static LayoutResolverErrorCode processCommands(state, nodes)
 LayoutResolverState *state;
-ASTNode *parent;
 ASTNodePointerVector *nodes;
 {
-	ASTNode **nodePointer;
+	ASTTraversal *traversal = state->traversal;
+	ASTTraversalStep step;
 	ASTNode *node;
-	unsigned long index = 0;
 	CommandLayoutInterpretation layout;
+	CommandLayoutInterpretationVector *layouts;
+	CommandId command;
+	LayoutResolverErrorCode OOM_FOR_TRAVERSAL_ERROR =
+	    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_TRAVERSAL;
 	LayoutResolverErrorCode errorCode = LayoutResolverErrorCode_OK;
 
 	if (nodes == NULL) {
 		return LayoutResolverErrorCode_NULL_NODES_PROVIDED;
 	}
 
-	nodePointer = nodes->items;
-	for (; index < nodes->size.length; nodePointer++, index++) {
-		node = *nodePointer;
+	ASTTraversal_start(traversal, nodes);
+	for (step = ASTTraversal_next(traversal, &node);
+	     step != ASTTraversalStep_END;
+	     step = ASTTraversal_next(traversal, &node)) {
+		if (step == ASTTraversalStep_OUT_OF_MEMORY) {
+			errorCode = OOM_FOR_TRAVERSAL_ERROR;
+			break;
+		}
+
 		if (node == NULL) {
 			errorCode = LayoutResolverErrorCode_NULL_NODES_PROVIDED;
-			if (state->errorLocation == NULL) {
-				/*
-				 * We set the location to the parentNode, since
-				 * NULL would not be very helpful
-				 */
-				state->errorLocation = parent;
-			}
+			/*
+			 * We set the location to the parentNode, since NULL
+			 * would not be very helpful
+			 */
+			node = ASTTraversal_getParent(traversal);
 			break;
 		}
 
 		switch (node->type) {
 		case ASTNodeType_COMMAND:
-			layout = getLayoutInterpretation(state, node);
-
-			errorCode = processCommandStart(state, node, layout);
-			if (errorCode != LayoutResolverErrorCode_OK) {
+			layouts = state->layoutStack;
+			command =
+			    CommandId_resolve(node->commandId,
+					      state->caseInsensitiveCommands);
+			if (step == ASTTraversalStep_LEAVE) {
+				/* The command's layout is on top of the stack */
+				layouts->size.length--;
+				layout = layouts->items[layouts->size.length];
+				state->openCommands[command]--;
+				errorCode =
+				    processCommandEnd(state, node, layout);
 				break;
 			}
 
-			if (layout != CommandLayoutInterpretation_COMMENT
-			    && node->children != NULL) {
-				errorCode =
-				    processCommands(state, node,
-						    node->children);
+			layout = getLayoutInterpretation(state, node);
+			if (layouts->size.length == layouts->size.capacity) {
+				layouts =
+				    CommandLayoutInterpretationVector_grow
+				    (layouts, layouts->size.capacity * 2);
 			}
-			if (errorCode != LayoutResolverErrorCode_OK) {
+			if (layouts == NULL) {
+				errorCode = OOM_FOR_TRAVERSAL_ERROR;
+				break;
+			}
+			layouts =
+			    CommandLayoutInterpretationVector_append(layouts,
+								     &layout);
+			if (layouts == NULL) {
+				errorCode = OOM_FOR_TRAVERSAL_ERROR;
 				break;
 			}
+			state->layoutStack = layouts;
 
-			errorCode = processCommandEnd(state, node, layout);
+			errorCode = processCommandStart(state, node, layout);
+			state->openCommands[command]++;
+			if (layout == CommandLayoutInterpretation_COMMENT) {
+				ASTTraversal_skipChildren(traversal);
+			}
 			break;
 
 		case ASTNodeType_TEXT:
 		case ASTNodeType_WHITESPACE:
-			errorCode = addSegmentContent(state, *nodePointer);
+			if (step == ASTTraversalStep_ENTER) {
+				errorCode = addSegmentContent(state, node);
+			}
 			break;
 
 		default:
@@ -632,13 +831,15 @@ ASTNodePointerVector *nodes;
 		}
 
 		if (errorCode != LayoutResolverErrorCode_OK) {
-			if (state->errorLocation == NULL) {
-				state->errorLocation = node;
-			}
 			break;
 		}
 	}
 
+	if (errorCode != LayoutResolverErrorCode_OK
+	    && state->errorLocation == NULL) {
+		state->errorLocation = node;
+	}
+
 	return errorCode;
 }
 
@@ -653,8 +854,10 @@ CommandLayoutInterpretation layout;
 	    LayoutResolverErrorCode_INVALID_CUSTOM_COMMAND_INTERPRETATION;
 	LayoutResolverErrorCode UNTRANSLATED_CUSTOM_LAYOUT_ERROR =
 	    LayoutResolverErrorCode_UNTRANSLATED_CUSTOM_LAYOUT_INTERPRETATION;
-	LayoutResolverErrorCode OOM_FOR_WARNINGS =
-	    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_WARNINGS;
+	LayoutResolverWarningCode NEW_PAGE_INSIDE_SAME_PAGE_WARNING =
+	    LayoutResolverWarningCode_NEW_PAGE_INSIDE_SAME_PAGE;
+	LayoutResolverWarningCode NESTED_SAME_PAGE_WARNING =
+	    LayoutResolverWarningCode_NESTED_SAME_PAGE;
 	LayoutResolverErrorCode errorCode = LayoutResolverErrorCode_OK;
 
 	switch (layout) {
@@ -669,45 +872,28 @@ CommandLayoutInterpretation layout;
 		}
 		state->blockTypeStack = grownBlockTypeStack;
 
-		newBlock(state, node, layout, NULL);
+		errorCode = newBlock(state, node, layout, NULL);
 		break;
 
 	case CommandLayoutInterpretation_NEW_PAGE:
 	case CommandLayoutInterpretation_SAME_PAGE:
 		if (layout == CommandLayoutInterpretation_NEW_PAGE
-		    && nodeHasParentOfType(node, COMMAND_SamePage,
-					   state->caseInsensitiveCommands)) {
-			LayoutResolverWarning warning;
-			LayoutResolverWarningVector *grownWarnings;
-			warning.cause = node;
-			warning.code =
-			    LayoutResolverWarningCode_NEW_PAGE_INSIDE_SAME_PAGE;
-			grownWarnings =
-			    LayoutResolverWarningVector_append(state->warnings,
-							       &warning);
-			if (grownWarnings == NULL) {
-				errorCode = OOM_FOR_WARNINGS;
+		    && isInsideCommand(state, CommandId_SAME_PAGE)) {
+			errorCode =
+			    addWarning(state, node,
+				       NEW_PAGE_INSIDE_SAME_PAGE_WARNING);
+			if (errorCode != LayoutResolverErrorCode_OK) {
 				break;
 			}
-			state->warnings = grownWarnings;
 		}
 
 		if (layout == CommandLayoutInterpretation_SAME_PAGE
-		    && nodeHasParentOfType(node, COMMAND_SamePage,
-					   state->caseInsensitiveCommands)) {
-			LayoutResolverWarning warning;
-			LayoutResolverWarningVector *grownWarnings;
-			warning.cause = node;
-			warning.code =
-			    LayoutResolverWarningCode_NESTED_SAME_PAGE;
-			grownWarnings =
-			    LayoutResolverWarningVector_append(state->warnings,
-							       &warning);
-			if (grownWarnings == NULL) {
-				errorCode = OOM_FOR_WARNINGS;
+		    && isInsideCommand(state, CommandId_SAME_PAGE)) {
+			errorCode =
+			    addWarning(state, node, NESTED_SAME_PAGE_WARNING);
+			if (errorCode != LayoutResolverErrorCode_OK) {
 				break;
 			}
-			state->warnings = grownWarnings;
 		}
 
 		errorCode = newBlock(state, node, layout, NULL);
@@ -784,6 +970,22 @@ CommandLayoutInterpretation layout;
 	    LayoutResolverErrorCode_UNTRANSLATED_CUSTOM_LAYOUT_INTERPRETATION;
 	LayoutResolverErrorCode errorCode = LayoutResolverErrorCode_OK;
 
+	switch (layout) {
+	case CommandLayoutInterpretation_NEW_PAGE:
+	case CommandLayoutInterpretation_NEW_LINE:
+	case CommandLayoutInterpretation_INLINE_CONTENT:
+	case CommandLayoutInterpretation_COMMENT:
+	case CommandLayoutInterpretation_NO_OP:
+		/*
+		 * Nothing to do, which is worth knowing before looking for the
+		 * upcoming node, since that may take a walk up the whole tree.
+		 */
+		return LayoutResolverErrorCode_OK;
+
+	default:
+		break;
+	}
+
 	upcomingNode = nextDFSNode(state->rootNodes, node, true);
 
 	switch (layout) {
@@ -859,14 +1061,6 @@ CommandLayoutInterpretation layout;
 
 		break;
 
-	case CommandLayoutInterpretation_NEW_PAGE:
-	case CommandLayoutInterpretation_NEW_LINE:
-	case CommandLayoutInterpretation_INLINE_CONTENT:
-	case CommandLayoutInterpretation_COMMENT:
-	case CommandLayoutInterpretation_NO_OP:
-		/* Nothing to do */
-		break;
-
 	case CommandLayoutInterpretation_INVALID_CUSTOM_COMMAND:
 		return LayoutResolverErrorCode_INVALID_CUSTOM_COMMAND;
 
@@ -891,42 +1085,39 @@ CommandLayoutInterpretation layout;
 ASTNode *exitedNode;
 {
 	LayoutResolverErrorCode errorCode = LayoutResolverErrorCode_OK;
-	LayoutParagraphVector *grownParagraphs = NULL;
 	LayoutBlockVector *grownBlocks = NULL;
+	bool sunk;
 	LayoutResolverErrorCode OOM_FOR_PARAGRAPHS_ERROR =
 	    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_PARAGRAPHS;
+	LayoutResolverErrorCode OOM_FOR_BLOCKS_ERROR =
+	    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_BLOCKS;
+	LayoutResolverErrorCode BLOCK_SINK_FAILURE_ERROR =
+	    LayoutResolverErrorCode_BLOCK_SINK_FAILURE;
 	errorCode = newParagraph(state, node, layout, exitedNode);
 	if (errorCode != LayoutResolverErrorCode_OK) {
 		return errorCode;
 	}
 
-	if (state->paragraphs->size.length > 0) {
-		grownParagraphs =
-		    LayoutParagraphVector_concat(state->block->paragraphs,
-						 state->paragraphs);
-		if (grownParagraphs == NULL) {
-			return OOM_FOR_PARAGRAPHS_ERROR;
-		}
-		LayoutParagraphVector_free(state->block->paragraphs);
-		state->block->paragraphs = grownParagraphs;
-
-		LayoutParagraphVector_free(state->paragraphs);
-		state->paragraphs = LayoutParagraphVector_new(0, 0);
-		if (state->paragraphs == NULL) {
-			return OOM_FOR_PARAGRAPHS_ERROR;
-		}
-	}
-
 	if (state->block->paragraphs->size.length > 0
 	    || state->block->type == LayoutBlockType_PAGE_BREAK
 	    || state->block->type == LayoutBlockType_SAME_PAGE_START
 	    || state->block->type == LayoutBlockType_SAME_PAGE_END) {
-		grownBlocks =
-		    LayoutBlockVector_append(state->blocks, state->block);
-		if (grownBlocks == NULL) {
-			return LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_BLOCKS;
+		if (state->blockSink != NULL) {
+			/* The sink owns the block's content from now on */
+			sunk = state->blockSink(state->block,
+						state->blockSinkContext);
+			state->block->paragraphs = NULL;
+			if (!sunk) {
+				return BLOCK_SINK_FAILURE_ERROR;
+			}
+		} else {
+			grownBlocks = LayoutBlockVector_append(state->blocks,
+							       state->block);
+			if (grownBlocks == NULL) {
+				return OOM_FOR_BLOCKS_ERROR;
+			}
+			state->blocks = grownBlocks;
 		}
-		state->blocks = grownBlocks;
 
 		state->block->paragraphs = LayoutParagraphVector_new(0, 0);
 		if (state->block->paragraphs == NULL) {
@@ -979,9 +1170,8 @@ CommandLayoutInterpretation layout;
 ASTNode *exitedNode;
 {
 	LayoutResolverErrorCode errorCode = LayoutResolverErrorCode_OK;
-	string *command;
+	CommandId command;
 	bool caseInsensitive = state->caseInsensitiveCommands;
-	LayoutLineVector *grownLines = NULL;
 	LayoutParagraphVector *grownParagraphs = NULL;
 	LayoutResolverErrorCode OOM_FOR_PARAGRAPHS_ERROR =
 	    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_PARAGRAPHS;
@@ -990,35 +1180,18 @@ ASTNode *exitedNode;
 		return errorCode;
 	}
 
-	if (state->lines->size.length > 0) {
-		grownLines =
-		    LayoutLineVector_concat(state->paragraph->lines,
-					    state->lines);
-		if (grownLines == NULL) {
-			return LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_LINES;
-		}
-		LayoutLineVector_free(state->paragraph->lines);
-		state->paragraph->lines = grownLines;
-
-		LayoutLineVector_free(state->lines);
-		state->lines = LayoutLineVector_new(0, 0);
-		if (state->lines == NULL) {
-			return LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_LINES;
-		}
-	}
-
 	if (state->paragraph->lines->size.length > 0
 	    || (exitedNode == state->paragraph->causingCommand
 		&& (layout == CommandLayoutInterpretation_NEW_PARAGRAPH
 		    || layout ==
 		    CommandLayoutInterpretation_NEW_ISOLATED_PARAGRAPH))) {
 		grownParagraphs =
-		    LayoutParagraphVector_append(state->paragraphs,
+		    LayoutParagraphVector_append(state->block->paragraphs,
 						 state->paragraph);
 		if (grownParagraphs == NULL) {
 			return OOM_FOR_PARAGRAPHS_ERROR;
 		}
-		state->paragraphs = grownParagraphs;
+		state->block->paragraphs = grownParagraphs;
 
 		state->paragraph->lines = LayoutLineVector_new(0, 0);
 		if (state->paragraph->lines == NULL) {
@@ -1029,11 +1202,12 @@ ASTNode *exitedNode;
 	state->paragraph->causingCommand = node;
 
 	state->paragraph->type = LayoutParagraphType_IMPLICIT;
-	command = exitedNode != NULL ? exitedNode->value : node->value;
-	if (string_equals(command, COMMAND_Paragraph, caseInsensitive)) {
+	command = exitedNode != NULL ? exitedNode->commandId : node->commandId;
+	command = CommandId_resolve(command, caseInsensitive);
+	if (command == CommandId_PARAGRAPH) {
+		/* The exited node is no longer counted as open */
 		if (exitedNode == NULL
-		    || nodeHasParentOfType(exitedNode, COMMAND_Paragraph,
-					   caseInsensitive)) {
+		    || isInsideCommand(state, CommandId_PARAGRAPH)) {
 			state->paragraph->type = LayoutParagraphType_EXPLICIT;
 		}
 	}
@@ -1047,7 +1221,6 @@ ASTNode *node;
 CommandLayoutInterpretation layout;
 {
 	LayoutResolverErrorCode errorCode = LayoutResolverErrorCode_OK;
-	LayoutLineSegmentVector *grownSegments = NULL;
 	LayoutLineVector *grownLines = NULL;
 	LayoutResolverErrorCode OOM_FOR_LINE_SEGMENTS_ERROR =
 	    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_LINE_SEGMENTS;
@@ -1056,32 +1229,16 @@ CommandLayoutInterpretation layout;
 		return errorCode;
 	}
 
-	if (state->segments->size.length > 0) {
-		grownSegments =
-		    LayoutLineSegmentVector_concat(state->line->segments,
-						   state->segments);
-		if (grownSegments == NULL) {
-			return OOM_FOR_LINE_SEGMENTS_ERROR;
-		}
-		LayoutLineSegmentVector_free(state->line->segments);
-		state->line->segments = grownSegments;
-
-		LayoutLineSegmentVector_free(state->segments);
-		state->segments = LayoutLineSegmentVector_new(0, 0);
-		if (state->segments == NULL) {
-			return OOM_FOR_LINE_SEGMENTS_ERROR;
-		}
-	}
-
 	if (state->line->segments->size.length > 0
 	    || layout == CommandLayoutInterpretation_NEW_LINE
 	    || layout == CommandLayoutInterpretation_NEW_CUSTOM_LINE
 	    || layout == CommandLayoutInterpretation_NEW_ISOLATED_LINE) {
-		grownLines = LayoutLineVector_append(state->lines, state->line);
+		grownLines = LayoutLineVector_append(state->paragraph->lines,
+						     state->line);
 		if (grownLines == NULL) {
 			return LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_LINES;
 		}
-		state->lines = grownLines;
+		state->paragraph->lines = grownLines;
 
 		state->line->segments = LayoutLineSegmentVector_new(0, 0);
 		if (state->line->segments == NULL) {
@@ -1102,27 +1259,25 @@ ASTNode *node;
 	LayoutLineSegmentVector *grownSegments = NULL;
 	LayoutResolverErrorCode OOM_FOR_SEGMENTS_ERROR =
 	    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_LINE_SEGMENTS;
-	unsigned long length;
 
 	if (segment->content->size.length > 0) {
+		segment->style =
+		    LayoutSegmentStyleTable_intern(state->styles, state->style);
+		if (segment->style == NULL) {
+			return OOM_FOR_SEGMENTS_ERROR;
+		}
 		grownSegments =
-		    LayoutLineSegmentVector_append(state->segments, segment);
+		    LayoutLineSegmentVector_append(state->line->segments,
+						   segment);
 		if (grownSegments == NULL) {
 			return OOM_FOR_SEGMENTS_ERROR;
 		}
-		state->segments = grownSegments;
+		state->line->segments = grownSegments;
 
 		segment->content = ASTNodePointerVector_new(0, 0);
 		if (segment->content == NULL) {
 			return OOM_FOR_SEGMENTS_ERROR;
 		}
-		length = segment->otherSegmentMarkers->size.length;
-		segment->otherSegmentMarkers =
-		    ASTNodePointerVector_bigSlice(segment->otherSegmentMarkers,
-						  0, length);
-		if (segment->otherSegmentMarkers == NULL) {
-			return OOM_FOR_SEGMENTS_ERROR;
-		}
 	}
 
 	segment->causingCommand = node;
@@ -1148,165 +1303,47 @@ static LayoutResolverErrorCode updateSegmentOnCommandStart(state, commandNode)
 LayoutResolverState *state;
 ASTNode *commandNode;
 {
-	LayoutContentAlignmentVector *contentAlignmentStack;
 	LayoutContentAlignmentVector *grownAlignments;
-	LayoutLineSegment *segment = state->segment;
-	LayoutContentAlignment alignment = segment->contentAlignment;
-	ASTNodePointerVector *grownMarkers;
-	string *command = commandNode->value;
-	bool caseInsensitive = state->caseInsensitiveCommands;
-	unsigned long length;
+	LayoutSegmentStyle *style = state->style;
+	LayoutContentAlignment alignment = style->contentAlignment;
+	LayoutSegmentMarkerStack *grownMarkers;
+	CommandId command = CommandId_resolve(commandNode->commandId,
+					      state->caseInsensitiveCommands);
+	const CommandDispatch *dispatch = getCommandDispatch(command);
 	LayoutResolverErrorCode OOM_FOR_LINE_SEGMENTS =
 	    LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_LINE_SEGMENTS;
-	LayoutResolverErrorCode LEFT_INDENTATION_OVERFLOW_ERROR =
-	    LayoutResolverErrorCode_LEFT_INDENTATION_LEVEL_OVERFLOW;
-	LayoutResolverErrorCode LEFT_INDENTATION_UNDERFLOW_ERROR =
-	    LayoutResolverErrorCode_LEFT_INDENTATION_LEVEL_UNDERFLOW;
-	LayoutResolverErrorCode RIGHT_INDENTATION_OVERFLOW_ERROR =
-	    LayoutResolverErrorCode_RIGHT_INDENTATION_LEVEL_OVERFLOW;
-	LayoutResolverErrorCode RIGHT_INDENTATION_UNDERFLOW_ERROR =
-	    LayoutResolverErrorCode_RIGHT_INDENTATION_LEVEL_UNDERFLOW;
-	LayoutResolverErrorCode FONT_UNDERLINED_LEVEL_OVERFLOW_ERROR =
-	    LayoutResolverErrorCode_FONT_UNDERLINED_LEVEL_OVERFLOW;
-
-	contentAlignmentStack = state->contentAlignmentStack;
-
-	/* contentAlignment */
-	if (string_equals(command, COMMAND_FlushRight, caseInsensitive)) {
-		grownAlignments =
-		    LayoutContentAlignmentVector_append(contentAlignmentStack,
-							&alignment);
-		if (grownAlignments == NULL) {
-			return OOM_FOR_LINE_SEGMENTS;
-		}
-		state->contentAlignmentStack = grownAlignments;
-		segment->contentAlignment =
-		    LayoutContentAlignment_JUSTIFY_RIGHT;
-		return LayoutResolverErrorCode_OK;
-	} else if (string_equals(command, COMMAND_FlushLeft, caseInsensitive)) {
-		grownAlignments =
-		    LayoutContentAlignmentVector_append(contentAlignmentStack,
-							&alignment);
-		if (grownAlignments == NULL) {
-			return OOM_FOR_LINE_SEGMENTS;
-		}
-		state->contentAlignmentStack = grownAlignments;
-		segment->contentAlignment = LayoutContentAlignment_JUSTIFY_LEFT;
-		return LayoutResolverErrorCode_OK;
-	} else if (string_equals(command, COMMAND_Center, caseInsensitive)) {
+
+	switch (dispatch->style) {
+	case SegmentStyle_CONTENT_ALIGNMENT:
 		grownAlignments =
-		    LayoutContentAlignmentVector_append(contentAlignmentStack,
-							&alignment);
+		    LayoutContentAlignmentVector_append
+		    (state->contentAlignmentStack, &alignment);
 		if (grownAlignments == NULL) {
 			return OOM_FOR_LINE_SEGMENTS;
 		}
 		state->contentAlignmentStack = grownAlignments;
-		segment->contentAlignment = LayoutContentAlignment_CENTER;
-		return LayoutResolverErrorCode_OK;
-	}
-
-	/* leftIndentationLevel */
-	if (string_equals(command, COMMAND_Indent, caseInsensitive)) {
-		if (segment->leftIndentationLevel == SHRT_MAX) {
-			return LEFT_INDENTATION_OVERFLOW_ERROR;
-		}
-		segment->leftIndentationLevel++;
+		style->contentAlignment =
+		    (LayoutContentAlignment) dispatch->argument;
 		return LayoutResolverErrorCode_OK;
-	} else if (string_equals(command, COMMAND_Outdent, caseInsensitive)) {
-		if (segment->leftIndentationLevel == SHRT_MIN) {
-			return LEFT_INDENTATION_UNDERFLOW_ERROR;
-		}
-		segment->leftIndentationLevel--;
-		return LayoutResolverErrorCode_OK;
-	}
-
-	/* rightIndentationLevel */
-	if (string_equals(command, COMMAND_IndentRight, caseInsensitive)) {
-		if (segment->rightIndentationLevel == SHRT_MAX) {
-			return RIGHT_INDENTATION_OVERFLOW_ERROR;
-		}
-		segment->rightIndentationLevel++;
-		return LayoutResolverErrorCode_OK;
-	} else
-	    if (string_equals(command, COMMAND_OutdentRight, caseInsensitive)) {
-		if (segment->rightIndentationLevel == SHRT_MIN) {
-			return RIGHT_INDENTATION_UNDERFLOW_ERROR;
-		}
-		segment->rightIndentationLevel--;
-		return LayoutResolverErrorCode_OK;
-	}
-
-	/* fontSizeChange */
-	if (string_equals(command, COMMAND_Bigger, caseInsensitive)) {
-		if (segment->fontSizeChange == SHRT_MAX) {
-			return
-			    LayoutResolverErrorCode_FONT_SIZE_CHANGE_OVERFLOW;
-		}
-		segment->fontSizeChange++;
-		return LayoutResolverErrorCode_OK;
-	} else if (string_equals(command, COMMAND_Smaller, caseInsensitive)) {
-		if (segment->fontSizeChange == SHRT_MIN) {
-			return
-			    LayoutResolverErrorCode_FONT_SIZE_CHANGE_UNDERFLOW;
-		}
-		segment->fontSizeChange--;
-		return LayoutResolverErrorCode_OK;
-	}
 
-	/* fontBoldLevel */
-	if (string_equals(command, COMMAND_Bold, caseInsensitive)) {
-		if (segment->fontBoldLevel == USHRT_MAX) {
-			return LayoutResolverErrorCode_FONT_BOLD_LEVEL_OVERFLOW;
-		}
-		segment->fontBoldLevel++;
-		return LayoutResolverErrorCode_OK;
-	}
-
-	/* fontItalicLevel */
-	if (string_equals(command, COMMAND_Italic, caseInsensitive)) {
-		if (segment->fontItalicLevel == USHRT_MAX) {
-			return
-			    LayoutResolverErrorCode_FONT_ITALIC_LEVEL_OVERFLOW;
-		}
-		segment->fontItalicLevel++;
-		return LayoutResolverErrorCode_OK;
-	}
-
-	/* fontUnderlinedLevel */
-	if (string_equals(command, COMMAND_Underline, caseInsensitive)) {
-		if (segment->fontUnderlinedLevel == USHRT_MAX) {
-			return FONT_UNDERLINED_LEVEL_OVERFLOW_ERROR;
-		}
-		segment->fontUnderlinedLevel++;
-		return LayoutResolverErrorCode_OK;
-	}
+	case SegmentStyle_NONE:
+	case SegmentStyle_OTHER_SEGMENT_MARKER:
+		break;
 
-	/* fontFixedLevel */
-	if (string_equals(command, COMMAND_Fixed, caseInsensitive)) {
-		if (segment->fontFixedLevel == USHRT_MAX) {
-			return
-			    LayoutResolverErrorCode_FONT_FIXED_LEVEL_OVERFLOW;
-		}
-		segment->fontFixedLevel++;
-		return LayoutResolverErrorCode_OK;
+	default:
+		return changeSegmentLevel(style, dispatch->style,
+					  dispatch->argument);
 	}
 
 	/* otherSegmentMarkers */
-	length = segment->otherSegmentMarkers->size.length;
-	grownMarkers =
-	    ASTNodePointerVector_bigSlice(segment->otherSegmentMarkers, 0,
-					  length);
-	if (grownMarkers == NULL) {
-		return OOM_FOR_LINE_SEGMENTS;
-	}
-	segment->otherSegmentMarkers = grownMarkers;
 	grownMarkers =
-	    ASTNodePointerVector_append(segment->otherSegmentMarkers,
-					&commandNode);
+	    LayoutSegmentMarkerStack_push(style->otherSegmentMarkers,
+					  commandNode);
 	if (grownMarkers == NULL) {
 		return OOM_FOR_LINE_SEGMENTS;
 	}
-	segment->otherSegmentMarkers = grownMarkers;
+	LayoutSegmentMarkerStack_release(style->otherSegmentMarkers);
+	style->otherSegmentMarkers = grownMarkers;
 
 	return LayoutResolverErrorCode_OK;
 }
@@ -1315,24 +1352,22 @@ static LayoutResolverErrorCode updateSegmentOnCommandEnd(state, commandNode)
 LayoutResolverState *state;
 ASTNode *commandNode;
 {
-	string *command = commandNode->value;
-	bool caseInsensitive = state->caseInsensitiveCommands;
-	ASTNodePointerVector *reducedMarkers = NULL;
-	ASTNode *marker = NULL;
-	unsigned long length;
+	CommandId command = CommandId_resolve(commandNode->commandId,
+					      state->caseInsensitiveCommands);
+	const CommandDispatch *dispatch = getCommandDispatch(command);
+	LayoutContentAlignmentVector *reducedAlignments;
+	LayoutContentAlignment poppedAlignment;
+	LayoutSegmentMarkerStack *markers = state->style->otherSegmentMarkers;
+	ASTNode *marker;
+	LayoutResolverErrorCode ALIGNMENT_STACK_UNDERFLOW_ERROR =
+	    LayoutResolverErrorCode_CONTENT_ALIGNMENT_STACK_UNDERFLOW;
 	LayoutResolverErrorCode SEGMENT_MARKER_STACK_UNDERFLOW_ERROR =
 	    LayoutResolverErrorCode_OTHER_SEGMENT_MARKER_STACK_UNDERFLOW;
 	LayoutResolverErrorCode SEGMENT_MARKER_STACK_INCONSISTENCY_ERROR =
 	    LayoutResolverErrorCode_OTHER_SEGMENT_MARKER_STACK_INCONSISTENCY;
 
-	/* contentAlignment */
-	if (string_equals(command, COMMAND_FlushRight, caseInsensitive)
-	    || string_equals(command, COMMAND_FlushLeft, caseInsensitive)
-	    || string_equals(command, COMMAND_Center, caseInsensitive)) {
-		LayoutContentAlignmentVector *reducedAlignments;
-		LayoutContentAlignment poppedAlignment;
-		LayoutResolverErrorCode ALIGNMENT_STACK_UNDERFLOW_ERROR =
-		    LayoutResolverErrorCode_CONTENT_ALIGNMENT_STACK_UNDERFLOW;
+	switch (dispatch->style) {
+	case SegmentStyle_CONTENT_ALIGNMENT:
 		reducedAlignments =
 		    LayoutContentAlignmentVector_pop
 		    (state->contentAlignmentStack, &poppedAlignment);
@@ -1340,176 +1375,203 @@ ASTNode *commandNode;
 			return ALIGNMENT_STACK_UNDERFLOW_ERROR;
 		}
 		state->contentAlignmentStack = reducedAlignments;
-		state->segment->contentAlignment = poppedAlignment;
+		state->style->contentAlignment = poppedAlignment;
 		return LayoutResolverErrorCode_OK;
+
+	case SegmentStyle_NONE:
+	case SegmentStyle_OTHER_SEGMENT_MARKER:
+		break;
+
+	default:
+		return changeSegmentLevel(state->style, dispatch->style,
+					  -dispatch->argument);
 	}
 
-	/* leftIndentationLevel */
-	if (string_equals(command, COMMAND_Indent, caseInsensitive)) {
-		LayoutResolverErrorCode LEFT_INDENTATION_UNDERFLOW_ERROR =
-		    LayoutResolverErrorCode_LEFT_INDENTATION_LEVEL_UNDERFLOW;
-		if (state->segment->leftIndentationLevel == SHRT_MIN) {
-			return LEFT_INDENTATION_UNDERFLOW_ERROR;
-		}
-		state->segment->leftIndentationLevel--;
-		return LayoutResolverErrorCode_OK;
-	} else if (string_equals(command, COMMAND_Outdent, caseInsensitive)) {
-		LayoutResolverErrorCode LEFT_INDENTATION_OVERFLOW_ERROR =
-		    LayoutResolverErrorCode_LEFT_INDENTATION_LEVEL_OVERFLOW;
-		if (state->segment->leftIndentationLevel == SHRT_MAX) {
-			return LEFT_INDENTATION_OVERFLOW_ERROR;
-		}
-		state->segment->leftIndentationLevel++;
-		return LayoutResolverErrorCode_OK;
+	/* otherSegmentMarkers */
+	if (markers == NULL) {
+		return SEGMENT_MARKER_STACK_UNDERFLOW_ERROR;
+	}
+	marker = markers->marker;
+	state->style->otherSegmentMarkers =
+	    LayoutSegmentMarkerStack_retain(markers->rest);
+	LayoutSegmentMarkerStack_release(markers);
+	if (!string_equals(marker->value, commandNode->value, false)) {
+		return SEGMENT_MARKER_STACK_INCONSISTENCY_ERROR;
 	}
 
-	/* rightIndentationLevel */
-	if (string_equals(command, COMMAND_IndentRight, caseInsensitive)) {
-		LayoutResolverErrorCode RIGHT_INDENTATION_UNDERFLOW_ERROR =
-		    LayoutResolverErrorCode_RIGHT_INDENTATION_LEVEL_UNDERFLOW;
-		if (state->segment->rightIndentationLevel == SHRT_MIN) {
-			return RIGHT_INDENTATION_UNDERFLOW_ERROR;
-		}
-		state->segment->rightIndentationLevel--;
-		return LayoutResolverErrorCode_OK;
-	} else
-	    if (string_equals(command, COMMAND_OutdentRight, caseInsensitive)) {
-		LayoutResolverErrorCode RIGHT_INDENTATION_OVERFLOW =
+	return LayoutResolverErrorCode_OK;
+}
+
+/*
+ * Changes the level of the segment's style by the provided change, which is
+ * either 1 or -1, failing if the level would overflow or underflow.
+ */
+static LayoutResolverErrorCode changeSegmentLevel(segmentStyle, style, change)
+LayoutSegmentStyle *segmentStyle;
+SegmentStyle style;
+int change;
+{
+	signed short *signedLevel = NULL;
+	unsigned short *level = NULL;
+	LayoutResolverErrorCode overflowError;
+	LayoutResolverErrorCode underflowError;
+
+	switch (style) {
+	case SegmentStyle_LEFT_INDENTATION_LEVEL:
+		signedLevel = &segmentStyle->leftIndentationLevel;
+		overflowError =
+		    LayoutResolverErrorCode_LEFT_INDENTATION_LEVEL_OVERFLOW;
+		underflowError =
+		    LayoutResolverErrorCode_LEFT_INDENTATION_LEVEL_UNDERFLOW;
+		break;
+
+	case SegmentStyle_RIGHT_INDENTATION_LEVEL:
+		signedLevel = &segmentStyle->rightIndentationLevel;
+		overflowError =
 		    LayoutResolverErrorCode_RIGHT_INDENTATION_LEVEL_OVERFLOW;
-		if (state->segment->rightIndentationLevel == SHRT_MAX) {
-			return RIGHT_INDENTATION_OVERFLOW;
-		}
-		state->segment->rightIndentationLevel++;
-		return LayoutResolverErrorCode_OK;
-	}
+		underflowError =
+		    LayoutResolverErrorCode_RIGHT_INDENTATION_LEVEL_UNDERFLOW;
+		break;
 
-	/* fontSizeChange */
-	if (string_equals(command, COMMAND_Bigger, caseInsensitive)) {
-		if (state->segment->fontSizeChange == SHRT_MIN) {
-			return
-			    LayoutResolverErrorCode_FONT_SIZE_CHANGE_UNDERFLOW;
-		}
-		state->segment->fontSizeChange--;
-		return LayoutResolverErrorCode_OK;
-	} else if (string_equals(command, COMMAND_Smaller, caseInsensitive)) {
-		if (state->segment->fontSizeChange == SHRT_MAX) {
-			return
-			    LayoutResolverErrorCode_FONT_SIZE_CHANGE_OVERFLOW;
-		}
-		state->segment->fontSizeChange++;
-		return LayoutResolverErrorCode_OK;
-	}
+	case SegmentStyle_FONT_SIZE_CHANGE:
+		signedLevel = &segmentStyle->fontSizeChange;
+		overflowError =
+		    LayoutResolverErrorCode_FONT_SIZE_CHANGE_OVERFLOW;
+		underflowError =
+		    LayoutResolverErrorCode_FONT_SIZE_CHANGE_UNDERFLOW;
+		break;
 
-	/* fontBoldLevel */
-	if (string_equals(command, COMMAND_Bold, caseInsensitive)) {
-		if (state->segment->fontBoldLevel == 0) {
-			return
-			    LayoutResolverErrorCode_FONT_BOLD_LEVEL_UNDERFLOW;
-		}
-		state->segment->fontBoldLevel--;
-		return LayoutResolverErrorCode_OK;
-	}
+	case SegmentStyle_FONT_BOLD_LEVEL:
+		level = &segmentStyle->fontBoldLevel;
+		overflowError = LayoutResolverErrorCode_FONT_BOLD_LEVEL_OVERFLOW;
+		underflowError =
+		    LayoutResolverErrorCode_FONT_BOLD_LEVEL_UNDERFLOW;
+		break;
 
-	/* fontItalicLevel */
-	if (string_equals(command, COMMAND_Italic, caseInsensitive)) {
-		if (state->segment->fontItalicLevel == 0) {
-			return
-			    LayoutResolverErrorCode_FONT_ITALIC_LEVEL_UNDERFLOW;
-		}
-		state->segment->fontItalicLevel--;
-		return LayoutResolverErrorCode_OK;
-	}
+	case SegmentStyle_FONT_ITALIC_LEVEL:
+		level = &segmentStyle->fontItalicLevel;
+		overflowError =
+		    LayoutResolverErrorCode_FONT_ITALIC_LEVEL_OVERFLOW;
+		underflowError =
+		    LayoutResolverErrorCode_FONT_ITALIC_LEVEL_UNDERFLOW;
+		break;
 
-	/* fontUnderlinedLevel */
-	if (string_equals(command, COMMAND_Underline, caseInsensitive)) {
-		LayoutResolverErrorCode FONT_UNDERLINED_LEVEL_UNDERFLOW_ERROR =
+	case SegmentStyle_FONT_UNDERLINED_LEVEL:
+		level = &segmentStyle->fontUnderlinedLevel;
+		overflowError =
+		    LayoutResolverErrorCode_FONT_UNDERLINED_LEVEL_OVERFLOW;
+		underflowError =
 		    LayoutResolverErrorCode_FONT_UNDERLINED_LEVEL_UNDERFLOW;
-		if (state->segment->fontUnderlinedLevel == 0) {
-			return FONT_UNDERLINED_LEVEL_UNDERFLOW_ERROR;
-		}
-		state->segment->fontUnderlinedLevel--;
+		break;
+
+	case SegmentStyle_FONT_FIXED_LEVEL:
+		level = &segmentStyle->fontFixedLevel;
+		overflowError =
+		    LayoutResolverErrorCode_FONT_FIXED_LEVEL_OVERFLOW;
+		underflowError =
+		    LayoutResolverErrorCode_FONT_FIXED_LEVEL_UNDERFLOW;
+		break;
+
+	default:
 		return LayoutResolverErrorCode_OK;
 	}
 
-	/* fontFixedLevel */
-	if (string_equals(command, COMMAND_Fixed, caseInsensitive)) {
-		if (state->segment->fontFixedLevel == 0) {
-			return
-			    LayoutResolverErrorCode_FONT_FIXED_LEVEL_UNDERFLOW;
+	if (signedLevel != NULL) {
+		if (change > 0 && *signedLevel == SHRT_MAX) {
+			return overflowError;
+		}
+		if (change < 0 && *signedLevel == SHRT_MIN) {
+			return underflowError;
 		}
-		state->segment->fontFixedLevel--;
+		*signedLevel += change;
 		return LayoutResolverErrorCode_OK;
 	}
 
-	/* otherSegmentMarkers */
-	length = state->segment->otherSegmentMarkers->size.length;
-	reducedMarkers =
-	    ASTNodePointerVector_bigSlice(state->segment->otherSegmentMarkers,
-					  0, length);
-	if (reducedMarkers == NULL) {
-		return LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_LINE_SEGMENTS;
+	if (change > 0 && *level == USHRT_MAX) {
+		return overflowError;
 	}
-	state->segment->otherSegmentMarkers = reducedMarkers;
-	reducedMarkers =
-	    ASTNodePointerVector_pop(state->segment->otherSegmentMarkers,
-				     &marker);
-	if (reducedMarkers == NULL) {
-		return SEGMENT_MARKER_STACK_UNDERFLOW_ERROR;
-	}
-	state->segment->otherSegmentMarkers = reducedMarkers;
-	if (!string_equals(marker->value, command, false)) {
-		return SEGMENT_MARKER_STACK_INCONSISTENCY_ERROR;
+	if (change < 0 && *level == 0) {
+		return underflowError;
 	}
-
+	*level += change;
 	return LayoutResolverErrorCode_OK;
 }
 
-static bool nodeHasParentOfType(node, type, caseInsensitive)
-ASTNode *node;
-string *type;
-bool caseInsensitive;
+static LayoutResolverErrorCode addWarning(state, cause, code)
+LayoutResolverState *state;
+ASTNode *cause;
+LayoutResolverWarningCode code;
 {
-	if (node == NULL || node->parent == NULL) {
-		return false;
-	}
+	LayoutResolverWarning warning;
+	LayoutResolverWarningVector *grownWarnings;
+
+	warning.cause = cause;
+	warning.code = code;
+	warning.count = 1;
+	warning.lastCause = cause;
+	grownWarnings = (LayoutResolverWarningVector *)
+	    WarningPolicy_record(state->warningPolicy,
+				 (Vector *) state->warnings, &warning,
+				 mergeWarnings);
+	if (grownWarnings == NULL) {
+		return LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_WARNINGS;
+	}
+
+	state->warnings = grownWarnings;
+	return LayoutResolverErrorCode_OK;
+}
 
-	if (node->parent->type != ASTNodeType_COMMAND) {
-		return false;	/* This should not happen, but, just in case */
-	}
+static bool mergeWarnings(recordedWarning, warning)
+void *recordedWarning;
+const void *warning;
+{
+	LayoutResolverWarning *recorded = recordedWarning;
+	const LayoutResolverWarning *merged = warning;
 
-	node = node->parent;
-	while (!string_equals(node->value, type, caseInsensitive)) {
-		node = node->parent;
-		if (node == NULL || node->type != ASTNodeType_COMMAND) {
-			return false;
-		}
+	if (recorded->code != merged->code) {
+		return false;
 	}
 
+	recorded->count += merged->count;
+	recorded->lastCause = merged->lastCause;
 	return true;
 }
 
+/*
+ * Returns true if a command of the provided resolved identifier is an
+ * ancestor of the node being processed.
+ */
+static bool isInsideCommand(state, command)
+LayoutResolverState *state;
+CommandId command;
+{
+	return state->openCommands[command] > 0;
+}
+
 static CommandLayoutInterpretation getLayoutInterpretation(state, commandNode)
 LayoutResolverState *state;
 ASTNode *commandNode;
 {
 	return getCommandLayoutInterpretation(commandNode,
 					      state->customCommandInterpreter,
+					      state->customCommandCache,
 					      state->caseInsensitiveCommands);
 }
 
 static CommandLayoutInterpretation
 getCommandLayoutInterpretation(command, customCommandInterpreter,
-			       caseInsensitive)
+			       customCommandCache, caseInsensitive)
 ASTNode *command;
 CustomCommandLayoutInterpretation customCommandInterpreter(ASTNode *, bool);
+CustomCommandCache *customCommandCache;
 bool caseInsensitive;
 {
 	CommandLayoutInterpretation interpretation;
 	CustomCommandLayoutInterpretation customInterpretation;
 
 	interpretation =
-	    getStandardCommandLayoutInterpretation(command->value,
-						   caseInsensitive);
+	    getCommandDispatch(CommandId_resolve(command->commandId,
+						 caseInsensitive))->layout;
 	if (interpretation != CommandLayoutInterpretation_CUSTOM) {
 		return interpretation;
 	}
@@ -1518,8 +1580,14 @@ bool caseInsensitive;
 		return CommandLayoutInterpretation_NO_OP;
 	}
 
-	customInterpretation =
-	    customCommandInterpreter(command, caseInsensitive);
+	if (!CustomCommandCache_get(customCommandCache, command->value,
+				    caseInsensitive, &customInterpretation)) {
+		customInterpretation =
+		    customCommandInterpreter(command, caseInsensitive);
+		/* An interpretation that failed to be cached is just repeated */
+		CustomCommandCache_put(customCommandCache, command->value,
+				       caseInsensitive, customInterpretation);
+	}
 	switch (customInterpretation) {
 	case CustomCommandLayoutInterpretation_NEW_BLOCK:
 		return CommandLayoutInterpretation_NEW_BLOCK;
@@ -1555,118 +1623,15 @@ bool caseInsensitive;
 	}
 }
 
-static CommandLayoutInterpretation
-getStandardCommandLayoutInterpretation(command, caseInsensitive)
-string *command;
-bool caseInsensitive;
+static const CommandDispatch *getCommandDispatch(command)
+CommandId command;
 {
-	if (COMMAND_lt == NULL) {
-		COMMAND_lt = string_from("lt");
-		COMMAND_Bold = string_from("Bold");
-		COMMAND_Italic = string_from("Italic");
-		COMMAND_Fixed = string_from("Fixed");
-		COMMAND_Smaller = string_from("Smaller");
-		COMMAND_Bigger = string_from("Bigger");
-		COMMAND_Underline = string_from("Underline");
-		COMMAND_Subscript = string_from("Subscript");
-		COMMAND_Superscript = string_from("Superscript");
-		COMMAND_Center = string_from("Center");
-		COMMAND_FlushLeft = string_from("FlushLeft");
-		COMMAND_FlushRight = string_from("FlushRight");
-		COMMAND_Indent = string_from("Indent");
-		COMMAND_IndentRight = string_from("IndentRight");
-		COMMAND_Outdent = string_from("Outdent");
-		COMMAND_OutdentRight = string_from("OutdentRight");
-		COMMAND_Excerpt = string_from("Excerpt");
-		COMMAND_Signature = string_from("Signature");
-		COMMAND_Paragraph = string_from("Paragraph");
-		COMMAND_SamePage = string_from("SamePage");
-		COMMAND_Heading = string_from("Heading");
-		COMMAND_Footing = string_from("Footing");
-		COMMAND_ISO_8859_1 = string_from("ISO-8859-1");
-		COMMAND_ISO_8859_2 = string_from("ISO-8859-2");
-		COMMAND_ISO_8859_3 = string_from("ISO-8859-3");
-		COMMAND_ISO_8859_4 = string_from("ISO-8859-4");
-		COMMAND_ISO_8859_5 = string_from("ISO-8859-5");
-		COMMAND_ISO_8859_6 = string_from("ISO-8859-6");
-		COMMAND_ISO_8859_7 = string_from("ISO-8859-7");
-		COMMAND_ISO_8859_8 = string_from("ISO-8859-8");
-		COMMAND_ISO_8859_9 = string_from("ISO-8859-9");
-		COMMAND_US_ASCII = string_from("US-ASCII");
-		COMMAND_No_op = string_from("No-op");
-		COMMAND_Comment = string_from("Comment");
-		COMMAND_nl = string_from("nl");
-		COMMAND_np = string_from("np");
-	}
-
-	if (string_equals(command, COMMAND_lt, caseInsensitive)) {
-		return CommandLayoutInterpretation_INLINE_CONTENT;
-	}
-
-	if (string_equals(command, COMMAND_Bold, caseInsensitive)
-	    || string_equals(command, COMMAND_Italic, caseInsensitive)
-	    || string_equals(command, COMMAND_Underline, caseInsensitive)
-	    || string_equals(command, COMMAND_Fixed, caseInsensitive)
-	    || string_equals(command, COMMAND_Smaller, caseInsensitive)
-	    || string_equals(command, COMMAND_Bigger, caseInsensitive)
-	    || string_equals(command, COMMAND_Center, caseInsensitive)
-	    || string_equals(command, COMMAND_FlushLeft, caseInsensitive)
-	    || string_equals(command, COMMAND_FlushRight, caseInsensitive)
-	    || string_equals(command, COMMAND_Indent, caseInsensitive)
-	    || string_equals(command, COMMAND_IndentRight, caseInsensitive)
-	    || string_equals(command, COMMAND_Outdent, caseInsensitive)
-	    || string_equals(command, COMMAND_OutdentRight, caseInsensitive)
-	    || string_equals(command, COMMAND_Subscript, caseInsensitive)
-	    || string_equals(command, COMMAND_Superscript, caseInsensitive)
-	    || string_equals(command, COMMAND_Excerpt, caseInsensitive)
-	    || string_equals(command, COMMAND_Signature, caseInsensitive)) {
-		return CommandLayoutInterpretation_NEW_LINE_SEGMENT;
-	}
-
-	if (string_equals(command, COMMAND_Paragraph, caseInsensitive)) {
-		return CommandLayoutInterpretation_NEW_ISOLATED_PARAGRAPH;
+	if ((unsigned long)command >=
+	    sizeof(COMMAND_DISPATCH) / sizeof(CommandDispatch)) {
+		return COMMAND_DISPATCH + CommandId_CUSTOM;
 	}
 
-	if (string_equals(command, COMMAND_SamePage, caseInsensitive)) {
-		return CommandLayoutInterpretation_SAME_PAGE;
-	}
-
-	if (string_equals(command, COMMAND_Heading, caseInsensitive)) {
-		return CommandLayoutInterpretation_HEADING_BLOCK;
-	}
-
-	if (string_equals(command, COMMAND_Footing, caseInsensitive)) {
-		return CommandLayoutInterpretation_FOOTING_BLOCK;
-	}
-
-	if (string_equals(command, COMMAND_ISO_8859_1, caseInsensitive)
-	    || string_equals(command, COMMAND_ISO_8859_2, caseInsensitive)
-	    || string_equals(command, COMMAND_ISO_8859_3, caseInsensitive)
-	    || string_equals(command, COMMAND_ISO_8859_4, caseInsensitive)
-	    || string_equals(command, COMMAND_ISO_8859_5, caseInsensitive)
-	    || string_equals(command, COMMAND_ISO_8859_6, caseInsensitive)
-	    || string_equals(command, COMMAND_ISO_8859_7, caseInsensitive)
-	    || string_equals(command, COMMAND_ISO_8859_8, caseInsensitive)
-	    || string_equals(command, COMMAND_ISO_8859_9, caseInsensitive)
-	    || string_equals(command, COMMAND_US_ASCII, caseInsensitive)
-	    || string_equals(command, COMMAND_No_op, caseInsensitive)
-	    ) {
-		return CommandLayoutInterpretation_NO_OP;
-	}
-
-	if (string_equals(command, COMMAND_Comment, caseInsensitive)) {
-		return CommandLayoutInterpretation_COMMENT;
-	}
-
-	if (string_equals(command, COMMAND_nl, caseInsensitive)) {
-		return CommandLayoutInterpretation_NEW_LINE;
-	}
-
-	if (string_equals(command, COMMAND_np, caseInsensitive)) {
-		return CommandLayoutInterpretation_NEW_PAGE;
-	}
-
-	return CommandLayoutInterpretation_CUSTOM;
+	return COMMAND_DISPATCH + command;
 }
 
 static ASTNode *nextDFSNode(rootNodes, node, leaveCurrentNode)
@@ -1685,12 +1650,14 @@ bool leaveCurrentNode;
 		return *node->children->items;
 	}
 
-	sibling = nextSibling(rootNodes, node);
-	if (sibling != NULL) {
-		return sibling;
+	for (; node != NULL; node = node->parent) {
+		sibling = nextSibling(rootNodes, node);
+		if (sibling != NULL) {
+			return sibling;
+		}
 	}
 
-	return nextDFSNode(rootNodes, node->parent, true);
+	return NULL;
 }
 
 static ASTNode *nextSibling(rootNodes, node)
@@ -1698,7 +1665,6 @@ ASTNodePointerVector *rootNodes;
 ASTNode *node;
 {
 	ASTNodePointerVector *siblings;
-	ASTNode **sibling;
 	unsigned long i;
 
 	if (node == NULL) {
@@ -1710,15 +1676,20 @@ ASTNode *node;
 		return NULL;
 	}
 
-	for (i = 0, sibling = siblings->items; i < siblings->size.length;
-	     i++, sibling++) {
-		if (*sibling == node) {
-			return i <
-			    siblings->size.length - 1 ? *(sibling + 1) : NULL;
+	i = node->siblingIndex;
+	if (i >= siblings->size.length || siblings->items[i] != node) {
+		/* The node was not created by the parser, look it up */
+		for (i = 0; i < siblings->size.length; i++) {
+			if (siblings->items[i] == node) {
+				break;
+			}
+		}
+		if (i == siblings->size.length) {
+			return NULL;
 		}
 	}
 
-	return NULL;
+	return i < siblings->size.length - 1 ? siblings->items[i + 1] : NULL;
 }
 
 static bool string_equals(string1, string2, caseInsensitive)
@@ -1736,3 +1707,4 @@ bool caseInsensitive;
 Vector_ofTypeImplementation(LayoutResolverWarning)
     Vector_ofTypeImplementation(LayoutContentAlignment)
     Vector_ofTypeImplementation(LayoutBlockType)
+    Vector_ofTypeImplementation(CommandLayoutInterpretation)
@@ -4,10 +4,13 @@
 #include "ast_node.h"
 #include "ast_node_pointer_vector.h"
 #include "bool.h"
+#include "custom_command_cache.h"
 #include "custom_command_layout_interpretation.h"
 #include "layout_block_vector.h"
+#include "layout_segment_style_table.h"
 #include "typed_vector.h"
 #include "vector.h"
+#include "warning_policy.h"
 
 typedef enum LayoutResolverErrorCode {
 	LayoutResolverErrorCode_OK,
@@ -40,7 +43,9 @@ typedef enum LayoutResolverErrorCode {
 	LayoutResolverErrorCode_FONT_UNDERLINED_LEVEL_UNDERFLOW,
 	LayoutResolverErrorCode_FONT_UNDERLINED_LEVEL_OVERFLOW,
 	LayoutResolverErrorCode_FONT_FIXED_LEVEL_UNDERFLOW,
-	LayoutResolverErrorCode_FONT_FIXED_LEVEL_OVERFLOW
+	LayoutResolverErrorCode_FONT_FIXED_LEVEL_OVERFLOW,
+	LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_TRAVERSAL,
+	LayoutResolverErrorCode_BLOCK_SINK_FAILURE
 } LayoutResolverErrorCode;
 
 typedef struct LayoutResolverError {
@@ -56,6 +61,12 @@ typedef enum LayoutResolverWarningCode {
 typedef struct LayoutResolverWarning {
 	ASTNode *cause;
 	LayoutResolverWarningCode code;
+	/*
+	 * The number of warnings represented by this one and the cause of the
+	 * last of them, see LayoutResolverOptions.warningPolicy.
+	 */
+	unsigned long count;
+	ASTNode *lastCause;
 } LayoutResolverWarning;
 
 Vector_ofType(LayoutResolverWarning)
@@ -70,14 +81,79 @@ typedef struct LayoutResolverResult {
 		LayoutBlockVector *blocks;
 		LayoutResolverError error;
 	} result;
+	/*
+	 * The distinct styles of the resolved segments, which the segments
+	 * refer to. NULL for the ERROR result, unless the layout was resolved
+	 * by resolveLayoutStreaming and the blocks already passed to the block
+	 * sink refer to the styles.
+	 */
+	LayoutSegmentStyleTable *styles;
 	LayoutResolverWarningVector *warnings;
 } LayoutResolverResult;
 
+typedef struct LayoutResolverOptions {
+	WarningPolicy warningPolicy;
+
+	/*
+	 * Declares that the custom command interpreter's interpretation of a
+	 * command depends only on the command's name (and the case sensitivity
+	 * of the commands), not on the command's parent or children, so the
+	 * interpreter is called only once for each distinct command name.
+	 */
+	bool interpretsCustomCommandsByName;
+
+	/*
+	 * The cache of the custom command interpretations used if the commands
+	 * are interpreted by their names, which may be reused by the following
+	 * calls with the same interpreter, or NULL to cache the interpretations
+	 * for a single call only. The cache is owned by the caller.
+	 */
+	CustomCommandCache *customCommandCache;
+} LayoutResolverOptions;
+
 LayoutResolverResult *resolveLayout(ASTNodePointerVector *nodes,
 				    CustomCommandLayoutInterpretation
 				    customCommandInterpreter(ASTNode *, bool),
 				    bool caseInsensitiveCommands);
 
+/*
+ * Resolves the layout like resolveLayout, the options may be NULL to use the
+ * defaults.
+ */
+LayoutResolverResult *resolveLayoutWithOptions(ASTNodePointerVector *nodes,
+					       CustomCommandLayoutInterpretation
+					       customCommandInterpreter(ASTNode
+									*,
+									bool),
+					       bool caseInsensitiveCommands,
+					       LayoutResolverOptions *options);
+
+/*
+ * Resolves the layout like resolveLayoutWithOptions, but passes every block
+ * to the block sink as soon as the block is completed instead of collecting
+ * the blocks, so that the caller may render and free each block right away.
+ * The sink takes over the block's content (see LayoutBlock_freeContent), and
+ * returns false to abort the resolving with the BLOCK_SINK_FAILURE error.
+ * The blocks of the SUCCESS result are always empty, and the segments of the
+ * sunk blocks refer to the styles of the result (of the ERROR result too), so
+ * the result must outlive their use. Returns NULL if no block sink is provided.
+ */
+LayoutResolverResult *resolveLayoutStreaming(ASTNodePointerVector *nodes,
+					     CustomCommandLayoutInterpretation
+					     customCommandInterpreter(ASTNode *,
+								      bool),
+					     bool caseInsensitiveCommands,
+					     LayoutResolverOptions *options,
+					     bool blockSink(LayoutBlock *block,
+							    void *context),
+					     void *blockSinkContext);
+
+/*
+ * Frees the paragraphs, lines and segments of a resolved block, but not the
+ * block itself nor the AST nodes the segments refer to.
+ */
+void LayoutBlock_freeContent(LayoutBlock *block);
+
 void LayoutResolverResult_free(LayoutResolverResult *result);
 
 #endif
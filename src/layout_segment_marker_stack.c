@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include "ast_node.h"
+#include "ast_node_pointer_vector.h"
+#include "layout_segment_marker_stack.h"
+
+LayoutSegmentMarkerStack *LayoutSegmentMarkerStack_push(stack, marker)
+LayoutSegmentMarkerStack *stack;
+ASTNode *marker;
+{
+	LayoutSegmentMarkerStack *top;
+
+	top = malloc(sizeof(LayoutSegmentMarkerStack));
+	if (top == NULL) {
+		return NULL;
+	}
+
+	top->marker = marker;
+	top->rest = LayoutSegmentMarkerStack_retain(stack);
+	top->length = stack != NULL ? stack->length + 1 : 1;
+	top->references = 1;
+	return top;
+}
+
+LayoutSegmentMarkerStack *LayoutSegmentMarkerStack_retain(stack)
+LayoutSegmentMarkerStack *stack;
+{
+	if (stack != NULL) {
+		stack->references++;
+	}
+	return stack;
+}
+
+void LayoutSegmentMarkerStack_release(stack)
+LayoutSegmentMarkerStack *stack;
+{
+	LayoutSegmentMarkerStack *rest;
+
+	/* Iterative, as deeply nested markers make long stacks */
+	while (stack != NULL) {
+		stack->references--;
+		if (stack->references > 0) {
+			return;
+		}
+		rest = stack->rest;
+		free(stack);
+		stack = rest;
+	}
+}
+
+unsigned long LayoutSegmentMarkerStack_getLength(stack)
+LayoutSegmentMarkerStack *stack;
+{
+	return stack != NULL ? stack->length : 0;
+}
+
+ASTNodePointerVector *LayoutSegmentMarkerStack_toVector(stack)
+LayoutSegmentMarkerStack *stack;
+{
+	unsigned long length = LayoutSegmentMarkerStack_getLength(stack);
+	ASTNodePointerVector *markers;
+
+	markers = ASTNodePointerVector_new(length, length);
+	if (markers == NULL) {
+		return NULL;
+	}
+
+	for (; stack != NULL; stack = stack->rest) {
+		markers->items[stack->length - 1] = stack->marker;
+	}
+	return markers;
+}
@@ -0,0 +1,58 @@
+#ifndef LAYOUT_SEGMENT_MARKER_STACK_HEADER_FILE
+#define LAYOUT_SEGMENT_MARKER_STACK_HEADER_FILE 1
+
+#include "ast_node.h"
+#include "ast_node_pointer_vector.h"
+
+/*
+ * An immutable stack of the other segment markers of line segments (see
+ * LayoutLineSegment.otherSegmentMarkers), represented by its top item. The
+ * items are linked to the items below them, so stacks sharing their bottom
+ * items share their memory, and a segment takes the markers of the previous
+ * segment without copying them. The NULL pointer is the empty stack.
+ *
+ * The items are reference-counted, every owner of a stack (a segment, or an
+ * item pushed on top of it) holds a reference to its top item.
+ */
+typedef struct LayoutSegmentMarkerStack {
+	ASTNode *marker;
+	/* The items below the marker, NULL for the bottom item */
+	struct LayoutSegmentMarkerStack *rest;
+	/* The number of items, including this one */
+	unsigned long length;
+	unsigned long references;
+} LayoutSegmentMarkerStack;
+
+/*
+ * Returns a new stack of the marker on top of the provided stack, holding a
+ * single reference owned by the caller, or NULL if the memory could not be
+ * allocated. The provided stack is referenced by the new one, the caller's
+ * reference to it is left as it is.
+ */
+LayoutSegmentMarkerStack *LayoutSegmentMarkerStack_push(LayoutSegmentMarkerStack
+							*stack,
+							ASTNode *marker);
+
+/*
+ * Adds a reference to the stack and returns the stack.
+ */
+LayoutSegmentMarkerStack
+    *LayoutSegmentMarkerStack_retain(LayoutSegmentMarkerStack *stack);
+
+/*
+ * Drops a reference to the stack, freeing the items no longer referenced.
+ */
+void LayoutSegmentMarkerStack_release(LayoutSegmentMarkerStack *stack);
+
+unsigned long LayoutSegmentMarkerStack_getLength(LayoutSegmentMarkerStack
+						 *stack);
+
+/*
+ * Returns a new vector of the markers from the bottom of the stack to its
+ * top, which must be freed by the caller, or NULL if the memory could not be
+ * allocated.
+ */
+ASTNodePointerVector *LayoutSegmentMarkerStack_toVector(LayoutSegmentMarkerStack
+							*stack);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef LAYOUT_SEGMENT_STYLE_HEADER_FILE
+#define LAYOUT_SEGMENT_STYLE_HEADER_FILE 1
+
+#include "layout_content_alignment.h"
+#include "layout_segment_marker_stack.h"
+
+/*
+ * The formatting of a line segment. The segments of a document share the
+ * styles interned in the document's LayoutSegmentStyleTable, so the segments
+ * of the same style refer to the same LayoutSegmentStyle.
+ */
+typedef struct LayoutSegmentStyle {
+	/* The index of the style in its style table */
+	unsigned long id;
+	LayoutContentAlignment contentAlignment;
+	signed short leftIndentationLevel;
+	signed short rightIndentationLevel;
+	signed short fontSizeChange;
+	unsigned short fontBoldLevel;
+	unsigned short fontItalicLevel;
+	unsigned short fontUnderlinedLevel;
+	unsigned short fontFixedLevel;
+	/*
+	 * Used for the <Subscript>, <Superscript>, <Excerpt>, <Signature> and
+	 * new line segment-causing custom commands. The stack is shared with
+	 * the styles of the neighbouring segments, see
+	 * LayoutLineSegment_getOtherSegmentMarkers for the markers as a vector.
+	 */
+	LayoutSegmentMarkerStack *otherSegmentMarkers;
+} LayoutSegmentStyle;
+
+#endif
@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include "arena.h"
+#include "bool.h"
+#include "layout_segment_marker_stack.h"
+#include "layout_segment_style.h"
+#include "layout_segment_style_table.h"
+
+#define STYLE_TABLE_INITIAL_CAPACITY 8
+
+struct LayoutSegmentStyleTable {
+	/* Holds the styles, so that they are never moved */
+	Arena *arena;
+	/* The styles by their ids */
+	LayoutSegmentStyle **styles;
+	unsigned long length;
+	unsigned long capacity;
+	/*
+	 * The styles by their hashes, using linear probing. There are twice as
+	 * many slots as the capacity for the styles, which is a power of two,
+	 * so at least half of the slots are empty (NULL).
+	 */
+	LayoutSegmentStyle **slots;
+};
+
+static unsigned long getStyleHash(const LayoutSegmentStyle * style);
+
+static bool stylesEqual(const LayoutSegmentStyle * style1,
+			const LayoutSegmentStyle * style2);
+
+static LayoutSegmentStyle **findSlot(LayoutSegmentStyle ** slots,
+				     unsigned long slotCount,
+				     const LayoutSegmentStyle * style);
+
+static bool grow(LayoutSegmentStyleTable * table);
+
+LayoutSegmentStyleTable *LayoutSegmentStyleTable_new()
+{
+	LayoutSegmentStyleTable *table;
+
+	table = malloc(sizeof(LayoutSegmentStyleTable));
+	if (table == NULL) {
+		return NULL;
+	}
+
+	table->arena = Arena_new(STYLE_TABLE_INITIAL_CAPACITY *
+				 sizeof(LayoutSegmentStyle) * 8);
+	table->styles = NULL;
+	table->length = 0;
+	table->capacity = 0;
+	table->slots = NULL;
+	if (table->arena == NULL || !grow(table)) {
+		LayoutSegmentStyleTable_free(table);
+		return NULL;
+	}
+
+	return table;
+}
+
+const LayoutSegmentStyle *LayoutSegmentStyleTable_intern(table, style)
+LayoutSegmentStyleTable *table;
+const LayoutSegmentStyle *style;
+{
+	LayoutSegmentStyle **slot;
+	LayoutSegmentStyle *internedStyle;
+
+	slot = findSlot(table->slots, table->capacity * 2, style);
+	if (*slot != NULL) {
+		return *slot;
+	}
+
+	if (table->length == table->capacity) {
+		if (!grow(table)) {
+			return NULL;
+		}
+		slot = findSlot(table->slots, table->capacity * 2, style);
+	}
+
+	internedStyle = Arena_allocate(table->arena,
+				       sizeof(LayoutSegmentStyle));
+	if (internedStyle == NULL) {
+		return NULL;
+	}
+
+	*internedStyle = *style;
+	internedStyle->id = table->length;
+	LayoutSegmentMarkerStack_retain(internedStyle->otherSegmentMarkers);
+	table->styles[table->length] = internedStyle;
+	table->length++;
+	*slot = internedStyle;
+	return internedStyle;
+}
+
+unsigned long LayoutSegmentStyleTable_getLength(table)
+LayoutSegmentStyleTable *table;
+{
+	return table != NULL ? table->length : 0;
+}
+
+const LayoutSegmentStyle *LayoutSegmentStyleTable_get(table, id)
+LayoutSegmentStyleTable *table;
+unsigned long id;
+{
+	if (table == NULL || id >= table->length) {
+		return NULL;
+	}
+
+	return table->styles[id];
+}
+
+void LayoutSegmentStyleTable_free(table)
+LayoutSegmentStyleTable *table;
+{
+	unsigned long i;
+
+	if (table == NULL) {
+		return;
+	}
+
+	for (i = 0; i < table->length; i++) {
+		LayoutSegmentMarkerStack_release(table->styles[i]->
+						 otherSegmentMarkers);
+	}
+	if (table->styles != NULL) {
+		free(table->styles);
+	}
+	if (table->slots != NULL) {
+		free(table->slots);
+	}
+	Arena_free(table->arena);
+	free(table);
+}
+
+static unsigned long getStyleHash(style)
+const LayoutSegmentStyle *style;
+{
+	unsigned long hash = (unsigned long)style->contentAlignment;
+
+	hash = hash * 31 + (unsigned short)style->leftIndentationLevel;
+	hash = hash * 31 + (unsigned short)style->rightIndentationLevel;
+	hash = hash * 31 + (unsigned short)style->fontSizeChange;
+	hash = hash * 31 + style->fontBoldLevel;
+	hash = hash * 31 + style->fontItalicLevel;
+	hash = hash * 31 + style->fontUnderlinedLevel;
+	hash = hash * 31 + style->fontFixedLevel;
+	/* The stack items are allocated, so the lowest bits are all zero */
+	hash = hash * 31 + ((unsigned long)style->otherSegmentMarkers >> 4);
+	return hash ^ (hash >> 16);
+}
+
+static bool stylesEqual(style1, style2)
+const LayoutSegmentStyle *style1;
+const LayoutSegmentStyle *style2;
+{
+	return style1->contentAlignment == style2->contentAlignment
+	    && style1->leftIndentationLevel == style2->leftIndentationLevel
+	    && style1->rightIndentationLevel == style2->rightIndentationLevel
+	    && style1->fontSizeChange == style2->fontSizeChange
+	    && style1->fontBoldLevel == style2->fontBoldLevel
+	    && style1->fontItalicLevel == style2->fontItalicLevel
+	    && style1->fontUnderlinedLevel == style2->fontUnderlinedLevel
+	    && style1->fontFixedLevel == style2->fontFixedLevel
+	    && style1->otherSegmentMarkers == style2->otherSegmentMarkers;
+}
+
+/*
+ * Returns the slot of the style equal to the provided one, or the empty slot
+ * the style would be stored in.
+ */
+static LayoutSegmentStyle **findSlot(slots, slotCount, style)
+LayoutSegmentStyle **slots;
+unsigned long slotCount;
+const LayoutSegmentStyle *style;
+{
+	unsigned long index = getStyleHash(style) & (slotCount - 1);
+
+	while (slots[index] != NULL && !stylesEqual(slots[index], style)) {
+		index = (index + 1) & (slotCount - 1);
+	}
+	return slots + index;
+}
+
+/*
+ * Doubles the capacity of the table (or sets the initial one), rehashing the
+ * styles into new slots.
+ */
+static bool grow(table)
+LayoutSegmentStyleTable *table;
+{
+	unsigned long capacity = table->capacity > 0 ? table->capacity * 2 :
+	    STYLE_TABLE_INITIAL_CAPACITY;
+	LayoutSegmentStyle **styles;
+	LayoutSegmentStyle **slots;
+	unsigned long i;
+
+	slots = malloc(capacity * 2 * sizeof(LayoutSegmentStyle *));
+	if (slots == NULL) {
+		return false;
+	}
+	styles = realloc(table->styles,
+			 capacity * sizeof(LayoutSegmentStyle *));
+	if (styles == NULL) {
+		free(slots);
+		return false;
+	}
+	table->styles = styles;
+
+	for (i = 0; i < capacity * 2; i++) {
+		slots[i] = NULL;
+	}
+	for (i = 0; i < table->length; i++) {
+		*findSlot(slots, capacity * 2, styles[i]) = styles[i];
+	}
+	if (table->slots != NULL) {
+		free(table->slots);
+	}
+	table->slots = slots;
+	table->capacity = capacity;
+	return true;
+}
@@ -0,0 +1,47 @@
+#ifndef LAYOUT_SEGMENT_STYLE_TABLE_HEADER_FILE
+#define LAYOUT_SEGMENT_STYLE_TABLE_HEADER_FILE 1
+
+#include "layout_segment_style.h"
+
+/*
+ * A set of the distinct segment styles of a document. Every style is stored
+ * once, under an id assigned in the order of the styles' first use, and is
+ * never moved, so the segments may refer to their styles by pointers, and two
+ * segments have the same style if and only if they refer to the same one.
+ */
+typedef struct LayoutSegmentStyleTable LayoutSegmentStyleTable;
+
+/*
+ * Returns NULL if the memory for the table could not be allocated.
+ */
+LayoutSegmentStyleTable *LayoutSegmentStyleTable_new(void);
+
+/*
+ * Returns the style of the table equal to the provided one (ignoring the id),
+ * adding a copy of the provided style to the table if there is none yet. The
+ * table keeps a reference to the style's other segment markers. Returns NULL
+ * if the memory for the added style could not be allocated.
+ */
+const LayoutSegmentStyle *LayoutSegmentStyleTable_intern(LayoutSegmentStyleTable
+							 *table,
+							 const
+							 LayoutSegmentStyle
+							 *style);
+
+/*
+ * Returns the number of the styles, which are identified by the ids lower
+ * than the number.
+ */
+unsigned long LayoutSegmentStyleTable_getLength(LayoutSegmentStyleTable
+						*table);
+
+/*
+ * Returns the style of the provided id, or NULL if there is no such style.
+ * Iterating the ids from 0 visits every distinct style of the document once.
+ */
+const LayoutSegmentStyle *LayoutSegmentStyleTable_get(LayoutSegmentStyleTable
+						      *table, unsigned long id);
+
+void LayoutSegmentStyleTable_free(LayoutSegmentStyleTable *table);
+
+#endif
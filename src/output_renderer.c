@@ -1,7 +1,10 @@
 #include <stdlib.h>
+#include "bool.h"
 #include "output_renderer.h"
 #include "string.h"
 
+static bool mergeWarnings(void *recordedWarning, const void *warning);
+
 void OutputRendererResult_free(result)
 OutputRendererResult *result;
 {
@@ -15,3 +18,34 @@ OutputRendererResult *result;
 	OutputRendererWarningVector_free(result->warnings);
 	free(result);
 }
+
+OutputRendererWarningVector *
+OutputRendererWarningVector_record(warnings, warning, policy)
+OutputRendererWarningVector *warnings;
+OutputRendererWarning *warning;
+const WarningPolicy *policy;
+{
+	warning->count = 1;
+	warning->lastNode = warning->node;
+	return (OutputRendererWarningVector *)
+	    WarningPolicy_record(policy, (Vector *) warnings, warning,
+				 mergeWarnings);
+}
+
+static bool mergeWarnings(recordedWarning, warning)
+void *recordedWarning;
+const void *warning;
+{
+	OutputRendererWarning *recorded = recordedWarning;
+	const OutputRendererWarning *merged = warning;
+
+	if (recorded->code != merged->code) {
+		return false;
+	}
+
+	recorded->count += merged->count;
+	recorded->lastNode = merged->lastNode;
+	return true;
+}
+
+Vector_ofTypeImplementation(OutputRendererWarning)
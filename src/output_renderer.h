@@ -9,6 +9,7 @@
 #include "layout_paragraph.h"
 #include "string.h"
 #include "typed_vector.h"
+#include "warning_policy.h"
 
 typedef unsigned int OutputRendererWarningCode;
 
@@ -19,10 +20,25 @@ typedef struct OutputRendererWarning {
 	LayoutLineSegment *segment;
 	ASTNode *node;
 	OutputRendererWarningCode code;
+	/*
+	 * The number of warnings represented by this one and the node of the
+	 * last of them, see OutputRendererWarningVector_record.
+	 */
+	unsigned long count;
+	ASTNode *lastNode;
 } OutputRendererWarning;
 
 Vector_ofType(OutputRendererWarning);
 
+/*
+ * Records the warning, setting its count and lastNode, according to the
+ * warning policy (see WarningPolicy_record). Returns the possibly reallocated
+ * vector, or NULL if the memory for the warning could not be allocated.
+ */
+OutputRendererWarningVector *OutputRendererWarningVector_record
+    (OutputRendererWarningVector * warnings, OutputRendererWarning * warning,
+     const WarningPolicy * policy);
+
 typedef unsigned int OutputRendererErrorCode;
 
 typedef struct OutputRendererError {
@@ -1,253 +1,450 @@
 #include <stdlib.h>
+#include <string.h>
+#include "arena.h"
 #include "ast_node.h"
 #include "ast_node_pointer_vector.h"
 #include "ast_node_type.h"
 #include "bool.h"
+#include "command_id.h"
 #include "parser.h"
 #include "string.h"
 #include "token.h"
 #include "token_type.h"
 #include "token_vector.h"
 
+/*
+ * The bounds of the size of the arena blocks, which is otherwise estimated
+ * from the number of tokens, so that small inputs do not waste memory and
+ * large inputs are not parsed into a single huge block.
+ */
+#define PARSER_ARENA_MIN_BLOCK_SIZE 4096
+#define PARSER_ARENA_MAX_BLOCK_SIZE 1048576
+
+/*
+ * The input bytes per token assumed when estimating the size of the arena
+ * blocks before the input is tokenized (see tokenizeAndParse).
+ */
+#define PARSER_BYTES_PER_TOKEN_ESTIMATE 8
+
+/* The state of a parser consuming the tokens one at a time */
+typedef struct ParserState {
+	bool caseInsensitiveCommands;
+	bool takeValues;
+	unsigned long maxNestingDepth;
+	Arena *arena;
+	/*
+	 * The root nodes, or, with an arena, all nodes whose parent command
+	 * has not been closed yet (see parseToken).
+	 */
+	ASTNodePointerVector *nodes;
+	/* The innermost command that has not been closed yet, or NULL */
+	ASTNode *parent;
+	/* The number of commands that have not been closed yet */
+	unsigned long depth;
+	/* The index of the next token */
+	unsigned long tokenIndex;
+	/* The first error encountered, its code is OK until then */
+	ParserError error;
+} ParserState;
+
+static ParserResult *parseTokens(TokenVector * tokens,
+				 bool caseInsensitiveCommands, bool takeValues,
+				 ParserOptions * options);
+
+static void initParser(ParserState * state, bool caseInsensitiveCommands,
+		       bool takeValues, ParserOptions * options,
+		       unsigned long tokenCountEstimate);
+
+static void parseToken(Token * token, void *parserState);
+
+static ParserResult *finishParsing(ParserState * state);
+
+static ASTNode *newNode(Token * token, unsigned long tokenIndex,
+			ASTNode * parent, bool takeValue, Arena * arena,
+			ParserErrorCode * errorCode);
+
+static bool appendNode(ASTNodePointerVector ** nodes, ASTNode * parent,
+		       ASTNode * node);
+
+static ASTNodePointerVector *moveNodesToArena(Arena * arena,
+					      ASTNodePointerVector * nodes,
+					      unsigned long from);
+
+static unsigned long estimateArenaBlockSize(unsigned long tokenCount);
+
+static void discardNodes(ASTNodePointerVector * nodes, Arena * arena);
+
 static void freeNodes(ASTNodePointerVector * nodes);
 
+static void freeNode(ASTNode * node);
+
 static ParserError createError(unsigned long byteIndex,
 			       unsigned long codepointIndex,
 			       unsigned long tokenIndex,
 			       ParserErrorCode errorCode);
 
+static bool isEmptyCommand(CommandId command);
+
 static bool string_equals(string * string1, string * string2,
 			  bool caseInsensitive);
 
 ParserResult *parse(tokens, caseInsensitiveCommands)
 TokenVector *tokens;
 bool caseInsensitiveCommands;
+{
+	return parseTokens(tokens, caseInsensitiveCommands, false, NULL);
+}
+
+ParserResult *parseWithOptions(tokens, caseInsensitiveCommands, options)
+TokenVector *tokens;
+bool caseInsensitiveCommands;
+ParserOptions *options;
+{
+	return parseTokens(tokens, caseInsensitiveCommands, false, options);
+}
+
+ParserResult *parseAndConsumeTokens(tokenizerResult, caseInsensitiveCommands,
+				    options)
+TokenizerResult *tokenizerResult;
+bool caseInsensitiveCommands;
+ParserOptions *options;
 {
 	ParserResult *result;
-	Token *token;
-	unsigned long tokenIndex = 0;
-	ASTNodePointerVector *nodes;
-	ASTNodePointerVector *grownNodes;
-	ASTNode *parent = NULL;
-	ASTNode *node = NULL;
-	string *value;
-	ASTNodePointerVector *siblings;
-	ParserErrorCode errorCode = ParserErrorCode_OK;
-	string *command_lt, *command_nl, *command_np;
 
-	result = malloc(sizeof(ParserResult));
+	if (tokenizerResult == NULL
+	    || tokenizerResult->type != TokenizerResultType_SUCCESS) {
+		return parseTokens(NULL, caseInsensitiveCommands, true,
+				   options);
+	}
+
+	result = parseTokens(tokenizerResult->result.tokens,
+			     caseInsensitiveCommands, true, options);
 	if (result == NULL) {
 		return NULL;
 	}
 
+	/*
+	 * The values left in the tokens (those of the command end tokens, the
+	 * values copied to the arena, and the values of the tokens following
+	 * an error) are freed along with the tokens.
+	 */
+	TokenVector_free(TokenizerResult_recycleTokens(tokenizerResult));
+	result->valueViews = tokenizerResult->valueViews;
+	tokenizerResult->valueViews = NULL;
+
+	return result;
+}
+
+ParserResult *tokenizeAndParse(richtext, caseInsensitiveCommands, isUtf8,
+				tokenizerOptions, parserOptions,
+				tokenizerResult)
+string *richtext;
+bool caseInsensitiveCommands;
+bool isUtf8;
+TokenizerOptions *tokenizerOptions;
+ParserOptions *parserOptions;
+TokenizerResult **tokenizerResult;
+{
+	ParserState state;
+	ParserResult *result;
+
+	if (tokenizerResult == NULL) {
+		return NULL;
+	}
+	*tokenizerResult = NULL;
+	if (richtext == NULL) {
+		return NULL;
+	}
+
+	initParser(&state, caseInsensitiveCommands, true, parserOptions,
+		   richtext->length / PARSER_BYTES_PER_TOKEN_ESTIMATE);
+	*tokenizerResult =
+	    tokenizeToSink(richtext, caseInsensitiveCommands, isUtf8,
+			   tokenizerOptions, parseToken, &state);
+
+	/*
+	 * The tokenizer error takes precedence over the parser error, as if
+	 * the whole input was tokenized before parsing it.
+	 */
+	if (*tokenizerResult == NULL
+	    || (*tokenizerResult)->type != TokenizerResultType_SUCCESS) {
+		discardNodes(state.nodes, state.arena);
+		return NULL;
+	}
+
+	result = finishParsing(&state);
+	if (result != NULL) {
+		result->valueViews = (*tokenizerResult)->valueViews;
+		(*tokenizerResult)->valueViews = NULL;
+	}
+	return result;
+}
+
+static ParserResult *parseTokens(tokens, caseInsensitiveCommands, takeValues,
+				 options)
+TokenVector *tokens;
+bool caseInsensitiveCommands;
+bool takeValues;
+ParserOptions *options;
+{
+	ParserState state;
+	ParserResult *result;
+	Token *token;
+	unsigned long tokenIndex;
+
 	if (tokens == NULL) {
+		result = malloc(sizeof(ParserResult));
+		if (result == NULL) {
+			return NULL;
+		}
 		result->type = ParserResultType_ERROR;
 		result->result.error =
 		    createError(0, 0, 0, ParserErrorCode_NULL_TOKENS);
+		result->valueViews = NULL;
+		result->arena = NULL;
 		return result;
 	}
 
-	result->type = ParserResultType_SUCCESS;
+	initParser(&state, caseInsensitiveCommands, takeValues, options,
+		   tokens->size.length);
+	for (token = tokens->items, tokenIndex = 0;
+	     tokenIndex < tokens->size.length
+	     && state.error.code == ParserErrorCode_OK; tokenIndex++, token++) {
+		parseToken(token, &state);
+	}
 
-	nodes = ASTNodePointerVector_new(0, 0);
-	if (nodes == NULL) {
-		result->type = ParserResultType_ERROR;
-		result->result.error =
-		    createError(0, 0, 0,
-				ParserErrorCode_OUT_OF_MEMORY_FOR_NODES);
-		return result;
+	return finishParsing(&state);
+}
+
+static void initParser(state, caseInsensitiveCommands, takeValues, options,
+		       tokenCountEstimate)
+ParserState *state;
+bool caseInsensitiveCommands;
+bool takeValues;
+ParserOptions *options;
+unsigned long tokenCountEstimate;
+{
+	state->caseInsensitiveCommands = caseInsensitiveCommands;
+	state->takeValues = takeValues;
+	state->maxNestingDepth = options != NULL ? options->maxNestingDepth : 0;
+	state->arena = NULL;
+	state->parent = NULL;
+	state->depth = 0;
+	state->tokenIndex = 0;
+	state->error = createError(0, 0, 0, ParserErrorCode_OK);
+
+	state->nodes = ASTNodePointerVector_new(0, 0);
+	if (state->nodes != NULL && options != NULL && options->useArena) {
+		state->arena =
+		    Arena_new(estimateArenaBlockSize(tokenCountEstimate));
+		if (state->arena == NULL) {
+			ASTNodePointerVector_free(state->nodes);
+			state->nodes = NULL;
+		}
 	}
+	if (state->nodes == NULL) {
+		state->error.code = ParserErrorCode_OUT_OF_MEMORY_FOR_NODES;
+	}
+}
+
+/*
+ * Adds the node of the token to the tree, or closes the current command for a
+ * command end token. The token is ignored once the parser has failed, the
+ * first error is kept in the state. This is a TokenSink.
+ *
+ * With an arena, the nodes are collected in the nodes vector until their
+ * parent command is closed, and only then are they moved to the parent's
+ * children vector, allocated in the arena with exactly the capacity needed.
+ */
+static void parseToken(token, parserState)
+Token *token;
+void *parserState;
+{
+	ParserState *state = parserState;
+	bool caseInsensitiveCommands = state->caseInsensitiveCommands;
+	unsigned long index;
+	ASTNodePointerVector **nodes = &state->nodes;
+	ASTNode *parent = state->parent;
+	ASTNode *node = NULL;
+	Arena *arena = state->arena;
+	ParserErrorCode errorCode = ParserErrorCode_OK;
+	CommandId command, parentCommand;
 
-	command_lt = string_from("lt");
-	command_nl = string_from("nl");
-	command_np = string_from("np");
-	if (command_lt == NULL || command_nl == NULL || command_np == NULL) {
-		errorCode = ParserErrorCode_OUT_OF_MEMORY_FOR_STRINGS;
+	if (state->error.code != ParserErrorCode_OK) {
+		return;
 	}
 
-	for (token = tokens->items, tokenIndex = 0;
-	     tokenIndex < tokens->size.length; tokenIndex++, token++) {
-		node = malloc(sizeof(ASTNode));
+	/* The command end tokens do not produce nodes */
+	if (token->type != TokenType_COMMAND_END) {
+		node = newNode(token, state->tokenIndex, parent,
+			       state->takeValues, arena, &errorCode);
 		if (node == NULL) {
-			errorCode = ParserErrorCode_OUT_OF_MEMORY_FOR_NODES;
-			break;
+			state->error = createError(token->byteIndex,
+						   token->codepointIndex,
+						   state->tokenIndex,
+						   errorCode);
+			return;
 		}
+	}
 
-		value = token->value;
-		node->byteIndex = token->byteIndex;
-		node->codepointIndex = token->codepointIndex;
-		node->tokenIndex = tokenIndex;
-		node->parent = parent;
-		node->children = NULL;
-		node->value = string_substring(value, 0, value->length);
-		if (node->value == NULL) {
-			errorCode = ParserErrorCode_OUT_OF_MEMORY_FOR_STRINGS;
+	switch (token->type) {
+	case TokenType_COMMAND_START:
+		node->type = ASTNodeType_COMMAND;
+		command = CommandId_resolve(node->commandId,
+					    caseInsensitiveCommands);
+		if (!isEmptyCommand(command) && state->maxNestingDepth > 0
+		    && state->depth == state->maxNestingDepth) {
+			errorCode = ParserErrorCode_MAX_NESTING_DEPTH_EXCEEDED;
 			break;
 		}
-
-		switch (token->type) {
-		case TokenType_COMMAND_START:
-			node->type = ASTNodeType_COMMAND;
+		if (arena == NULL) {
 			node->children = ASTNodePointerVector_new(0, 0);
-			if (node->children == NULL) {
-				errorCode =
-				    ParserErrorCode_OUT_OF_MEMORY_FOR_NODES;
-				break;
-			}
-
-			siblings = parent == NULL ? nodes : parent->children;
-			grownNodes =
-			    ASTNodePointerVector_append(siblings, &node);
-			if (grownNodes == NULL) {
-				errorCode =
-				    ParserErrorCode_OUT_OF_MEMORY_FOR_NODES;
-				break;
-			}
-
-			if (parent == NULL) {
-				nodes = grownNodes;
-			} else {
-				parent->children = grownNodes;
-			}
-
-			if (!string_equals
-			    (node->value, command_lt, caseInsensitiveCommands)
-			    && !string_equals(node->value, command_nl,
-					      caseInsensitiveCommands)
-			    && !string_equals(node->value, command_np,
-					      caseInsensitiveCommands)) {
-				parent = node;
-			}
+		} else if (isEmptyCommand(command)) {
+			node->children =
+			    moveNodesToArena(arena, *nodes,
+					     (*nodes)->size.length);
+		}
+		if ((arena == NULL || isEmptyCommand(command))
+		    && node->children == NULL) {
+			errorCode = ParserErrorCode_OUT_OF_MEMORY_FOR_NODES;
+			break;
+		}
 
-			/* Prevent possible double-freeing on error */
-			node = NULL;
+		if (!appendNode(nodes, arena == NULL ? parent : NULL, node)) {
+			errorCode = ParserErrorCode_OUT_OF_MEMORY_FOR_NODES;
 			break;
+		}
 
-		case TokenType_COMMAND_END:
-			string_free(node->value);
-			free(node);
-			node = NULL;
+		if (!isEmptyCommand(command)) {
+			parent = node;
+			state->depth++;
+		}
 
-			/*
-			   The following line would not fit into the line length
-			   limit on higher indentation level.
-			 */
+		/* Prevent possible double-freeing on error */
+		node = NULL;
+		break;
+
+	case TokenType_COMMAND_END:
+		command = CommandId_resolve(token->commandId,
+					    caseInsensitiveCommands);
+		if (isEmptyCommand(command)) {
 			errorCode =
 			    ParserErrorCode_UNALLOWED_BALANCING_COMMAND_END;
-			if (string_equals
-			    (token->value, command_lt, caseInsensitiveCommands)
-			    || string_equals(token->value, command_nl,
-					     caseInsensitiveCommands)
-			    || string_equals(token->value, command_np,
-					     caseInsensitiveCommands)
-			    ) {
-				break;
-			}
-			errorCode = ParserErrorCode_OK;
-
-			if (parent == NULL) {
-				errorCode =
-				    ParserErrorCode_UNEXPECTED_COMMAND_END;
-				break;
-			}
-
-			if (!string_equals
-			    (token->value, parent->value,
-			     caseInsensitiveCommands)) {
-				errorCode =
-				    ParserErrorCode_IMPROPERLY_BALANCED_COMMAND;
-				break;
-			}
-
-			parent = parent->parent;
 			break;
+		}
 
-		case TokenType_TEXT:
-		case TokenType_WHITESPACE:
-			node->type = token->type == TokenType_TEXT ?
-			    ASTNodeType_TEXT : ASTNodeType_WHITESPACE;
-			siblings = parent == NULL ? nodes : parent->children;
-			grownNodes =
-			    ASTNodePointerVector_append(siblings, &node);
-
-			if (grownNodes == NULL) {
-				errorCode =
-				    ParserErrorCode_OUT_OF_MEMORY_FOR_NODES;
-				break;
-			}
-
-			if (parent == NULL) {
-				nodes = grownNodes;
-			} else {
-				parent->children = grownNodes;
-			}
+		if (parent == NULL) {
+			errorCode = ParserErrorCode_UNEXPECTED_COMMAND_END;
+			break;
+		}
 
-			/* Prevent possible double-freeing on error */
-			node = NULL;
+		/* Only the names of custom commands need comparing */
+		parentCommand = CommandId_resolve(parent->commandId,
+						  caseInsensitiveCommands);
+		if (command != parentCommand
+		    || (command == CommandId_CUSTOM
+			&& !string_equals(token->value, parent->value,
+					  caseInsensitiveCommands))) {
+			errorCode = ParserErrorCode_IMPROPERLY_BALANCED_COMMAND;
 			break;
+		}
 
-		default:
-			errorCode = ParserErrorCode_UNSUPPORTED_TOKEN_TYPE;
+		if (arena != NULL) {
+			/* The parent's children follow the parent */
+			index = (*nodes)->size.length;
+			while ((*nodes)->items[index - 1] != parent) {
+				index--;
+			}
+			parent->children =
+			    moveNodesToArena(arena, *nodes, index);
+		}
+		if (parent->children == NULL) {
+			errorCode = ParserErrorCode_OUT_OF_MEMORY_FOR_NODES;
 			break;
 		}
 
-		if (errorCode != ParserErrorCode_OK) {
+		parent = parent->parent;
+		state->depth--;
+		break;
+
+	case TokenType_TEXT:
+	case TokenType_WHITESPACE:
+		node->type = token->type == TokenType_TEXT ?
+		    ASTNodeType_TEXT : ASTNodeType_WHITESPACE;
+		if (!appendNode(nodes, arena == NULL ? parent : NULL, node)) {
+			errorCode = ParserErrorCode_OUT_OF_MEMORY_FOR_NODES;
 			break;
 		}
-	}
 
-	string_free(command_lt);
-	string_free(command_nl);
-	string_free(command_np);
+		/* Prevent possible double-freeing on error */
+		node = NULL;
+		break;
 
-	if (parent != NULL && errorCode == ParserErrorCode_OK) {
-		errorCode = ParserErrorCode_UNTERMINATED_COMMAND;
+	default:
+		errorCode = ParserErrorCode_UNSUPPORTED_TOKEN_TYPE;
+		break;
 	}
+
 	if (errorCode != ParserErrorCode_OK) {
-		result->type = ParserResultType_ERROR;
+		if (arena == NULL) {
+			freeNode(node);
+		}
+		state->error = createError(token->byteIndex,
+					   token->codepointIndex,
+					   state->tokenIndex, errorCode);
 	}
+	state->parent = parent;
+	state->tokenIndex++;
+}
 
-	switch (result->type) {
-	case ParserResultType_SUCCESS:
-		result->result.nodes = nodes;
-		break;
-
-	case ParserResultType_ERROR:
-		if (errorCode == ParserErrorCode_OK) {
-			errorCode = ParserErrorCode_INTERNAL_ASSERTION_FAILED;
-		}
+/*
+ * Creates the result of the parser once all tokens have been parsed. The
+ * nodes are freed if the parser has failed. Returns NULL (freeing the nodes)
+ * if the memory for the result could not be allocated.
+ */
+static ParserResult *finishParsing(state)
+ParserState *state;
+{
+	ParserResult *result;
+	ASTNodePointerVector *arenaNodes;
+	ASTNode *parent = state->parent;
 
-		if (parent != NULL
-		    && errorCode == ParserErrorCode_UNTERMINATED_COMMAND) {
-			result->result.error =
-			    createError(parent->byteIndex,
-					parent->codepointIndex,
-					parent->tokenIndex, errorCode);
-		} else if (tokenIndex < tokens->size.length) {
-			result->result.error =
-			    createError(token->byteIndex, token->codepointIndex,
-					tokenIndex, errorCode);
+	result = malloc(sizeof(ParserResult));
+	if (result == NULL) {
+		discardNodes(state->nodes, state->arena);
+		return NULL;
+	}
+	result->valueViews = NULL;
+	result->arena = NULL;
+
+	if (state->error.code == ParserErrorCode_OK && parent != NULL) {
+		state->error =
+		    createError(parent->byteIndex, parent->codepointIndex,
+				parent->tokenIndex,
+				ParserErrorCode_UNTERMINATED_COMMAND);
+	}
+	if (state->error.code == ParserErrorCode_OK && state->arena != NULL) {
+		arenaNodes = moveNodesToArena(state->arena, state->nodes, 0);
+		if (arenaNodes == NULL) {
+			state->error =
+			    createError(0, 0, 0,
+					ParserErrorCode_OUT_OF_MEMORY_FOR_NODES);
 		} else {
-			result->result.error = createError(0, 0, 0, errorCode);
+			ASTNodePointerVector_free(state->nodes);
+			state->nodes = arenaNodes;
 		}
+	}
 
-		if (node != NULL) {
-			free(node);
-		}
-		freeNodes(nodes);
-		break;
-
-	default:
+	if (state->error.code != ParserErrorCode_OK) {
 		result->type = ParserResultType_ERROR;
-		errorCode = ParserErrorCode_INTERNAL_ASSERTION_FAILED;
-		result->result.error = createError(0, 0, 0, errorCode);
-		if (node != NULL) {
-			free(node);
-		}
-		freeNodes(nodes);
-		break;
+		result->result.error = state->error;
+		discardNodes(state->nodes, state->arena);
+		return result;
 	}
 
+	result->type = ParserResultType_SUCCESS;
+	result->result.nodes = state->nodes;
+	result->arena = state->arena;
 	return result;
 }
 
@@ -260,7 +457,11 @@ ParserResult *result;
 
 	switch (result->type) {
 	case ParserResultType_SUCCESS:
-		freeNodes(result->result.nodes);
+		if (result->arena != NULL) {
+			Arena_free(result->arena);
+		} else {
+			freeNodes(result->result.nodes);
+		}
 		break;
 
 	case ParserResultType_ERROR:
@@ -269,28 +470,239 @@ ParserResult *result;
 	default:
 		break;
 	}
+	TokenValueViewBlock_free(result->valueViews);
 
 	free(result);
 }
 
+/*
+ * Creates a node of the token, which is not a command end token. The node's
+ * value is moved from the token if takeValue is set, unless the value is
+ * owned by the token and the arena is used, in which case the value is copied
+ * to the arena, same as when takeValue is not set. Returns NULL and sets the
+ * error code if the memory for the node or its value could not be allocated.
+ */
+static ASTNode *newNode(token, tokenIndex, parent, takeValue, arena, errorCode)
+Token *token;
+unsigned long tokenIndex;
+ASTNode *parent;
+bool takeValue;
+Arena *arena;
+ParserErrorCode *errorCode;
+{
+	ASTNode *node;
+	string *value = token->value;
+
+	if (arena != NULL) {
+		node = Arena_allocate(arena, sizeof(ASTNode));
+	} else {
+		node = malloc(sizeof(ASTNode));
+	}
+	if (node == NULL) {
+		*errorCode = ParserErrorCode_OUT_OF_MEMORY_FOR_NODES;
+		return NULL;
+	}
+
+	node->byteIndex = token->byteIndex;
+	node->codepointIndex = token->codepointIndex;
+	node->tokenIndex = tokenIndex;
+	node->commandId = token->commandId;
+	node->parent = parent;
+	node->children = NULL;
+	node->isValueView = false;
+	if (takeValue && (arena == NULL || token->isValueView)) {
+		node->value = value;
+		node->isValueView = token->isValueView;
+		token->value = NULL;
+		return node;
+	}
+
+	if (arena == NULL) {
+		node->value = string_substring(value, 0, value->length);
+	} else {
+		node->value = Arena_allocate(arena,
+					     sizeof(string) + value->length);
+		if (node->value != NULL) {
+			node->value->length = value->length;
+			node->value->content =
+			    (unsigned char *)(node->value + 1);
+			memcpy(node->value->content, value->content,
+			       value->length);
+		}
+	}
+	if (node->value == NULL) {
+		if (arena == NULL) {
+			free(node);
+		}
+		*errorCode = ParserErrorCode_OUT_OF_MEMORY_FOR_STRINGS;
+		return NULL;
+	}
+
+	return node;
+}
+
+/*
+ * Appends the node to the children of the parent, or to the nodes if the
+ * parent is NULL. Returns false if the memory could not be allocated.
+ */
+static bool appendNode(nodes, parent, node)
+ASTNodePointerVector **nodes;
+ASTNode *parent;
+ASTNode *node;
+{
+	ASTNodePointerVector **siblings;
+	ASTNodePointerVector *grownNodes;
+
+	siblings = parent == NULL ? nodes : &parent->children;
+	/*
+	 * The nodes are the root nodes, or, in the arena, the stack of the
+	 * children of all open commands, so they grow exponentially to keep
+	 * deeply nested input linear.
+	 */
+	if (parent == NULL && (*nodes)->size.length == (*nodes)->size.capacity
+	    && (*nodes)->size.capacity > 0) {
+		grownNodes = ASTNodePointerVector_grow(*nodes,
+						       (*nodes)->size.capacity *
+						       2);
+		if (grownNodes == NULL) {
+			return false;
+		}
+		*nodes = grownNodes;
+	}
+	node->siblingIndex = (*siblings)->size.length;
+	grownNodes = ASTNodePointerVector_append(*siblings, &node);
+	if (grownNodes == NULL) {
+		return false;
+	}
+
+	*siblings = grownNodes;
+	return true;
+}
+
+/*
+ * Moves the nodes following the provided index to a new vector allocated in
+ * the arena, removing them from the nodes vector.
+ */
+static ASTNodePointerVector *moveNodesToArena(arena, nodes, from)
+Arena *arena;
+ASTNodePointerVector *nodes;
+unsigned long from;
+{
+	ASTNodePointerVector *movedNodes;
+	unsigned long length = nodes->size.length - from;
+	unsigned long i;
+
+	movedNodes = Arena_allocate(arena, sizeof(ASTNodePointerVector));
+	if (movedNodes == NULL) {
+		return NULL;
+	}
+	movedNodes->items = Arena_allocate(arena, length * sizeof(ASTNode *));
+	if (movedNodes->items == NULL) {
+		return NULL;
+	}
+
+	movedNodes->size.itemSize = sizeof(ASTNode *);
+	movedNodes->size.length = length;
+	movedNodes->size.capacity = length;
+	for (i = 0; i < length; i++) {
+		movedNodes->items[i] = nodes->items[from + i];
+		movedNodes->items[i]->siblingIndex = i;
+	}
+	nodes->size.length = from;
+	return movedNodes;
+}
+
+/*
+ * Returns the size of the arena blocks that fit the nodes of the tokens, and
+ * their values in most cases, into a single block.
+ */
+static unsigned long estimateArenaBlockSize(tokenCount)
+unsigned long tokenCount;
+{
+	unsigned long size = tokenCount *
+	    (sizeof(ASTNode) + sizeof(ASTNode *) + sizeof(string) + 16);
+
+	if (size < PARSER_ARENA_MIN_BLOCK_SIZE) {
+		return PARSER_ARENA_MIN_BLOCK_SIZE;
+	}
+	if (size > PARSER_ARENA_MAX_BLOCK_SIZE) {
+		return PARSER_ARENA_MAX_BLOCK_SIZE;
+	}
+	return size;
+}
+
+/* Frees the nodes of a failed parsing */
+static void discardNodes(nodes, arena)
+ASTNodePointerVector *nodes;
+Arena *arena;
+{
+	if (arena == NULL) {
+		freeNodes(nodes);
+		return;
+	}
+
+	/* The nodes vector is not allocated in the arena on failure */
+	ASTNodePointerVector_free(nodes);
+	Arena_free(arena);
+}
+
+/*
+ * Frees the nodes and their descendants without recursion. The nodes are
+ * freed from the last one, the children of a node before the node itself,
+ * and the parent pointers lead back from the emptied children vectors, so
+ * no stack is needed either.
+ */
 static void freeNodes(nodes)
 ASTNodePointerVector *nodes;
 {
-	ASTNode **node;
-	unsigned long index = 0;
+	ASTNodePointerVector *siblings = nodes;
+	ASTNode *parent = NULL;
+	ASTNode *node;
+
 	if (nodes == NULL) {
 		return;
 	}
 
-	for (node = nodes->items; index < nodes->size.length; index++, node++) {
-		freeNodes((*node)->children);
-		string_free((*node)->value);
-		free(*node);
+	while (siblings != nodes || siblings->size.length > 0) {
+		if (siblings->size.length == 0) {
+			/* The parent is the last of its siblings */
+			siblings = parent->parent != NULL ?
+			    parent->parent->children : nodes;
+			parent = parent->parent;
+			continue;
+		}
+
+		node = siblings->items[siblings->size.length - 1];
+		if (node != NULL && node->children != NULL
+		    && node->children->size.length > 0) {
+			siblings = node->children;
+			parent = node;
+			continue;
+		}
+
+		if (node != NULL) {
+			ASTNodePointerVector_free(node->children);
+		}
+		freeNode(node);
+		siblings->size.length--;
 	}
 
 	ASTNodePointerVector_free(nodes);
 }
 
+static void freeNode(node)
+ASTNode *node;
+{
+	if (node == NULL) {
+		return;
+	}
+
+	if (!node->isValueView) {
+		string_free(node->value);
+	}
+	free(node);
+}
+
 static ParserError createError(byteIndex, codepointIndex, tokenIndex, errorCode)
 unsigned long byteIndex;
 unsigned long codepointIndex;
@@ -305,6 +717,14 @@ ParserErrorCode errorCode;
 	return error;
 }
 
+/* Returns true for the commands that have no content and no end tag */
+static bool isEmptyCommand(command)
+CommandId command;
+{
+	return command == CommandId_LT || command == CommandId_NL
+	    || command == CommandId_NP;
+}
+
 static bool string_equals(string1, string2, caseInsensitive)
 string *string1;
 string *string2;
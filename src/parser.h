@@ -1,6 +1,7 @@
 #ifndef PARSER_HEADER_FILE
 #define PARSER_HEADER_FILE 1
 
+#include "arena.h"
 #include "ast_node_pointer_vector.h"
 #include "bool.h"
 #include "tokenizer.h"
@@ -17,7 +18,8 @@ typedef enum ParserErrorCode {
 	ParserErrorCode_OUT_OF_MEMORY_FOR_STRINGS,
 	ParserErrorCode_OUT_OF_MEMORY_FOR_NODES,
 	ParserErrorCode_UNSUPPORTED_TOKEN_TYPE,
-	ParserErrorCode_INTERNAL_ASSERTION_FAILED
+	ParserErrorCode_INTERNAL_ASSERTION_FAILED,
+	ParserErrorCode_MAX_NESTING_DEPTH_EXCEEDED
 } ParserErrorCode;
 
 typedef struct ParserError {
@@ -38,10 +40,86 @@ typedef struct ParserResult {
 		ASTNodePointerVector *nodes;
 		ParserError error;
 	} result;
+	/*
+	 * The string headers of the node values referencing the tokenized
+	 * input, taken over from the tokenizer result by parseAndConsumeTokens,
+	 * NULL otherwise.
+	 */
+	TokenValueViewBlock *valueViews;
+	/*
+	 * The arena holding the nodes, their children vectors and their values
+	 * (except for the value views) if the parser was told to use one (see
+	 * ParserOptions.useArena), NULL otherwise. The nodes of an arena must
+	 * not be freed or modified individually.
+	 */
+	Arena *arena;
 } ParserResult;
 
+typedef struct ParserOptions {
+	/*
+	 * The parser will allocate the nodes, their children vectors and their
+	 * values from an arena instead of allocating each of them separately.
+	 * The nodes are placed next to each other in document order, and the
+	 * whole tree is freed by freeing a few large blocks of memory.
+	 */
+	bool useArena;
+
+	/*
+	 * The maximum number of commands nested in each other, 0 for no limit.
+	 * The parser fails with the MAX_NESTING_DEPTH_EXCEEDED error at the
+	 * first command exceeding the limit, so that the rest of the input is
+	 * not parsed needlessly.
+	 */
+	unsigned long maxNestingDepth;
+} ParserOptions;
+
+/*
+ * Parses the tokens into a tree of nodes. The nodes own copies of the token
+ * values, so the tokens may be freed independently of the parser result.
+ */
 ParserResult *parse(TokenVector * tokens, bool caseInsensitiveCommands);
 
+/*
+ * Same as parse, but allows to alter the parser's behavior. The options may be
+ * NULL, in which case the default behavior is used.
+ */
+ParserResult *parseWithOptions(TokenVector * tokens,
+			       bool caseInsensitiveCommands,
+			       ParserOptions * options);
+
+/*
+ * Same as parse, but moves the values of the tokens into the nodes instead of
+ * copying them, and frees the tokens of the tokenizer result afterwards. The
+ * tokenizer result keeps its warnings and codepoint index, and must still be
+ * freed by the caller, but no longer references any tokens. The nodes
+ * referencing the tokenized input (see TokenizerOptions.useValueViews) keep
+ * referencing it, so the input must outlive the parser result in such case.
+ */
+ParserResult *parseAndConsumeTokens(TokenizerResult * tokenizerResult,
+				    bool caseInsensitiveCommands,
+				    ParserOptions * options);
+
+/*
+ * Tokenizes and parses the input in a single pass, building the nodes as the
+ * tokens are recognized (see tokenizeToSink), so the tokens are never stored.
+ * The values of the tokens are moved into the nodes, same as with
+ * parseAndConsumeTokens, so the input must outlive the parser result if the
+ * tokenizer options request value views.
+ *
+ * The tokenizer result, which has no tokens but provides the warnings, the
+ * codepoint index and the tokenizer error, is stored to tokenizerResult and
+ * must be freed by the caller. The function returns NULL if the tokenizer
+ * failed (the tokenizer error takes precedence over the parser error, same as
+ * when the input is tokenized first), or if the memory for either result
+ * could not be allocated. The errors are otherwise the same as if the input
+ * was tokenized and then parsed.
+ */
+ParserResult *tokenizeAndParse(string * richtext,
+			       bool caseInsensitiveCommands, bool isUtf8,
+			       TokenizerOptions * tokenizerOptions,
+			       ParserOptions * parserOptions,
+			       TokenizerResult ** tokenizerResult);
+
 void ParserResult_free(ParserResult * result);
 
 #endif
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include "bool.h"
+#include "codepoint_index.h"
 #include "custom_command_layout_interpretation.h"
 #include "layout_post_processor.h"
 #include "layout_resolver.h"
@@ -7,6 +8,7 @@
 #include "parser.h"
 #include "processor.h"
 #include "tokenizer.h"
+#include "warning_policy.h"
 
 ProcessorResult *process(richtext, isUtf8,
 			 caseInsensitiveCommands,
@@ -20,6 +22,27 @@ CustomCommandLayoutInterpretation customCommandInterpreter(ASTNode *, bool);
 LayoutPostProcessor *layoutPostProcessor;
 OutputRenderer *outputRenderer;
 void *outputRendererConfiguration;
+{
+	return processWithOptions(richtext, isUtf8, caseInsensitiveCommands,
+				  customCommandInterpreter, layoutPostProcessor,
+				  outputRenderer, outputRendererConfiguration,
+				  NULL);
+}
+
+ProcessorResult *processWithOptions(richtext, isUtf8,
+				    caseInsensitiveCommands,
+				    customCommandInterpreter,
+				    layoutPostProcessor,
+				    outputRenderer,
+				    outputRendererConfiguration, options)
+string *richtext;
+bool isUtf8;
+bool caseInsensitiveCommands;
+CustomCommandLayoutInterpretation customCommandInterpreter(ASTNode *, bool);
+LayoutPostProcessor *layoutPostProcessor;
+OutputRenderer *outputRenderer;
+void *outputRendererConfiguration;
+ProcessorOptions *options;
 {
 	ProcessorResult *result = NULL;
 	ProcessorError OOM_POST_PROCESSOR_ERROR =
@@ -29,6 +52,9 @@ void *outputRendererConfiguration;
 	LayoutResolverResult *layoutResolverResult = NULL;
 	LayoutPostProcessorResult *layoutPostProcessorResult = NULL;
 	OutputRendererResult *outputRendererResult = NULL;
+	TokenizerOptions tokenizerOptions;
+	ParserOptions parserOptions;
+	LayoutResolverOptions layoutResolverOptions;
 
 	result = malloc(sizeof(ProcessorResult));
 	if (result == NULL) {
@@ -55,7 +81,37 @@ void *outputRendererConfiguration;
 		return result;
 	}
 
-	tokenizerResult = tokenize(richtext, caseInsensitiveCommands, isUtf8);
+	/*
+	 * The input outlives the nodes, which take over the token values, so
+	 * there is no need to copy the values while tokenizing at all.
+	 */
+	tokenizerOptions.useValueViews = true;
+	tokenizerOptions.presizeTokens = false;
+	tokenizerOptions.tokens = NULL;
+	tokenizerOptions.lazyCodepointIndexes =
+	    options != NULL ? options->lazyCodepointIndexes : false;
+	tokenizerOptions.threadCount = 0;
+	tokenizerOptions.warningPolicy.type = WarningPolicyType_RECORD_ALL;
+	tokenizerOptions.warningPolicy.limit = 0;
+	if (options != NULL) {
+		tokenizerOptions.warningPolicy = options->warningPolicy;
+	}
+	layoutResolverOptions.warningPolicy = tokenizerOptions.warningPolicy;
+	layoutResolverOptions.interpretsCustomCommandsByName = false;
+	layoutResolverOptions.customCommandCache = NULL;
+
+	/*
+	 * The nodes are built as the tokens are recognized, taking over their
+	 * values, so the tokens are never stored. The whole tree is freed at
+	 * once, so it can be allocated in an arena.
+	 */
+	parserOptions.useArena = true;
+	parserOptions.maxNestingDepth =
+	    options != NULL ? options->maxNestingDepth : 0;
+	parserResult =
+	    tokenizeAndParse(richtext, caseInsensitiveCommands, isUtf8,
+			     &tokenizerOptions, &parserOptions,
+			     &tokenizerResult);
 	if (tokenizerResult == NULL) {
 		result->type = ProcessorResultType_PROCESSOR_ERROR;
 		result->result.processorError =
@@ -70,9 +126,6 @@ void *outputRendererConfiguration;
 		TokenizerResult_free(tokenizerResult);
 		return result;
 	}
-
-	parserResult =
-	    parse(tokenizerResult->result.tokens, caseInsensitiveCommands);
 	if (parserResult == NULL) {
 		result->type = ProcessorResultType_PROCESSOR_ERROR;
 		result->result.processorError =
@@ -83,19 +136,28 @@ void *outputRendererConfiguration;
 	if (parserResult->type != ParserResultType_SUCCESS) {
 		result->type = ProcessorResultType_PARSER_ERROR;
 		result->result.parserError = parserResult->result.error;
+		if (tokenizerResult->lazyCodepointIndex != NULL) {
+			result->result.parserError.codepointIndex =
+			    CodepointIndex_of(tokenizerResult->
+					      lazyCodepointIndex,
+					      parserResult->result.error.
+					      byteIndex);
+		}
 		TokenizerResult_free(tokenizerResult);
 		ParserResult_free(parserResult);
 		return result;
 	}
+	TokenizerResult_free(tokenizerResult);
 
 	layoutResolverResult =
-	    resolveLayout(parserResult->result.nodes,
-			  customCommandInterpreter, caseInsensitiveCommands);
+	    resolveLayoutWithOptions(parserResult->result.nodes,
+				     customCommandInterpreter,
+				     caseInsensitiveCommands,
+				     &layoutResolverOptions);
 	if (layoutResolverResult == NULL) {
 		result->type = ProcessorResultType_PROCESSOR_ERROR;
 		result->result.processorError =
 		    ProcessorError_OUT_OF_MEMORY_FOR_LAYOUT_RESOLVER_RESULT;
-		TokenizerResult_free(tokenizerResult);
 		ParserResult_free(parserResult);
 		return result;
 	}
@@ -105,7 +167,6 @@ void *outputRendererConfiguration;
 		result->type = ProcessorResultType_LAYOUT_RESOLVER_ERROR;
 		result->result.layoutResolverError =
 		    layoutResolverResult->result.error;
-		TokenizerResult_free(tokenizerResult);
 		ParserResult_free(parserResult);
 		LayoutResolverResult_free(layoutResolverResult);
 		return result;
@@ -118,7 +179,6 @@ void *outputRendererConfiguration;
 			result->type = ProcessorResultType_PROCESSOR_ERROR;
 			result->result.processorError =
 			    OOM_POST_PROCESSOR_ERROR;
-			TokenizerResult_free(tokenizerResult);
 			ParserResult_free(parserResult);
 			LayoutResolverResult_free(layoutResolverResult);
 			return result;
@@ -131,7 +191,6 @@ void *outputRendererConfiguration;
 			result->type = ProcessorResultType_POST_PROCESSOR_ERROR;
 			result->result.layoutPostProcessorError =
 			    *layoutPostProcessorResult->error;
-			TokenizerResult_free(tokenizerResult);
 			ParserResult_free(parserResult);
 			LayoutResolverResult_free(layoutResolverResult);
 			LayoutPostProcessorResult_free
@@ -148,7 +207,6 @@ void *outputRendererConfiguration;
 		result->type = ProcessorResultType_PROCESSOR_ERROR;
 		result->result.processorError =
 		    ProcessorError_OUT_OF_MEMORY_FOR_OUTPUT_RENDERER_RESULT;
-		TokenizerResult_free(tokenizerResult);
 		ParserResult_free(parserResult);
 		LayoutResolverResult_free(layoutResolverResult);
 		return result;
@@ -159,7 +217,6 @@ void *outputRendererConfiguration;
 		result->type = ProcessorResultType_OUTPUT_RENDERER_ERROR;
 		result->result.outputRendererError =
 		    outputRendererResult->result.error;
-		TokenizerResult_free(tokenizerResult);
 		ParserResult_free(parserResult);
 		LayoutResolverResult_free(layoutResolverResult);
 		OutputRendererResult_free(outputRendererResult);
@@ -173,7 +230,6 @@ void *outputRendererConfiguration;
 	 * We're freeing this near the very end, because the structures refer
 	 * each other for easier debugging.
 	 */
-	TokenizerResult_free(tokenizerResult);
 	ParserResult_free(parserResult);
 	LayoutResolverResult_free(layoutResolverResult);
 	OutputRendererResult_free(outputRendererResult);
@@ -10,6 +10,7 @@
 #include "parser.h"
 #include "string.h"
 #include "tokenizer.h"
+#include "warning_policy.h"
 
 typedef enum ProcessorResultType {
 	ProcessorResultType_SUCCESS,
@@ -48,6 +49,30 @@ typedef struct ProcessorResult {
 	OutputRendererWarningVector *outputRendererWarnings;
 } ProcessorResult;
 
+typedef struct ProcessorOptions {
+	/*
+	 * Applied to the tokenizer and layout resolver warnings. The layout
+	 * post-processor and the output renderer apply their own policies
+	 * (see OutputRendererWarningVector_record).
+	 */
+	WarningPolicy warningPolicy;
+
+	/*
+	 * The maximum number of commands nested in each other, 0 for no limit
+	 * (see ParserOptions.maxNestingDepth).
+	 */
+	unsigned long maxNestingDepth;
+
+	/*
+	 * Computes the codepoint indexes only for the tokenizer and parser
+	 * errors and warnings (see TokenizerOptions.lazyCodepointIndexes). The
+	 * codepointIndex of every node passed to the layout resolver, the
+	 * post-processor and the output renderer is then 0, so the option may
+	 * be used only if they do not use the codepoint indexes of the nodes.
+	 */
+	bool lazyCodepointIndexes;
+} ProcessorOptions;
+
 ProcessorResult *process(string * richtext, bool isUtf8,
 			 bool caseInsensitiveCommands,
 			 CustomCommandLayoutInterpretation
@@ -56,4 +81,17 @@ ProcessorResult *process(string * richtext, bool isUtf8,
 			 OutputRenderer * outputRenderer,
 			 void *outputRendererConfiguration);
 
+/*
+ * Processes the input like process, the options may be NULL to use the
+ * defaults.
+ */
+ProcessorResult *processWithOptions(string * richtext, bool isUtf8,
+				    bool caseInsensitiveCommands,
+				    CustomCommandLayoutInterpretation
+				    customCommandInterpreter(ASTNode *, bool),
+				    LayoutPostProcessor * layoutPostProcessor,
+				    OutputRenderer * outputRenderer,
+				    void *outputRendererConfiguration,
+				    ProcessorOptions * options);
+
 #endif
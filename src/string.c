@@ -11,6 +11,7 @@ unsigned long length;
 	}
 
 	newString->length = length;
+	newString->content = NULL;
 	if (length) {
 		newString->content = malloc(sizeof(char) * length);
 		if (newString->content == NULL) {
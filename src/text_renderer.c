@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ast_node.h"
+#include "ast_node_pointer_vector.h"
+#include "bool.h"
+#include "command_id.h"
+#include "layout_block.h"
+#include "layout_block_vector.h"
+#include "layout_line.h"
+#include "layout_line_segment.h"
+#include "layout_paragraph.h"
+#include "output_renderer.h"
+#include "string.h"
+#include "text_renderer.h"
+
+static bool appendSegmentText(string * output, unsigned long *capacity,
+			      LayoutLineSegment * segment,
+			      bool caseInsensitiveCommands);
+
+static bool appendBytes(string * output, unsigned long *capacity,
+			const unsigned char *bytes, unsigned long length);
+
+OutputRendererResult *renderText(document, configuration)
+LayoutBlockVector *document;
+void *configuration;
+{
+	OutputRendererResult *result = malloc(sizeof(OutputRendererResult));
+	string *output = string_new(0);
+	unsigned long capacity = 0;
+	LayoutBlock *block;
+	LayoutParagraph *paragraph;
+	LayoutLine *line;
+	bool caseInsensitive = *(bool *) configuration;
+	bool isFirstParagraph = true;
+	bool isSuccess = true;
+	unsigned long i;
+	unsigned long j;
+	unsigned long k;
+	unsigned long l;
+
+	if (output != NULL) {
+		/* The content is allocated as the text is appended */
+		output->content = NULL;
+	}
+	if (result == NULL || output == NULL) {
+		free(result);
+		string_free(output);
+		return NULL;
+	}
+
+	result->warnings = OutputRendererWarningVector_new(0, 0);
+	if (result->warnings == NULL) {
+		free(result);
+		string_free(output);
+		return NULL;
+	}
+
+	block = document->items;
+	for (i = 0; isSuccess && i < document->size.length; i++, block++) {
+		paragraph = block->paragraphs->items;
+		for (j = 0; isSuccess && j < block->paragraphs->size.length;
+		     j++, paragraph++) {
+			if (!isFirstParagraph) {
+				isSuccess =
+				    appendBytes(output, &capacity,
+						(unsigned char *)"\n", 1);
+			}
+			isFirstParagraph = false;
+
+			line = paragraph->lines->items;
+			for (k = 0; isSuccess && k < paragraph->lines->
+			     size.length; k++, line++) {
+				for (l = 0; isSuccess
+				     && l < line->segments->size.length; l++) {
+					isSuccess =
+					    appendSegmentText(output, &capacity,
+							      line->segments->
+							      items + l,
+							      caseInsensitive);
+				}
+				isSuccess = isSuccess
+				    && appendBytes(output, &capacity,
+						   (unsigned char *)"\n", 1);
+			}
+		}
+	}
+
+	if (!isSuccess) {
+		OutputRendererWarningVector_free(result->warnings);
+		free(result);
+		string_free(output);
+		return NULL;
+	}
+
+	result->type = OutputRendererResultType_SUCCESS;
+	result->result.output = output;
+	return result;
+}
+
+static bool appendSegmentText(output, capacity, segment,
+			      caseInsensitiveCommands)
+string *output;
+unsigned long *capacity;
+LayoutLineSegment *segment;
+bool caseInsensitiveCommands;
+{
+	ASTNode **nodes = segment->content->items;
+	string *value;
+	unsigned long i;
+
+	for (i = 0; i < segment->content->size.length; i++) {
+		value = nodes[i]->value;
+		if (nodes[i]->type == ASTNodeType_COMMAND) {
+			/* Of the commands, only <lt> stands for any text */
+			if (CommandId_resolve(nodes[i]->commandId,
+					      caseInsensitiveCommands) ==
+			    CommandId_LT
+			    && !appendBytes(output, capacity,
+					    (unsigned char *)"<", 1)) {
+				return false;
+			}
+			continue;
+		}
+
+		/* Line breaks in the input are not line breaks in richtext */
+		if (nodes[i]->type == ASTNodeType_WHITESPACE
+		    && (value->content[0] == '\r'
+			|| value->content[0] == '\n')) {
+			if (!appendBytes(output, capacity,
+					 (unsigned char *)" ", 1)) {
+				return false;
+			}
+		} else if (!appendBytes(output, capacity, value->content,
+					value->length)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool appendBytes(output, capacity, bytes, length)
+string *output;
+unsigned long *capacity;
+const unsigned char *bytes;
+unsigned long length;
+{
+	unsigned long grownCapacity = *capacity;
+	unsigned char *grownContent;
+
+	if (output->length + length > grownCapacity) {
+		grownCapacity = grownCapacity < 4096 ? 4096 : grownCapacity;
+		while (output->length + length > grownCapacity) {
+			grownCapacity *= 2;
+		}
+		grownContent = realloc(output->content, grownCapacity);
+		if (grownContent == NULL) {
+			return false;
+		}
+		output->content = grownContent;
+		*capacity = grownCapacity;
+	}
+
+	memcpy(output->content + output->length, bytes, length);
+	output->length += length;
+	return true;
+}
@@ -0,0 +1,18 @@
+#ifndef TEXT_RENDERER_HEADER_FILE
+#define TEXT_RENDERER_HEADER_FILE 1
+
+#include "layout_block_vector.h"
+#include "output_renderer.h"
+
+/*
+ * An output renderer (see OutputRenderer) of the plain text of the document,
+ * each line of a paragraph on a line of its own, and the paragraphs separated
+ * by an empty line. Line breaks in the input are rendered as spaces, and the
+ * <lt> commands as "<". The configuration points to the bool flag of case
+ * insensitive commands, which must match the flag the document was processed
+ * with. Returns NULL if the memory for the output could not be allocated.
+ */
+OutputRendererResult *renderText(LayoutBlockVector * document,
+				 void *configuration);
+
+#endif
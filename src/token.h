@@ -1,6 +1,8 @@
 #ifndef TOKEN_HEADER_FILE
 #define TOKEN_HEADER_FILE 1
 
+#include "bool.h"
+#include "command_id.h"
 #include "string.h"
 #include "token_type.h"
 
@@ -9,6 +11,17 @@ typedef struct Token {
 	unsigned long codepointIndex;
 	TokenType type;
 	string *value;
+	/*
+	 * Set if the value's content is not owned by the token, but references
+	 * the tokenized input instead (see TokenizerOptions.useValueViews).
+	 * Such values must not be freed using string_free.
+	 */
+	bool isValueView;
+	/*
+	 * The identifier of the command for command tokens, CommandId_NONE for
+	 * the other tokens.
+	 */
+	CommandId commandId;
 } Token;
 
 #endif
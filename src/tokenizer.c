@@ -1,13 +1,21 @@
 #include <stdlib.h>
+#include <string.h>
+#if defined(RICHTEXT_THREADS)
+#include <pthread.h>
+#endif
 #include "utf8/single_byte_encoding.h"
 #include "utf8/single_byte_to_utf8.h"
 #include "tokenizer.h"
 #include "bool.h"
+#include "byte_scanner.h"
+#include "codepoint_index.h"
+#include "command_id.h"
 #include "string.h"
 #include "token.h"
 #include "token_type.h"
 #include "token_vector.h"
 #include "typed_vector.h"
+#include "whitespace.h"
 
 typedef enum TextEncoding {
 	TextEncoding_UNKNOWN,
@@ -31,12 +39,71 @@ typedef enum TextEncoding {
 } TextEncoding;
 
 Vector_ofType(TextEncoding)
-static TokenizerResult *addWarning(TokenizerResult *result,
-				   TokenizerWarningVector **warnings,
-				   TokenVector *tokens,
-				   unsigned long byteIndex,
-				   unsigned long codepointIndex,
-				   TokenizerWarningCode code);
+#define TOKEN_VALUE_VIEW_BLOCK_CAPACITY 512
+#define TOKENIZER_OOM_FOR_INPUT_BUFFER \
+	TokenizerErrorCode_OUT_OF_MEMORY_FOR_INPUT_BUFFER
+#define OOM_FOR_CODEPOINT_INDEX \
+	TokenizerErrorCode_OUT_OF_MEMORY_FOR_CODEPOINT_INDEX
+struct TokenValueViewBlock {
+	TokenValueViewBlock *previous;
+	unsigned long length;
+	string views[TOKEN_VALUE_VIEW_BLOCK_CAPACITY];
+};
+
+struct TokenizerState {
+	/* The input that has not been consumed by the emitted tokens yet */
+	unsigned char *buffer;
+	unsigned long bufferLength;
+	unsigned long bufferCapacity;
+	/* The index of the buffer's first byte in the whole input */
+	unsigned long bufferByteIndex;
+	bool ownsBuffer;
+	/* The index of the next buffered byte to process */
+	unsigned long scanIndex;
+	unsigned long codepointIndex;
+	/* The token that is being read */
+	Token token;
+	bool isInsideCommand;
+	bool caseInsensitiveCommands;
+	TextEncoding currentEncoding;
+	TextEncodingVector *encodingStack;
+	TokenVector *tokens;
+	/* Receives the tokens instead of the token vector if not NULL */
+	TokenSink *tokenSink;
+	void *tokenSinkContext;
+	TokenizerWarningVector *warnings;
+	WarningPolicy warningPolicy;
+	TokenValueViewBlock **valueViews;
+	/* Records the encoding changes if the codepoints are not counted */
+	CodepointIndex *lazyCodepointIndex;
+	TokenizerError error;
+	bool isFinished;
+};
+
+static TokenizerErrorCode initState(TokenizerState *state,
+				    bool caseInsensitiveCommands, bool isUtf8,
+				    unsigned long tokenCountEstimate,
+				    TokenVector *tokens);
+
+static TokenizerErrorCode processInput(TokenizerState *state, bool isFinal);
+
+static TokenizerErrorCode finishInput(TokenizerState *state);
+
+static void resolveCodepointIndexes(TokenizerWarningVector *warnings,
+				    TokenizerError *error,
+				    CodepointIndex *codepointIndex);
+
+static TokenizerResult *takeResult(TokenizerState *state);
+
+static unsigned long getRequiredInputLength(unsigned char byte,
+					    TextEncoding encoding);
+
+static TokenizerErrorCode addWarning(TokenizerState *state,
+				     unsigned long byteIndex,
+				     unsigned long codepointIndex,
+				     TokenizerWarningCode code);
+
+static bool mergeWarnings(void *recordedWarning, const void *warning);
 
 static TokenizerResult *finalizeToError(TokenizerResult *result,
 					unsigned long byteIndex,
@@ -45,16 +112,17 @@ static TokenizerResult *finalizeToError(TokenizerResult *result,
 					TokenizerWarningVector *warnings,
 					TokenVector *tokens);
 
-static TokenizerErrorCode addToken(TokenVector **tokens, Token *token,
-				   string *input,
+static TokenizerErrorCode addToken(TokenizerState *state, string *input,
 				   unsigned long valueStartIndex,
-				   unsigned long valueEndIndex,
-				   TextEncoding valueEncoding);
+				   unsigned long valueEndIndex);
 
-static void freeTokens(TokenVector *tokens);
+static string *newValueView(TokenValueViewBlock **valueViews, string *input,
+			    unsigned long valueStartIndex,
+			    unsigned long valueEndIndex);
 
-static unsigned long getWhitespaceLength(string *input, unsigned long index,
-					 bool isUtf8);
+static bool isAsciiOnly(unsigned char *content, unsigned long length);
+
+static void freeTokens(TokenVector *tokens);
 
 static TokenizerErrorCode updateEncodingStack(TextEncodingVector
 					      **encodingStack,
@@ -62,151 +130,533 @@ static TokenizerErrorCode updateEncodingStack(TextEncodingVector
 					      Token *token,
 					      bool caseInsensitiveCommands);
 
+static TokenizerErrorCode recordEncoding(TokenizerState *state,
+					 unsigned long byteIndex);
+
 static TextEncoding tokenToEncoding(Token *token, bool caseInsensitive);
 
 static string *transcodeToUtf8(string *input, TextEncoding inputEncoding);
 
-static bool string_equals(string *string1, string *string2,
-			  bool caseInsensitive);
+#if defined(RICHTEXT_THREADS)
+
+/*
+ * The input is split only into chunks of at least this length, shorter chunks
+ * are not worth the overhead of a thread.
+ */
+#define MIN_CHUNK_LENGTH 32768
+
+typedef struct TokenizerChunk {
+	unsigned long start;
+	unsigned long end;
+	TokenizerState state;
+	TokenValueViewBlock *valueViews;
+	bool presizeTokens;
+	pthread_t thread;
+	bool isThreadStarted;
+} TokenizerChunk;
+
+static bool tokenizeInParallel(TokenizerResult *result, string *richtext,
+			       bool caseInsensitiveCommands, bool isUtf8,
+			       TokenizerOptions *options);
+
+static unsigned long splitInput(string *richtext, TokenizerChunk *chunks,
+				unsigned long chunkCount);
+
+static unsigned long findChunkEnd(unsigned char *bytes, unsigned long start,
+				  unsigned long from, unsigned long length);
+
+static void initChunk(TokenizerChunk *chunk, string *richtext,
+		      bool caseInsensitiveCommands, bool isUtf8,
+		      TokenizerOptions *options, TokenizerState *previous);
+
+static void *tokenizeChunk(void *chunk);
+
+static void mergeChunks(TokenizerResult *result, TokenizerChunk *chunks,
+			unsigned long chunkCount, string *richtext,
+			bool isUtf8, TokenizerOptions *options);
+
+static void freeChunk(TokenizerChunk *chunk);
+
+#endif
 
 TokenizerResult *tokenize(richtext, caseInsensitiveCommands, isUtf8)
 string *richtext;
 bool caseInsensitiveCommands;
 bool isUtf8;
 {
-	unsigned long tokenCountEstimate;
+	return tokenizeWithOptions(richtext, caseInsensitiveCommands, isUtf8,
+				   NULL);
+}
+
+TokenizerResult *tokenizeWithOptions(richtext, caseInsensitiveCommands, isUtf8,
+				     options)
+string *richtext;
+bool caseInsensitiveCommands;
+bool isUtf8;
+TokenizerOptions *options;
+{
+	return tokenizeToSink(richtext, caseInsensitiveCommands, isUtf8,
+			      options, NULL, NULL);
+}
+
+TokenizerResult *tokenizeToSink(richtext, caseInsensitiveCommands, isUtf8,
+				options, sink, sinkContext)
+string *richtext;
+bool caseInsensitiveCommands;
+bool isUtf8;
+TokenizerOptions *options;
+TokenSink *sink;
+void *sinkContext;
+{
 	TokenizerResult *result = malloc(sizeof(TokenizerResult));
-	TokenizerResult *errorResult;
-	TokenVector *tokens;
-	TokenizerWarningVector *warnings = TokenizerWarningVector_new(0, 0);
-	Token token;
-	unsigned char *currentByte;
-	unsigned char nextByte;
-	unsigned long currentByteIndex;
-	unsigned long codepointIndex = 0;
-	unsigned long valueStartIndex = 0;
-	unsigned long whitespaceLength;
-	bool isInsideCommand;
-	bool caseInsensitive = caseInsensitiveCommands;
-	TextEncodingVector *encodingStack = NULL;
-	TextEncoding currentEncoding =
-	    isUtf8 ? TextEncoding_UTF8 : TextEncoding_US_ASCII;
-	TokenizerWarningCode WARN_UNEXPECTED_CONT_BYTE =
-	    TokenizerWarningCode_UNEXPECTED_UTF8_CONTINUATION_BYTE;
-	TokenizerWarningCode WARN_INVALID_CHARACTER =
-	    TokenizerWarningCode_INVALID_UTF8_CHARACTER;
-	TokenizerErrorCode errorCode = TokenizerErrorCode_OK;
+	TokenizerState state;
+	TokenizerErrorCode errorCode;
+	unsigned long tokenCountEstimate;
+	TokenVector *tokens = options != NULL && sink == NULL ?
+	    options->tokens : NULL;
 
 	if (richtext == NULL) {
-		TokenizerWarningVector_free(warnings);
 		if (result != NULL) {
 			free(result);
 		}
 		return NULL;
 	}
 	if (result == NULL) {
-		TokenizerWarningVector_free(warnings);
 		return NULL;
 	}
 
-	if (warnings == NULL) {
-		result->type = TokenizerResultType_ERROR;
-		result->result.error.byteIndex = 0;
-		result->result.error.codepointIndex = 0;
-		result->result.error.code =
-		    TokenizerErrorCode_OUT_OF_MEMORY_FOR_WARNINGS;
-		result->warnings = NULL;
+	result->valueViews = NULL;
+	result->lazyCodepointIndex = NULL;
+#if defined(RICHTEXT_THREADS)
+	if (options != NULL && options->threadCount > 1 && sink == NULL
+	    && tokenizeInParallel(result, richtext, caseInsensitiveCommands,
+				  isUtf8, options)) {
 		return result;
 	}
-
-	encodingStack = TextEncodingVector_new(0, 0);
-	if (encodingStack == NULL) {
+#endif
+	if (sink != NULL) {
+		tokenCountEstimate = 0;
+	} else if (options != NULL && options->presizeTokens) {
+		tokenCountEstimate = estimateTokenCount(richtext);
+	} else {
+		tokenCountEstimate = richtext->length / 1024;
+	}
+	errorCode =
+	    initState(&state, caseInsensitiveCommands, isUtf8,
+		      tokenCountEstimate, tokens);
+	if (errorCode != TokenizerErrorCode_OK) {
+		freeTokens(state.tokens);
 		result->type = TokenizerResultType_ERROR;
-		result->result.error.byteIndex = 0;
-		result->result.error.codepointIndex = 0;
-		result->result.error.code =
-		    TokenizerErrorCode_OUT_OF_MEMORY_FOR_ENCODING_STACK;
+		result->result.error = state.error;
+		result->warnings = state.warnings;
 		return result;
 	}
 
-	tokenCountEstimate = richtext->length / 1024;
-	tokens = TokenVector_new(0, tokenCountEstimate);
+	/* The whole input is available, so there is no need to copy it */
+	state.buffer = richtext->content;
+	state.bufferLength = richtext->length;
+	state.tokenSink = sink;
+	state.tokenSinkContext = sinkContext;
+	if (options != NULL && options->useValueViews) {
+		state.valueViews = &result->valueViews;
+	}
+	if (options != NULL) {
+		state.warningPolicy = options->warningPolicy;
+	}
+	if (options != NULL && options->lazyCodepointIndexes) {
+		result->lazyCodepointIndex =
+		    CodepointIndex_new(richtext->content, richtext->length,
+				       isUtf8);
+		if (result->lazyCodepointIndex == NULL) {
+			TextEncodingVector_free(state.encodingStack);
+			return finalizeToError(result, 0, 0,
+					       OOM_FOR_CODEPOINT_INDEX,
+					       state.warnings, state.tokens);
+		}
+		state.lazyCodepointIndex = result->lazyCodepointIndex;
+	}
+
+	errorCode = processInput(&state, true);
+	if (errorCode == TokenizerErrorCode_OK) {
+		errorCode = finishInput(&state);
+	}
+	TextEncodingVector_free(state.encodingStack);
+	if (state.lazyCodepointIndex != NULL) {
+		resolveCodepointIndexes(state.warnings, &state.error,
+					state.lazyCodepointIndex);
+	}
+
+	if (errorCode != TokenizerErrorCode_OK) {
+		return finalizeToError(result, state.error.byteIndex,
+				       state.error.codepointIndex, errorCode,
+				       state.warnings, state.tokens);
+	}
 
 	result->type = TokenizerResultType_SUCCESS;
-	result->result.tokens = tokens;
-	result->warnings = warnings;
+	result->result.tokens = state.tokens;
+	result->warnings = state.warnings;
+	return result;
+}
+
+unsigned long estimateTokenCount(richtext)
+string *richtext;
+{
+	if (richtext == NULL) {
+		return 0;
+	}
+
+	/*
+	 * Every whitespace and command token starts with a boundary byte, and
+	 * every text token is followed by one of them or by the end of input.
+	 */
+	return 2 * countBoundaryBytes(richtext->content, richtext->length) + 1;
+}
+
+TokenizerState *TokenizerState_new(caseInsensitiveCommands, isUtf8)
+bool caseInsensitiveCommands;
+bool isUtf8;
+{
+	TokenizerState *state = malloc(sizeof(TokenizerState));
+	if (state == NULL) {
+		return NULL;
+	}
+
+	if (initState(state, caseInsensitiveCommands, isUtf8, 0, NULL) !=
+	    TokenizerErrorCode_OK) {
+		TokenizerWarningVector_free(state->warnings);
+		TextEncodingVector_free(state->encodingStack);
+		free(state);
+		return NULL;
+	}
+	state->ownsBuffer = true;
+
+	return state;
+}
+
+TokenizerResult *TokenizerState_feed(state, chunk)
+TokenizerState *state;
+string *chunk;
+{
+	unsigned char *resizedBuffer;
+	unsigned long requiredCapacity;
+	unsigned long consumedLength;
+
+	if (state == NULL || chunk == NULL || state->isFinished) {
+		return NULL;
+	}
+
+	if (state->error.code != TokenizerErrorCode_OK) {
+		return takeResult(state);
+	}
+
+	requiredCapacity = state->bufferLength + chunk->length;
+	if (requiredCapacity > state->bufferCapacity) {
+		if (requiredCapacity < state->bufferCapacity * 2) {
+			requiredCapacity = state->bufferCapacity * 2;
+		}
+		resizedBuffer = realloc(state->buffer, requiredCapacity);
+		if (resizedBuffer == NULL) {
+			state->error.byteIndex =
+			    state->bufferByteIndex + state->bufferLength;
+			state->error.codepointIndex = state->codepointIndex;
+			state->error.code = TOKENIZER_OOM_FOR_INPUT_BUFFER;
+			return takeResult(state);
+		}
+		state->buffer = resizedBuffer;
+		state->bufferCapacity = requiredCapacity;
+	}
+	if (chunk->length > 0) {
+		memcpy(state->buffer + state->bufferLength, chunk->content,
+		       chunk->length);
+		state->bufferLength += chunk->length;
+	}
+
+	if (processInput(state, false) == TokenizerErrorCode_OK) {
+		/*
+		 * Only the input of the token that has not been completed yet
+		 * (and the bytes that could not be processed without the
+		 * following input) needs to be kept.
+		 */
+		consumedLength =
+		    state->token.byteIndex - state->bufferByteIndex;
+		if (consumedLength > 0) {
+			memmove(state->buffer, state->buffer + consumedLength,
+				state->bufferLength - consumedLength);
+			state->bufferLength -= consumedLength;
+			state->bufferByteIndex += consumedLength;
+			state->scanIndex -= consumedLength;
+		}
+	}
+
+	return takeResult(state);
+}
+
+TokenizerResult *TokenizerState_finish(state)
+TokenizerState *state;
+{
+	if (state == NULL || state->isFinished) {
+		return NULL;
+	}
+
+	state->isFinished = true;
+	if (state->error.code == TokenizerErrorCode_OK
+	    && processInput(state, true) == TokenizerErrorCode_OK) {
+		finishInput(state);
+	}
+
+	return takeResult(state);
+}
+
+void TokenizerState_free(state)
+TokenizerState *state;
+{
+	if (state == NULL) {
+		return;
+	}
+
+	if (state->ownsBuffer && state->buffer != NULL) {
+		free(state->buffer);
+	}
+	freeTokens(state->tokens);
+	TokenizerWarningVector_free(state->warnings);
+	TextEncodingVector_free(state->encodingStack);
+	free(state);
+}
+
+TokenVector *TokenizerResult_recycleTokens(result)
+TokenizerResult *result;
+{
+	TokenVector *tokens;
+	Token *token;
+	unsigned long i;
+
+	if (result == NULL || result->type != TokenizerResultType_SUCCESS
+	    || result->result.tokens == NULL) {
+		return NULL;
+	}
+
+	tokens = result->result.tokens;
+	for (token = tokens->items, i = 0; i < tokens->size.length;
+	     i++, token++) {
+		if (!token->isValueView) {
+			string_free(token->value);
+		}
+	}
+	tokens->size.length = 0;
+	result->result.tokens = NULL;
+
+	return tokens;
+}
+
+void TokenValueViewBlock_free(valueViews)
+TokenValueViewBlock *valueViews;
+{
+	TokenValueViewBlock *previous;
+
+	while (valueViews != NULL) {
+		previous = valueViews->previous;
+		free(valueViews);
+		valueViews = previous;
+	}
+}
+
+void TokenizerResult_free(result)
+TokenizerResult *result;
+{
+	if (result == NULL) {
+		return;
+	}
+
+	TokenizerWarningVector_free(result->warnings);
+	CodepointIndex_free(result->lazyCodepointIndex);
+
+	switch (result->type) {
+	case TokenizerResultType_SUCCESS:
+		freeTokens(result->result.tokens);
+		break;
+	case TokenizerResultType_ERROR:
+		break;
+	default:
+		break;
+	}
+	TokenValueViewBlock_free(result->valueViews);
+
+	free(result);
+}
+
+static TokenizerErrorCode initState(state, caseInsensitiveCommands, isUtf8,
+				    tokenCountEstimate, tokens)
+TokenizerState *state;
+bool caseInsensitiveCommands;
+bool isUtf8;
+unsigned long tokenCountEstimate;
+TokenVector *tokens;
+{
+	state->buffer = NULL;
+	state->bufferLength = 0;
+	state->bufferCapacity = 0;
+	state->bufferByteIndex = 0;
+	state->ownsBuffer = false;
+	state->scanIndex = 0;
+	state->codepointIndex = 0;
+	state->token.byteIndex = 0;
+	state->token.codepointIndex = 0;
+	state->token.type = TokenType_TEXT;
+	state->isInsideCommand = false;
+	state->caseInsensitiveCommands = caseInsensitiveCommands;
+	state->currentEncoding =
+	    isUtf8 ? TextEncoding_UTF8 : TextEncoding_US_ASCII;
+	state->encodingStack = NULL;
+	state->tokens = tokens;
+	state->tokenSink = NULL;
+	state->tokenSinkContext = NULL;
+	state->valueViews = NULL;
+	state->lazyCodepointIndex = NULL;
+	state->warningPolicy.type = WarningPolicyType_RECORD_ALL;
+	state->warningPolicy.limit = 0;
+	state->isFinished = false;
+	state->error.byteIndex = 0;
+	state->error.codepointIndex = 0;
+	state->error.code = TokenizerErrorCode_OK;
+
+	state->warnings = TokenizerWarningVector_new(0, 0);
+	if (state->warnings == NULL) {
+		state->error.code =
+		    TokenizerErrorCode_OUT_OF_MEMORY_FOR_WARNINGS;
+		return state->error.code;
+	}
+
+	state->encodingStack = TextEncodingVector_new(0, 0);
+	if (state->encodingStack == NULL) {
+		state->error.code =
+		    TokenizerErrorCode_OUT_OF_MEMORY_FOR_ENCODING_STACK;
+		return state->error.code;
+	}
 
 	if (tokens == NULL) {
-		TokenizerErrorCode oomErrorCode =
-		    TokenizerErrorCode_OUT_OF_MEMORY_FOR_TOKENS;
-		return finalizeToError(result, 0, 0, oomErrorCode, warnings,
-				       NULL);
+		state->tokens = TokenVector_new(0, tokenCountEstimate);
+	} else if (TokenVector_grow(tokens, tokenCountEstimate) == NULL) {
+		state->tokens = NULL;
+	}
+	if (state->tokens == NULL) {
+		/* A vector that could not be grown is freed by the caller */
+		state->tokens = tokens;
+		state->error.code = TokenizerErrorCode_OUT_OF_MEMORY_FOR_TOKENS;
+		TextEncodingVector_free(state->encodingStack);
+		state->encodingStack = NULL;
+		return state->error.code;
 	}
 
-	token.byteIndex = 0;
-	token.codepointIndex = 0;
-	token.type = TokenType_TEXT;
+	return TokenizerErrorCode_OK;
+}
 
-	for (currentByte = richtext->content,
-	     currentByteIndex = 0,
-	     isInsideCommand = false;
-	     currentByteIndex < richtext->length;
+static TokenizerErrorCode processInput(state, isFinal)
+TokenizerState *state;
+bool isFinal;
+{
+	string input;
+	Token *token = &state->token;
+	bool caseInsensitive = state->caseInsensitiveCommands;
+	unsigned long offset = state->bufferByteIndex;
+	unsigned char *currentByte;
+	unsigned char nextByte;
+	unsigned long currentByteIndex;
+	unsigned long codepointIndex = state->codepointIndex;
+	unsigned long valueStartIndex = 0;
+	unsigned long whitespaceLength;
+	unsigned long plainTextLength;
+	unsigned long plainTextCodepoints = 0;
+	unsigned long sequenceLength;
+	bool isWellFormed;
+	TokenizerWarningCode WARN_UNEXPECTED_CONT_BYTE =
+	    TokenizerWarningCode_UNEXPECTED_UTF8_CONTINUATION_BYTE;
+	TokenizerWarningCode WARN_INVALID_CHARACTER =
+	    TokenizerWarningCode_INVALID_UTF8_CHARACTER;
+	TokenizerErrorCode errorCode = TokenizerErrorCode_OK;
+	/* The codepoint indexes stay 0 if they are computed lazily */
+	unsigned long codepointStep = state->lazyCodepointIndex == NULL ? 1 : 0;
+	unsigned long *countedCodepoints =
+	    state->lazyCodepointIndex == NULL ? &plainTextCodepoints : NULL;
+
+	input.content = state->buffer;
+	input.length = state->bufferLength;
+
+	/*
+	   The indexes into the input are relative to the start of the buffer,
+	   while the token's byteIndex is absolute.
+	 */
+	for (currentByteIndex = state->scanIndex,
+	     currentByte = input.content + currentByteIndex;
+	     currentByteIndex < input.length;
 	     currentByteIndex++, currentByte++) {
+		if (!isFinal
+		    && input.length - currentByteIndex <
+		    getRequiredInputLength(*currentByte,
+					   state->currentEncoding)) {
+			/* Wait for the rest of the input to arrive */
+			break;
+		}
+
 		switch (*currentByte) {
 		case '<':
-			if (isInsideCommand) {
+			if (state->isInsideCommand) {
 				errorCode =
 				    TokenizerErrorCode_UNEXPECTED_COMMAND_START;
 				break;
 			}
-			isInsideCommand = true;
+			state->isInsideCommand = true;
 
-			if (currentByteIndex > token.byteIndex) {
+			if (offset + currentByteIndex > token->byteIndex) {
 				errorCode =
-				    addToken(&tokens, &token, richtext,
-					     token.byteIndex, currentByteIndex,
-					     currentEncoding);
+				    addToken(state, &input,
+					     token->byteIndex - offset,
+					     currentByteIndex);
 				if (errorCode != TokenizerErrorCode_OK) {
 					break;
 				}
-				token.codepointIndex = codepointIndex;
+				token->codepointIndex = codepointIndex;
 			}
 
 			nextByte =
 			    currentByteIndex + 1 <
-			    richtext->length ? *(currentByte + 1) : 0;
-			token.type = nextByte == '/' ?
+			    input.length ? *(currentByte + 1) : 0;
+			token->type = nextByte == '/' ?
 			    TokenType_COMMAND_END : TokenType_COMMAND_START;
-			token.byteIndex = currentByteIndex;
-			codepointIndex++;
+			token->byteIndex = offset + currentByteIndex;
+			codepointIndex += codepointStep;
 			break;
 		case '>':
-			if (isInsideCommand) {
-				isInsideCommand = false;
-				valueStartIndex = token.byteIndex +
-				    (token.type ==
+			if (state->isInsideCommand) {
+				state->isInsideCommand = false;
+				valueStartIndex = token->byteIndex - offset +
+				    (token->type ==
 				     TokenType_COMMAND_END ? 2 : 1);
 				errorCode =
-				    addToken(&tokens, &token, richtext,
-					     valueStartIndex, currentByteIndex,
-					     currentEncoding);
+				    addToken(state, &input, valueStartIndex,
+					     currentByteIndex);
 				if (errorCode != TokenizerErrorCode_OK) {
 					break;
 				}
 				errorCode =
-				    updateEncodingStack(&encodingStack,
-							&currentEncoding,
-							&token,
-							caseInsensitive);
+				    updateEncodingStack(&state->encodingStack,
+							&state->currentEncoding,
+							token, caseInsensitive);
+				if (errorCode != TokenizerErrorCode_OK) {
+					break;
+				}
+				errorCode = recordEncoding(state, offset +
+							   currentByteIndex + 1);
 				if (errorCode != TokenizerErrorCode_OK) {
 					break;
 				}
 
-				token.byteIndex = currentByteIndex + 1;
-				token.codepointIndex = codepointIndex + 1;
-				token.type = TokenType_TEXT;
+				token->byteIndex =
+				    offset + currentByteIndex + 1;
+				token->codepointIndex =
+				    codepointIndex + codepointStep;
+				token->type = TokenType_TEXT;
 			}
-			codepointIndex++;
+			codepointIndex += codepointStep;
 			break;
 		default:
 			/*
@@ -218,103 +668,129 @@ bool isUtf8;
 			 */
 
 			/*
-			   Note: overlong character encodings are not supported
-			   because they are not valid UTF-8 representations of a
-			   code point.
+			   Note: overlong character encodings, surrogates and
+			   codepoints above U+10FFFF are reported as invalid
+			   characters because they are not valid UTF-8
+			   representations of a code point.
 			 */
 
+			/*
+			   Runs of characters that are neither whitespace nor
+			   command delimiters only advance the codepoint index,
+			   so we skip over them in blocks. The UTF-8 characters
+			   are validated and counted by the same kernel.
+			 */
+			if (state->currentEncoding == TextEncoding_UTF8) {
+				plainTextLength =
+				    getUtf8TextLength(currentByte,
+						      input.length -
+						      currentByteIndex,
+						      countedCodepoints);
+			} else {
+				plainTextLength =
+				    getPlainTextLength(currentByte,
+						       input.length -
+						       currentByteIndex);
+				plainTextCodepoints = plainTextLength;
+			}
+			if (plainTextLength > 0) {
+				currentByteIndex += plainTextLength - 1;
+				currentByte += plainTextLength - 1;
+				codepointIndex +=
+				    plainTextCodepoints * codepointStep;
+				break;
+			}
+
 			whitespaceLength =
-			    getWhitespaceLength(richtext, currentByteIndex,
-						currentEncoding ==
+			    getWhitespaceLength(currentByte,
+						input.length - currentByteIndex,
+						state->currentEncoding ==
 						TextEncoding_UTF8);
 
-			if (!isInsideCommand && whitespaceLength > 0) {
-				if (currentByteIndex > token.byteIndex) {
+			if (!state->isInsideCommand && whitespaceLength > 0) {
+				if (offset + currentByteIndex >
+				    token->byteIndex) {
 					TokenizerErrorCode errorOk =
 					    TokenizerErrorCode_OK;
 					errorCode =
-					    addToken(&tokens, &token, richtext,
-						     token.byteIndex,
-						     currentByteIndex,
-						     currentEncoding);
+					    addToken(state, &input,
+						     token->byteIndex - offset,
+						     currentByteIndex);
 					if (errorCode != errorOk) {
 						break;
 					}
-					token.codepointIndex = codepointIndex;
+					token->codepointIndex = codepointIndex;
 				}
 
-				token.byteIndex = currentByteIndex;
-				token.type = TokenType_WHITESPACE;
+				token->byteIndex = offset + currentByteIndex;
+				token->type = TokenType_WHITESPACE;
 				errorCode =
-				    addToken(&tokens, &token, richtext,
-					     token.byteIndex,
+				    addToken(state, &input, currentByteIndex,
 					     currentByteIndex +
-					     whitespaceLength, currentEncoding);
+					     whitespaceLength);
 				if (errorCode != TokenizerErrorCode_OK) {
 					break;
 				}
 
-				token.byteIndex =
-				    currentByteIndex + whitespaceLength;
-				token.codepointIndex = codepointIndex + 1;
+				token->byteIndex = offset + currentByteIndex +
+				    whitespaceLength;
+				token->codepointIndex =
+				    codepointIndex + codepointStep;
 				if (*currentByte < 128) {
 					if (whitespaceLength > 1) {
 						/* CRLF */
-						token.codepointIndex +=
-						    whitespaceLength - 1;
+						token->codepointIndex +=
+						    codepointStep;
 					}
 				}
-				token.type = TokenType_TEXT;
+				token->type = TokenType_TEXT;
 			}
 
-			if (currentEncoding != TextEncoding_UTF8) {
-				/* Nothing to do for single-byte encodings */
-			} else if (*currentByte < 128) {
-				/* single-byte UTF-8 codepoints */
+			if (*currentByte < 128) {
+				/* single-byte codepoints in all encodings */
 				if (whitespaceLength > 1) {	/* CRLF */
 					currentByteIndex +=
 					    whitespaceLength - 1;
 					currentByte += whitespaceLength - 1;
-					codepointIndex += whitespaceLength - 1;
+					codepointIndex += codepointStep;
 				}
+			} else if (state->currentEncoding != TextEncoding_UTF8) {
+				/* Nothing to do for single-byte encodings */
 			} else if (*currentByte <= 192) {
 				/* unexpected continuation byte */
-				errorResult =
-				    addWarning(result, &warnings, tokens,
-					       currentByteIndex,
+				errorCode =
+				    addWarning(state,
+					       offset + currentByteIndex,
 					       codepointIndex,
 					       WARN_UNEXPECTED_CONT_BYTE);
-				if (errorResult != NULL) {
-					return errorResult;
-				}
-			} else if (*currentByte <= 223) {
-				/* Two-byte UTF-8 codepoints */
-				/* Skip over the continuation byte */
-				currentByteIndex++;
-				currentByte++;
-			} else if (*currentByte <= 239) {
-				/* Three-byte UTF-8 codepoints */
-				/* Skip over the continuation bytes */
-				currentByteIndex += 2;
-				currentByte += 2;
-			} else if (*currentByte <= 247) {
-				/* Four-byte UTF-8 codepoints */
-				/* Skip over the continuation bytes */
-				currentByteIndex += 3;
-				currentByte += 3;
 			} else {
-				/* Invalid UTF-8 character */
-				errorResult =
-				    addWarning(result, &warnings, tokens,
-					       currentByteIndex,
-					       codepointIndex,
-					       WARN_INVALID_CHARACTER);
-				if (errorResult != NULL) {
-					return errorResult;
+				/*
+				   Multi-byte UTF-8 codepoints, an ill-formed
+				   sequence is skipped as a single (invalid)
+				   character.
+				 */
+				sequenceLength =
+				    getUtf8SequenceLength(currentByte,
+							  input.length -
+							  currentByteIndex,
+							  &isWellFormed);
+				if (!isWellFormed) {
+					errorCode =
+					    addWarning(state,
+						       offset +
+						       currentByteIndex,
+						       codepointIndex,
+						       WARN_INVALID_CHARACTER);
 				}
+				/* Skip over the continuation bytes */
+				currentByteIndex += sequenceLength - 1;
+				currentByte += sequenceLength - 1;
+			}
+			if (errorCode != TokenizerErrorCode_OK) {
+				break;
 			}
 
-			codepointIndex++;
+			codepointIndex += codepointStep;
 
 			break;
 		}
@@ -324,55 +800,140 @@ bool isUtf8;
 		}
 	}
 
-	if (errorCode == TokenizerErrorCode_OK
-	    && token.byteIndex < richtext->length) {
-		if (isInsideCommand) {
+	state->scanIndex = currentByteIndex;
+	state->codepointIndex = codepointIndex;
+	if (errorCode != TokenizerErrorCode_OK) {
+		state->error.byteIndex = offset + currentByteIndex;
+		state->error.codepointIndex = codepointIndex;
+		state->error.code = errorCode;
+	}
+
+	return errorCode;
+}
+
+static TokenizerErrorCode finishInput(state)
+TokenizerState *state;
+{
+	string input;
+	unsigned long offset = state->bufferByteIndex;
+	TokenizerErrorCode errorCode = TokenizerErrorCode_OK;
+
+	input.content = state->buffer;
+	input.length = state->bufferLength;
+
+	if (state->token.byteIndex < offset + input.length) {
+		if (state->isInsideCommand) {
 			errorCode = TokenizerErrorCode_UNTERMINATED_COMMAND;
 		} else {
-			token.value =
-			    string_substring(richtext, token.byteIndex,
-					     richtext->length);
-			tokens = TokenVector_append(tokens, &token);
+			errorCode =
+			    addToken(state, &input,
+				     state->token.byteIndex - offset,
+				     input.length);
 		}
 	}
 
 	if (errorCode != TokenizerErrorCode_OK) {
-		return finalizeToError(result, currentByteIndex, codepointIndex,
-				       errorCode, warnings, tokens);
+		state->error.byteIndex = offset + state->scanIndex;
+		state->error.codepointIndex = state->codepointIndex;
+		state->error.code = errorCode;
 	}
 
-	result->result.tokens = (TokenVector *) tokens;
-	result->warnings = (TokenizerWarningVector *) warnings;
-	return result;
+	return errorCode;
 }
 
-void TokenizerResult_free(result)
-TokenizerResult *result;
+/*
+ * Fills in the codepoint indexes of the warnings and of the error using the
+ * codepoint index of the input, since the tokenizer did not count them.
+ */
+static void resolveCodepointIndexes(warnings, error, codepointIndex)
+TokenizerWarningVector *warnings;
+TokenizerError *error;
+CodepointIndex *codepointIndex;
 {
+	TokenizerWarning *warning;
+	unsigned long i;
+
+	if (warnings != NULL) {
+		for (warning = warnings->items, i = 0;
+		     i < warnings->size.length; i++, warning++) {
+			warning->codepointIndex =
+			    CodepointIndex_of(codepointIndex,
+					      warning->byteIndex);
+			warning->lastCodepointIndex =
+			    CodepointIndex_of(codepointIndex,
+					      warning->lastByteIndex);
+		}
+	}
+	error->codepointIndex =
+	    CodepointIndex_of(codepointIndex, error->byteIndex);
+}
+
+static TokenizerResult *takeResult(state)
+TokenizerState *state;
+{
+	TokenizerResult *result = malloc(sizeof(TokenizerResult));
 	if (result == NULL) {
-		return;
+		return NULL;
 	}
 
-	TokenizerWarningVector_free(result->warnings);
+	result->valueViews = NULL;
+	result->lazyCodepointIndex = NULL;
+	result->warnings = state->warnings;
+	state->warnings = TokenizerWarningVector_new(0, 0);
 
-	switch (result->type) {
-	case TokenizerResultType_SUCCESS:
-		freeTokens(result->result.tokens);
-		break;
-	case TokenizerResultType_ERROR:
-		break;
-	default:
-		break;
+	if (state->error.code != TokenizerErrorCode_OK) {
+		freeTokens(state->tokens);
+		state->tokens = NULL;
+		result->type = TokenizerResultType_ERROR;
+		result->result.error = state->error;
+		return result;
 	}
 
-	free(result);
+	result->type = TokenizerResultType_SUCCESS;
+	result->result.tokens = state->tokens;
+	state->tokens = TokenVector_new(0, 0);
+
+	/* The failure will be reported by the next call */
+	if (state->warnings == NULL) {
+		state->error.code =
+		    TokenizerErrorCode_OUT_OF_MEMORY_FOR_WARNINGS;
+	} else if (state->tokens == NULL) {
+		state->error.code = TokenizerErrorCode_OUT_OF_MEMORY_FOR_TOKENS;
+	}
+	if (state->error.code != TokenizerErrorCode_OK) {
+		state->error.byteIndex =
+		    state->bufferByteIndex + state->scanIndex;
+		state->error.codepointIndex = state->codepointIndex;
+	}
+
+	return result;
 }
 
-static TokenizerResult *addWarning(result, warnings, tokens, byteIndex,
-				   codepointIndex, code)
-TokenizerResult *result;
-TokenizerWarningVector **warnings;
-TokenVector *tokens;
+static unsigned long getRequiredInputLength(byte, encoding)
+unsigned char byte;
+TextEncoding encoding;
+{
+	switch (byte) {
+	case '<':		/* distinguishing command starts and ends */
+	case '\r':		/* CRLF */
+		return 2;
+	}
+
+	if (encoding != TextEncoding_UTF8 || byte <= 192) {
+		return 1;
+	} else if (byte <= 223) {
+		return 2;
+	} else if (byte <= 239) {
+		return 3;
+	} else if (byte <= 247) {
+		return 4;
+	}
+
+	return 1;
+}
+
+static TokenizerErrorCode addWarning(state, byteIndex, codepointIndex, code)
+TokenizerState *state;
 unsigned long byteIndex;
 unsigned long codepointIndex;
 TokenizerWarningCode code;
@@ -382,14 +943,35 @@ TokenizerWarningCode code;
 	warning.byteIndex = byteIndex;
 	warning.codepointIndex = codepointIndex;
 	warning.code = code;
-	resizedWarnings = TokenizerWarningVector_append(*warnings, &warning);
+	warning.count = 1;
+	warning.lastByteIndex = byteIndex;
+	warning.lastCodepointIndex = codepointIndex;
+	resizedWarnings = (TokenizerWarningVector *)
+	    WarningPolicy_record(&state->warningPolicy,
+				 (Vector *) state->warnings, &warning,
+				 mergeWarnings);
 	if (resizedWarnings != NULL) {
-		*warnings = resizedWarnings;
-		return NULL;
+		state->warnings = resizedWarnings;
+		return TokenizerErrorCode_OK;
+	}
+	return TokenizerErrorCode_OUT_OF_MEMORY_FOR_WARNINGS;
+}
+
+static bool mergeWarnings(recordedWarning, warning)
+void *recordedWarning;
+const void *warning;
+{
+	TokenizerWarning *recorded = recordedWarning;
+	const TokenizerWarning *merged = warning;
+
+	if (recorded->code != merged->code) {
+		return false;
 	}
-	return finalizeToError(result, byteIndex, codepointIndex,
-			       TokenizerErrorCode_OUT_OF_MEMORY_FOR_WARNINGS,
-			       *warnings, tokens);
+
+	recorded->count += merged->count;
+	recorded->lastByteIndex = merged->lastByteIndex;
+	recorded->lastCodepointIndex = merged->lastCodepointIndex;
+	return true;
 }
 
 static TokenizerResult *finalizeToError(result, byteIndex, codepointIndex,
@@ -402,6 +984,8 @@ TokenizerWarningVector *warnings;
 TokenVector *tokens;
 {
 	freeTokens(tokens);
+	TokenValueViewBlock_free(result->valueViews);
+	result->valueViews = NULL;
 	result->type = TokenizerResultType_ERROR;
 	result->result.error.byteIndex = byteIndex;
 	result->result.error.codepointIndex = codepointIndex;
@@ -410,170 +994,130 @@ TokenVector *tokens;
 	return result;
 }
 
-static TokenizerErrorCode addToken(tokens, token, input, valueStartIndex,
-				   valueEndIndex, valueEncoding)
-TokenVector **tokens;
-Token *token;
+static TokenizerErrorCode addToken(state, input, valueStartIndex,
+				   valueEndIndex)
+TokenizerState *state;
 string *input;
 unsigned long valueStartIndex;
 unsigned long valueEndIndex;
-TextEncoding valueEncoding;
 {
+	Token *token = &state->token;
+	TextEncoding valueEncoding = state->currentEncoding;
+	TokenValueViewBlock **valueViews = state->valueViews;
 	TokenVector *resizedTokens;
-	string *tokenValue;
-
-	tokenValue = string_substring(input, valueStartIndex, valueEndIndex);
-	if (tokenValue == NULL) {
-		return TokenizerErrorCode_OUT_OF_MEMORY_FOR_SUBSTRING;
+	string rawValue;
+	bool needsTranscoding;
+
+	rawValue.content = input->content + valueStartIndex;
+	rawValue.length = valueEndIndex - valueStartIndex;
+
+	/*
+	 * All supported single-byte encodings match UTF-8 in the 7-bit range,
+	 * so such values can be referenced as they are.
+	 */
+	needsTranscoding = valueEncoding != TextEncoding_UTF8
+	    && (valueViews == NULL
+		|| !isAsciiOnly(rawValue.content, rawValue.length));
+
+	if (needsTranscoding) {
+		token->value = transcodeToUtf8(&rawValue, valueEncoding);
+		token->isValueView = false;
+		if (token->value == NULL) {
+			return TokenizerErrorCode_TEXT_DECODING_FAILURE;
+		}
+	} else if (valueViews != NULL) {
+		token->value = newValueView(valueViews, input, valueStartIndex,
+					    valueEndIndex);
+		token->isValueView = true;
+		if (token->value == NULL) {
+			return TokenizerErrorCode_OUT_OF_MEMORY_FOR_SUBSTRING;
+		}
+	} else {
+		token->value =
+		    string_substring(input, valueStartIndex, valueEndIndex);
+		token->isValueView = false;
+		if (token->value == NULL) {
+			return TokenizerErrorCode_OUT_OF_MEMORY_FOR_SUBSTRING;
+		}
 	}
 
-	if (valueEncoding == TextEncoding_UTF8) {
-		token->value = tokenValue;
+	if (token->type == TokenType_COMMAND_START
+	    || token->type == TokenType_COMMAND_END) {
+		token->commandId = CommandId_fromName(token->value);
 	} else {
-		token->value = transcodeToUtf8(tokenValue, valueEncoding);
-		string_free(tokenValue);
-		if (token->value == NULL) {
-			return TokenizerErrorCode_TEXT_DECODING_FAILURE;
+		token->commandId = CommandId_NONE;
+	}
+
+	if (state->tokenSink != NULL) {
+		state->tokenSink(token, state->tokenSinkContext);
+		if (token->value != NULL && !token->isValueView) {
+			string_free(token->value);
 		}
+		token->value = NULL;
+		return TokenizerErrorCode_OK;
 	}
 
-	resizedTokens = TokenVector_append(*tokens, token);
+	resizedTokens = TokenVector_append(state->tokens, token);
 	if (resizedTokens == NULL) {
+		if (!token->isValueView) {
+			string_free(token->value);
+		}
 		return TokenizerErrorCode_OUT_OF_MEMORY_FOR_TOKENS;
 	}
-	*tokens = resizedTokens;
+	state->tokens = resizedTokens;
 
 	return TokenizerErrorCode_OK;
 }
 
-static void freeTokens(tokens)
-TokenVector *tokens;
+static string *newValueView(valueViews, input, valueStartIndex, valueEndIndex)
+TokenValueViewBlock **valueViews;
+string *input;
+unsigned long valueStartIndex;
+unsigned long valueEndIndex;
 {
-	Token *token;
-	unsigned long i = 0;
+	TokenValueViewBlock *block = *valueViews;
+	string *view;
 
-	if (tokens == NULL) {
-		return;
+	if (block == NULL || block->length == TOKEN_VALUE_VIEW_BLOCK_CAPACITY) {
+		block = malloc(sizeof(TokenValueViewBlock));
+		if (block == NULL) {
+			return NULL;
+		}
+		block->previous = *valueViews;
+		block->length = 0;
+		*valueViews = block;
 	}
 
-	for (token = tokens->items; i < tokens->size.length; i++, token++) {
-		string_free(token->value);
-	}
-	TokenVector_free(tokens);
+	view = block->views + block->length;
+	block->length++;
+	view->content = input->content + valueStartIndex;
+	view->length = valueEndIndex - valueStartIndex;
+	return view;
 }
 
-static unsigned long getWhitespaceLength(input, index, isUtf8)
-string *input;
-unsigned long index;
-bool isUtf8;
+static bool isAsciiOnly(content, length)
+unsigned char *content;
+unsigned long length;
 {
-	unsigned char *start;
-	unsigned char byte1, byte2, byte3;
-
-	if (index >= input->length) {
-		return 0;
-	}
-
-	start = (input->content + index);
-	byte1 = *start;
-	byte2 = index < input->length - 1 ? *(start + 1) : 0;
-	byte3 = index < input->length - 2 ? *(start + 2) : 0;
+	return getAsciiLength(content, length) == length;
+}
 
-	switch (byte1) {
-	case ' ':
-	case '\t':		/* horizontal tab */
-	case '\n':		/* newline */
-	case '\v':		/* vertical tab */
-	case '\f':		/* form feed, use <np> instead in richtext */
-		return 1;
-	case '\r':		/* carriage return */
-		/*
-		 * Treat for CRLF as a single whitespace token because it is
-		 * meant to be formatted as a single space character.
-		 */
-		return byte2 == '\n' ? 2 : 1;
-	}
+static void freeTokens(tokens)
+TokenVector *tokens;
+{
+	Token *token;
+	unsigned long i = 0;
 
-	if (!isUtf8) {
-		/* ISO-8859-* has only one extra white-space above 127 */
-		if (byte1 == 160) {	/* Non-breaking space */
-			return 1;
-		}
-		return 0;
+	if (tokens == NULL) {
+		return;
 	}
 
-	/* See https://en.wikipedia.org/wiki/Whitespace_character#Unicode */
-
-	if (byte1 < 128) {
-		/* single-byte UTF-8 codepoints */
-		return 0;
-	} else if (byte1 <= 192) {
-		/* unexpected continuation byte */
-		return 0;
-	} else if (byte1 <= 223) {
-		/* Two-byte UTF-8 codepoints */
-		if (byte1 == 194) {
-			switch (byte2) {
-			case 133:	/* next line */
-			case 160:	/* no-break space */
-				return 2;
-			}
-		}
-	} else if (byte1 <= 239) {
-		/* Three-byte UTF-8 codepoints */
-		switch (byte1) {
-		case 225:
-			switch (byte2) {
-			case 154:
-				/* ogham space mark */
-				return byte3 == 128 ? 3 : 0;
-			}
-			break;
-		case 226:
-			switch (byte2) {
-			case 128:
-				switch (byte3) {
-				case 128:	/* en quad */
-				case 129:	/* em quad */
-				case 130:	/* en space */
-				case 131:	/* em space */
-				case 132:	/* three-per-em space */
-				case 133:	/* four-per-em space */
-				case 134:	/* six-per-em space */
-				case 135:	/* figure space */
-				case 136:	/* punctuation space */
-				case 137:	/* thin space */
-				case 138:	/* hair space */
-				case 168:	/* line separator, use <nl> instead in richtext */
-				case 169:	/* paragraph separator,use <Paragraph> instead in richtext */
-				case 175:	/* narrow no-break space */
-					return 3;
-				}
-				break;
-			case 129:
-				switch (byte3) {
-				case 159:	/* medium mathematical space */
-					return 3;
-				}
-				break;
-			}
-			break;
-		case 227:
-			switch (byte2) {
-			case 128:
-				switch (byte3) {
-				case 128:	/* ideographic space */
-					return 3;
-				}
-				break;
-			}
-			break;
+	for (token = tokens->items; i < tokens->size.length; i++, token++) {
+		if (!token->isValueView) {
+			string_free(token->value);
 		}
 	}
-	/* There are no four-byte UTF-8 codepoints for whitespace */
-	/* We also ignore invalid UTF-8 characters (byte1 > 247) here */
-
-	return 0;
+	TokenVector_free(tokens);
 }
 
 static TokenizerErrorCode updateEncodingStack(encodingStack, currentEncoding,
@@ -616,68 +1160,66 @@ bool caseInsensitiveCommands;
 	return TokenizerErrorCode_OK;
 }
 
+static TokenizerErrorCode recordEncoding(state, byteIndex)
+TokenizerState *state;
+unsigned long byteIndex;
+{
+	if (state->lazyCodepointIndex == NULL) {
+		return TokenizerErrorCode_OK;
+	}
+
+	if (!CodepointIndex_setEncoding(state->lazyCodepointIndex, byteIndex,
+					state->currentEncoding ==
+					TextEncoding_UTF8)) {
+		return OOM_FOR_CODEPOINT_INDEX;
+	}
+	return TokenizerErrorCode_OK;
+}
+
 static TextEncoding tokenToEncoding(token, caseInsensitive)
 Token *token;
 bool caseInsensitive;
 {
-	unsigned char encodingValue[11];
-	string encoding;
-	unsigned char codepage;
-
 	if (token == NULL) {
 		return TextEncoding_UNKNOWN;
 	}
 
-	encoding.content = encodingValue;
-
-	encodingValue[0] = 'U';
-	encodingValue[1] = 'S';
-	encodingValue[2] = '-';
-	encodingValue[3] = 'A';
-	encodingValue[4] = 'S';
-	encodingValue[5] = 'C';
-	encodingValue[6] = 'I';
-	encodingValue[7] = 'I';
-	encoding.length = 8;
-
-	if (string_equals(token->value, &encoding, caseInsensitive)) {
+	switch (CommandId_resolve(token->commandId, caseInsensitive)) {
+	case CommandId_US_ASCII:
 		return TextEncoding_US_ASCII;
+	case CommandId_ISO_8859_1:
+		return TextEncoding_ISO_8859_1;
+	case CommandId_ISO_8859_2:
+		return TextEncoding_ISO_8859_2;
+	case CommandId_ISO_8859_3:
+		return TextEncoding_ISO_8859_3;
+	case CommandId_ISO_8859_4:
+		return TextEncoding_ISO_8859_4;
+	case CommandId_ISO_8859_5:
+		return TextEncoding_ISO_8859_5;
+	case CommandId_ISO_8859_6:
+		return TextEncoding_ISO_8859_6;
+	case CommandId_ISO_8859_7:
+		return TextEncoding_ISO_8859_7;
+	case CommandId_ISO_8859_8:
+		return TextEncoding_ISO_8859_8;
+	case CommandId_ISO_8859_9:
+		return TextEncoding_ISO_8859_9;
+	case CommandId_ISO_8859_10:
+		return TextEncoding_ISO_8859_10;
+	case CommandId_ISO_8859_11:
+		return TextEncoding_ISO_8859_11;
+	case CommandId_ISO_8859_13:
+		return TextEncoding_ISO_8859_13;
+	case CommandId_ISO_8859_14:
+		return TextEncoding_ISO_8859_14;
+	case CommandId_ISO_8859_15:
+		return TextEncoding_ISO_8859_15;
+	case CommandId_ISO_8859_16:
+		return TextEncoding_ISO_8859_16;
+	default:
+		return TextEncoding_UNKNOWN;
 	}
-
-	encodingValue[0] = 'I';
-	encodingValue[1] = 'S';
-	encodingValue[2] = 'O';
-	encodingValue[3] = '-';
-	encodingValue[4] = '8';
-	encodingValue[5] = '8';
-	encodingValue[6] = '5';
-	encodingValue[7] = '9';
-	encodingValue[8] = '-';
-	encoding.length = 10;
-
-	for (codepage = 1; codepage <= 9; codepage++) {
-		encodingValue[9] = '0' + codepage;
-		if (string_equals(token->value, &encoding, caseInsensitive)) {
-			return TextEncoding_ISO_8859_1 + codepage - 1;
-		}
-	}
-
-	encodingValue[9] = '1';
-	encoding.length = 11;
-	for (codepage = 0; codepage <= 6; codepage++) {
-		if (codepage == 2) {
-			continue;
-		}
-
-		encodingValue[10] = '0' + codepage;
-		if (string_equals(token->value, &encoding, caseInsensitive)) {
-			return TextEncoding_ISO_8859_10 + codepage - (codepage >
-								      2 ? 1 :
-								      0);
-		}
-	}
-
-	return TextEncoding_UNKNOWN;
 }
 
 static string *transcodeToUtf8(input, inputEncoding)
@@ -742,16 +1284,429 @@ TextEncoding inputEncoding;
 	return transcodeSingleByteEncodedTextToUtf8(encoding, input);
 }
 
-static bool string_equals(string1, string2, caseInsensitive)
-string *string1;
-string *string2;
-bool caseInsensitive;
+#if defined(RICHTEXT_THREADS)
+
+/*
+ * Tokenizes the input split into chunks concurrently, producing the same
+ * result as the serial tokenizer. Returns false (leaving the result
+ * untouched) if the input is too short or cannot be split, in which case the
+ * input should be tokenized serially.
+ */
+static bool tokenizeInParallel(result, richtext, caseInsensitiveCommands,
+			       isUtf8, options)
+TokenizerResult *result;
+string *richtext;
+bool caseInsensitiveCommands;
+bool isUtf8;
+TokenizerOptions *options;
+{
+	TextEncoding initialEncoding =
+	    isUtf8 ? TextEncoding_UTF8 : TextEncoding_US_ASCII;
+	TokenizerChunk *chunks;
+	TokenizerChunk *chunk;
+	TokenizerState *previous;
+	unsigned long chunkCount = options->threadCount;
+	unsigned long i;
+
+	if (chunkCount > richtext->length / MIN_CHUNK_LENGTH) {
+		chunkCount = richtext->length / MIN_CHUNK_LENGTH;
+	}
+	if (chunkCount < 2) {
+		return false;
+	}
+	chunks = malloc(sizeof(TokenizerChunk) * chunkCount);
+	if (chunks == NULL) {
+		return false;
+	}
+	chunkCount = splitInput(richtext, chunks, chunkCount);
+	if (chunkCount < 2) {
+		free(chunks);
+		return false;
+	}
+
+	/*
+	 * The chunks are tokenized speculatively, as if no encoding command
+	 * was in effect at their start, since encoding commands are rare.
+	 */
+	for (i = 0, chunk = chunks; i < chunkCount; i++, chunk++) {
+		initChunk(chunk, richtext, caseInsensitiveCommands, isUtf8,
+			  options, NULL);
+		chunk->isThreadStarted =
+		    pthread_create(&chunk->thread, NULL, tokenizeChunk,
+				   chunk) == 0;
+		if (!chunk->isThreadStarted) {
+			tokenizeChunk(chunk);
+		}
+	}
+	for (i = 0, chunk = chunks; i < chunkCount; i++, chunk++) {
+		if (chunk->isThreadStarted) {
+			pthread_join(chunk->thread, NULL);
+		}
+	}
+
+	/*
+	 * A chunk starting inside an encoding command's content is tokenized
+	 * again, now that the state at its start is known.
+	 */
+	for (i = 1, chunk = chunks + 1; i < chunkCount; i++, chunk++) {
+		previous = &(chunk - 1)->state;
+		if (previous->error.code != TokenizerErrorCode_OK) {
+			break;
+		}
+		if (previous->currentEncoding != initialEncoding
+		    || previous->encodingStack->size.length > 0) {
+			freeChunk(chunk);
+			initChunk(chunk, richtext, caseInsensitiveCommands,
+				  isUtf8, options, previous);
+			tokenizeChunk(chunk);
+		}
+	}
+
+	mergeChunks(result, chunks, chunkCount, richtext, isUtf8, options);
+	free(chunks);
+	return true;
+}
+
+/*
+ * Splits the input into (at most) the provided number of chunks of similar
+ * length and returns the number of chunks. The chunks are split at spaces
+ * outside of commands, because the serial tokenizer always ends the current
+ * token before such a space and emits the space as a token of its own, in
+ * all encodings.
+ */
+static unsigned long splitInput(richtext, chunks, chunkCount)
+string *richtext;
+TokenizerChunk *chunks;
+unsigned long chunkCount;
 {
-	if (caseInsensitive) {
-		return string_caseInsensitiveCompare(string1, string2) == 0;
+	unsigned long length = richtext->length;
+	unsigned long start = 0;
+	unsigned long end;
+	unsigned long splitCount = 0;
+	unsigned long i;
+
+	for (i = 1; i < chunkCount; i++) {
+		end = length / chunkCount * i;
+		if (end <= start) {
+			continue;
+		}
+		end = findChunkEnd(richtext->content, start, end, length);
+		if (end >= length) {
+			break;
+		}
+		chunks[splitCount].start = start;
+		chunks[splitCount].end = end;
+		splitCount++;
+		start = end;
 	}
-	return string_compare(string1, string2) == 0;
+	chunks[splitCount].start = start;
+	chunks[splitCount].end = length;
+
+	return splitCount + 1;
 }
 
+/*
+ * Returns the index of the first space outside of a command at or after the
+ * from index, or the length of the input if there is none. The start index
+ * must be outside of a command.
+ */
+static unsigned long findChunkEnd(bytes, start, from, length)
+unsigned char *bytes;
+unsigned long start;
+unsigned long from;
+unsigned long length;
+{
+	unsigned long index = from;
+	bool isInsideCommand;
+
+	/*
+	 * A command starts at a '<' and every '>' ends a command or is outside
+	 * of one, so the last of these bytes determines the state (a '<'
+	 * inside a command is an error that ends the tokenization anyway).
+	 */
+	while (index > start && bytes[index - 1] != '<'
+	       && bytes[index - 1] != '>') {
+		index--;
+	}
+	isInsideCommand = index > start && bytes[index - 1] == '<';
+
+	for (index = from; index < length; index++) {
+		switch (bytes[index]) {
+		case '<':
+			isInsideCommand = true;
+			break;
+		case '>':
+			isInsideCommand = false;
+			break;
+		case ' ':
+			if (!isInsideCommand) {
+				return index;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	return length;
+}
+
+/*
+ * Initializes the tokenizer state of the chunk, continuing from the state
+ * the previous chunk ended in, or from the initial state if previous is
+ * NULL. A failure is recorded as the chunk's error.
+ */
+static void initChunk(chunk, richtext, caseInsensitiveCommands, isUtf8,
+		      options, previous)
+TokenizerChunk *chunk;
+string *richtext;
+bool caseInsensitiveCommands;
+bool isUtf8;
+TokenizerOptions *options;
+TokenizerState *previous;
+{
+	TokenizerState *state = &chunk->state;
+	TextEncodingVector *encodingStack;
+	unsigned long i;
+
+	/* The token vector is presized by the chunk's thread */
+	chunk->valueViews = NULL;
+	chunk->presizeTokens = options->presizeTokens;
+	initState(state, caseInsensitiveCommands, isUtf8, 0, NULL);
+	state->buffer = richtext->content + chunk->start;
+	state->bufferLength = chunk->end - chunk->start;
+	state->bufferByteIndex = chunk->start;
+	state->token.byteIndex = chunk->start;
+	state->error.byteIndex = chunk->start;
+	if (state->error.code != TokenizerErrorCode_OK) {
+		return;
+	}
+	if (options->useValueViews) {
+		state->valueViews = &chunk->valueViews;
+	}
+	state->warningPolicy = options->warningPolicy;
+
+	if (previous != NULL) {
+		state->currentEncoding = previous->currentEncoding;
+		for (i = 0; i < previous->encodingStack->size.length; i++) {
+			encodingStack =
+			    TextEncodingVector_append(state->encodingStack,
+						      previous->encodingStack->
+						      items + i);
+			if (encodingStack == NULL) {
+				state->error.code =
+				    TokenizerErrorCode_OUT_OF_MEMORY_FOR_ENCODING_STACK;
+				return;
+			}
+			state->encodingStack = encodingStack;
+		}
+	}
+
+	if (options->lazyCodepointIndexes) {
+		state->lazyCodepointIndex =
+		    CodepointIndex_new(richtext->content, richtext->length,
+				       state->currentEncoding ==
+				       TextEncoding_UTF8);
+		if (state->lazyCodepointIndex == NULL) {
+			state->error.code = OOM_FOR_CODEPOINT_INDEX;
+		}
+	}
+}
+
+static void *tokenizeChunk(chunk)
+void *chunk;
+{
+	TokenizerState *state = &((TokenizerChunk *) chunk)->state;
+	string input;
+	unsigned long tokenCountEstimate;
+
+	if (state->error.code != TokenizerErrorCode_OK) {
+		return NULL;
+	}
+
+	input.content = state->buffer;
+	input.length = state->bufferLength;
+	if (((TokenizerChunk *) chunk)->presizeTokens) {
+		tokenCountEstimate = estimateTokenCount(&input);
+	} else {
+		tokenCountEstimate = input.length / 1024;
+	}
+	if (TokenVector_grow(state->tokens, tokenCountEstimate) == NULL) {
+		state->error.code = TokenizerErrorCode_OUT_OF_MEMORY_FOR_TOKENS;
+		return NULL;
+	}
+
+	if (processInput(state, true) == TokenizerErrorCode_OK) {
+		finishInput(state);
+	}
+
+	return NULL;
+}
+
+/*
+ * Stitches the tokens and warnings of the chunks into the result, offsetting
+ * their codepoint indexes, up to the first chunk that ended with an error.
+ */
+static void mergeChunks(result, chunks, chunkCount, richtext, isUtf8,
+			options)
+TokenizerResult *result;
+TokenizerChunk *chunks;
+unsigned long chunkCount;
+string *richtext;
+bool isUtf8;
+TokenizerOptions *options;
+{
+	TokenVector *tokens = options->tokens;
+	TokenizerWarningVector *warnings = TokenizerWarningVector_new(0, 0);
+	TokenizerWarningVector *resizedWarnings;
+	TokenizerChunk *chunk;
+	TokenizerState *state;
+	TokenValueViewBlock *oldestBlock;
+	TokenizerError error;
+	Token *token;
+	TokenizerWarning warning;
+	unsigned long lastChunk;
+	unsigned long tokenCount = 0;
+	unsigned long codepointOffset = 0;
+	unsigned long i;
+	unsigned long j;
+
+	error.byteIndex = 0;
+	error.codepointIndex = 0;
+	error.code = TokenizerErrorCode_OK;
+
+	/* The chunks following an error are not tokenized by the serial code */
+	for (lastChunk = 0; lastChunk + 1 < chunkCount; lastChunk++) {
+		if (chunks[lastChunk].state.error.code !=
+		    TokenizerErrorCode_OK) {
+			break;
+		}
+	}
+	for (i = lastChunk + 1; i < chunkCount; i++) {
+		freeChunk(chunks + i);
+	}
+
+	for (i = 0; i <= lastChunk; i++) {
+		if (chunks[i].state.tokens != NULL) {
+			tokenCount += chunks[i].state.tokens->size.length;
+		}
+	}
+	if (tokens == NULL) {
+		tokens = TokenVector_new(0, tokenCount);
+	} else if (TokenVector_grow(tokens, tokenCount) == NULL) {
+		error.code = TokenizerErrorCode_OUT_OF_MEMORY_FOR_TOKENS;
+	}
+	if (tokens == NULL) {
+		error.code = TokenizerErrorCode_OUT_OF_MEMORY_FOR_TOKENS;
+	} else if (warnings == NULL) {
+		error.code = TokenizerErrorCode_OUT_OF_MEMORY_FOR_WARNINGS;
+	}
+	if (options->lazyCodepointIndexes) {
+		result->lazyCodepointIndex =
+		    CodepointIndex_new(richtext->content, richtext->length,
+				       isUtf8);
+		if (result->lazyCodepointIndex == NULL
+		    && error.code == TokenizerErrorCode_OK) {
+			error.code = OOM_FOR_CODEPOINT_INDEX;
+		}
+	}
+
+	for (i = 0, chunk = chunks; i <= lastChunk; i++, chunk++) {
+		state = &chunk->state;
+		if (error.code == TokenizerErrorCode_OK
+		    && state->error.code != TokenizerErrorCode_OK) {
+			error = state->error;
+			error.codepointIndex += codepointOffset;
+		}
+
+		if (error.code == TokenizerErrorCode_OK) {
+			token = tokens->items + tokens->size.length;
+			memcpy(token, state->tokens->items,
+			       sizeof(Token) * state->tokens->size.length);
+			tokens->size.length += state->tokens->size.length;
+			for (j = 0; j < state->tokens->size.length;
+			     j++, token++) {
+				token->codepointIndex += codepointOffset;
+			}
+			TokenVector_free(state->tokens);
+			state->tokens = NULL;
+		}
+
+		for (j = 0; warnings != NULL && state->warnings != NULL
+		     && j < state->warnings->size.length; j++) {
+			warning = state->warnings->items[j];
+			warning.codepointIndex += codepointOffset;
+			warning.lastCodepointIndex += codepointOffset;
+			/* Coalesces the warnings across the chunks' borders */
+			resizedWarnings = (TokenizerWarningVector *)
+			    WarningPolicy_record(&options->warningPolicy,
+						 (Vector *) warnings, &warning,
+						 mergeWarnings);
+			if (resizedWarnings == NULL) {
+				/* The warnings of the chunks are dropped */
+				TokenizerWarningVector_free(warnings);
+				error.code =
+				    TokenizerErrorCode_OUT_OF_MEMORY_FOR_WARNINGS;
+			}
+			warnings = resizedWarnings;
+		}
+
+		if (chunk->valueViews != NULL) {
+			for (oldestBlock = chunk->valueViews;
+			     oldestBlock->previous != NULL;
+			     oldestBlock = oldestBlock->previous) {
+			}
+			oldestBlock->previous = result->valueViews;
+			result->valueViews = chunk->valueViews;
+			chunk->valueViews = NULL;
+		}
+
+		if (result->lazyCodepointIndex != NULL
+		    && state->lazyCodepointIndex != NULL
+		    && !CodepointIndex_merge(result->lazyCodepointIndex,
+					     state->lazyCodepointIndex,
+					     chunk->start)
+		    && error.code == TokenizerErrorCode_OK) {
+			error.code = OOM_FOR_CODEPOINT_INDEX;
+		}
+
+		codepointOffset += state->codepointIndex;
+		freeChunk(chunk);
+	}
+
+	if (result->lazyCodepointIndex != NULL) {
+		resolveCodepointIndexes(warnings, &error,
+					result->lazyCodepointIndex);
+	}
+	if (error.code != TokenizerErrorCode_OK) {
+		finalizeToError(result, error.byteIndex, error.codepointIndex,
+				error.code, warnings, tokens);
+		return;
+	}
+
+	result->type = TokenizerResultType_SUCCESS;
+	result->result.tokens = tokens;
+	result->warnings = warnings;
+}
+
+static void freeChunk(chunk)
+TokenizerChunk *chunk;
+{
+	TokenizerState *state = &chunk->state;
+
+	freeTokens(state->tokens);
+	TokenizerWarningVector_free(state->warnings);
+	TextEncodingVector_free(state->encodingStack);
+	CodepointIndex_free(state->lazyCodepointIndex);
+	TokenValueViewBlock_free(chunk->valueViews);
+	state->tokens = NULL;
+	state->warnings = NULL;
+	state->encodingStack = NULL;
+	state->lazyCodepointIndex = NULL;
+	chunk->valueViews = NULL;
+}
+
+#endif
+
 Vector_ofTypeImplementation(TokenizerWarning)
     Vector_ofTypeImplementation(TextEncoding)
@@ -2,8 +2,11 @@
 #define TOKENIZER_HEADER_FILE 1
 
 #include "bool.h"
+#include "codepoint_index.h"
 #include "string.h"
+#include "token.h"
 #include "token_vector.h"
+#include "warning_policy.h"
 
 /*
   Note: UTF-8 uses 1-4 bytes to encode a codepoint, but some "characters" may
@@ -27,7 +30,9 @@ typedef enum TokenizerErrorCode {
 	TokenizerErrorCode_OUT_OF_MEMORY_FOR_SUBSTRING,
 	TokenizerErrorCode_OUT_OF_MEMORY_FOR_TOKENS,
 	TokenizerErrorCode_OUT_OF_MEMORY_FOR_WARNINGS,
-	TokenizerErrorCode_OUT_OF_MEMORY_FOR_ENCODING_STACK
+	TokenizerErrorCode_OUT_OF_MEMORY_FOR_ENCODING_STACK,
+	TokenizerErrorCode_OUT_OF_MEMORY_FOR_INPUT_BUFFER,
+	TokenizerErrorCode_OUT_OF_MEMORY_FOR_CODEPOINT_INDEX
 } TokenizerErrorCode;
 
 typedef struct TokenizerError {
@@ -45,9 +50,81 @@ typedef struct TokenizerWarning {
 	unsigned long byteIndex;
 	unsigned long codepointIndex;
 	TokenizerWarningCode code;
+	/*
+	 * The number of warnings represented by this one and the location of
+	 * the last of them, see TokenizerOptions.warningPolicy.
+	 */
+	unsigned long count;
+	unsigned long lastByteIndex;
+	unsigned long lastCodepointIndex;
 } TokenizerWarning;
 
 Vector_ofType(TokenizerWarning)
+typedef struct TokenizerOptions {
+	/*
+	 * Tokens containing UTF-8 (or 7-bit ASCII) text will reference the
+	 * tokenized input instead of copying their values to newly allocated
+	 * memory. Only the tokens that need to be transcoded to UTF-8 will own
+	 * their values (see Token.isValueView).
+	 *
+	 * The tokenized input must not be modified or freed before the
+	 * tokenizer result is freed when this option is used.
+	 */
+	bool useValueViews;
+
+	/*
+	 * The tokenizer will make an extra pass over the input to compute an
+	 * upper bound of the number of tokens (see estimateTokenCount), and
+	 * allocate the token vector only once, instead of growing it
+	 * repeatedly.
+	 */
+	bool presizeTokens;
+
+	/*
+	 * An empty token vector to fill with tokens instead of allocating a new
+	 * one, or NULL. This allows to reuse the memory of the vector across
+	 * multiple documents (see TokenizerResult_recycleTokens). The vector is
+	 * owned by the tokenizer result afterwards, even in case of an error.
+	 */
+	TokenVector *tokens;
+
+	/*
+	 * The tokenizer will not count the codepoints of the input, leaving
+	 * the codepoint indexes of the tokens 0. It will provide a sparse
+	 * index of the input instead (see TokenizerResult.lazyCodepointIndex),
+	 * which computes the codepoint index of a byte index on demand, and
+	 * is used to fill in the codepoint indexes of the warnings and the
+	 * error.
+	 *
+	 * The tokenized input must not be modified or freed before the
+	 * tokenizer result is freed when this option is used.
+	 */
+	bool lazyCodepointIndexes;
+
+	/*
+	 * The number of threads tokenizing consecutive parts of the input,
+	 * 0 or 1 to tokenize the input in the calling thread. The result is
+	 * the same as if the input was tokenized by a single thread.
+	 *
+	 * The option is ignored unless the tokenizer is built with
+	 * RICHTEXT_THREADS defined (see the THREADS option of the Makefile).
+	 */
+	unsigned int threadCount;
+
+	/*
+	 * Limits the number of recorded warnings, which may be as high as the
+	 * number of bytes of the input if it is not a text (see
+	 * WarningPolicyType).
+	 */
+	WarningPolicy warningPolicy;
+} TokenizerOptions;
+
+/*
+ * The string headers of token values referencing the tokenized input are
+ * allocated in blocks to avoid allocating memory for every token.
+ */
+typedef struct TokenValueViewBlock TokenValueViewBlock;
+
 typedef enum TokenizerResultType {
 	TokenizerResultType_SUCCESS,
 	TokenizerResultType_ERROR
@@ -60,11 +137,107 @@ typedef struct TokenizerResult {
 		TokenizerError error;
 	} result;
 	TokenizerWarningVector *warnings;
+	TokenValueViewBlock *valueViews;
+	/*
+	 * Maps the byte indexes of the input to codepoint indexes if the
+	 * tokenizer did not count the codepoints (see
+	 * TokenizerOptions.lazyCodepointIndexes), NULL otherwise.
+	 */
+	CodepointIndex *lazyCodepointIndex;
 } TokenizerResult;
 
 TokenizerResult *tokenize(string *richtext, bool caseInsensitiveCommands,
 			  bool isUtf8);
 
+/*
+ * Same as tokenize, but allows to alter the tokenizer's behavior. The options
+ * may be NULL, in which case the default behavior is used.
+ */
+TokenizerResult *tokenizeWithOptions(string *richtext,
+				     bool caseInsensitiveCommands, bool isUtf8,
+				     TokenizerOptions *options);
+
+/*
+ * Receives the tokens from tokenizeToSink one at a time, as soon as each of
+ * them is recognized. The sink may take over the token's value by setting it
+ * to NULL, the value is freed by the tokenizer otherwise (unless it is a view
+ * of the input, see Token.isValueView). The token itself is reused by the
+ * tokenizer once the sink returns.
+ */
+typedef void TokenSink(Token *token, void *context);
+
+/*
+ * Same as tokenizeWithOptions, but passes the tokens to the sink instead of
+ * collecting them, so the token vector of a successful result is left empty.
+ * The tokens are passed in order, before the tokenizer moves on, and the
+ * sink is not told about an error following them. The tokens, presizeTokens
+ * and threadCount options are ignored, as there is no token vector to fill.
+ * The tokens are collected as by tokenizeWithOptions if the sink is NULL.
+ */
+TokenizerResult *tokenizeToSink(string *richtext, bool caseInsensitiveCommands,
+				bool isUtf8, TokenizerOptions *options,
+				TokenSink *sink, void *sinkContext);
+
+/*
+ * Returns an upper bound of the number of tokens the provided input will be
+ * split into. The bound is computed by a single fast pass over the input and
+ * is usually much closer to the actual token count than the input's length.
+ */
+unsigned long estimateTokenCount(string *richtext);
+
+/*
+ * State of a tokenizer processing its input incrementally, as the chunks of
+ * the input become available. The input is buffered only until the tokens
+ * covering it are emitted, so the memory used by the tokenizer is bounded by
+ * the length of the longest token and the length of the fed chunks, not by
+ * the length of the whole input.
+ *
+ * The tokens are emitted exactly as tokenize would emit them for the
+ * concatenation of all chunks, including their byte and codepoint indexes,
+ * regardless of how the input is split into chunks (chunks may end inside a
+ * command, in the middle of a UTF-8 sequence or between CR and LF).
+ */
+typedef struct TokenizerState TokenizerState;
+
+/*
+ * Returns NULL if the memory for the state could not be allocated.
+ */
+TokenizerState *TokenizerState_new(bool caseInsensitiveCommands, bool isUtf8);
+
+/*
+ * Feeds the next chunk of the input to the tokenizer and returns the tokens
+ * and warnings that have been completed by it (the tokens still owning their
+ * values). The returned result must be freed using TokenizerResult_free.
+ *
+ * Once an error is encountered, all following calls return the error. The
+ * function returns NULL for NULL input, if the tokenizer has already been
+ * finished, or if the memory for the result could not be allocated.
+ */
+TokenizerResult *TokenizerState_feed(TokenizerState *state, string *chunk);
+
+/*
+ * Signals the end of the input to the tokenizer and returns the remaining
+ * tokens and warnings (or an error, for example for an unterminated command).
+ * The tokenizer cannot be fed any more input afterwards.
+ */
+TokenizerResult *TokenizerState_finish(TokenizerState *state);
+
+void TokenizerState_free(TokenizerState *state);
+
 void TokenizerResult_free(TokenizerResult *result);
 
+/*
+ * Frees the values of the result's tokens and returns the emptied token
+ * vector, keeping its capacity, so that it can be passed to the tokenizer
+ * again (see TokenizerOptions.tokens). The result will no longer reference
+ * the vector. Returns NULL if the result is NULL or has no tokens.
+ */
+TokenVector *TokenizerResult_recycleTokens(TokenizerResult *result);
+
+/*
+ * Frees the blocks of token value views, should they outlive the tokenizer
+ * result (see parseAndConsumeTokens).
+ */
+void TokenValueViewBlock_free(TokenValueViewBlock *valueViews);
+
 #endif
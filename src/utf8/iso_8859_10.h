@@ -2,7 +2,10 @@
 #define UTF8_ISO_8859_10_HEADER_FILE 1
 
 #include "../string.h"
+#include "utf8_encoder.h"
 
 string *iso885910ToUtf8(string * text);
 
+const Utf8Character *getIso885910Utf8Table(void);
+
 #endif
@@ -1,46 +1,61 @@
 #include "../string.h"
-#include "iso_8859.h"
 #include "iso_8859_11.h"
+#include "utf8_encoder.h"
 
-static unsigned long decodeIso885911Byte(unsigned int byte);
-
-static unsigned long EXTENDED_CHARS_CODEPOINTS[128];
+static const Utf8Character UTF8_CHARACTERS[128];
 
 string *iso885911ToUtf8(text)
 string *text;
 {
-	return transcodeIso8859ToUtf8(text, decodeIso885911Byte);
+	return transcodeSingleByteEncodingToUtf8UsingTable(text,
+							   UTF8_CHARACTERS);
 }
 
-static unsigned long decodeIso885911Byte(byte)
-unsigned int byte;
+const Utf8Character *getIso885911Utf8Table()
 {
-	unsigned long codepoint = EXTENDED_CHARS_CODEPOINTS[byte - 0x80];
-	return codepoint != 0 ? codepoint : byte;
+	return UTF8_CHARACTERS;
 }
 
 /* https://en.wikipedia.org/wiki/ISO/IEC_8859-11 */
-static unsigned long EXTENDED_CHARS_CODEPOINTS[] = {
+static const Utf8Character UTF8_CHARACTERS[] = {
 	/* 0x8x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x80), UTF8(0x81), UTF8(0x82), UTF8(0x83),
+	UTF8(0x84), UTF8(0x85), UTF8(0x86), UTF8(0x87),
+	UTF8(0x88), UTF8(0x89), UTF8(0x8a), UTF8(0x8b),
+	UTF8(0x8c), UTF8(0x8d), UTF8(0x8e), UTF8(0x8f),
 	/* 0x9x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x90), UTF8(0x91), UTF8(0x92), UTF8(0x93),
+	UTF8(0x94), UTF8(0x95), UTF8(0x96), UTF8(0x97),
+	UTF8(0x98), UTF8(0x99), UTF8(0x9a), UTF8(0x9b),
+	UTF8(0x9c), UTF8(0x9d), UTF8(0x9e), UTF8(0x9f),
 	/* 0xAx */
-	0, 0xe01, 0xe02, 0xe03, 0xe04, 0xe05, 0xe06, 0xe07,
-	0xe08, 0xe09, 0xe0a, 0xe0b, 0xe0c, 0xe0d, 0xe0e, 0xe0f,
+	UTF8(0xa0), UTF8(0xe01), UTF8(0xe02), UTF8(0xe03),
+	UTF8(0xe04), UTF8(0xe05), UTF8(0xe06), UTF8(0xe07),
+	UTF8(0xe08), UTF8(0xe09), UTF8(0xe0a), UTF8(0xe0b),
+	UTF8(0xe0c), UTF8(0xe0d), UTF8(0xe0e), UTF8(0xe0f),
 	/* 0xBx */
-	0xe10, 0xe11, 0xe12, 0xe13, 0xe14, 0xe15, 0xe16, 0xe17,
-	0xe18, 0xe19, 0xe1a, 0xe1b, 0xe1c, 0xe1d, 0xe1e, 0xe1f,
+	UTF8(0xe10), UTF8(0xe11), UTF8(0xe12), UTF8(0xe13),
+	UTF8(0xe14), UTF8(0xe15), UTF8(0xe16), UTF8(0xe17),
+	UTF8(0xe18), UTF8(0xe19), UTF8(0xe1a), UTF8(0xe1b),
+	UTF8(0xe1c), UTF8(0xe1d), UTF8(0xe1e), UTF8(0xe1f),
 	/* 0xCx */
-	0xe20, 0xe21, 0xe22, 0xe23, 0xe24, 0xe25, 0xe26, 0xe27,
-	0xe28, 0xe29, 0xe2a, 0xe2b, 0xe2c, 0xe2d, 0xe2e, 0xe2f,
+	UTF8(0xe20), UTF8(0xe21), UTF8(0xe22), UTF8(0xe23),
+	UTF8(0xe24), UTF8(0xe25), UTF8(0xe26), UTF8(0xe27),
+	UTF8(0xe28), UTF8(0xe29), UTF8(0xe2a), UTF8(0xe2b),
+	UTF8(0xe2c), UTF8(0xe2d), UTF8(0xe2e), UTF8(0xe2f),
 	/* 0xDx */
-	0xe30, 0xe31, 0xe32, 0xe33, 0xe34, 0xe35, 0xe36, 0xe37,
-	0xe38, 0xe39, 0xe3a, 0, 0, 0, 0, 0xe3f,
+	UTF8(0xe30), UTF8(0xe31), UTF8(0xe32), UTF8(0xe33),
+	UTF8(0xe34), UTF8(0xe35), UTF8(0xe36), UTF8(0xe37),
+	UTF8(0xe38), UTF8(0xe39), UTF8(0xe3a), UTF8(0xdb),
+	UTF8(0xdc), UTF8(0xdd), UTF8(0xde), UTF8(0xe3f),
 	/* 0xEx */
-	0xe40, 0xe41, 0xe42, 0xe43, 0xe44, 0xe45, 0xe46, 0xe47,
-	0xe48, 0xe49, 0xe4a, 0xe4b, 0xe4c, 0xe4d, 0xe4e, 0xe4f,
+	UTF8(0xe40), UTF8(0xe41), UTF8(0xe42), UTF8(0xe43),
+	UTF8(0xe44), UTF8(0xe45), UTF8(0xe46), UTF8(0xe47),
+	UTF8(0xe48), UTF8(0xe49), UTF8(0xe4a), UTF8(0xe4b),
+	UTF8(0xe4c), UTF8(0xe4d), UTF8(0xe4e), UTF8(0xe4f),
 	/* 0xFx */
-	0xe50, 0xe51, 0xe52, 0xe53, 0xe54, 0xe55, 0xe56, 0xe57,
-	0xe58, 0xe59, 0xe5a, 0xe5b, 0, 0, 0, 0
+	UTF8(0xe50), UTF8(0xe51), UTF8(0xe52), UTF8(0xe53),
+	UTF8(0xe54), UTF8(0xe55), UTF8(0xe56), UTF8(0xe57),
+	UTF8(0xe58), UTF8(0xe59), UTF8(0xe5a), UTF8(0xe5b),
+	UTF8(0xfc), UTF8(0xfd), UTF8(0xfe), UTF8(0xff)
 };
@@ -1,44 +1,61 @@
 #include "../string.h"
-#include "iso_8859.h"
 #include "iso_8859_13.h"
+#include "utf8_encoder.h"
 
-static unsigned long decodeIso885913Byte(unsigned int byte);
-
-static unsigned long EXTENDED_CHARS_CODEPOINTS[128];
+static const Utf8Character UTF8_CHARACTERS[128];
 
 string *iso885913ToUtf8(text)
 string *text;
 {
-	return transcodeIso8859ToUtf8(text, decodeIso885913Byte);
+	return transcodeSingleByteEncodingToUtf8UsingTable(text,
+							   UTF8_CHARACTERS);
 }
 
-static unsigned long decodeIso885913Byte(byte)
-unsigned int byte;
+const Utf8Character *getIso885913Utf8Table()
 {
-	unsigned long codepoint = EXTENDED_CHARS_CODEPOINTS[byte - 0x80];
-	return codepoint != 0 ? codepoint : byte;
+	return UTF8_CHARACTERS;
 }
 
 /* https://en.wikipedia.org/wiki/ISO/IEC_8859-13 */
-static unsigned long EXTENDED_CHARS_CODEPOINTS[] = {
+static const Utf8Character UTF8_CHARACTERS[] = {
 	/* 0x8x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x80), UTF8(0x81), UTF8(0x82), UTF8(0x83),
+	UTF8(0x84), UTF8(0x85), UTF8(0x86), UTF8(0x87),
+	UTF8(0x88), UTF8(0x89), UTF8(0x8a), UTF8(0x8b),
+	UTF8(0x8c), UTF8(0x8d), UTF8(0x8e), UTF8(0x8f),
 	/* 0x9x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x90), UTF8(0x91), UTF8(0x92), UTF8(0x93),
+	UTF8(0x94), UTF8(0x95), UTF8(0x96), UTF8(0x97),
+	UTF8(0x98), UTF8(0x99), UTF8(0x9a), UTF8(0x9b),
+	UTF8(0x9c), UTF8(0x9d), UTF8(0x9e), UTF8(0x9f),
 	/* 0xAx */
-	0, 0x201d, 0, 0, 0, 0x201e, 0, 0, 0xd8, 0, 0x156, 0, 0, 0, 0, 0xc6,
+	UTF8(0xa0), UTF8(0x201d), UTF8(0xa2), UTF8(0xa3),
+	UTF8(0xa4), UTF8(0x201e), UTF8(0xa6), UTF8(0xa7),
+	UTF8(0xd8), UTF8(0xa9), UTF8(0x156), UTF8(0xab),
+	UTF8(0xac), UTF8(0xad), UTF8(0xae), UTF8(0xc6),
 	/* 0xBx */
-	0, 0, 0, 0, 0x201c, 0, 0, 0, 0xf8, 0, 0x157, 0, 0, 0, 0, 0xe6,
+	UTF8(0xb0), UTF8(0xb1), UTF8(0xb2), UTF8(0xb3),
+	UTF8(0x201c), UTF8(0xb5), UTF8(0xb6), UTF8(0xb7),
+	UTF8(0xf8), UTF8(0xb9), UTF8(0x157), UTF8(0xbb),
+	UTF8(0xbc), UTF8(0xbd), UTF8(0xbe), UTF8(0xe6),
 	/* 0xCx */
-	0x104, 0x12e, 0x100, 0x106, 0, 0, 0x118, 0x112,
-	0x10c, 0, 0x179, 0x116, 0x122, 0x136, 0x12a, 0x13b,
+	UTF8(0x104), UTF8(0x12e), UTF8(0x100), UTF8(0x106),
+	UTF8(0xc4), UTF8(0xc5), UTF8(0x118), UTF8(0x112),
+	UTF8(0x10c), UTF8(0xc9), UTF8(0x179), UTF8(0x116),
+	UTF8(0x122), UTF8(0x136), UTF8(0x12a), UTF8(0x13b),
 	/* 0xDx */
-	0x160, 0x143, 0x145, 0, 0x14c, 0, 0, 0,
-	0x172, 0x141, 0x15a, 0x16a, 0, 0x17b, 0x17d, 0,
+	UTF8(0x160), UTF8(0x143), UTF8(0x145), UTF8(0xd3),
+	UTF8(0x14c), UTF8(0xd5), UTF8(0xd6), UTF8(0xd7),
+	UTF8(0x172), UTF8(0x141), UTF8(0x15a), UTF8(0x16a),
+	UTF8(0xdc), UTF8(0x17b), UTF8(0x17d), UTF8(0xdf),
 	/* 0xEx */
-	0x105, 0x12f, 0x101, 0x107, 0, 0, 0x119, 0x113,
-	0x10d, 0, 0x17a, 0x117, 0x123, 0x137, 0x12b, 0x13c,
+	UTF8(0x105), UTF8(0x12f), UTF8(0x101), UTF8(0x107),
+	UTF8(0xe4), UTF8(0xe5), UTF8(0x119), UTF8(0x113),
+	UTF8(0x10d), UTF8(0xe9), UTF8(0x17a), UTF8(0x117),
+	UTF8(0x123), UTF8(0x137), UTF8(0x12b), UTF8(0x13c),
 	/* 0xFx */
-	0x161, 0x144, 0x146, 0, 0x14d, 0, 0, 0,
-	0x173, 0x142, 0x15b, 0x16b, 0, 0x17c, 0x17e, 0x2019
+	UTF8(0x161), UTF8(0x144), UTF8(0x146), UTF8(0xf3),
+	UTF8(0x14d), UTF8(0xf5), UTF8(0xf6), UTF8(0xf7),
+	UTF8(0x173), UTF8(0x142), UTF8(0x15b), UTF8(0x16b),
+	UTF8(0xfc), UTF8(0x17c), UTF8(0x17e), UTF8(0x2019)
 };
@@ -2,7 +2,10 @@
 #define UTF8_ISO_8859_13_HEADER_FILE 1
 
 #include "../string.h"
+#include "utf8_encoder.h"
 
 string *iso885913ToUtf8(string * text);
 
+const Utf8Character *getIso885913Utf8Table(void);
+
 #endif
@@ -1,40 +1,61 @@
 #include "../string.h"
-#include "iso_8859.h"
 #include "iso_8859_15.h"
+#include "utf8_encoder.h"
 
-static unsigned long decodeIso885915Byte(unsigned int byte);
-
-static unsigned long EXTENDED_CHARS_CODEPOINTS[128];
+static const Utf8Character UTF8_CHARACTERS[128];
 
 string *iso885915ToUtf8(text)
 string *text;
 {
-	return transcodeIso8859ToUtf8(text, decodeIso885915Byte);
+	return transcodeSingleByteEncodingToUtf8UsingTable(text,
+							   UTF8_CHARACTERS);
 }
 
-static unsigned long decodeIso885915Byte(byte)
-unsigned int byte;
+const Utf8Character *getIso885915Utf8Table()
 {
-	unsigned long codepoint = EXTENDED_CHARS_CODEPOINTS[byte - 0x80];
-	return codepoint != 0 ? codepoint : byte;
+	return UTF8_CHARACTERS;
 }
 
 /* https://en.wikipedia.org/wiki/ISO/IEC_8859-15 */
-static unsigned long EXTENDED_CHARS_CODEPOINTS[] = {
+static const Utf8Character UTF8_CHARACTERS[] = {
 	/* 0x8x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x80), UTF8(0x81), UTF8(0x82), UTF8(0x83),
+	UTF8(0x84), UTF8(0x85), UTF8(0x86), UTF8(0x87),
+	UTF8(0x88), UTF8(0x89), UTF8(0x8a), UTF8(0x8b),
+	UTF8(0x8c), UTF8(0x8d), UTF8(0x8e), UTF8(0x8f),
 	/* 0x9x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x90), UTF8(0x91), UTF8(0x92), UTF8(0x93),
+	UTF8(0x94), UTF8(0x95), UTF8(0x96), UTF8(0x97),
+	UTF8(0x98), UTF8(0x99), UTF8(0x9a), UTF8(0x9b),
+	UTF8(0x9c), UTF8(0x9d), UTF8(0x9e), UTF8(0x9f),
 	/* 0xAx */
-	0, 0, 0, 0, 0x20ac, 0, 0x160, 0, 0x161, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0xa0), UTF8(0xa1), UTF8(0xa2), UTF8(0xa3),
+	UTF8(0x20ac), UTF8(0xa5), UTF8(0x160), UTF8(0xa7),
+	UTF8(0x161), UTF8(0xa9), UTF8(0xaa), UTF8(0xab),
+	UTF8(0xac), UTF8(0xad), UTF8(0xae), UTF8(0xaf),
 	/* 0xBx */
-	0, 0, 0, 0, 0x17d, 0, 0, 0, 0x17e, 0, 0, 0, 0x152, 0x153, 0x178, 0,
+	UTF8(0xb0), UTF8(0xb1), UTF8(0xb2), UTF8(0xb3),
+	UTF8(0x17d), UTF8(0xb5), UTF8(0xb6), UTF8(0xb7),
+	UTF8(0x17e), UTF8(0xb9), UTF8(0xba), UTF8(0xbb),
+	UTF8(0x152), UTF8(0x153), UTF8(0x178), UTF8(0xbf),
 	/* 0xCx */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0xc0), UTF8(0xc1), UTF8(0xc2), UTF8(0xc3),
+	UTF8(0xc4), UTF8(0xc5), UTF8(0xc6), UTF8(0xc7),
+	UTF8(0xc8), UTF8(0xc9), UTF8(0xca), UTF8(0xcb),
+	UTF8(0xcc), UTF8(0xcd), UTF8(0xce), UTF8(0xcf),
 	/* 0xDx */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0xd0), UTF8(0xd1), UTF8(0xd2), UTF8(0xd3),
+	UTF8(0xd4), UTF8(0xd5), UTF8(0xd6), UTF8(0xd7),
+	UTF8(0xd8), UTF8(0xd9), UTF8(0xda), UTF8(0xdb),
+	UTF8(0xdc), UTF8(0xdd), UTF8(0xde), UTF8(0xdf),
 	/* 0xEx */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0xe0), UTF8(0xe1), UTF8(0xe2), UTF8(0xe3),
+	UTF8(0xe4), UTF8(0xe5), UTF8(0xe6), UTF8(0xe7),
+	UTF8(0xe8), UTF8(0xe9), UTF8(0xea), UTF8(0xeb),
+	UTF8(0xec), UTF8(0xed), UTF8(0xee), UTF8(0xef),
 	/* 0xFx */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+	UTF8(0xf0), UTF8(0xf1), UTF8(0xf2), UTF8(0xf3),
+	UTF8(0xf4), UTF8(0xf5), UTF8(0xf6), UTF8(0xf7),
+	UTF8(0xf8), UTF8(0xf9), UTF8(0xfa), UTF8(0xfb),
+	UTF8(0xfc), UTF8(0xfd), UTF8(0xfe), UTF8(0xff)
 };
@@ -1,46 +1,61 @@
 #include "../string.h"
-#include "iso_8859.h"
 #include "iso_8859_2.h"
+#include "utf8_encoder.h"
 
-static unsigned long decodeIso88592Byte(unsigned int byte);
-
-static unsigned long EXTENDED_CHARS_CODEPOINTS[128];
+static const Utf8Character UTF8_CHARACTERS[128];
 
 string *iso88592ToUtf8(text)
 string *text;
 {
-	return transcodeIso8859ToUtf8(text, decodeIso88592Byte);
+	return transcodeSingleByteEncodingToUtf8UsingTable(text,
+							   UTF8_CHARACTERS);
 }
 
-static unsigned long decodeIso88592Byte(byte)
-unsigned int byte;
+const Utf8Character *getIso88592Utf8Table()
 {
-	unsigned long codepoint = EXTENDED_CHARS_CODEPOINTS[byte - 0x80];
-	return codepoint != 0 ? codepoint : byte;
+	return UTF8_CHARACTERS;
 }
 
 /* https://en.wikipedia.org/wiki/ISO/IEC_8859-2 */
-static unsigned long EXTENDED_CHARS_CODEPOINTS[] = {
+static const Utf8Character UTF8_CHARACTERS[] = {
 	/* 0x8x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x80), UTF8(0x81), UTF8(0x82), UTF8(0x83),
+	UTF8(0x84), UTF8(0x85), UTF8(0x86), UTF8(0x87),
+	UTF8(0x88), UTF8(0x89), UTF8(0x8a), UTF8(0x8b),
+	UTF8(0x8c), UTF8(0x8d), UTF8(0x8e), UTF8(0x8f),
 	/* 0x9x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x90), UTF8(0x91), UTF8(0x92), UTF8(0x93),
+	UTF8(0x94), UTF8(0x95), UTF8(0x96), UTF8(0x97),
+	UTF8(0x98), UTF8(0x99), UTF8(0x9a), UTF8(0x9b),
+	UTF8(0x9c), UTF8(0x9d), UTF8(0x9e), UTF8(0x9f),
 	/* 0xAx */
-	0, 0x104, 0x2d8, 0x141, 0, 0x13d, 0x15a, 0,
-	0, 0x160, 0x15e, 0x164, 0x179, 0, 0x17d, 0x17b,
+	UTF8(0xa0), UTF8(0x104), UTF8(0x2d8), UTF8(0x141),
+	UTF8(0xa4), UTF8(0x13d), UTF8(0x15a), UTF8(0xa7),
+	UTF8(0xa8), UTF8(0x160), UTF8(0x15e), UTF8(0x164),
+	UTF8(0x179), UTF8(0xad), UTF8(0x17d), UTF8(0x17b),
 	/* 0xBx */
-	0, 0x105, 0x2db, 0x142, 0, 0x13e, 0x15b, 0x2c7,
-	0, 0x161, 0x15f, 0x165, 0x17a, 0x2dd, 0x17e, 0x17c,
+	UTF8(0xb0), UTF8(0x105), UTF8(0x2db), UTF8(0x142),
+	UTF8(0xb4), UTF8(0x13e), UTF8(0x15b), UTF8(0x2c7),
+	UTF8(0xb8), UTF8(0x161), UTF8(0x15f), UTF8(0x165),
+	UTF8(0x17a), UTF8(0x2dd), UTF8(0x17e), UTF8(0x17c),
 	/* 0xCx */
-	0x154, 0, 0, 0x102, 0, 0x139, 0x106, 0,
-	0x10c, 0, 0x118, 0, 0x11a, 0, 0, 0x10e,
+	UTF8(0x154), UTF8(0xc1), UTF8(0xc2), UTF8(0x102),
+	UTF8(0xc4), UTF8(0x139), UTF8(0x106), UTF8(0xc7),
+	UTF8(0x10c), UTF8(0xc9), UTF8(0x118), UTF8(0xcb),
+	UTF8(0x11a), UTF8(0xcd), UTF8(0xce), UTF8(0x10e),
 	/* 0xDx */
-	0x110, 0x143, 0x147, 0, 0, 0x150, 0, 0,
-	0x158, 0x16e, 0, 0x170, 0, 0, 0x162, 0,
+	UTF8(0x110), UTF8(0x143), UTF8(0x147), UTF8(0xd3),
+	UTF8(0xd4), UTF8(0x150), UTF8(0xd6), UTF8(0xd7),
+	UTF8(0x158), UTF8(0x16e), UTF8(0xda), UTF8(0x170),
+	UTF8(0xdc), UTF8(0xdd), UTF8(0x162), UTF8(0xdf),
 	/* 0xEx */
-	0x155, 0, 0, 0x103, 0, 0x13a, 0x107, 0,
-	0x10d, 0, 0x119, 0, 0x11b, 0, 0, 0x10f,
+	UTF8(0x155), UTF8(0xe1), UTF8(0xe2), UTF8(0x103),
+	UTF8(0xe4), UTF8(0x13a), UTF8(0x107), UTF8(0xe7),
+	UTF8(0x10d), UTF8(0xe9), UTF8(0x119), UTF8(0xeb),
+	UTF8(0x11b), UTF8(0xed), UTF8(0xee), UTF8(0x10f),
 	/* 0xFx */
-	0x111, 0x144, 0x148, 0, 0, 0x151, 0, 0,
-	0x159, 0x16f, 0, 0x171, 0, 0, 0x163, 0x2d9
+	UTF8(0x111), UTF8(0x144), UTF8(0x148), UTF8(0xf3),
+	UTF8(0xf4), UTF8(0x151), UTF8(0xf6), UTF8(0xf7),
+	UTF8(0x159), UTF8(0x16f), UTF8(0xfa), UTF8(0x171),
+	UTF8(0xfc), UTF8(0xfd), UTF8(0x163), UTF8(0x2d9)
 };
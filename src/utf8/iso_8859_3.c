@@ -1,42 +1,61 @@
 #include "../string.h"
-#include "iso_8859.h"
 #include "iso_8859_3.h"
+#include "utf8_encoder.h"
 
-static unsigned long decodeIso88593Byte(unsigned int byte);
-
-static unsigned long EXTENDED_CHARS_CODEPOINTS[128];
+static const Utf8Character UTF8_CHARACTERS[128];
 
 string *iso88593ToUtf8(text)
 string *text;
 {
-	return transcodeIso8859ToUtf8(text, decodeIso88593Byte);
+	return transcodeSingleByteEncodingToUtf8UsingTable(text,
+							   UTF8_CHARACTERS);
 }
 
-static unsigned long decodeIso88593Byte(byte)
-unsigned int byte;
+const Utf8Character *getIso88593Utf8Table()
 {
-	unsigned long codepoint = EXTENDED_CHARS_CODEPOINTS[byte - 0x80];
-	return codepoint != 0 ? codepoint : byte;
+	return UTF8_CHARACTERS;
 }
 
 /* https://en.wikipedia.org/wiki/ISO/IEC_8859-3 */
-static unsigned long EXTENDED_CHARS_CODEPOINTS[] = {
+static const Utf8Character UTF8_CHARACTERS[] = {
 	/* 0x8x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x80), UTF8(0x81), UTF8(0x82), UTF8(0x83),
+	UTF8(0x84), UTF8(0x85), UTF8(0x86), UTF8(0x87),
+	UTF8(0x88), UTF8(0x89), UTF8(0x8a), UTF8(0x8b),
+	UTF8(0x8c), UTF8(0x8d), UTF8(0x8e), UTF8(0x8f),
 	/* 0x9x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x90), UTF8(0x91), UTF8(0x92), UTF8(0x93),
+	UTF8(0x94), UTF8(0x95), UTF8(0x96), UTF8(0x97),
+	UTF8(0x98), UTF8(0x99), UTF8(0x9a), UTF8(0x9b),
+	UTF8(0x9c), UTF8(0x9d), UTF8(0x9e), UTF8(0x9f),
 	/* 0xAx */
-	0, 0x126, 0x2d8, 0, 0, 0, 0x124, 0,
-	0, 0x130, 0x15e, 0x11e, 0x134, 0, 0, 0x17b,
+	UTF8(0xa0), UTF8(0x126), UTF8(0x2d8), UTF8(0xa3),
+	UTF8(0xa4), UTF8(0xa5), UTF8(0x124), UTF8(0xa7),
+	UTF8(0xa8), UTF8(0x130), UTF8(0x15e), UTF8(0x11e),
+	UTF8(0x134), UTF8(0xad), UTF8(0xae), UTF8(0x17b),
 	/* 0xBx */
-	0, 0x127, 0, 0, 0, 0, 0x125, 0,
-	0, 0x131, 0x15f, 0x11f, 0x135, 0, 0, 0x17c,
+	UTF8(0xb0), UTF8(0x127), UTF8(0xb2), UTF8(0xb3),
+	UTF8(0xb4), UTF8(0xb5), UTF8(0x125), UTF8(0xb7),
+	UTF8(0xb8), UTF8(0x131), UTF8(0x15f), UTF8(0x11f),
+	UTF8(0x135), UTF8(0xbd), UTF8(0xbe), UTF8(0x17c),
 	/* 0xCx */
-	0, 0, 0, 0, 0, 0x10a, 0x108, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0xc0), UTF8(0xc1), UTF8(0xc2), UTF8(0xc3),
+	UTF8(0xc4), UTF8(0x10a), UTF8(0x108), UTF8(0xc7),
+	UTF8(0xc8), UTF8(0xc9), UTF8(0xca), UTF8(0xcb),
+	UTF8(0xcc), UTF8(0xcd), UTF8(0xce), UTF8(0xcf),
 	/* 0xDx */
-	0, 0, 0, 0, 0, 0x120, 0, 0, 0x11c, 0, 0, 0, 0, 0x16c, 0x15c, 0,
+	UTF8(0xd0), UTF8(0xd1), UTF8(0xd2), UTF8(0xd3),
+	UTF8(0xd4), UTF8(0x120), UTF8(0xd6), UTF8(0xd7),
+	UTF8(0x11c), UTF8(0xd9), UTF8(0xda), UTF8(0xdb),
+	UTF8(0xdc), UTF8(0x16c), UTF8(0x15c), UTF8(0xdf),
 	/* 0xEx */
-	0, 0, 0, 0, 0, 0x10b, 0x109, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0xe0), UTF8(0xe1), UTF8(0xe2), UTF8(0xe3),
+	UTF8(0xe4), UTF8(0x10b), UTF8(0x109), UTF8(0xe7),
+	UTF8(0xe8), UTF8(0xe9), UTF8(0xea), UTF8(0xeb),
+	UTF8(0xec), UTF8(0xed), UTF8(0xee), UTF8(0xef),
 	/* 0xFx */
-	0, 0, 0, 0, 0, 0x121, 0, 0, 0x11d, 0, 0, 0, 0, 0x16d, 0x15d, 0x2d9
+	UTF8(0xf0), UTF8(0xf1), UTF8(0xf2), UTF8(0xf3),
+	UTF8(0xf4), UTF8(0x121), UTF8(0xf6), UTF8(0xf7),
+	UTF8(0x11d), UTF8(0xf9), UTF8(0xfa), UTF8(0xfb),
+	UTF8(0xfc), UTF8(0x16d), UTF8(0x15d), UTF8(0x2d9)
 };
@@ -2,7 +2,10 @@
 #define UTF8_ISO_8859_3_HEADER_FILE 1
 
 #include "../string.h"
+#include "utf8_encoder.h"
 
 string *iso88593ToUtf8(string * text);
 
+const Utf8Character *getIso88593Utf8Table(void);
+
 #endif
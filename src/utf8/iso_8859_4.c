@@ -1,46 +1,61 @@
 #include "../string.h"
-#include "iso_8859.h"
 #include "iso_8859_4.h"
+#include "utf8_encoder.h"
 
-static unsigned long decodeIso88594Byte(unsigned int byte);
-
-static unsigned long EXTENDED_CHARS_CODEPOINTS[128];
+static const Utf8Character UTF8_CHARACTERS[128];
 
 string *iso88594ToUtf8(text)
 string *text;
 {
-	return transcodeIso8859ToUtf8(text, decodeIso88594Byte);
+	return transcodeSingleByteEncodingToUtf8UsingTable(text,
+							   UTF8_CHARACTERS);
 }
 
-static unsigned long decodeIso88594Byte(byte)
-unsigned int byte;
+const Utf8Character *getIso88594Utf8Table()
 {
-	unsigned long codepoint = EXTENDED_CHARS_CODEPOINTS[byte - 0x80];
-	return codepoint != 0 ? codepoint : byte;
+	return UTF8_CHARACTERS;
 }
 
 /* https://en.wikipedia.org/wiki/ISO/IEC_8859-4 */
-static unsigned long EXTENDED_CHARS_CODEPOINTS[] = {
+static const Utf8Character UTF8_CHARACTERS[] = {
 	/* 0x8x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x80), UTF8(0x81), UTF8(0x82), UTF8(0x83),
+	UTF8(0x84), UTF8(0x85), UTF8(0x86), UTF8(0x87),
+	UTF8(0x88), UTF8(0x89), UTF8(0x8a), UTF8(0x8b),
+	UTF8(0x8c), UTF8(0x8d), UTF8(0x8e), UTF8(0x8f),
 	/* 0x9x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x90), UTF8(0x91), UTF8(0x92), UTF8(0x93),
+	UTF8(0x94), UTF8(0x95), UTF8(0x96), UTF8(0x97),
+	UTF8(0x98), UTF8(0x99), UTF8(0x9a), UTF8(0x9b),
+	UTF8(0x9c), UTF8(0x9d), UTF8(0x9e), UTF8(0x9f),
 	/* 0xAx */
-	0, 0x104, 0x138, 0x156, 0, 0x128, 0x13b,
-	0, 0, 0x160, 0x112, 0x122, 0x166, 0, 0x17d, 0,
+	UTF8(0xa0), UTF8(0x104), UTF8(0x138), UTF8(0x156),
+	UTF8(0xa4), UTF8(0x128), UTF8(0x13b), UTF8(0xa7),
+	UTF8(0xa8), UTF8(0x160), UTF8(0x112), UTF8(0x122),
+	UTF8(0x166), UTF8(0xad), UTF8(0x17d), UTF8(0xaf),
 	/* 0xBx */
-	0, 0x105, 0x2db, 0x157, 0, 0x129, 0x13c, 0x2c7,
-	0, 0x161, 0x113, 0x123, 0x167, 0x14a, 0x17e, 0x14b,
+	UTF8(0xb0), UTF8(0x105), UTF8(0x2db), UTF8(0x157),
+	UTF8(0xb4), UTF8(0x129), UTF8(0x13c), UTF8(0x2c7),
+	UTF8(0xb8), UTF8(0x161), UTF8(0x113), UTF8(0x123),
+	UTF8(0x167), UTF8(0x14a), UTF8(0x17e), UTF8(0x14b),
 	/* 0xCx */
-	0x100, 0, 0, 0, 0, 0, 0, 0x12e,
-	0x10c, 0, 0x118, 0, 0x116, 0, 0, 0x12a,
+	UTF8(0x100), UTF8(0xc1), UTF8(0xc2), UTF8(0xc3),
+	UTF8(0xc4), UTF8(0xc5), UTF8(0xc6), UTF8(0x12e),
+	UTF8(0x10c), UTF8(0xc9), UTF8(0x118), UTF8(0xcb),
+	UTF8(0x116), UTF8(0xcd), UTF8(0xce), UTF8(0x12a),
 	/* 0xDx */
-	0x110, 0x145, 0x14c, 0x136, 0, 0, 0, 0,
-	0, 0x172, 0, 0, 0, 0x168, 0x16a, 0,
+	UTF8(0x110), UTF8(0x145), UTF8(0x14c), UTF8(0x136),
+	UTF8(0xd4), UTF8(0xd5), UTF8(0xd6), UTF8(0xd7),
+	UTF8(0xd8), UTF8(0x172), UTF8(0xda), UTF8(0xdb),
+	UTF8(0xdc), UTF8(0x168), UTF8(0x16a), UTF8(0xdf),
 	/* 0xEx */
-	0x101, 0, 0, 0, 0, 0, 0, 0x12f,
-	0x10d, 0, 0x119, 0, 0x117, 0, 0, 0x12b,
+	UTF8(0x101), UTF8(0xe1), UTF8(0xe2), UTF8(0xe3),
+	UTF8(0xe4), UTF8(0xe5), UTF8(0xe6), UTF8(0x12f),
+	UTF8(0x10d), UTF8(0xe9), UTF8(0x119), UTF8(0xeb),
+	UTF8(0x117), UTF8(0xed), UTF8(0xee), UTF8(0x12b),
 	/* 0xFx */
-	0x111, 0x146, 0x14d, 0x137, 0, 0, 0, 0,
-	0, 0x173, 0, 0, 0, 0x169, 0x16b, 0x2d9
+	UTF8(0x111), UTF8(0x146), UTF8(0x14d), UTF8(0x137),
+	UTF8(0xf4), UTF8(0xf5), UTF8(0xf6), UTF8(0xf7),
+	UTF8(0xf8), UTF8(0x173), UTF8(0xfa), UTF8(0xfb),
+	UTF8(0xfc), UTF8(0x169), UTF8(0x16b), UTF8(0x2d9)
 };
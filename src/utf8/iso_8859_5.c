@@ -1,46 +1,61 @@
 #include "../string.h"
-#include "iso_8859.h"
 #include "iso_8859_5.h"
+#include "utf8_encoder.h"
 
-static unsigned long decodeIso88595Byte(unsigned int byte);
-
-static unsigned long EXTENDED_CHARS_CODEPOINTS[128];
+static const Utf8Character UTF8_CHARACTERS[128];
 
 string *iso88595ToUtf8(text)
 string *text;
 {
-	return transcodeIso8859ToUtf8(text, decodeIso88595Byte);
+	return transcodeSingleByteEncodingToUtf8UsingTable(text,
+							   UTF8_CHARACTERS);
 }
 
-static unsigned long decodeIso88595Byte(byte)
-unsigned int byte;
+const Utf8Character *getIso88595Utf8Table()
 {
-	unsigned long codepoint = EXTENDED_CHARS_CODEPOINTS[byte - 0x80];
-	return codepoint != 0 ? codepoint : byte;
+	return UTF8_CHARACTERS;
 }
 
 /* https://en.wikipedia.org/wiki/ISO/IEC_8859-5 */
-static unsigned long EXTENDED_CHARS_CODEPOINTS[] = {
+static const Utf8Character UTF8_CHARACTERS[] = {
 	/* 0x8x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x80), UTF8(0x81), UTF8(0x82), UTF8(0x83),
+	UTF8(0x84), UTF8(0x85), UTF8(0x86), UTF8(0x87),
+	UTF8(0x88), UTF8(0x89), UTF8(0x8a), UTF8(0x8b),
+	UTF8(0x8c), UTF8(0x8d), UTF8(0x8e), UTF8(0x8f),
 	/* 0x9x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x90), UTF8(0x91), UTF8(0x92), UTF8(0x93),
+	UTF8(0x94), UTF8(0x95), UTF8(0x96), UTF8(0x97),
+	UTF8(0x98), UTF8(0x99), UTF8(0x9a), UTF8(0x9b),
+	UTF8(0x9c), UTF8(0x9d), UTF8(0x9e), UTF8(0x9f),
 	/* 0xAx */
-	0, 0x401, 0x402, 0x403, 0x404, 0x405, 0x406, 0x407,
-	0x408, 0x409, 0x40a, 0x40b, 0x40c, 0, 0x40e, 0x40f,
+	UTF8(0xa0), UTF8(0x401), UTF8(0x402), UTF8(0x403),
+	UTF8(0x404), UTF8(0x405), UTF8(0x406), UTF8(0x407),
+	UTF8(0x408), UTF8(0x409), UTF8(0x40a), UTF8(0x40b),
+	UTF8(0x40c), UTF8(0xad), UTF8(0x40e), UTF8(0x40f),
 	/* 0xBx */
-	0x410, 0x411, 0x412, 0x413, 0x414, 0x415, 0x416, 0x417,
-	0x418, 0x419, 0x41a, 0x41b, 0x41c, 0x41d, 0x41e, 0x41f,
+	UTF8(0x410), UTF8(0x411), UTF8(0x412), UTF8(0x413),
+	UTF8(0x414), UTF8(0x415), UTF8(0x416), UTF8(0x417),
+	UTF8(0x418), UTF8(0x419), UTF8(0x41a), UTF8(0x41b),
+	UTF8(0x41c), UTF8(0x41d), UTF8(0x41e), UTF8(0x41f),
 	/* 0xCx */
-	0x420, 0x421, 0x422, 0x423, 0x424, 0x425, 0x426, 0x427,
-	0x428, 0x429, 0x42a, 0x42b, 0x42c, 0x42d, 0x42e, 0x42f,
+	UTF8(0x420), UTF8(0x421), UTF8(0x422), UTF8(0x423),
+	UTF8(0x424), UTF8(0x425), UTF8(0x426), UTF8(0x427),
+	UTF8(0x428), UTF8(0x429), UTF8(0x42a), UTF8(0x42b),
+	UTF8(0x42c), UTF8(0x42d), UTF8(0x42e), UTF8(0x42f),
 	/* 0xDx */
-	0x430, 0x431, 0x432, 0x433, 0x434, 0x435, 0x436, 0x437,
-	0x438, 0x439, 0x43a, 0x43b, 0x43c, 0x43d, 0x43e, 0x43f,
+	UTF8(0x430), UTF8(0x431), UTF8(0x432), UTF8(0x433),
+	UTF8(0x434), UTF8(0x435), UTF8(0x436), UTF8(0x437),
+	UTF8(0x438), UTF8(0x439), UTF8(0x43a), UTF8(0x43b),
+	UTF8(0x43c), UTF8(0x43d), UTF8(0x43e), UTF8(0x43f),
 	/* 0xEx */
-	0x440, 0x441, 0x442, 0x443, 0x444, 0x445, 0x446, 0x447,
-	0x448, 0x449, 0x44a, 0x44b, 0x44c, 0x44d, 0x44e, 0x44f,
+	UTF8(0x440), UTF8(0x441), UTF8(0x442), UTF8(0x443),
+	UTF8(0x444), UTF8(0x445), UTF8(0x446), UTF8(0x447),
+	UTF8(0x448), UTF8(0x449), UTF8(0x44a), UTF8(0x44b),
+	UTF8(0x44c), UTF8(0x44d), UTF8(0x44e), UTF8(0x44f),
 	/* 0xFx */
-	0x2116, 0x451, 0x452, 0x453, 0x454, 0x455, 0x456, 0x457,
-	0x458, 0x459, 0x45a, 0x45b, 0x45c, 0xa7, 0x45e, 0x45f
+	UTF8(0x2116), UTF8(0x451), UTF8(0x452), UTF8(0x453),
+	UTF8(0x454), UTF8(0x455), UTF8(0x456), UTF8(0x457),
+	UTF8(0x458), UTF8(0x459), UTF8(0x45a), UTF8(0x45b),
+	UTF8(0x45c), UTF8(0xa7), UTF8(0x45e), UTF8(0x45f)
 };
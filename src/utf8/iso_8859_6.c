@@ -1,43 +1,61 @@
 #include "../string.h"
-#include "iso_8859.h"
 #include "iso_8859_6.h"
+#include "utf8_encoder.h"
 
-static unsigned long decodeIso88596Byte(unsigned int byte);
-
-static unsigned long EXTENDED_CHARS_CODEPOINTS[128];
+static const Utf8Character UTF8_CHARACTERS[128];
 
 string *iso88596ToUtf8(text)
 string *text;
 {
-	return transcodeIso8859ToUtf8(text, decodeIso88596Byte);
+	return transcodeSingleByteEncodingToUtf8UsingTable(text,
+							   UTF8_CHARACTERS);
 }
 
-static unsigned long decodeIso88596Byte(byte)
-unsigned int byte;
+const Utf8Character *getIso88596Utf8Table()
 {
-	unsigned long codepoint = EXTENDED_CHARS_CODEPOINTS[byte - 0x80];
-	return codepoint != 0 ? codepoint : byte;
+	return UTF8_CHARACTERS;
 }
 
 /* https://en.wikipedia.org/wiki/ISO/IEC_8859-6 */
-static unsigned long EXTENDED_CHARS_CODEPOINTS[] = {
+static const Utf8Character UTF8_CHARACTERS[] = {
 	/* 0x8x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x80), UTF8(0x81), UTF8(0x82), UTF8(0x83),
+	UTF8(0x84), UTF8(0x85), UTF8(0x86), UTF8(0x87),
+	UTF8(0x88), UTF8(0x89), UTF8(0x8a), UTF8(0x8b),
+	UTF8(0x8c), UTF8(0x8d), UTF8(0x8e), UTF8(0x8f),
 	/* 0x9x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x90), UTF8(0x91), UTF8(0x92), UTF8(0x93),
+	UTF8(0x94), UTF8(0x95), UTF8(0x96), UTF8(0x97),
+	UTF8(0x98), UTF8(0x99), UTF8(0x9a), UTF8(0x9b),
+	UTF8(0x9c), UTF8(0x9d), UTF8(0x9e), UTF8(0x9f),
 	/* 0xAx */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x60c, 0, 0, 0,
+	UTF8(0xa0), UTF8(0xa1), UTF8(0xa2), UTF8(0xa3),
+	UTF8(0xa4), UTF8(0xa5), UTF8(0xa6), UTF8(0xa7),
+	UTF8(0xa8), UTF8(0xa9), UTF8(0xaa), UTF8(0xab),
+	UTF8(0x60c), UTF8(0xad), UTF8(0xae), UTF8(0xaf),
 	/* 0xBx */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x61b, 0, 0, 0, 0x61f,
+	UTF8(0xb0), UTF8(0xb1), UTF8(0xb2), UTF8(0xb3),
+	UTF8(0xb4), UTF8(0xb5), UTF8(0xb6), UTF8(0xb7),
+	UTF8(0xb8), UTF8(0xb9), UTF8(0xba), UTF8(0x61b),
+	UTF8(0xbc), UTF8(0xbd), UTF8(0xbe), UTF8(0x61f),
 	/* 0xCx */
-	0, 0x621, 0x622, 0x623, 0x624, 0x625, 0x626, 0x627,
-	0x628, 0x629, 0x62a, 0x62b, 0x62c, 0x62d, 0x62e, 0x62f,
+	UTF8(0xc0), UTF8(0x621), UTF8(0x622), UTF8(0x623),
+	UTF8(0x624), UTF8(0x625), UTF8(0x626), UTF8(0x627),
+	UTF8(0x628), UTF8(0x629), UTF8(0x62a), UTF8(0x62b),
+	UTF8(0x62c), UTF8(0x62d), UTF8(0x62e), UTF8(0x62f),
 	/* 0xDx */
-	0x630, 0x631, 0x632, 0x633, 0x634, 0x635, 0x636, 0x637,
-	0x638, 0x639, 0x63a, 0, 0, 0, 0, 0,
+	UTF8(0x630), UTF8(0x631), UTF8(0x632), UTF8(0x633),
+	UTF8(0x634), UTF8(0x635), UTF8(0x636), UTF8(0x637),
+	UTF8(0x638), UTF8(0x639), UTF8(0x63a), UTF8(0xdb),
+	UTF8(0xdc), UTF8(0xdd), UTF8(0xde), UTF8(0xdf),
 	/* 0xEx */
-	0x640, 0x641, 0x642, 0x643, 0x644, 0x645, 0x646, 0x647,
-	0x648, 0x649, 0x64a, 0x64b, 0x64c, 0x64d, 0x64e, 0x64f,
+	UTF8(0x640), UTF8(0x641), UTF8(0x642), UTF8(0x643),
+	UTF8(0x644), UTF8(0x645), UTF8(0x646), UTF8(0x647),
+	UTF8(0x648), UTF8(0x649), UTF8(0x64a), UTF8(0x64b),
+	UTF8(0x64c), UTF8(0x64d), UTF8(0x64e), UTF8(0x64f),
 	/* 0xFx */
-	0x650, 0x651, 0x652, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+	UTF8(0x650), UTF8(0x651), UTF8(0x652), UTF8(0xf3),
+	UTF8(0xf4), UTF8(0xf5), UTF8(0xf6), UTF8(0xf7),
+	UTF8(0xf8), UTF8(0xf9), UTF8(0xfa), UTF8(0xfb),
+	UTF8(0xfc), UTF8(0xfd), UTF8(0xfe), UTF8(0xff)
 };
@@ -1,46 +1,61 @@
 #include "../string.h"
-#include "iso_8859.h"
 #include "iso_8859_7.h"
+#include "utf8_encoder.h"
 
-static unsigned long decodeIso88597Byte(unsigned int byte);
-
-static unsigned long EXTENDED_CHARS_CODEPOINTS[128];
+static const Utf8Character UTF8_CHARACTERS[128];
 
 string *iso88597ToUtf8(text)
 string *text;
 {
-	return transcodeIso8859ToUtf8(text, decodeIso88597Byte);
+	return transcodeSingleByteEncodingToUtf8UsingTable(text,
+							   UTF8_CHARACTERS);
 }
 
-static unsigned long decodeIso88597Byte(byte)
-unsigned int byte;
+const Utf8Character *getIso88597Utf8Table()
 {
-	unsigned long codepoint = EXTENDED_CHARS_CODEPOINTS[byte - 0x80];
-	return codepoint != 0 ? codepoint : byte;
+	return UTF8_CHARACTERS;
 }
 
 /* https://en.wikipedia.org/wiki/ISO/IEC_8859-7 */
-static unsigned long EXTENDED_CHARS_CODEPOINTS[] = {
+static const Utf8Character UTF8_CHARACTERS[] = {
 	/* 0x8x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x80), UTF8(0x81), UTF8(0x82), UTF8(0x83),
+	UTF8(0x84), UTF8(0x85), UTF8(0x86), UTF8(0x87),
+	UTF8(0x88), UTF8(0x89), UTF8(0x8a), UTF8(0x8b),
+	UTF8(0x8c), UTF8(0x8d), UTF8(0x8e), UTF8(0x8f),
 	/* 0x9x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x90), UTF8(0x91), UTF8(0x92), UTF8(0x93),
+	UTF8(0x94), UTF8(0x95), UTF8(0x96), UTF8(0x97),
+	UTF8(0x98), UTF8(0x99), UTF8(0x9a), UTF8(0x9b),
+	UTF8(0x9c), UTF8(0x9d), UTF8(0x9e), UTF8(0x9f),
 	/* 0xAx */
-	0, 0x2018, 0x2019, 0, 0x20ac, 0x20af, 0, 0,
-	0, 0, 0x37a, 0, 0, 0, 0, 0x2015,
+	UTF8(0xa0), UTF8(0x2018), UTF8(0x2019), UTF8(0xa3),
+	UTF8(0x20ac), UTF8(0x20af), UTF8(0xa6), UTF8(0xa7),
+	UTF8(0xa8), UTF8(0xa9), UTF8(0x37a), UTF8(0xab),
+	UTF8(0xac), UTF8(0xad), UTF8(0xae), UTF8(0x2015),
 	/* 0xBx */
-	0, 0, 0, 0, 0x384, 0x385, 0x386, 0,
-	0x388, 0x389, 0x38a, 0, 0x38c, 0, 0x38e, 0x38f,
+	UTF8(0xb0), UTF8(0xb1), UTF8(0xb2), UTF8(0xb3),
+	UTF8(0x384), UTF8(0x385), UTF8(0x386), UTF8(0xb7),
+	UTF8(0x388), UTF8(0x389), UTF8(0x38a), UTF8(0xbb),
+	UTF8(0x38c), UTF8(0xbd), UTF8(0x38e), UTF8(0x38f),
 	/* 0xCx */
-	0x390, 0x391, 0x392, 0x393, 0x394, 0x395, 0x396, 0x397,
-	0x398, 0x399, 0x39a, 0x39b, 0x39c, 0x39d, 0x39e, 0x39f,
+	UTF8(0x390), UTF8(0x391), UTF8(0x392), UTF8(0x393),
+	UTF8(0x394), UTF8(0x395), UTF8(0x396), UTF8(0x397),
+	UTF8(0x398), UTF8(0x399), UTF8(0x39a), UTF8(0x39b),
+	UTF8(0x39c), UTF8(0x39d), UTF8(0x39e), UTF8(0x39f),
 	/* 0xDx */
-	0x3a0, 0x3a1, 0, 0x3a3, 0x3a4, 0x3a5, 0x3a6, 0x3a7,
-	0x3a8, 0x3a9, 0x3aa, 0x3ab, 0x3ac, 0x3ad, 0x3ae, 0x3af,
+	UTF8(0x3a0), UTF8(0x3a1), UTF8(0xd2), UTF8(0x3a3),
+	UTF8(0x3a4), UTF8(0x3a5), UTF8(0x3a6), UTF8(0x3a7),
+	UTF8(0x3a8), UTF8(0x3a9), UTF8(0x3aa), UTF8(0x3ab),
+	UTF8(0x3ac), UTF8(0x3ad), UTF8(0x3ae), UTF8(0x3af),
 	/* 0xEx */
-	0x3b0, 0x3b1, 0x3b2, 0x3b3, 0x3b4, 0x3b5, 0x3b6, 0x3b7,
-	0x3b8, 0x3b9, 0x3ba, 0x3bb, 0x3bc, 0x3bd, 0x3be, 0x3bf,
+	UTF8(0x3b0), UTF8(0x3b1), UTF8(0x3b2), UTF8(0x3b3),
+	UTF8(0x3b4), UTF8(0x3b5), UTF8(0x3b6), UTF8(0x3b7),
+	UTF8(0x3b8), UTF8(0x3b9), UTF8(0x3ba), UTF8(0x3bb),
+	UTF8(0x3bc), UTF8(0x3bd), UTF8(0x3be), UTF8(0x3bf),
 	/* 0xFx */
-	0x3c0, 0x3c1, 0x3c2, 0x3c3, 0x3c4, 0x3c5, 0x3c6, 0x3c7,
-	0x3c8, 0x3c9, 0x3ca, 0x3cb, 0x3cc, 0x3cd, 0x3ce, 0,
+	UTF8(0x3c0), UTF8(0x3c1), UTF8(0x3c2), UTF8(0x3c3),
+	UTF8(0x3c4), UTF8(0x3c5), UTF8(0x3c6), UTF8(0x3c7),
+	UTF8(0x3c8), UTF8(0x3c9), UTF8(0x3ca), UTF8(0x3cb),
+	UTF8(0x3cc), UTF8(0x3cd), UTF8(0x3ce), UTF8(0xff)
 };
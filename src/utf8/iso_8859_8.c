@@ -1,42 +1,61 @@
 #include "../string.h"
-#include "iso_8859.h"
 #include "iso_8859_8.h"
+#include "utf8_encoder.h"
 
-static unsigned long decodeIso88598Byte(unsigned int byte);
-
-static unsigned long EXTENDED_CHARS_CODEPOINTS[128];
+static const Utf8Character UTF8_CHARACTERS[128];
 
 string *iso88598ToUtf8(text)
 string *text;
 {
-	return transcodeIso8859ToUtf8(text, decodeIso88598Byte);
+	return transcodeSingleByteEncodingToUtf8UsingTable(text,
+							   UTF8_CHARACTERS);
 }
 
-static unsigned long decodeIso88598Byte(byte)
-unsigned int byte;
+const Utf8Character *getIso88598Utf8Table()
 {
-	unsigned long codepoint = EXTENDED_CHARS_CODEPOINTS[byte - 0x80];
-	return codepoint != 0 ? codepoint : byte;
+	return UTF8_CHARACTERS;
 }
 
 /* https://en.wikipedia.org/wiki/ISO/IEC_8859-8 */
-static unsigned long EXTENDED_CHARS_CODEPOINTS[] = {
+static const Utf8Character UTF8_CHARACTERS[] = {
 	/* 0x8x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x80), UTF8(0x81), UTF8(0x82), UTF8(0x83),
+	UTF8(0x84), UTF8(0x85), UTF8(0x86), UTF8(0x87),
+	UTF8(0x88), UTF8(0x89), UTF8(0x8a), UTF8(0x8b),
+	UTF8(0x8c), UTF8(0x8d), UTF8(0x8e), UTF8(0x8f),
 	/* 0x9x */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0x90), UTF8(0x91), UTF8(0x92), UTF8(0x93),
+	UTF8(0x94), UTF8(0x95), UTF8(0x96), UTF8(0x97),
+	UTF8(0x98), UTF8(0x99), UTF8(0x9a), UTF8(0x9b),
+	UTF8(0x9c), UTF8(0x9d), UTF8(0x9e), UTF8(0x9f),
 	/* 0xAx */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xd7, 0, 0, 0, 0, 0,
+	UTF8(0xa0), UTF8(0xa1), UTF8(0xa2), UTF8(0xa3),
+	UTF8(0xa4), UTF8(0xa5), UTF8(0xa6), UTF8(0xa7),
+	UTF8(0xa8), UTF8(0xa9), UTF8(0xd7), UTF8(0xab),
+	UTF8(0xac), UTF8(0xad), UTF8(0xae), UTF8(0xaf),
 	/* 0xBx */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xf7, 0, 0, 0, 0, 0,
+	UTF8(0xb0), UTF8(0xb1), UTF8(0xb2), UTF8(0xb3),
+	UTF8(0xb4), UTF8(0xb5), UTF8(0xb6), UTF8(0xb7),
+	UTF8(0xb8), UTF8(0xb9), UTF8(0xf7), UTF8(0xbb),
+	UTF8(0xbc), UTF8(0xbd), UTF8(0xbe), UTF8(0xbf),
 	/* 0xCx */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	UTF8(0xc0), UTF8(0xc1), UTF8(0xc2), UTF8(0xc3),
+	UTF8(0xc4), UTF8(0xc5), UTF8(0xc6), UTF8(0xc7),
+	UTF8(0xc8), UTF8(0xc9), UTF8(0xca), UTF8(0xcb),
+	UTF8(0xcc), UTF8(0xcd), UTF8(0xce), UTF8(0xcf),
 	/* 0xDx */
-	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x2017,
+	UTF8(0xd0), UTF8(0xd1), UTF8(0xd2), UTF8(0xd3),
+	UTF8(0xd4), UTF8(0xd5), UTF8(0xd6), UTF8(0xd7),
+	UTF8(0xd8), UTF8(0xd9), UTF8(0xda), UTF8(0xdb),
+	UTF8(0xdc), UTF8(0xdd), UTF8(0xde), UTF8(0x2017),
 	/* 0xEx */
-	0x5d0, 0x5d1, 0x5d2, 0x5d3, 0x5d4, 0x5d5, 0x5d6, 0x5d7,
-	0x5d8, 0x5d9, 0x5da, 0x5db, 0x5dc, 0x5dd, 0x5de, 0x5df,
+	UTF8(0x5d0), UTF8(0x5d1), UTF8(0x5d2), UTF8(0x5d3),
+	UTF8(0x5d4), UTF8(0x5d5), UTF8(0x5d6), UTF8(0x5d7),
+	UTF8(0x5d8), UTF8(0x5d9), UTF8(0x5da), UTF8(0x5db),
+	UTF8(0x5dc), UTF8(0x5dd), UTF8(0x5de), UTF8(0x5df),
 	/* 0xFx */
-	0x5e0, 0x5e1, 0x5e2, 0x5e3, 0x5e4, 0x5e5, 0x5e6, 0x5e7,
-	0x5e8, 0x5e9, 0x5ea, 0, 0, 0x200e, 0x200f, 0,
+	UTF8(0x5e0), UTF8(0x5e1), UTF8(0x5e2), UTF8(0x5e3),
+	UTF8(0x5e4), UTF8(0x5e5), UTF8(0x5e6), UTF8(0x5e7),
+	UTF8(0x5e8), UTF8(0x5e9), UTF8(0x5ea), UTF8(0xfb),
+	UTF8(0xfc), UTF8(0x200e), UTF8(0x200f), UTF8(0xff)
 };
@@ -2,7 +2,10 @@
 #define UTF8_ISO_8859_8_HEADER_FILE 1
 
 #include "../string.h"
+#include "utf8_encoder.h"
 
 string *iso88598ToUtf8(string * text);
 
+const Utf8Character *getIso88598Utf8Table(void);
+
 #endif
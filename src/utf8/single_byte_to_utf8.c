@@ -17,48 +17,70 @@
 #include "iso_8859_16.h"
 #include "single_byte_to_utf8.h"
 #include "us_ascii.h"
+#include "utf8_encoder.h"
+
+static const Utf8Character *getUtf8Table(SingleByteEncoding encoding);
 
 string *transcodeSingleByteEncodedTextToUtf8(inputEncoding, input)
 SingleByteEncoding inputEncoding;
 string *input;
 {
-	if (input == NULL) {
-		return NULL;
-	}
+	return transcodeSingleByteEncodingToUtf8UsingTable(input,
+							   getUtf8Table
+							   (inputEncoding));
+}
+
+unsigned long transcodeSingleByteEncodedTextToUtf8Buffer(inputEncoding, input,
+							 output,
+							 outputCapacity)
+SingleByteEncoding inputEncoding;
+string *input;
+unsigned char *output;
+unsigned long outputCapacity;
+{
+	return transcodeSingleByteEncodingToUtf8Buffer(input,
+						       getUtf8Table
+						       (inputEncoding), output,
+						       outputCapacity);
+}
 
-	switch (inputEncoding) {
+static const Utf8Character *getUtf8Table(encoding)
+SingleByteEncoding encoding;
+{
+	switch (encoding) {
 	case SingleByteEncoding_US_ASCII:
-		return usAsciiToUtf8(input);
+		/* See usAsciiToUtf8 */
+		return getIso88591Utf8Table();
 	case SingleByteEncoding_ISO_8859_1:
-		return iso88591ToUtf8(input);
+		return getIso88591Utf8Table();
 	case SingleByteEncoding_ISO_8859_2:
-		return iso88592ToUtf8(input);
+		return getIso88592Utf8Table();
 	case SingleByteEncoding_ISO_8859_3:
-		return iso88593ToUtf8(input);
+		return getIso88593Utf8Table();
 	case SingleByteEncoding_ISO_8859_4:
-		return iso88594ToUtf8(input);
+		return getIso88594Utf8Table();
 	case SingleByteEncoding_ISO_8859_5:
-		return iso88595ToUtf8(input);
+		return getIso88595Utf8Table();
 	case SingleByteEncoding_ISO_8859_6:
-		return iso88596ToUtf8(input);
+		return getIso88596Utf8Table();
 	case SingleByteEncoding_ISO_8859_7:
-		return iso88597ToUtf8(input);
+		return getIso88597Utf8Table();
 	case SingleByteEncoding_ISO_8859_8:
-		return iso88598ToUtf8(input);
+		return getIso88598Utf8Table();
 	case SingleByteEncoding_ISO_8859_9:
-		return iso88599ToUtf8(input);
+		return getIso88599Utf8Table();
 	case SingleByteEncoding_ISO_8859_10:
-		return iso885910ToUtf8(input);
+		return getIso885910Utf8Table();
 	case SingleByteEncoding_ISO_8859_11:
-		return iso885911ToUtf8(input);
+		return getIso885911Utf8Table();
 	case SingleByteEncoding_ISO_8859_13:
-		return iso885913ToUtf8(input);
+		return getIso885913Utf8Table();
 	case SingleByteEncoding_ISO_8859_14:
-		return iso885914ToUtf8(input);
+		return getIso885914Utf8Table();
 	case SingleByteEncoding_ISO_8859_15:
-		return iso885915ToUtf8(input);
+		return getIso885915Utf8Table();
 	case SingleByteEncoding_ISO_8859_16:
-		return iso885916ToUtf8(input);
+		return getIso885916Utf8Table();
 	default:
 		return NULL;
 	}
@@ -7,4 +7,17 @@
 string *transcodeSingleByteEncodedTextToUtf8(SingleByteEncoding inputEncoding,
 					     string * input);
 
+/*
+ * Transcodes the input to UTF-8 into the provided buffer, see
+ * transcodeSingleByteEncodingToUtf8Buffer for the details. Returns the
+ * length of the whole UTF-8 encoded text, or 0 if the input is NULL or the
+ * encoding is not supported.
+ */
+unsigned long transcodeSingleByteEncodedTextToUtf8Buffer(SingleByteEncoding
+							 inputEncoding,
+							 string * input,
+							 unsigned char *output,
+							 unsigned long
+							 outputCapacity);
+
 #endif
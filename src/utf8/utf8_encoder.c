@@ -1,9 +1,14 @@
 #include <limits.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
+#include "../bool.h"
+#include "../byte_scanner.h"
 #include "../string.h"
 #include "utf8_encoder.h"
 
+static bool encodeCharacter(unsigned long codepoint, Utf8Character * character);
+
 unsigned int getEncodedCodepointLength(codepoint)
 unsigned long codepoint;
 {
@@ -29,46 +34,19 @@ unsigned long codepoint;
 string *encodeCodepoint(codepoint)
 unsigned long codepoint;
 {
-	unsigned int length = getEncodedCodepointLength(codepoint);
+	Utf8Character character;
 	string *result;
 
-	if (length == 0) {
+	if (!encodeCharacter(codepoint, &character)) {
 		return NULL;
 	}
 
-	result = string_new(length);
+	result = string_new(character.length);
 	if (result == NULL) {
 		return NULL;
 	}
 
-	switch (length) {
-	case 1:
-		*result->content = codepoint;
-		break;
-
-	case 2:
-		*result->content = 0xc0 | (codepoint >> 6);
-		*(result->content + 1) = 0x80 | (0x3f & codepoint);
-		break;
-
-	case 3:
-		*result->content = 0xe0 | (codepoint >> 12);
-		*(result->content + 1) = 0x80 | (0x3f & (codepoint >> 6));
-		*(result->content + 2) = 0x80 | (0x3f & codepoint);
-		break;
-
-	case 4:
-		*result->content = 0xf0 | (codepoint >> 18);
-		*(result->content + 1) = 0x80 | (0x3f & (codepoint >> 12));
-		*(result->content + 2) = 0x80 | (0x3f & (codepoint >> 6));
-		*(result->content + 3) = 0x80 | (0x3f & codepoint);
-		break;
-
-	default:
-		string_free(result);
-		return NULL;
-	}
-
+	memcpy(result->content, character.bytes, character.length);
 	return result;
 }
 
@@ -78,7 +56,10 @@ string *input;
 void *codepointDecoderContext;
 CodepointDecoder *codepointDecoder;
 {
-	unsigned long length = 0, i;
+	/* Every byte value is decoded and encoded only once */
+	Utf8Character characters[256];
+	Utf8Character *character;
+	unsigned long codepoint, length = 0, i;
 	unsigned char *inputChar, *outputChar;
 	string *result;
 
@@ -86,16 +67,25 @@ CodepointDecoder *codepointDecoder;
 		return NULL;
 	}
 
+	for (i = 0; i < 256; i++) {
+		characters[i].length = 0;
+	}
+
 	inputChar = input->content;
 	for (i = 0; i < input->length; i++, inputChar++) {
-		unsigned long codepoint, encodedCodepointLength;
-		codepoint =
-		    codepointDecoder(*inputChar, codepointDecoderContext);
-		encodedCodepointLength = getEncodedCodepointLength(codepoint);
-		if (ULONG_MAX - encodedCodepointLength < length) {
+		character = characters + *inputChar;
+		if (character->length == 0) {
+			codepoint =
+			    codepointDecoder(*inputChar,
+					     codepointDecoderContext);
+			if (!encodeCharacter(codepoint, character)) {
+				return NULL;
+			}
+		}
+		if (ULONG_MAX - character->length < length) {
 			return NULL;
 		}
-		length += encodedCodepointLength;
+		length += character->length;
 	}
 
 	result = string_new(length);
@@ -106,22 +96,137 @@ CodepointDecoder *codepointDecoder;
 	inputChar = input->content;
 	outputChar = result->content;
 	for (i = 0; i < input->length; i++, inputChar++) {
-		unsigned long codepoint;
-		string *encodedCodepoint;
-		codepoint =
-		    codepointDecoder(*inputChar, codepointDecoderContext);
-		encodedCodepoint = encodeCodepoint(codepoint);
-		if (encodedCodepoint == NULL) {
-			string_free(result);
-			return NULL;
+		character = characters + *inputChar;
+		memcpy(outputChar, character->bytes, character->length);
+		outputChar += character->length;
+	}
+
+	return result;
+}
+
+unsigned long transcodeSingleByteEncodingToUtf8Buffer(input, upperCharacters,
+						      output, outputCapacity)
+const string *input;
+const Utf8Character *upperCharacters;
+unsigned char *output;
+unsigned long outputCapacity;
+{
+	const unsigned char *inputChar, *inputEnd;
+	const Utf8Character *character;
+	unsigned long length = 0;
+	unsigned long runLength;
+
+	if (input == NULL || upperCharacters == NULL) {
+		return 0;
+	}
+	if (output == NULL) {
+		outputCapacity = 0;
+	}
+
+	inputChar = input->content;
+	inputEnd = inputChar + input->length;
+	while (inputChar < inputEnd) {
+		/* The ASCII characters are encoded the same way in UTF-8 */
+		runLength = getAsciiLength(inputChar, inputEnd - inputChar);
+		if (runLength > 0) {
+			if (length < outputCapacity) {
+				memcpy(output + length, inputChar,
+				       outputCapacity - length < runLength ?
+				       outputCapacity - length : runLength);
+			}
+			length += runLength;
+			inputChar += runLength;
+			continue;
 		}
 
-		memcpy(outputChar, encodedCodepoint->content,
-		       encodedCodepoint->length);
-		outputChar += encodedCodepoint->length;
+		character = upperCharacters + (*inputChar - 0x80);
+		if (length + character->length <= outputCapacity) {
+			memcpy(output + length, character->bytes,
+			       character->length);
+		} else {
+			/* Do not write any characters following this one */
+			outputCapacity = length;
+		}
+		length += character->length;
+		inputChar++;
+	}
 
-		string_free(encodedCodepoint);
+	return length;
+}
+
+string *transcodeSingleByteEncodingToUtf8UsingTable(input, upperCharacters)
+const string *input;
+const Utf8Character *upperCharacters;
+{
+	string *result;
+	unsigned char *shrunkContent;
+	unsigned long capacity;
+
+	if (input == NULL || upperCharacters == NULL
+	    || input->length > ULONG_MAX / 3) {
+		return NULL;
+	}
+
+	/*
+	 * Allocating the largest possible output avoids sizing the output in
+	 * a separate pass, the unused memory is released afterwards.
+	 */
+	capacity = input->length * 3;
+	result = string_new(capacity);
+	if (result == NULL) {
+		return NULL;
+	}
+	if (capacity == 0) {
+		result->content = NULL;
+		return result;
+	}
+
+	result->length =
+	    transcodeSingleByteEncodingToUtf8Buffer(input, upperCharacters,
+						    result->content, capacity);
+	if (result->length < capacity) {
+		shrunkContent = realloc(result->content, result->length);
+		if (shrunkContent != NULL) {
+			result->content = shrunkContent;
+		}
 	}
 
 	return result;
 }
+
+static bool encodeCharacter(codepoint, character)
+unsigned long codepoint;
+Utf8Character *character;
+{
+	unsigned char *bytes = character->bytes;
+
+	character->length = getEncodedCodepointLength(codepoint);
+	switch (character->length) {
+	case 1:
+		bytes[0] = codepoint;
+		break;
+
+	case 2:
+		bytes[0] = 0xc0 | (codepoint >> 6);
+		bytes[1] = 0x80 | (0x3f & codepoint);
+		break;
+
+	case 3:
+		bytes[0] = 0xe0 | (codepoint >> 12);
+		bytes[1] = 0x80 | (0x3f & (codepoint >> 6));
+		bytes[2] = 0x80 | (0x3f & codepoint);
+		break;
+
+	case 4:
+		bytes[0] = 0xf0 | (codepoint >> 18);
+		bytes[1] = 0x80 | (0x3f & (codepoint >> 12));
+		bytes[2] = 0x80 | (0x3f & (codepoint >> 6));
+		bytes[3] = 0x80 | (0x3f & codepoint);
+		break;
+
+	default:
+		return false;
+	}
+
+	return true;
+}
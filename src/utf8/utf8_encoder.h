@@ -9,8 +9,61 @@ string *encodeCodepoint(unsigned long codepoint);
 
 typedef unsigned long CodepointDecoder(unsigned int byte, void *context);
 
+/* The UTF-8 encoded form of a single codepoint */
+typedef struct Utf8Character {
+	unsigned char length;
+	unsigned char bytes[4];
+} Utf8Character;
+
+/*
+ * Expands to the initializer of the Utf8Character encoding the provided
+ * codepoint, which must be in the 0x80 - 0xFFFF range. This allows building
+ * the transcoding tables of the single-byte encodings at compile time.
+ */
+#define UTF8(codepoint) {\
+	(codepoint) < 0x800 ? 2 : 3,\
+	{\
+		(codepoint) < 0x800 ?\
+		    (0xc0 | ((codepoint) >> 6)) : (0xe0 | ((codepoint) >> 12)),\
+		(codepoint) < 0x800 ?\
+		    (0x80 | ((codepoint) & 0x3f)) :\
+		    (0x80 | (((codepoint) >> 6) & 0x3f)),\
+		(codepoint) < 0x800 ? 0 : (0x80 | ((codepoint) & 0x3f)),\
+		0\
+	}\
+}
+
 string *transcodeSingleByteEncodingToUtf8(string * input,
 					  void *codepointDecoderContext,
 					  CodepointDecoder * codepointDecoder);
 
+/*
+ * Transcodes the provided text in a single-byte encoding matching ASCII in
+ * the lower 128 characters to UTF-8, using the table of the UTF-8 encoded
+ * forms of the upper 128 characters (0x80 - 0xFF) of the encoding. The table
+ * entries must be at most 3 bytes long (see UTF8).
+ *
+ * The output is written to the provided buffer, which must not overlap the
+ * input, but no more than outputCapacity bytes (and only whole characters)
+ * are written. The function returns the length of the whole UTF-8 encoded
+ * text, so the output has been truncated if the returned value exceeds the
+ * outputCapacity. Passing a large enough buffer (3 times the length of the
+ * input always suffices) makes this a single pass over the input.
+ */
+unsigned long transcodeSingleByteEncodingToUtf8Buffer(const string * input,
+						      const Utf8Character *
+						      upperCharacters,
+						      unsigned char *output,
+						      unsigned long
+						      outputCapacity);
+
+/*
+ * Same as transcodeSingleByteEncodingToUtf8Buffer, but the output is
+ * returned as a newly allocated string. Returns NULL if the memory
+ * allocation fails or an argument is NULL.
+ */
+string *transcodeSingleByteEncodingToUtf8UsingTable(const string * input,
+						    const Utf8Character *
+						    upperCharacters);
+
 #endif
@@ -0,0 +1,56 @@
+#include "bool.h"
+#include "vector.h"
+#include "warning_policy.h"
+
+Vector *WarningPolicy_record(policy, warnings, warning, mergeWarnings)
+const WarningPolicy *policy;
+Vector *warnings;
+void *warning;
+WarningMerger *mergeWarnings;
+{
+	char *recordedWarning;
+	unsigned long i;
+
+	if (warnings == NULL || warning == NULL) {
+		return NULL;
+	}
+
+	if (policy == NULL) {
+		return Vector_append(warnings, warning);
+	}
+
+	switch (policy->type) {
+	case WarningPolicyType_RECORD_FIRST:
+		if (warnings->size.length >= policy->limit) {
+			return warnings;
+		}
+		break;
+
+	case WarningPolicyType_COALESCE_RUNS:
+		if (warnings->size.length > 0) {
+			recordedWarning = (char *)warnings->items +
+			    (warnings->size.length - 1) *
+			    warnings->size.itemSize;
+			if (mergeWarnings(recordedWarning, warning)) {
+				return warnings;
+			}
+		}
+		break;
+
+	case WarningPolicyType_COUNT_ONLY:
+		/* There are only a few warning codes */
+		recordedWarning = warnings->items;
+		for (i = 0; i < warnings->size.length; i++) {
+			if (mergeWarnings(recordedWarning, warning)) {
+				return warnings;
+			}
+			recordedWarning += warnings->size.itemSize;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return Vector_append(warnings, warning);
+}
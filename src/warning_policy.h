@@ -0,0 +1,58 @@
+#ifndef WARNING_POLICY_HEADER_FILE
+#define WARNING_POLICY_HEADER_FILE 1
+
+#include "bool.h"
+#include "vector.h"
+
+/*
+ * The ways the warnings of a processing stage can be recorded. Every recorded
+ * warning carries the number of warnings it represents, along with the
+ * location of the first and the last of them.
+ */
+typedef enum WarningPolicyType {
+	/* Every warning is recorded on its own, this is the default */
+	WarningPolicyType_RECORD_ALL,
+
+	/*
+	 * At most WarningPolicy.limit warnings are recorded, the following
+	 * warnings are discarded.
+	 */
+	WarningPolicyType_RECORD_FIRST,
+
+	/*
+	 * Consecutive warnings of the same code are recorded as a single
+	 * warning, e.g. a run of undecodable bytes is recorded as one warning.
+	 */
+	WarningPolicyType_COALESCE_RUNS,
+
+	/*
+	 * A single warning is recorded for every warning code, counting all
+	 * warnings of that code.
+	 */
+	WarningPolicyType_COUNT_ONLY
+} WarningPolicyType;
+
+typedef struct WarningPolicy {
+	WarningPolicyType type;
+	/* The maximum number of recorded warnings (RECORD_FIRST only) */
+	unsigned long limit;
+} WarningPolicy;
+
+/*
+ * Merges the warning into the recorded warning and returns true if both are
+ * of the same code, returns false and leaves both intact otherwise.
+ */
+typedef bool WarningMerger(void *recordedWarning, const void *warning);
+
+/*
+ * Records the warning into the vector of warnings according to the policy,
+ * the default policy is used if the policy is NULL. The merger is used to
+ * coalesce the warnings of the same code.
+ *
+ * Returns the possibly reallocated vector, or NULL if the memory for the
+ * warning could not be allocated (the vector is left intact in such case).
+ */
+Vector *WarningPolicy_record(const WarningPolicy * policy, Vector * warnings,
+			     void *warning, WarningMerger * mergeWarnings);
+
+#endif
@@ -0,0 +1,124 @@
+#include <stddef.h>
+#include "bool.h"
+#include "whitespace.h"
+
+/*
+ * The whitespace is recognized by a DFA processing at most 3 bytes. To keep
+ * the transition table small, the input bytes are first mapped to one of the
+ * following classes, telling apart only the bytes that occur in whitespace:
+ *
+ *  0: any other byte
+ *  1: '\t', '\v', '\f', ' '
+ *  2: '\r'
+ *  3: '\n'
+ *  4-7: 0xC2, 0xE1, 0xE2, 0xE3 (UTF-8 lead bytes)
+ *  8-10: 0x80, 0x81, 0x85
+ *  11: 0x82-0x84, 0x86-0x8A
+ *  12-14: 0x9A, 0x9F, 0xA0
+ *  15: 0xA8, 0xA9, 0xAF
+ *
+ * Bytes beyond the end of the input are treated as class 0.
+ */
+#define BYTE_CLASS_COUNT 16
+
+static const unsigned char BYTE_CLASSES[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 3, 1, 1, 2, 0, 0,	/* 0x00-0x0F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x10-0x1F */
+	1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x20-0x2F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x30-0x3F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x40-0x4F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x50-0x5F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x60-0x6F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x70-0x7F */
+	8, 9, 11, 11, 11, 10, 11, 11, 11, 11, 11, 0, 0, 0, 0, 0,	/* 0x80-0x8F */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 12, 0, 0, 0, 0, 13,	/* 0x90-0x9F */
+	14, 0, 0, 0, 0, 0, 0, 0, 15, 15, 0, 0, 0, 0, 0, 15,	/* 0xA0-0xAF */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0xB0-0xBF */
+	0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0xC0-0xCF */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0xD0-0xDF */
+	0, 5, 6, 7, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0xE0-0xEF */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0	/* 0xF0-0xFF */
+};
+
+/* DFA states */
+#define UT 0			/* start in UTF-8 */
+#define SB 1			/* start in a single-byte encoding */
+#define CR 2			/* after '\r' */
+#define C2 3			/* after 0xC2 */
+#define E1 4			/* after 0xE1 */
+#define E1_9A 5			/* after 0xE1 0x9A */
+#define E2 6			/* after 0xE2 */
+#define E2_80 7			/* after 0xE2 0x80 */
+#define E2_81 8			/* after 0xE2 0x81 */
+#define E3 9			/* after 0xE3 */
+#define E3_80 10		/* after 0xE3 0x80 */
+
+/* Final states, carrying the length of the recognized whitespace */
+#define FINAL 0x80
+#define NO (FINAL | 0)
+#define L1 (FINAL | 1)
+#define L2 (FINAL | 2)
+#define L3 (FINAL | 3)
+
+static const unsigned char TRANSITIONS[][BYTE_CLASS_COUNT] = {
+	/* UT */
+	{NO, L1, CR, L1, C2, E1, E2, E3,
+	 NO, NO, NO, NO, NO, NO, NO, NO},
+	/* SB, ISO-8859-* has only one extra white-space above 127 (NBSP) */
+	{NO, L1, CR, L1, NO, NO, NO, NO,
+	 NO, NO, NO, NO, NO, NO, L1, NO},
+	/* CR, CRLF is meant to be formatted as a single space character */
+	{L1, L1, L1, L2, L1, L1, L1, L1,
+	 L1, L1, L1, L1, L1, L1, L1, L1},
+	/* C2: next line, no-break space */
+	{NO, NO, NO, NO, NO, NO, NO, NO,
+	 NO, NO, L2, NO, NO, NO, L2, NO},
+	/* E1 */
+	{NO, NO, NO, NO, NO, NO, NO, NO,
+	 NO, NO, NO, NO, E1_9A, NO, NO, NO},
+	/* E1_9A: ogham space mark */
+	{NO, NO, NO, NO, NO, NO, NO, NO,
+	 L3, NO, NO, NO, NO, NO, NO, NO},
+	/* E2 */
+	{NO, NO, NO, NO, NO, NO, NO, NO,
+	 E2_80, E2_81, NO, NO, NO, NO, NO, NO},
+	/*
+	 * E2_80: en quad - hair space, line separator, paragraph separator,
+	 * narrow no-break space
+	 */
+	{NO, NO, NO, NO, NO, NO, NO, NO,
+	 L3, L3, L3, L3, NO, NO, NO, L3},
+	/* E2_81: medium mathematical space */
+	{NO, NO, NO, NO, NO, NO, NO, NO,
+	 NO, NO, NO, NO, NO, L3, NO, NO},
+	/* E3 */
+	{NO, NO, NO, NO, NO, NO, NO, NO,
+	 E3_80, NO, NO, NO, NO, NO, NO, NO},
+	/* E3_80: ideographic space */
+	{NO, NO, NO, NO, NO, NO, NO, NO,
+	 L3, NO, NO, NO, NO, NO, NO, NO}
+};
+
+unsigned long getWhitespaceLength(bytes, length, isUtf8)
+const unsigned char *bytes;
+unsigned long length;
+bool isUtf8;
+{
+	unsigned char state;
+
+	if (bytes == NULL || length == 0) {
+		return 0;
+	}
+
+	/* Every path through the DFA reaches a final state within 3 bytes */
+	state = TRANSITIONS[isUtf8 ? UT : SB][BYTE_CLASSES[bytes[0]]];
+	if (state & FINAL) {
+		return state & ~FINAL;
+	}
+	state = TRANSITIONS[state][BYTE_CLASSES[length > 1 ? bytes[1] : 0]];
+	if (state & FINAL) {
+		return state & ~FINAL;
+	}
+	state = TRANSITIONS[state][BYTE_CLASSES[length > 2 ? bytes[2] : 0]];
+	return state & ~FINAL;
+}
@@ -0,0 +1,19 @@
+#ifndef WHITESPACE_HEADER_FILE
+#define WHITESPACE_HEADER_FILE 1
+
+#include "bool.h"
+
+/*
+ * Returns the length in bytes of the whitespace character at the start of
+ * the provided input, or 0 if the input does not start with whitespace. CRLF
+ * is treated as a single whitespace character.
+ *
+ * The input is treated as UTF-8 if isUtf8 is set, and as one of the
+ * supported single-byte encodings (ASCII and ISO-8859-*) otherwise. See
+ * https://en.wikipedia.org/wiki/Whitespace_character#Unicode for the list of
+ * recognized Unicode whitespace characters.
+ */
+unsigned long getWhitespaceLength(const unsigned char *bytes,
+				  unsigned long length, bool isUtf8);
+
+#endif
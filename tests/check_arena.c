@@ -0,0 +1,73 @@
+#include <string.h>
+#include "../src/arena.h"
+#include "unit.h"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+START_TEST(Arena_allocate_placesAllocationsNextToEachOther)
+{
+	Arena *arena = Arena_new(0);
+	char *first;
+	char *second;
+	char *third;
+
+	assert(arena != NULL, "Expected an arena");
+	first = Arena_allocate(arena, 3);
+	second = Arena_allocate(arena, 3);
+	third = Arena_allocate(arena, sizeof(double));
+	assert(first != NULL && second != NULL && third != NULL,
+	       "Expected the memory to be allocated");
+	assert(second > first && second - first < 64 && third > second
+	       && third - second < 64, "Expected consecutive allocations");
+	assert((second - first) % sizeof(double) == 0
+	       && (third - second) % sizeof(double) == 0,
+	       "Expected aligned allocations");
+	memcpy(first, "abc", 3);
+	memcpy(second, "def", 3);
+	assert(memcmp(first, "abc", 3) == 0,
+	       "Expected the allocations not to overlap");
+	Arena_free(arena);
+END_TEST}
+
+START_TEST(Arena_allocate_allocatesNewBlocksAsNeeded)
+{
+	Arena *arena = Arena_new(256);
+	char *small;
+	char *large;
+	char *next;
+	unsigned long i;
+
+	small = Arena_allocate(arena, 16);
+	large = Arena_allocate(arena, 1000);
+	next = Arena_allocate(arena, 16);
+	assert(small != NULL && large != NULL && next != NULL,
+	       "Expected the memory to be allocated");
+	assert(next - small == 16,
+	       "Expected large allocation not to waste the current block");
+	memset(large, 'x', 1000);
+
+	for (i = 0; i < 100; i++) {
+		assert(Arena_allocate(arena, 24) != NULL,
+		       "Expected the memory to be allocated");
+	}
+	assert(Arena_allocate(NULL, 1) == NULL, "Expected NULL for NULL arena");
+	Arena_free(arena);
+	Arena_free(NULL);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(Arena_allocate_placesAllocationsNextToEachOther);
+	runTest(Arena_allocate_allocatesNewBlocksAsNeeded);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
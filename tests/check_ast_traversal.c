@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../src/ast_node.h"
+#include "../src/ast_node_pointer_vector.h"
+#include "../src/ast_traversal.h"
+#include "../src/parser.h"
+#include "../src/string.h"
+#include "../src/tokenizer.h"
+#include "unit.h"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+static ParserResult *parseString(string * input);
+
+static string *nestedCommands(unsigned long depth);
+
+/*
+ * Appends the first character of the values of the visited nodes to the
+ * buffer, in upper case on entering and in lower case on leaving the node.
+ */
+static void visit(ASTTraversal * traversal, ASTNodePointerVector * nodes,
+		  char *buffer, char skippedNodeValue);
+
+START_TEST(ASTTraversal_next_visitsNodesInDocumentOrder)
+{
+	ParserResult *result = parseString(string_from("<a><b>c</b>d</a><nl>"));
+	ASTTraversal *traversal = ASTTraversal_new();
+	char buffer[32];
+
+	assert(traversal != NULL, "Expected a traversal");
+	visit(traversal, result->result.nodes, buffer, '\0');
+	assertCStringEquals("visited nodes", buffer, "ABCcbDdaNn");
+
+	/* The traversal can be reused */
+	visit(traversal, result->result.nodes->items[0]->children, buffer,
+	      '\0');
+	assertCStringEquals("visited children", buffer, "BCcbDd");
+
+	ASTTraversal_free(traversal);
+	ParserResult_free(result);
+END_TEST}
+
+START_TEST(ASTTraversal_skipChildren_leavesEnteredNode)
+{
+	ParserResult *result = parseString(string_from("<a><b>c</b>d</a><nl>"));
+	ASTTraversal *traversal = ASTTraversal_new();
+	char buffer[32];
+
+	visit(traversal, result->result.nodes, buffer, 'b');
+	assertCStringEquals("visited nodes", buffer, "ABbDdaNn");
+	visit(traversal, result->result.nodes, buffer, 'a');
+	assertCStringEquals("visited nodes", buffer, "AaNn");
+
+	ASTTraversal_free(traversal);
+	ParserResult_free(result);
+END_TEST}
+
+START_TEST(ASTTraversal_getParent_returnsParentOfCurrentNode)
+{
+	ParserResult *result = parseString(string_from("<a><b>c</b></a>"));
+	ASTTraversal *traversal = ASTTraversal_new();
+	ASTNode *a = result->result.nodes->items[0];
+	ASTNode *b = a->children->items[0];
+	ASTNode *node;
+
+	ASTTraversal_start(traversal, result->result.nodes);
+	assert(ASTTraversal_next(traversal, &node) == ASTTraversalStep_ENTER
+	       && node == a, "Expected a to be entered");
+	assert(ASTTraversal_getParent(traversal) == NULL,
+	       "Expected no parent of a");
+	assertUnsignedLongEquals("depth of a",
+				 ASTTraversal_getDepth(traversal), 0);
+	ASTTraversal_next(traversal, &node);
+	ASTTraversal_next(traversal, &node);
+	assert(node == b->children->items[0], "Expected c to be entered");
+	assert(ASTTraversal_getParent(traversal) == b, "Expected parent b");
+	assertUnsignedLongEquals("depth of c",
+				 ASTTraversal_getDepth(traversal), 2);
+	assert(ASTTraversal_next(traversal, &node) == ASTTraversalStep_LEAVE
+	       && node == b->children->items[0], "Expected c to be left");
+	assert(ASTTraversal_next(traversal, &node) == ASTTraversalStep_LEAVE
+	       && node == b, "Expected b to be left");
+	assert(ASTTraversal_getParent(traversal) == a, "Expected parent a");
+	assert(ASTTraversal_next(traversal, &node) == ASTTraversalStep_LEAVE
+	       && node == a, "Expected a to be left");
+	assert(ASTTraversal_next(traversal, &node) == ASTTraversalStep_END
+	       && node == NULL, "Expected the end of the traversal");
+	assert(ASTTraversal_next(traversal, &node) == ASTTraversalStep_END,
+	       "Expected the traversal to stay at its end");
+
+	ASTTraversal_free(traversal);
+	ParserResult_free(result);
+END_TEST}
+
+START_TEST(ASTTraversal_next_handlesNullInput)
+{
+	ASTTraversal *traversal = ASTTraversal_new();
+	ASTNodePointerVector *nodes = ASTNodePointerVector_new(0, 1);
+	ASTNode *nullNode = NULL;
+	ASTNode *node;
+
+	ASTTraversal_start(traversal, NULL);
+	assert(ASTTraversal_next(traversal, &node) == ASTTraversalStep_END,
+	       "Expected no nodes to be visited");
+
+	nodes = ASTNodePointerVector_append(nodes, &nullNode);
+	ASTTraversal_start(traversal, nodes);
+	assert(ASTTraversal_next(traversal, &node) == ASTTraversalStep_ENTER
+	       && node == NULL, "Expected the NULL node to be entered");
+	assert(ASTTraversal_next(traversal, &node) == ASTTraversalStep_LEAVE
+	       && node == NULL, "Expected the NULL node to be left");
+	assert(ASTTraversal_next(traversal, &node) == ASTTraversalStep_END,
+	       "Expected the end of the traversal");
+
+	assert(ASTTraversal_next(NULL, &node) == ASTTraversalStep_END,
+	       "Expected the END step for NULL traversal");
+	ASTTraversal_start(NULL, nodes);
+	ASTTraversal_skipChildren(NULL);
+	assert(ASTTraversal_getParent(NULL) == NULL,
+	       "Expected no parent for NULL traversal");
+	ASTTraversal_free(NULL);
+	ASTTraversal_free(traversal);
+	ASTNodePointerVector_free(nodes);
+END_TEST}
+
+START_TEST(ASTTraversal_next_handlesDeeplyNestedNodes)
+{
+	unsigned long depth = 1000000;
+	string *input = nestedCommands(depth);
+	ParserResult *result = parseString(input);
+	ASTTraversal *traversal = ASTTraversal_new();
+	ASTTraversalStep step;
+	ASTNode *node;
+	unsigned long entered = 0;
+	unsigned long left = 0;
+	unsigned long maxDepth = 0;
+
+	ASTTraversal_start(traversal, result->result.nodes);
+	for (step = ASTTraversal_next(traversal, &node);
+	     step == ASTTraversalStep_ENTER || step == ASTTraversalStep_LEAVE;
+	     step = ASTTraversal_next(traversal, &node)) {
+		if (step == ASTTraversalStep_ENTER) {
+			entered++;
+			if (ASTTraversal_getDepth(traversal) > maxDepth) {
+				maxDepth = ASTTraversal_getDepth(traversal);
+			}
+		} else {
+			left++;
+		}
+	}
+
+	assert(step == ASTTraversalStep_END, "Expected the traversal to end");
+	assertUnsignedLongEquals("entered nodes", entered, depth + 1);
+	assertUnsignedLongEquals("left nodes", left, depth + 1);
+	assertUnsignedLongEquals("maximum depth", maxDepth, depth);
+
+	ASTTraversal_free(traversal);
+	ParserResult_free(result);
+	string_free(input);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(ASTTraversal_next_visitsNodesInDocumentOrder);
+	runTest(ASTTraversal_skipChildren_leavesEnteredNode);
+	runTest(ASTTraversal_getParent_returnsParentOfCurrentNode);
+	runTest(ASTTraversal_next_handlesNullInput);
+	runTest(ASTTraversal_next_handlesDeeplyNestedNodes);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
+
+static ParserResult *parseString(input)
+string *input;
+{
+	TokenizerResult *tokenizerResult;
+	ParserOptions options;
+	ParserResult *result;
+
+	options.useArena = true;
+	options.maxNestingDepth = 0;
+	result = tokenizeAndParse(input, false, false, NULL, &options,
+				  &tokenizerResult);
+	TokenizerResult_free(tokenizerResult);
+	return result;
+}
+
+static string *nestedCommands(depth)
+unsigned long depth;
+{
+	string *input = string_new(depth * 7 + 1);
+	unsigned char *content = input->content;
+	unsigned long i;
+
+	for (i = 0; i < depth; i++, content += 3) {
+		memcpy(content, "<x>", 3);
+	}
+	*content = 'a';
+	content++;
+	for (i = 0; i < depth; i++, content += 4) {
+		memcpy(content, "</x>", 4);
+	}
+	return input;
+}
+
+static void visit(traversal, nodes, buffer, skippedNodeValue)
+ASTTraversal *traversal;
+ASTNodePointerVector *nodes;
+char *buffer;
+char skippedNodeValue;
+{
+	ASTTraversalStep step;
+	ASTNode *node;
+	unsigned long length = 0;
+	char value;
+
+	ASTTraversal_start(traversal, nodes);
+	for (step = ASTTraversal_next(traversal, &node);
+	     step == ASTTraversalStep_ENTER || step == ASTTraversalStep_LEAVE;
+	     step = ASTTraversal_next(traversal, &node)) {
+		value = (char)node->value->content[0];
+		if (step == ASTTraversalStep_ENTER) {
+			buffer[length] = (char)(value - 'a' + 'A');
+			if (value == skippedNodeValue) {
+				ASTTraversal_skipChildren(traversal);
+			}
+		} else {
+			buffer[length] = value;
+		}
+		length++;
+	}
+
+	buffer[length] = '\0';
+}
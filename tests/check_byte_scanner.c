@@ -0,0 +1,306 @@
+#include <string.h>
+#include "../src/bool.h"
+#include "../src/byte_scanner.h"
+#include "unit.h"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+START_TEST(getPlainTextLength_returns0ForNullOrEmptyInput)
+{
+	assertUnsignedLongEquals("length of NULL", getPlainTextLength(NULL, 5),
+				 0);
+	assertUnsignedLongEquals("length of empty input",
+				 getPlainTextLength((unsigned char *)"abc", 0),
+				 0);
+END_TEST}
+
+START_TEST(getPlainTextLength_stopsAtEverySpecialByte)
+{
+	unsigned char input[128];
+	const char *specialBytes = "<> \t\n\v\f\r";
+	unsigned long specialByteIndex;
+	unsigned long position;
+	unsigned char byte;
+
+	/*
+	   Every special byte is tested at every position to exercise both the
+	   block scanning and the per-byte scanning regardless of the block size.
+	 */
+	for (specialByteIndex = 0; specialBytes[specialByteIndex] != 0;
+	     specialByteIndex++) {
+		for (position = 0; position < sizeof(input); position++) {
+			memset(input, 'a', sizeof(input));
+			input[position] = specialBytes[specialByteIndex];
+			assertUnsignedLongEquals("plain text length",
+						 getPlainTextLength(input,
+								    sizeof
+								    (input)),
+						 position);
+		}
+	}
+
+	for (byte = 128; byte != 0; byte++) {
+		memset(input, 'a', sizeof(input));
+		input[byte - 128] = byte;
+		assertUnsignedLongEquals("plain text length",
+					 getPlainTextLength(input,
+							    sizeof(input)),
+					 byte - 128);
+	}
+END_TEST}
+
+START_TEST(getPlainTextLength_acceptsAllOtherAsciiCharacters)
+{
+	unsigned char input[200];
+	unsigned long length = 0;
+	unsigned char byte;
+
+	for (byte = 0; byte < 128; byte++) {
+		if (strchr("<> \t\n\v\f\r", byte) == NULL) {
+			input[length] = byte;
+			length++;
+		}
+	}
+	/* The NUL byte is matched by strchr, so we add it explicitly */
+	input[length] = 0;
+	length++;
+
+	assertUnsignedLongEquals("plain text length",
+				 getPlainTextLength(input, length), length);
+	assertUnsignedLongEquals("plain text length of an unaligned slice",
+				 getPlainTextLength(input + 3, length - 3),
+				 length - 3);
+END_TEST}
+
+START_TEST(getAsciiLength_stopsAtFirstNonAsciiByte)
+{
+	unsigned char input[128];
+	unsigned long position;
+	unsigned int byte;
+
+	assertUnsignedLongEquals("length of NULL", getAsciiLength(NULL, 5), 0);
+	for (byte = 128; byte < 256; byte++) {
+		for (position = 0; position < sizeof(input); position++) {
+			memset(input, byte - 128, sizeof(input));
+			input[position] = byte;
+			assertUnsignedLongEquals("ASCII length",
+						 getAsciiLength(input,
+								sizeof(input)),
+						 position);
+		}
+	}
+	memset(input, 127, sizeof(input));
+	assertUnsignedLongEquals("ASCII length of ASCII-only input",
+				 getAsciiLength(input + 1, sizeof(input) - 1),
+				 sizeof(input) - 1);
+END_TEST}
+
+START_TEST(getUtf8SequenceLength_recognizesWellFormedCharacters)
+{
+	/* length, expected length, well-formed, bytes */
+	static char *sequences[] = {
+		"1", "1", "y", "\177",
+		"2", "2", "y", "\302\200",
+		"2", "2", "y", "\337\277",
+		"3", "3", "y", "\340\240\200",
+		"3", "3", "y", "\355\237\277",
+		"3", "3", "y", "\356\200\200",
+		"4", "4", "y", "\360\220\200\200",
+		"4", "4", "y", "\364\217\277\277",
+		"1", "1", "n", "\200",
+		"1", "1", "n", "\277",
+		"2", "1", "n", "\300\200",
+		"2", "1", "n", "\301\277",
+		"3", "1", "n", "\340\200\200",
+		"3", "1", "n", "\340\237\277",
+		"3", "1", "n", "\355\240\200",
+		"4", "1", "n", "\360\200\200\200",
+		"4", "1", "n", "\364\220\200\200",
+		"4", "1", "n", "\365\200\200\200",
+		"1", "1", "n", "\377",
+		"2", "1", "n", "\302a",
+		"3", "2", "n", "\342\202a",
+		"2", "2", "n", "\342\202",
+		"3", "3", "n", "\360\237\230",
+		"4", "3", "n", "\360\237\230\302",
+		NULL
+	};
+	char **sequence;
+	bool isWellFormed;
+	unsigned long length;
+
+	assertUnsignedLongEquals("length of NULL",
+				 getUtf8SequenceLength(NULL, 3, &isWellFormed),
+				 0);
+	for (sequence = sequences; *sequence != NULL; sequence += 4) {
+		length =
+		    getUtf8SequenceLength((unsigned char *)sequence[3],
+					  (unsigned long)atoi(sequence[0]),
+					  &isWellFormed);
+		assertUnsignedLongEquals("sequence length", length,
+					 (unsigned long)atoi(sequence[1]));
+		assert(isWellFormed == (*sequence[2] == 'y'),
+		       "Expected the sequence to be (not) well-formed");
+	}
+END_TEST}
+
+START_TEST(getUtf8TextLength_countsCodepointsOfWellFormedText)
+{
+	/* Includes non-whitespace characters starting like whitespace */
+	static char *characters[] = {
+		"a", "\177", "\302\200", "\302\251", "\337\277", "\340\240\200",
+		"\342\200\234", "\342\201\260", "\343\200\202", "\343\201\202",
+		"\355\237\277", "\356\200\200", "\357\277\277", "\341\232\201",
+		"\360\220\200\200", "\360\237\230\200", "\364\217\277\277", NULL
+	};
+	char **character;
+	unsigned char input[1000];
+	unsigned long length = 0;
+	unsigned long characterCount = 0;
+	unsigned long textLength;
+	unsigned long codepointCount;
+
+	/* Long enough to make every character occur at every block offset */
+	while (length < sizeof(input) - 4) {
+		for (character = characters;
+		     *character != NULL && length < sizeof(input) - 4;
+		     character++) {
+			memcpy(input + length, *character, strlen(*character));
+			length += strlen(*character);
+			characterCount++;
+			textLength =
+			    getUtf8TextLength(input, length, &codepointCount);
+			assertUnsignedLongEquals("UTF-8 text length",
+						 textLength, length);
+			assertUnsignedLongEquals("codepoint count",
+						 codepointCount,
+						 characterCount);
+		}
+	}
+
+	assertUnsignedLongEquals("length of NULL",
+				 getUtf8TextLength(NULL, 5, &codepointCount),
+				 0);
+	assertUnsignedLongEquals("codepoint count of NULL", codepointCount, 0);
+END_TEST}
+
+START_TEST(getUtf8TextLength_stopsAtEveryIllFormedOrSpecialSequence)
+{
+	/* Three characters in six bytes */
+	char *characters = "a\305\276\342\200\234";
+	static char *stopSequences[] = {
+		"<", ">", " ", "\t", "\n", "\v", "\f", "\r", "\200", "\300\200",
+		"\301\277", "\340\200\257", "\355\240\200", "\360\200\200\200",
+		"\364\220\200\200", "\370\210\200\200\200", "\377", "\302a",
+		"\342\202a", "\302\205", "\302\240", "\341\232\200",
+		"\342\200\200", "\342\200\250", "\342\201\237", "\343\200\200",
+		NULL
+	};
+	char **stopSequence;
+	unsigned char input[300];
+	unsigned long prefixLength;
+	unsigned long stopSequenceLength;
+	unsigned long codepointCount;
+	unsigned long length;
+
+	/*
+	   Every sequence is tested at every character boundary to exercise
+	   both the block validation and the per-character validation
+	   regardless of the block size.
+	 */
+	for (stopSequence = stopSequences; *stopSequence != NULL;
+	     stopSequence++) {
+		stopSequenceLength = strlen(*stopSequence);
+		for (prefixLength = 0; prefixLength < 200; prefixLength += 6) {
+			memset(input, 'b', sizeof(input));
+			memcpy(input + prefixLength, *stopSequence,
+			       stopSequenceLength);
+			for (length = 0; length < prefixLength; length += 6) {
+				memcpy(input + length, characters, 6);
+			}
+			length = getUtf8TextLength(input, sizeof(input),
+						   &codepointCount);
+			assertUnsignedLongEquals(*stopSequence, length,
+						 prefixLength);
+			assertUnsignedLongEquals("codepoint count",
+						 codepointCount,
+						 prefixLength / 2);
+		}
+	}
+
+	/* Truncated characters at the end of the input */
+	memcpy(input, characters, 6);
+	memcpy(input + 6, "\360\237\230\200", 4);
+	for (length = 6; length < 10; length++) {
+		assertUnsignedLongEquals("length of truncated input",
+					 getUtf8TextLength(input, length,
+							   &codepointCount),
+					 6);
+	}
+END_TEST}
+
+START_TEST(countBoundaryBytes_countsExactlyTheBoundaryBytes)
+{
+	unsigned char input[600];
+	unsigned long expected[601];
+	unsigned long i;
+	unsigned long start;
+	unsigned long end;
+	unsigned long count;
+
+	/* Every byte value occurs at multiple positions within the blocks */
+	expected[0] = 0;
+	for (i = 0; i < sizeof(input); i++) {
+		input[i] = (unsigned char)(i * 7);
+		expected[i + 1] = expected[i]
+		    + (strchr("< \t\n\v\f\r\240\302\341\342\343", input[i]) !=
+		       NULL && input[i] != 0 ? 1 : 0);
+	}
+
+	assertUnsignedLongEquals("count for NULL", countBoundaryBytes(NULL, 3),
+				 0);
+	for (start = 0; start < 40; start++) {
+		for (end = start; end <= sizeof(input); end++) {
+			count = countBoundaryBytes(input + start, end - start);
+			assertUnsignedLongEquals("boundary byte count", count,
+						 expected[end] -
+						 expected[start]);
+		}
+	}
+END_TEST}
+
+START_TEST(countBoundaryBytes_countsLongRunsOfBoundaryBytes)
+{
+	unsigned long length = 100000;
+	unsigned char *input = malloc(length);
+
+	/* Long enough to overflow any 8-bit per-lane counters */
+	memset(input, ' ', length);
+	assertUnsignedLongEquals("boundary byte count",
+				 countBoundaryBytes(input, length), length);
+	free(input);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(getPlainTextLength_returns0ForNullOrEmptyInput);
+	runTest(getPlainTextLength_stopsAtEverySpecialByte);
+	runTest(getPlainTextLength_acceptsAllOtherAsciiCharacters);
+	runTest(getAsciiLength_stopsAtFirstNonAsciiByte);
+	runTest(getUtf8SequenceLength_recognizesWellFormedCharacters);
+	runTest(getUtf8TextLength_countsCodepointsOfWellFormedText);
+	runTest(getUtf8TextLength_stopsAtEveryIllFormedOrSpecialSequence);
+	runTest(countBoundaryBytes_countsExactlyTheBoundaryBytes);
+	runTest(countBoundaryBytes_countsLongRunsOfBoundaryBytes);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/bool.h"
+#include "../src/codepoint_index.h"
+#include "unit.h"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+START_TEST(CodepointIndex_of_countsCodepointsLikeTokenizer)
+{
+	char *input = "a\342\202z\200\360\237\230\200\r\nb";
+	CodepointIndex *index =
+	    CodepointIndex_new((unsigned char *)input, strlen(input), true);
+	static unsigned long expected[] = { 0, 1, 2, 2, 3, 4, 5, 5, 5, 5, 6, 7,
+		8, 8
+	};
+	unsigned long byteIndex;
+
+	assert(index != NULL, "Expected an index");
+	for (byteIndex = 0; byteIndex < 14; byteIndex++) {
+		assertUnsignedLongEquals("codepoint index",
+					 CodepointIndex_of(index, byteIndex),
+					 expected[byteIndex]);
+	}
+	CodepointIndex_free(index);
+END_TEST}
+
+START_TEST(CodepointIndex_of_countsBytesOfSingleByteEncodings)
+{
+	unsigned long length = 3 * CODEPOINT_INDEX_CHECKPOINT_DISTANCE;
+	unsigned char *input = malloc(length);
+	CodepointIndex *index;
+	unsigned long i;
+
+	for (i = 0; i < length; i += 2) {
+		input[i] = 0xC5;
+		input[i + 1] = 0xBE;
+	}
+	index = CodepointIndex_new(input, length, true);
+	assertUnsignedLongEquals("UTF-8 input",
+				 CodepointIndex_of(index, length), length / 2);
+
+	/* The checkpoints following the change are counted again */
+	assert(CodepointIndex_setEncoding(index, 1000, false),
+	       "Expected the encoding to be changed");
+	assertUnsignedLongEquals("partially single-byte encoded input",
+				 CodepointIndex_of(index, length),
+				 500 + length - 1000);
+	assertUnsignedLongEquals("start of the single-byte encoded text",
+				 CodepointIndex_of(index, 1000), 500);
+	assertUnsignedLongEquals("single-byte encoded text",
+				 CodepointIndex_of(index, 1001), 501);
+	assert(CodepointIndex_setEncoding(index, 2000, true),
+	       "Expected the encoding to be changed back");
+	assertUnsignedLongEquals("input with a single-byte encoded part",
+				 CodepointIndex_of(index, length),
+				 500 + 1000 + (length - 2000) / 2);
+
+	CodepointIndex_free(index);
+	free(input);
+END_TEST}
+
+START_TEST(CodepointIndex_of_acceptsNullIndexAndIndexesBeyondInput)
+{
+	CodepointIndex *index =
+	    CodepointIndex_new((unsigned char *)"abc", 3, true);
+
+	assertUnsignedLongEquals("NULL index", CodepointIndex_of(NULL, 2), 0);
+	assertUnsignedLongEquals("beyond the input",
+				 CodepointIndex_of(index, 100), 3);
+	CodepointIndex_free(index);
+	CodepointIndex_free(NULL);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(CodepointIndex_of_countsCodepointsLikeTokenizer);
+	runTest(CodepointIndex_of_countsBytesOfSingleByteEncodings);
+	runTest(CodepointIndex_of_acceptsNullIndexAndIndexesBeyondInput);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
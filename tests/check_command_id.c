@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include "../src/bool.h"
+#include "../src/command_id.h"
+#include "../src/string.h"
+#include "unit.h"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+static CommandId getCommandId(char *name);
+
+static char *STANDARD_COMMANDS[] = {
+	"", "", "lt", "nl", "np", "Bold", "Italic", "Fixed", "Smaller",
+	"Bigger", "Underline", "Subscript", "Superscript", "Center",
+	"FlushLeft", "FlushRight", "Indent", "IndentRight", "Outdent",
+	"OutdentRight", "Excerpt", "Signature", "Paragraph", "SamePage",
+	"Heading", "Footing", "Comment", "No-op", "US-ASCII", "ISO-8859-1",
+	"ISO-8859-2", "ISO-8859-3", "ISO-8859-4", "ISO-8859-5", "ISO-8859-6",
+	"ISO-8859-7", "ISO-8859-8", "ISO-8859-9", "ISO-8859-10", "ISO-8859-11",
+	"ISO-8859-13", "ISO-8859-14", "ISO-8859-15", "ISO-8859-16", NULL
+};
+
+START_TEST(CommandId_fromName_recognizesStandardCommands)
+{
+	unsigned int id;
+
+	for (id = CommandId_LT; STANDARD_COMMANDS[id] != NULL; id++) {
+		assertUnsignedLongEquals(STANDARD_COMMANDS[id],
+					 getCommandId(STANDARD_COMMANDS[id]),
+					 id);
+	}
+	assertUnsignedLongEquals("last command id", id - 1,
+				 CommandId_ISO_8859_16);
+END_TEST}
+
+START_TEST(CommandId_fromName_flagsCaseMismatchedStandardCommands)
+{
+	assertUnsignedLongEquals("LT", getCommandId("LT"),
+				 CommandId_LT | CommandId_CASE_MISMATCH);
+	assertUnsignedLongEquals("bold", getCommandId("bold"),
+				 CommandId_BOLD | CommandId_CASE_MISMATCH);
+	assertUnsignedLongEquals("sAMEpAGE", getCommandId("sAMEpAGE"),
+				 CommandId_SAME_PAGE | CommandId_CASE_MISMATCH);
+	assertUnsignedLongEquals("iso-8859-1", getCommandId("iso-8859-1"),
+				 CommandId_ISO_8859_1 |
+				 CommandId_CASE_MISMATCH);
+	assertUnsignedLongEquals("us-ascii", getCommandId("us-ascii"),
+				 CommandId_US_ASCII | CommandId_CASE_MISMATCH);
+END_TEST}
+
+START_TEST(CommandId_fromName_returnsCustomForOtherNames)
+{
+	static char *names[] = {
+		"", "l", "ltt", "Bol", "Bolds", "Blod", "ISO-8859-0",
+		"ISO-8859-12", "ISO-8859-17", "ISO-8859-100", "US_ASCII",
+		"Noop", "FlushRightt", "OutdentRightt", "B\303\266ld", "foo",
+		NULL
+	};
+	char **name;
+
+	for (name = names; *name != NULL; name++) {
+		assertUnsignedLongEquals(*name, getCommandId(*name),
+					 CommandId_CUSTOM);
+	}
+	assertUnsignedLongEquals("NULL", CommandId_fromName(NULL),
+				 CommandId_CUSTOM);
+END_TEST}
+
+START_TEST(CommandId_resolve_honorsCaseSensitivity)
+{
+	CommandId bold = CommandId_BOLD;
+	CommandId mismatchedBold = getCommandId("BOLD");
+
+	assertUnsignedLongEquals("Bold, case-sensitive",
+				 CommandId_resolve(bold, false),
+				 CommandId_BOLD);
+	assertUnsignedLongEquals("Bold, case-insensitive",
+				 CommandId_resolve(bold, true), CommandId_BOLD);
+	assertUnsignedLongEquals("BOLD, case-sensitive",
+				 CommandId_resolve(mismatchedBold, false),
+				 CommandId_CUSTOM);
+	assertUnsignedLongEquals("BOLD, case-insensitive",
+				 CommandId_resolve(mismatchedBold, true),
+				 CommandId_BOLD);
+	assertUnsignedLongEquals("NONE",
+				 CommandId_resolve(CommandId_NONE, false),
+				 CommandId_NONE);
+	assertUnsignedLongEquals("CUSTOM",
+				 CommandId_resolve(CommandId_CUSTOM, true),
+				 CommandId_CUSTOM);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(CommandId_fromName_recognizesStandardCommands);
+	runTest(CommandId_fromName_flagsCaseMismatchedStandardCommands);
+	runTest(CommandId_fromName_returnsCustomForOtherNames);
+	runTest(CommandId_resolve_honorsCaseSensitivity);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
+
+static CommandId getCommandId(name)
+char *name;
+{
+	string *nameString = string_from(name);
+	CommandId id = CommandId_fromName(nameString);
+	string_free(nameString);
+	return id;
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include "../src/ast_node.h"
+#include "../src/bool.h"
+#include "../src/custom_command_cache.h"
+#include "../src/custom_command_layout_interpretation.h"
+#include "../src/string.h"
+#include "unit.h"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+static CustomCommandLayoutInterpretation interpreter(ASTNode * node,
+						     bool caseInsensitive);
+
+static CustomCommandLayoutInterpretation otherInterpreter(ASTNode * node,
+							  bool caseInsensitive);
+
+START_TEST(CustomCommandCache_get_returnsCachedInterpretations)
+{
+	CustomCommandCache *cache = CustomCommandCache_new();
+	CustomCommandLayoutInterpretation interpretation;
+	CustomCommandLayoutInterpretation NEW_BLOCK =
+	    CustomCommandLayoutInterpretation_NEW_BLOCK;
+	CustomCommandLayoutInterpretation NEW_LINE =
+	    CustomCommandLayoutInterpretation_NEW_LINE;
+
+	assert(cache != NULL, "Expected a cache");
+	assert(!CustomCommandCache_get(cache, string_from("X-Block"), false,
+				       &interpretation),
+	       "Expected no cached interpretation");
+	assert(CustomCommandCache_put(cache, string_from("X-Block"), false,
+				      NEW_BLOCK)
+	       && CustomCommandCache_put(cache, string_from("X-Line"), true,
+					 NEW_LINE),
+	       "Expected the interpretations to be cached");
+	assertUnsignedLongEquals("cached names",
+				 CustomCommandCache_getLength(cache), 2);
+
+	assert(CustomCommandCache_get(cache, string_from("X-Block"), false,
+				      &interpretation)
+	       && interpretation == NEW_BLOCK,
+	       "Expected the cached NEW_BLOCK interpretation");
+	assert(!CustomCommandCache_get(cache, string_from("x-block"), false,
+				       &interpretation),
+	       "Expected the case sensitive names to differ in case");
+	assert(!CustomCommandCache_get(cache, string_from("X-Block"), true,
+				       &interpretation),
+	       "Expected the name to differ in the case sensitivity");
+	assert(CustomCommandCache_get(cache, string_from("x-LINE"), true,
+				      &interpretation)
+	       && interpretation == NEW_LINE,
+	       "Expected the case insensitive name to ignore the case");
+	CustomCommandCache_free(cache);
+END_TEST}
+
+START_TEST(CustomCommandCache_put_growsTheCache)
+{
+	CustomCommandCache *cache = CustomCommandCache_new();
+	CustomCommandLayoutInterpretation interpretation;
+	char name[16];
+	unsigned long i;
+
+	for (i = 0; i < 1000; i++) {
+		sprintf(name, "X-%lu", i);
+		interpretation = (CustomCommandLayoutInterpretation) (i % 9);
+		assert(CustomCommandCache_put(cache, string_from(name), false,
+					      interpretation),
+		       "Expected the interpretation to be cached");
+	}
+	assertUnsignedLongEquals("cached names",
+				 CustomCommandCache_getLength(cache), 1000);
+	for (i = 0; i < 1000; i++) {
+		sprintf(name, "X-%lu", i);
+		assert(CustomCommandCache_get(cache, string_from(name), false,
+					      &interpretation)
+		       && interpretation ==
+		       (CustomCommandLayoutInterpretation) (i % 9),
+		       "Expected the cached interpretation");
+	}
+	CustomCommandCache_free(cache);
+END_TEST}
+
+START_TEST(CustomCommandCache_bind_clearsCacheOfOtherInterpreter)
+{
+	CustomCommandCache *cache = CustomCommandCache_new();
+	CustomCommandLayoutInterpretation interpretation;
+
+	CustomCommandCache_bind(cache, interpreter);
+	CustomCommandCache_put(cache, string_from("X-Block"), false,
+			       CustomCommandLayoutInterpretation_NEW_BLOCK);
+	CustomCommandCache_bind(cache, interpreter);
+	assert(CustomCommandCache_get(cache, string_from("X-Block"), false,
+				      &interpretation),
+	       "Expected the cache of the same interpreter to be kept");
+	CustomCommandCache_bind(cache, otherInterpreter);
+	assert(!CustomCommandCache_get(cache, string_from("X-Block"), false,
+				       &interpretation),
+	       "Expected the cache of another interpreter to be cleared");
+	assertUnsignedLongEquals("cached names",
+				 CustomCommandCache_getLength(cache), 0);
+	CustomCommandCache_free(cache);
+END_TEST}
+
+START_TEST(CustomCommandCache_bind_releasesMemoryOfOtherInterpreter)
+{
+	CustomCommandCache *cache = CustomCommandCache_new();
+	unsigned long initialSize = CustomCommandCache_getMemorySize(cache);
+	char name[16];
+	unsigned long i;
+
+	CustomCommandCache_bind(cache, interpreter);
+	for (i = 0; i < 1000; i++) {
+		sprintf(name, "X-%lu", i);
+		CustomCommandCache_put(cache, string_from(name), false,
+				       CustomCommandLayoutInterpretation_NO_OP);
+	}
+	assert(CustomCommandCache_getMemorySize(cache) > initialSize * 10,
+	       "Expected the cache to grow");
+	CustomCommandCache_bind(cache, otherInterpreter);
+	assertUnsignedLongEquals("memory size",
+				 CustomCommandCache_getMemorySize(cache),
+				 initialSize);
+
+	assert(CustomCommandCache_put(cache, string_from("X-Block"), false,
+				      CustomCommandLayoutInterpretation_NO_OP),
+	       "Expected the cleared cache to be usable");
+	assertUnsignedLongEquals("cached names",
+				 CustomCommandCache_getLength(cache), 1);
+	CustomCommandCache_free(cache);
+END_TEST}
+
+START_TEST(CustomCommandCache_put_clearsFullCache)
+{
+	CustomCommandCache *cache = CustomCommandCache_new();
+	CustomCommandLayoutInterpretation interpretation;
+	CustomCommandLayoutInterpretation NO_OP =
+	    CustomCommandLayoutInterpretation_NO_OP;
+	char name[16];
+	unsigned long i;
+
+	for (i = 0; i <= 65536; i++) {
+		sprintf(name, "X-%lu", i);
+		assert(CustomCommandCache_put(cache, string_from(name), false,
+					      NO_OP),
+		       "Expected the interpretation to be cached");
+	}
+	assertUnsignedLongEquals("cached names",
+				 CustomCommandCache_getLength(cache), 1);
+	assert(CustomCommandCache_get(cache, string_from(name), false,
+				      &interpretation),
+	       "Expected the last name to be cached");
+	assert(!CustomCommandCache_get(cache, string_from("X-0"), false,
+				       &interpretation),
+	       "Expected the first name to be dropped");
+	CustomCommandCache_free(cache);
+END_TEST}
+
+START_TEST(CustomCommandCache_handlesNullInput)
+{
+	CustomCommandLayoutInterpretation interpretation;
+
+	assert(!CustomCommandCache_get(NULL, string_from("X"), false,
+				       &interpretation),
+	       "Expected no interpretation cached in NULL cache");
+	assert(!CustomCommandCache_put(NULL, string_from("X"), false,
+				       CustomCommandLayoutInterpretation_NO_OP),
+	       "Expected no interpretation to be cached in NULL cache");
+	assertUnsignedLongEquals("cached names",
+				 CustomCommandCache_getLength(NULL), 0);
+	assertUnsignedLongEquals("memory size",
+				 CustomCommandCache_getMemorySize(NULL), 0);
+	CustomCommandCache_bind(NULL, interpreter);
+	CustomCommandCache_free(NULL);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(CustomCommandCache_get_returnsCachedInterpretations);
+	runTest(CustomCommandCache_put_growsTheCache);
+	runTest(CustomCommandCache_bind_clearsCacheOfOtherInterpreter);
+	runTest(CustomCommandCache_bind_releasesMemoryOfOtherInterpreter);
+	runTest(CustomCommandCache_put_clearsFullCache);
+	runTest(CustomCommandCache_handlesNullInput);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
+
+static CustomCommandLayoutInterpretation interpreter(node, caseInsensitive)
+ASTNode *node;
+bool caseInsensitive;
+{
+	(void)node;
+	(void)caseInsensitive;
+	return CustomCommandLayoutInterpretation_NO_OP;
+}
+
+static CustomCommandLayoutInterpretation otherInterpreter(node,
+							  caseInsensitive)
+ASTNode *node;
+bool caseInsensitive;
+{
+	(void)node;
+	(void)caseInsensitive;
+	return CustomCommandLayoutInterpretation_INVALID_COMMAND;
+}
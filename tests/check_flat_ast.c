@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include "../src/ast_node.h"
+#include "../src/ast_node_pointer_vector.h"
+#include "../src/ast_node_type.h"
+#include "../src/bool.h"
+#include "../src/flat_ast.h"
+#include "../src/json/ast_node.h"
+#include "../src/json/json_encoder.h"
+#include "../src/json/json_value.h"
+#include "../src/json/layout_block.h"
+#include "../src/layout_resolver.h"
+#include "../src/parser.h"
+#include "../src/string.h"
+#include "../src/tokenizer.h"
+#include "unit.h"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+static ParserResult *parseString(const char *input);
+
+static string *nodesToJSON(ASTNodePointerVector * nodes);
+
+static string *layoutToJSON(ASTNodePointerVector * nodes);
+
+static char *_assertFlatNode(char *fileName, unsigned int line, FlatAST * ast,
+			     unsigned long index, unsigned long parent,
+			     unsigned long firstChild,
+			     unsigned long nextSibling,
+			     unsigned long subtreeEnd, char *value);
+
+#define assertFlatNode(ast, index, parent, firstChild, nextSibling,\
+		       subtreeEnd, value)\
+do {\
+	char *_assertError = _assertFlatNode(__FILE__, __LINE__, ast, index,\
+					     parent, firstChild, nextSibling,\
+					     subtreeEnd, value);\
+	if (_assertError != NULL) {\
+		return _assertError;\
+	}\
+} while (0)
+
+START_TEST(FlatAST_fromNodes_storesNodesInDocumentOrder)
+{
+	ParserResult *parserResult =
+	    parseString("<bold>a<nl> b</bold><x>c</x>");
+	FlatAST *ast = FlatAST_fromNodes(parserResult->result.nodes);
+	unsigned long NO_NODE = FLAT_AST_NO_NODE;
+
+	ParserResult_free(parserResult);
+	assert(ast != NULL, "Expected a flat AST");
+	assertUnsignedLongEquals("node count", ast->length, 7);
+	assertFlatNode(ast, 0, NO_NODE, 1, 5, 5, "bold");
+	assertFlatNode(ast, 1, 0, NO_NODE, 2, 2, "a");
+	assertFlatNode(ast, 2, 0, NO_NODE, 3, 3, "nl");
+	assertFlatNode(ast, 3, 0, NO_NODE, 4, 4, " ");
+	assertFlatNode(ast, 4, 0, NO_NODE, NO_NODE, 5, "b");
+	assertFlatNode(ast, 5, NO_NODE, 6, NO_NODE, 7, "x");
+	assertFlatNode(ast, 6, 5, NO_NODE, NO_NODE, 7, "c");
+	assert(ast->nodes[2].type == ASTNodeType_COMMAND
+	       && ast->nodes[2].commandId == CommandId_NL,
+	       "Expected the nl command node");
+	assertUnsignedLongEquals("byteIndex of c", ast->nodes[6].byteIndex,
+				 23);
+	FlatAST_free(ast);
+
+	assert(FlatAST_fromNodes(NULL) == NULL, "Expected NULL for NULL");
+	FlatAST_free(NULL);
+END_TEST}
+
+START_TEST(FlatAST_toNodes_createsEqualTree)
+{
+	ParserResult *parserResult =
+	    parseString("<Bold>a <x>b<Nl><y></y></x></Bold><lt> c");
+	FlatAST *ast = FlatAST_fromNodes(parserResult->result.nodes);
+	ASTNodePointerVector *nodes = FlatAST_toNodes(ast);
+	string *expectedJSON = nodesToJSON(parserResult->result.nodes);
+	string *json = nodesToJSON(nodes);
+	ASTNode *x;
+
+	assert(nodes != NULL, "Expected the node tree to be created");
+	assert(string_compare(json, expectedJSON) == 0,
+	       "Expected the same node tree");
+	assert(FlatAST_toNodes(ast) == nodes,
+	       "Expected the node tree to be created only once");
+
+	x = nodes->items[0]->children->items[2];
+	assertUnsignedLongEquals("index of x", FlatAST_indexOf(ast, x), 3);
+	assert(x->parent == nodes->items[0], "Expected x's parent");
+	assert(FlatAST_indexOf(ast, parserResult->result.nodes->items[0]) ==
+	       FLAT_AST_NO_NODE, "Expected NO_NODE for a foreign node");
+	ParserResult_free(parserResult);
+	FlatAST_free(ast);
+
+	parserResult = parseString("");
+	ast = FlatAST_fromNodes(parserResult->result.nodes);
+	nodes = FlatAST_toNodes(ast);
+	assert(nodes != NULL && nodes->size.length == 0,
+	       "Expected empty node tree");
+	FlatAST_free(ast);
+	ParserResult_free(parserResult);
+END_TEST}
+
+START_TEST(FlatAST_toNodes_isConsumableByResolveLayout)
+{
+	ParserResult *parserResult =
+	    parseString
+	    ("<center>Title</center><nl><nl><Indent><bold>a</bold> b<Excerpt>c<nl>d</Excerpt></Indent><Comment>e<x>f</x></Comment><np><Heading>g</Heading>h  i");
+	FlatAST *ast = FlatAST_fromNodes(parserResult->result.nodes);
+	string *expectedJSON = layoutToJSON(parserResult->result.nodes);
+	string *json = layoutToJSON(FlatAST_toNodes(ast));
+
+	assert(expectedJSON != NULL && json != NULL,
+	       "Expected the layouts to be resolved");
+	assert(string_compare(json, expectedJSON) == 0,
+	       "Expected the same layout");
+	ParserResult_free(parserResult);
+	FlatAST_free(ast);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(FlatAST_fromNodes_storesNodesInDocumentOrder);
+	runTest(FlatAST_toNodes_createsEqualTree);
+	runTest(FlatAST_toNodes_isConsumableByResolveLayout);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
+
+static ParserResult *parseString(input)
+const char *input;
+{
+	string *richtext = string_from(input);
+	TokenizerResult *tokenizerResult = tokenize(richtext, true, true);
+	ParserResult *result = parse(tokenizerResult->result.tokens, true);
+
+	TokenizerResult_free(tokenizerResult);
+	string_free(richtext);
+	return result;
+}
+
+static string *nodesToJSON(nodes)
+ASTNodePointerVector *nodes;
+{
+	/* The JSON shares the values of the nodes, so it is not freed */
+	return JSON_encode(ASTNodePointerVector_toJSON(nodes));
+}
+
+static string *layoutToJSON(nodes)
+ASTNodePointerVector *nodes;
+{
+	LayoutResolverResult *result = resolveLayout(nodes, NULL, true);
+	JSONValue *value;
+	string *json;
+
+	if (result == NULL
+	    || result->type != LayoutResolverResultType_SUCCESS) {
+		return NULL;
+	}
+
+	/* The JSON shares the values of the nodes, so it is not freed */
+	value = LayoutBlockVector_toJSON(result->result.blocks);
+	json = JSON_encode(value);
+	LayoutResolverResult_free(result);
+	return json;
+}
+
+static char *_assertFlatNode(fileName, line, ast, index, parent, firstChild,
+			     nextSibling, subtreeEnd, value)
+char *fileName;
+unsigned int line;
+FlatAST *ast;
+unsigned long index;
+unsigned long parent;
+unsigned long firstChild;
+unsigned long nextSibling;
+unsigned long subtreeEnd;
+char *value;
+{
+	FlatASTNode *node = ast->nodes + index;
+	string *expectedValue = string_from(value);
+	bool isValueEqual =
+	    string_compare(ast->values + index, expectedValue) == 0;
+
+	string_free(expectedValue);
+	if (node->parent != parent) {
+		return unit_assertUnsignedLongEquals(fileName, line, "parent",
+						     node->parent, parent);
+	}
+	if (node->firstChild != firstChild) {
+		return unit_assertUnsignedLongEquals(fileName, line,
+						     "firstChild",
+						     node->firstChild,
+						     firstChild);
+	}
+	if (node->nextSibling != nextSibling) {
+		return unit_assertUnsignedLongEquals(fileName, line,
+						     "nextSibling",
+						     node->nextSibling,
+						     nextSibling);
+	}
+	if (node->subtreeEnd != subtreeEnd) {
+		return unit_assertUnsignedLongEquals(fileName, line,
+						     "subtreeEnd",
+						     node->subtreeEnd,
+						     subtreeEnd);
+	}
+	return unit_assert(fileName, line, isValueEqual,
+			   "Expected the node's value");
+}
@@ -0,0 +1,181 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/bool.h"
+#include "../src/input_file.h"
+#include "unit.h"
+
+#define TEST_FILE_PATH "/tmp/richtext-processor-check-input-file.txt"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+static bool writeTestFile(const char *content);
+
+START_TEST(InputFile_open_mapsRegularFiles)
+{
+	char *content = "Hello <bold>world</bold>";
+	InputFile *file;
+
+	assert(writeTestFile(content), "Expected the test file to be written");
+	file = InputFile_open(TEST_FILE_PATH);
+	remove(TEST_FILE_PATH);
+	assert(file != NULL
+	       && file->errorCode == InputFileErrorCode_OK,
+	       "Expected the file to be loaded");
+	assert(file->isMapped, "Expected the file to be memory-mapped");
+	assertUnsignedLongEquals("content length", file->content.length,
+				 strlen(content));
+	assert(memcmp(file->content.content, content, strlen(content)) == 0,
+	       "Expected the file's content");
+	InputFile_free(file);
+END_TEST}
+
+START_TEST(InputFile_open_readsEmptyFiles)
+{
+	InputFile *file;
+
+	assert(writeTestFile(""), "Expected the test file to be written");
+	file = InputFile_open(TEST_FILE_PATH);
+	remove(TEST_FILE_PATH);
+	assert(file != NULL
+	       && file->errorCode == InputFileErrorCode_OK,
+	       "Expected the file to be loaded");
+	assert(!file->isMapped, "Expected the empty file to be read");
+	assertUnsignedLongEquals("content length", file->content.length, 0);
+	InputFile_free(file);
+END_TEST}
+
+START_TEST(InputFile_open_reportsMissingFiles)
+{
+	InputFile *file;
+
+	remove(TEST_FILE_PATH);
+	file = InputFile_open(TEST_FILE_PATH);
+	assert(file != NULL
+	       && file->errorCode == InputFileErrorCode_CANNOT_OPEN_FILE,
+	       "Expected CANNOT_OPEN_FILE error");
+	assert(file->systemErrorCode == ENOENT, "Expected ENOENT errno");
+	InputFile_free(file);
+	InputFile_free(NULL);
+END_TEST}
+
+START_TEST(InputFile_fromDescriptor_loadsRestOfFile)
+{
+	char *content = "Hello <bold>world</bold>";
+	char buffer[6];
+	int fileDescriptor;
+	InputFile *file;
+
+	assert(writeTestFile(content), "Expected the test file to be written");
+	fileDescriptor = open(TEST_FILE_PATH, O_RDONLY);
+	remove(TEST_FILE_PATH);
+	assert(fileDescriptor != -1, "Expected the test file to be opened");
+	assert(read(fileDescriptor, buffer, 6) == 6,
+	       "Expected the start of the file to be read");
+	file = InputFile_fromDescriptor(fileDescriptor);
+	assert(file != NULL
+	       && file->errorCode == InputFileErrorCode_OK,
+	       "Expected the file to be loaded");
+	assert(!file->isMapped, "Expected the unaligned rest to be read");
+	assertUnsignedLongEquals("content length", file->content.length,
+				 strlen(content) - 6);
+	assert(memcmp(file->content.content, content + 6,
+		      strlen(content) - 6) == 0,
+	       "Expected the rest of the file's content");
+	InputFile_free(file);
+	close(fileDescriptor);
+END_TEST}
+
+START_TEST(InputFile_fromDescriptor_mapsRestOfFileFromPageBoundary)
+{
+	long pageSize = sysconf(_SC_PAGESIZE);
+	char *content = malloc((size_t) pageSize + 6);
+	int fileDescriptor;
+	InputFile *file;
+
+	memset(content, 'a', (size_t) pageSize);
+	strcpy(content + pageSize, "<nl>b");
+	assert(writeTestFile(content), "Expected the test file to be written");
+	fileDescriptor = open(TEST_FILE_PATH, O_RDONLY);
+	remove(TEST_FILE_PATH);
+	assert(fileDescriptor != -1, "Expected the test file to be opened");
+	assert(lseek(fileDescriptor, pageSize, SEEK_SET) == pageSize,
+	       "Expected the file offset to be set");
+	file = InputFile_fromDescriptor(fileDescriptor);
+	assert(file != NULL
+	       && file->errorCode == InputFileErrorCode_OK,
+	       "Expected the file to be loaded");
+	assert(file->isMapped, "Expected the aligned rest to be mapped");
+	assertUnsignedLongEquals("content length", file->content.length, 5);
+	assert(memcmp(file->content.content, "<nl>b", 5) == 0,
+	       "Expected the rest of the file's content");
+	assert(lseek(fileDescriptor, 0, SEEK_CUR) == pageSize + 5,
+	       "Expected the file offset at the end of the file");
+	InputFile_free(file);
+	close(fileDescriptor);
+	free(content);
+END_TEST}
+
+START_TEST(InputFile_fromDescriptor_readsPipes)
+{
+	char *content = "<italic>piped</italic> text";
+	int pipeDescriptors[2];
+	InputFile *file;
+
+	assert(pipe(pipeDescriptors) == 0, "Expected a pipe");
+	assert(write(pipeDescriptors[1], content, strlen(content)) ==
+	       (ssize_t) strlen(content), "Expected the content to be written");
+	close(pipeDescriptors[1]);
+	file = InputFile_fromDescriptor(pipeDescriptors[0]);
+	close(pipeDescriptors[0]);
+	assert(file != NULL
+	       && file->errorCode == InputFileErrorCode_OK,
+	       "Expected the pipe to be read");
+	assert(!file->isMapped, "Expected the pipe to be read into a buffer");
+	assertUnsignedLongEquals("content length", file->content.length,
+				 strlen(content));
+	assert(memcmp(file->content.content, content, strlen(content)) == 0,
+	       "Expected the piped content");
+	InputFile_free(file);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(InputFile_open_mapsRegularFiles);
+	runTest(InputFile_open_readsEmptyFiles);
+	runTest(InputFile_open_reportsMissingFiles);
+	runTest(InputFile_fromDescriptor_loadsRestOfFile);
+	runTest(InputFile_fromDescriptor_mapsRestOfFileFromPageBoundary);
+	runTest(InputFile_fromDescriptor_readsPipes);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
+
+static bool writeTestFile(content)
+const char *content;
+{
+	FILE *file = fopen(TEST_FILE_PATH, "wb");
+	size_t length = strlen(content);
+	bool isWritten;
+
+	if (file == NULL) {
+		return false;
+	}
+
+	isWritten = fwrite(content, 1, length, file) == length;
+	return fclose(file) == 0 && isWritten;
+}
@@ -1,9 +1,12 @@
 #include <limits.h>
 #include <stdio.h>
+#include <string.h>
 #include "../src/ast_node.h"
 #include "../src/ast_node_pointer_vector.h"
 #include "../src/ast_node_type.h"
 #include "../src/bool.h"
+#include "../src/command_id.h"
+#include "../src/custom_command_cache.h"
 #include "../src/custom_command_layout_interpretation.h"
 #include "../src/layout_block.h"
 #include "../src/layout_block_type.h"
@@ -17,6 +20,9 @@
 #include "../src/layout_paragraph_type.h"
 #include "../src/layout_paragraph_vector.h"
 #include "../src/layout_resolver.h"
+#include "../src/layout_segment_marker_stack.h"
+#include "../src/layout_segment_style.h"
+#include "../src/layout_segment_style_table.h"
 #include "../src/tokenizer.h"
 #include "../src/parser.h"
 #include "../src/string.h"
@@ -31,7 +37,7 @@ unsigned int tests_run = 0;
 unsigned int tests_failed = 0;
 
 static char *STRINGIFIED_WARNING_CODES[2];
-static char *STRINGIFIED_ERROR_CODES[31];
+static char *STRINGIFIED_ERROR_CODES[33];
 static char *STRINGIFIED_AST_NODE_TYPE[3];
 static char *STRINGIFIED_LAYOUT_CONTENT_ALIGNMENT[4];
 static char *STRINGIFIED_LAYOUT_PARAGRAPH_TYPE[2];
@@ -155,6 +161,22 @@ static LayoutResolverResult *process(const char *richtext,
 				     customCommandInterpreter(ASTNode *, bool),
 				     bool caseInsensitiveCommands);
 
+static ASTNodePointerVector *parseNodes(const char *richtext,
+					bool caseInsensitiveCommands);
+
+/* The blocks received by the testing block sink */
+typedef struct SunkBlocks {
+	unsigned long count;
+	unsigned long segments;
+	LayoutBlockType types[8];
+	/* The number of blocks to accept before failing */
+	unsigned long limit;
+	/* The style of the first sunk segment, NULL if none was sunk yet */
+	const LayoutSegmentStyle *firstStyle;
+} SunkBlocks;
+
+static bool sinkBlock(LayoutBlock * block, void *context);
+
 static ASTNode *makeNode(unsigned long byteIndex, unsigned long codepointIndex,
 			 unsigned long tokenIndex, ASTNodeType type,
 			 char *value, ASTNode * parent, ASTNode * childNodes[]);
@@ -167,6 +189,12 @@ static ASTNode *newNode(unsigned long byteIndex, unsigned long codepointIndex,
 static CustomCommandLayoutInterpretation
 _testingCommandInterpreter(ASTNode * node, bool caseInsensitive);
 
+/* Counts its calls, interpreting the commands like the testing interpreter */
+static CustomCommandLayoutInterpretation
+_countingCommandInterpreter(ASTNode * node, bool caseInsensitive);
+
+static unsigned long interpretedCommands = 0;
+
 static bool string_equals(string * string1, string * string2,
 			  bool caseInsensitive);
 
@@ -233,6 +261,7 @@ START_TEST(resolveLayout_returnsErrorForNonRootNodes)
 	rootNode.tokenIndex = 0;
 	rootNode.type = ASTNodeType_COMMAND;
 	rootNode.value = string_from("root");
+	rootNode.commandId = CommandId_CUSTOM;
 	rootNode.parent = NULL;
 	rootNode.children = ASTNodePointerVector_new(0, 1);
 
@@ -656,23 +685,25 @@ START_TEST(resolveLayout_parsesSingleTextToSingleSegmentResult)
 	assert(paragraph->lines->items->segments->size.length == 1,
 	       "Expected 1 segment");
 	segment = paragraph->lines->items->segments->items;
-	assert(segment->contentAlignment == LayoutContentAlignment_DEFAULT,
+	assert(segment->style->contentAlignment ==
+	       LayoutContentAlignment_DEFAULT,
 	       "Expected the segment to have LayoutContentAlignment_DEFAULT content alignment");
-	assert(segment->leftIndentationLevel == 0,
+	assert(segment->style->leftIndentationLevel == 0,
 	       "Expected the segment to have 0 left indentation level");
-	assert(segment->rightIndentationLevel == 0,
+	assert(segment->style->rightIndentationLevel == 0,
 	       "Expected the segment to have 0 right indentation level");
-	assert(segment->fontSizeChange == 0,
+	assert(segment->style->fontSizeChange == 0,
 	       "Expected the segment to have 0 font size change");
-	assert(segment->fontBoldLevel == 0,
+	assert(segment->style->fontBoldLevel == 0,
 	       "Expected the segment to have 0 font bold level");
-	assert(segment->fontItalicLevel == 0,
+	assert(segment->style->fontItalicLevel == 0,
 	       "Expected the segment to have 0 font italic level");
-	assert(segment->fontUnderlinedLevel == 0,
+	assert(segment->style->fontUnderlinedLevel == 0,
 	       "Expected the segment to have 0 font underline level");
-	assert(segment->fontFixedLevel == 0,
+	assert(segment->style->fontFixedLevel == 0,
 	       "Expected the segment to have 0 font fixed level");
-	assert(segment->otherSegmentMarkers->size.length == 0,
+	assert(LayoutSegmentMarkerStack_getLength
+	       (segment->style->otherSegmentMarkers) == 0,
 	       "Expected the segment's other segment markers vector to be empty");
 	assert(segment->content->size.length == 1,
 	       "Expected a 1 node in the segment's content");
@@ -1200,7 +1231,7 @@ START_TEST(resolveLayout_preservesMultipleExplicitEmptyLines)
 	LayoutResolverResult *result = process(input, NULL, false);
 	ASTNode nodes[4];
 	LayoutLineSegment segments[2];
-	LayoutLine lines[2];
+	LayoutLine lines[3];
 	LayoutParagraph paragraphs[1];
 	LayoutBlock blocks[1];
 
@@ -1854,6 +1885,36 @@ START_TEST(resolveLayout_warnsAboutNewPageInsideSamePage)
 		       warningCause);
 END_TEST}
 
+START_TEST(resolveLayout_warnsAboutNewPageDeepInsideSamePage)
+{
+	unsigned long depth = 100000;
+	string *input = string_new(depth * 7 + 25);
+	unsigned char *content = input->content;
+	ParserResult *parsedInput;
+	LayoutResolverResult *result;
+	unsigned long i;
+
+	memcpy(content, "<SamePage>", 10);
+	content += 10;
+	for (i = 0; i < depth; i++, content += 3) {
+		memcpy(content, "<x>", 3);
+	}
+	memcpy(content, "<np>", 4);
+	content += 4;
+	for (i = 0; i < depth; i++, content += 4) {
+		memcpy(content, "</x>", 4);
+	}
+	memcpy(content, "</SamePage>", 11);
+	parsedInput = parse(tokenize(input, true, true)->result.tokens, false);
+
+	result = resolveLayout(parsedInput->result.nodes, NULL, false);
+	assert_success(result, 1, 3);
+	assert(result->warnings->items[0].code ==
+	       LayoutResolverWarningCode_NEW_PAGE_INSIDE_SAME_PAGE
+	       && result->warnings->items[0].cause->byteIndex == depth * 3 + 10,
+	       "Expected a warning about the nested new page only");
+END_TEST}
+
 START_TEST(resolveLayout_warnsAboutNestedSamePageInsideSamePage)
 {
 	char *input = "<SamePage><SamePage>text</SamePage></SamePage>";
@@ -1893,6 +1954,48 @@ START_TEST(resolveLayout_emitsWarningsOnErrorsAsWell)
 		       warningCause);
 END_TEST}
 
+START_TEST(resolveLayoutWithOptions_coalescesWarnings)
+{
+	char *input = "<SamePage><np><np>x<np><SamePage></SamePage></SamePage>";
+	ParserResult *parsedInput =
+	    parse(tokenize(string_from(input), true, true)->result.tokens,
+		  false);
+	ASTNodePointerVector *nodes = parsedInput->result.nodes;
+	ASTNodePointerVector *children = (*nodes->items)->children;
+	LayoutResolverOptions options;
+	LayoutResolverResult *result;
+	LayoutResolverWarning *warning;
+
+	options.warningPolicy.type = WarningPolicyType_COALESCE_RUNS;
+	options.warningPolicy.limit = 0;
+	options.interpretsCustomCommandsByName = false;
+	options.customCommandCache = NULL;
+	result = resolveLayoutWithOptions(nodes, NULL, false, &options);
+	assert(result->type == LayoutResolverResultType_SUCCESS,
+	       "Expected a successful result");
+	assert(result->warnings->size.length == 2, "Expected 2 warnings");
+	warning = result->warnings->items;
+	assert(warning->code ==
+	       LayoutResolverWarningCode_NEW_PAGE_INSIDE_SAME_PAGE
+	       && warning->count == 3 && warning->cause == children->items[0]
+	       && warning->lastCause == children->items[3],
+	       "Expected the <np> warnings to be coalesced");
+	warning++;
+	assert(warning->code == LayoutResolverWarningCode_NESTED_SAME_PAGE
+	       && warning->count == 1 && warning->cause == children->items[4]
+	       && warning->lastCause == children->items[4],
+	       "Expected the nested <SamePage> warning");
+	LayoutResolverResult_free(result);
+
+	options.warningPolicy.type = WarningPolicyType_RECORD_FIRST;
+	options.warningPolicy.limit = 1;
+	result = resolveLayoutWithOptions(nodes, NULL, false, &options);
+	assert(result->warnings->size.length == 1
+	       && result->warnings->items[0].count == 1,
+	       "Expected only the first warning to be recorded");
+	LayoutResolverResult_free(result);
+END_TEST}
+
 START_TEST(resolveLayout_doesNotModifyItsInput)
 {
 	char *input =
@@ -1919,6 +2022,301 @@ START_TEST(resolveLayout_doesNotModifyItsInput)
 	}
 END_TEST}
 
+START_TEST(resolveLayout_processesDeeplyNestedCommands)
+{
+	unsigned long depth = 1000000;
+	string *input = string_new(depth * 7 + 1);
+	unsigned char *content = input->content;
+	TokenizerResult *tokenizerResult;
+	ParserOptions options;
+	ParserResult *parserResult;
+	LayoutResolverResult *result;
+	LayoutLine *line;
+	ASTNode *text;
+	unsigned long i;
+
+	for (i = 0; i < depth; i++, content += 3) {
+		memcpy(content, "<x>", 3);
+	}
+	*content = 'a';
+	content++;
+	for (i = 0; i < depth; i++, content += 4) {
+		memcpy(content, "</x>", 4);
+	}
+	options.useArena = true;
+	options.maxNestingDepth = 0;
+	parserResult = tokenizeAndParse(input, false, false, NULL, &options,
+					&tokenizerResult);
+	assert(parserResult != NULL
+	       && parserResult->type == ParserResultType_SUCCESS,
+	       "Expected parsing to succeed");
+
+	result = resolveLayout(parserResult->result.nodes, NULL, false);
+	assert_success(result, 0, 1);
+	line = result->result.blocks->items[0].paragraphs->items[0].lines->items;
+	assertUnsignedLongEquals("segments", line->segments->size.length, 1);
+	assertUnsignedLongEquals("segment content",
+				 line->segments->items[0].content->size.length,
+				 1);
+	text = line->segments->items[0].content->items[0];
+	assert(text->type == ASTNodeType_TEXT && text->byteIndex == depth * 3,
+	       "Expected the text of the deepest command");
+	LayoutResolverResult_free(result);
+	ParserResult_free(parserResult);
+	TokenizerResult_free(tokenizerResult);
+END_TEST}
+
+START_TEST(resolveLayout_processesManySiblingCommandsInLinearTime)
+{
+	/* Looking up each command among its siblings would take hours */
+	unsigned long count = 1000000;
+	string *input = string_new(count * 14);
+	unsigned char *content = input->content;
+	TokenizerResult *tokenizerResult;
+	ParserOptions options;
+	ParserResult *parserResult;
+	LayoutResolverResult *result;
+	LayoutLine *line;
+	unsigned long i;
+
+	for (i = 0; i < count; i++, content += 14) {
+		memcpy(content, "<Bold>a</Bold>", 14);
+	}
+	options.useArena = true;
+	options.maxNestingDepth = 0;
+	parserResult = tokenizeAndParse(input, false, false, NULL, &options,
+					&tokenizerResult);
+	assert(parserResult != NULL
+	       && parserResult->type == ParserResultType_SUCCESS,
+	       "Expected parsing to succeed");
+
+	result = resolveLayout(parserResult->result.nodes, NULL, false);
+	assert_success(result, 0, 1);
+	line = result->result.blocks->items[0].paragraphs->items[0].lines->items;
+	assertUnsignedLongEquals("segments", line->segments->size.length,
+				 count);
+	LayoutResolverResult_free(result);
+	ParserResult_free(parserResult);
+	TokenizerResult_free(tokenizerResult);
+END_TEST}
+
+START_TEST(resolveLayout_appendsManyLinesToTheirParagraph)
+{
+	unsigned long count = 100000;
+	string *input = string_new(count * 5);
+	unsigned char *content = input->content;
+	TokenizerResult *tokenizerResult;
+	ParserOptions options;
+	ParserResult *parserResult;
+	LayoutResolverResult *result;
+	LayoutLineVector *lines;
+	unsigned long i;
+
+	for (i = 0; i < count; i++, content += 5) {
+		memcpy(content, "a<nl>", 5);
+	}
+	options.useArena = true;
+	options.maxNestingDepth = 0;
+	parserResult = tokenizeAndParse(input, false, false, NULL, &options,
+					&tokenizerResult);
+	assert(parserResult != NULL
+	       && parserResult->type == ParserResultType_SUCCESS,
+	       "Expected parsing to succeed");
+
+	result = resolveLayout(parserResult->result.nodes, NULL, false);
+	assert_success(result, 0, 1);
+	lines = result->result.blocks->items[0].paragraphs->items[0].lines;
+	assertUnsignedLongEquals("lines", lines->size.length, count);
+	for (i = 0; i < count; i++) {
+		assertUnsignedLongEquals("segments",
+					 lines->items[i].segments->size.length,
+					 1);
+	}
+	LayoutResolverResult_free(result);
+	ParserResult_free(parserResult);
+	TokenizerResult_free(tokenizerResult);
+	string_free(input);
+END_TEST}
+
+START_TEST(resolveLayout_sharesOtherSegmentMarkersOfSegments)
+{
+	char *input =
+	    "<Excerpt>a<Bold>b</Bold>c<Subscript>d</Subscript></Excerpt>";
+	LayoutResolverResult *result = process(input, NULL, false);
+	LayoutLineSegment *segments;
+	ASTNodePointerVector *markers;
+
+	assert_success(result, 0, 1);
+	segments = result->result.blocks->items[0].paragraphs->items[0].lines->
+	    items[0].segments->items;
+	assert(segments[0].style->otherSegmentMarkers != NULL
+	       && segments[1].style->otherSegmentMarkers ==
+	       segments[0].style->otherSegmentMarkers
+	       && segments[2].style->otherSegmentMarkers ==
+	       segments[0].style->otherSegmentMarkers,
+	       "Expected the segments to share their markers");
+	assert(segments[3].style->otherSegmentMarkers->rest ==
+	       segments[0].style->otherSegmentMarkers,
+	       "Expected the nested marker to be pushed on the shared ones");
+
+	markers = LayoutLineSegment_getOtherSegmentMarkers(segments + 3);
+	assertUnsignedLongEquals("markers", markers->size.length, 2);
+	assert(string_compare(markers->items[0]->value,
+			      string_from("Excerpt")) == 0
+	       && string_compare(markers->items[1]->value,
+				 string_from("Subscript")) == 0,
+	       "Expected the markers from the outermost one");
+	ASTNodePointerVector_free(markers);
+	LayoutResolverResult_free(result);
+END_TEST}
+
+START_TEST(resolveLayout_internsSegmentStyles)
+{
+	char *input =
+	    "<Bold>a</Bold>b<nl><Bold>c<Italic>d</Italic></Bold>e<Bold>f</Bold>";
+	LayoutResolverResult *result = process(input, NULL, false);
+	LayoutLineVector *lines;
+	LayoutLineSegment *segments;
+	const LayoutSegmentStyle *style;
+	unsigned long id;
+
+	assert_success(result, 0, 1);
+	lines = result->result.blocks->items[0].paragraphs->items[0].lines;
+	segments = lines->items[1].segments->items;
+	assert(lines->items[0].segments->items[0].style == segments[0].style
+	       && segments[0].style == segments[3].style,
+	       "Expected the bold segments to share their style");
+	assert(lines->items[0].segments->items[1].style == segments[2].style,
+	       "Expected the plain segments to share their style");
+	assertUnsignedLongEquals("styles",
+				 LayoutSegmentStyleTable_getLength(result->
+								   styles), 3);
+	for (id = 0; id < 3; id++) {
+		style = LayoutSegmentStyleTable_get(result->styles, id);
+		assert(style != NULL && style->id == id,
+		       "Expected the style of the id");
+	}
+	assert(LayoutSegmentStyleTable_get(result->styles, 3) == NULL,
+	       "Expected no more styles");
+	assert(segments[1].style->fontBoldLevel == 1
+	       && segments[1].style->fontItalicLevel == 1,
+	       "Expected the bold italic style");
+	LayoutResolverResult_free(result);
+END_TEST}
+
+START_TEST(resolveLayout_cachesCustomCommandInterpretationsByName)
+{
+	char *input =
+	    "<X-Block>a</X-Block><x-block>b</x-block><X-Line>c</X-Line>d";
+	ASTNodePointerVector *nodes = parseNodes(input, true);
+	LayoutResolverOptions options;
+	CustomCommandCache *cache;
+	LayoutResolverResult *expected;
+	LayoutResolverResult *result;
+
+	options.warningPolicy.type = WarningPolicyType_RECORD_ALL;
+	options.warningPolicy.limit = 0;
+	options.interpretsCustomCommandsByName = false;
+	options.customCommandCache = NULL;
+	interpretedCommands = 0;
+	expected = resolveLayoutWithOptions(nodes, _countingCommandInterpreter,
+					    true, &options);
+	assert_success(expected, 0, 3);
+	assertUnsignedLongEquals("interpreted commands", interpretedCommands,
+				 3);
+
+	options.interpretsCustomCommandsByName = true;
+	interpretedCommands = 0;
+	result = resolveLayoutWithOptions(nodes, _countingCommandInterpreter,
+					  true, &options);
+	assert_success(result, 0, 3);
+	assertUnsignedLongEquals("interpreted commands", interpretedCommands,
+				 2);
+	LayoutResolverResult_free(result);
+
+	cache = CustomCommandCache_new();
+	options.customCommandCache = cache;
+	interpretedCommands = 0;
+	result = resolveLayoutWithOptions(nodes, _countingCommandInterpreter,
+					  true, &options);
+	LayoutResolverResult_free(result);
+	result = resolveLayoutWithOptions(nodes, _countingCommandInterpreter,
+					  true, &options);
+	assert_success(result, 0, 3);
+	assertUnsignedLongEquals("interpreted commands", interpretedCommands,
+				 2);
+	assertUnsignedLongEquals("cached names",
+				 CustomCommandCache_getLength(cache), 2);
+
+	CustomCommandCache_free(cache);
+	LayoutResolverResult_free(expected);
+	LayoutResolverResult_free(result);
+END_TEST}
+
+START_TEST(resolveLayoutStreaming_passesCompletedBlocksToSink)
+{
+	char *input =
+	    "<Heading>a</Heading><Center>b<nl>c</Center><np>d<Bold>e</Bold>";
+	ASTNodePointerVector *nodes = parseNodes(input, false);
+	LayoutResolverResult *expected = resolveLayout(nodes, NULL, false);
+	LayoutResolverResult *result;
+	LayoutBlock *block;
+	SunkBlocks sunkBlocks;
+	unsigned long i;
+
+	sunkBlocks.count = 0;
+	sunkBlocks.segments = 0;
+	sunkBlocks.limit = 8;
+	sunkBlocks.firstStyle = NULL;
+	result = resolveLayoutStreaming(nodes, NULL, false, NULL, sinkBlock,
+					&sunkBlocks);
+	assert_success(result, 0, 0);
+	assertUnsignedLongEquals("sunk blocks", sunkBlocks.count,
+				 expected->result.blocks->size.length);
+	for (i = 0, block = expected->result.blocks->items;
+	     i < sunkBlocks.count; i++, block++) {
+		assert(sunkBlocks.types[i] == block->type,
+		       "Expected the blocks to be sunk in document order");
+	}
+	assertUnsignedLongEquals("sunk segments", sunkBlocks.segments, 5);
+	assertUnsignedLongEquals("styles",
+				 LayoutSegmentStyleTable_getLength(result->
+								   styles),
+				 LayoutSegmentStyleTable_getLength(expected->
+								   styles));
+
+	assert(resolveLayoutStreaming(nodes, NULL, false, NULL, NULL,
+				      &sunkBlocks) == NULL,
+	       "Expected no result without a block sink");
+	LayoutResolverResult_free(expected);
+	LayoutResolverResult_free(result);
+END_TEST}
+
+START_TEST(resolveLayoutStreaming_abortsOnSinkFailure)
+{
+	ASTNodePointerVector *nodes =
+	    parseNodes("<Bold>a</Bold><np>b<np>c", false);
+	LayoutResolverResult *result;
+	SunkBlocks sunkBlocks;
+
+	sunkBlocks.count = 0;
+	sunkBlocks.segments = 0;
+	sunkBlocks.limit = 1;
+	sunkBlocks.firstStyle = NULL;
+	result = resolveLayoutStreaming(nodes, NULL, false, NULL, sinkBlock,
+					&sunkBlocks);
+	assert(result != NULL && result->type == LayoutResolverResultType_ERROR
+	       && result->result.error.code ==
+	       LayoutResolverErrorCode_BLOCK_SINK_FAILURE,
+	       "Expected the BLOCK_SINK_FAILURE error");
+	assertUnsignedLongEquals("sunk blocks", sunkBlocks.count, 1);
+	assert(result->styles != NULL && sunkBlocks.firstStyle != NULL,
+	       "Expected the styles of the sunk block to be kept");
+	assertUnsignedLongEquals("font bold level",
+				 sunkBlocks.firstStyle->fontBoldLevel, 1);
+	LayoutResolverResult_free(result);
+END_TEST}
+
 START_TEST(LayoutResolverResult_free_handlesNullInput)
 {
 	LayoutResolverResult_free(NULL);
@@ -1998,9 +2396,19 @@ static void all_tests()
 	runTest(resolveLayout_supportsCustomCommandInterpreters);
 	runTest(resolveLayout_preservesCommandsAsSegmentContent);
 	runTest(resolveLayout_warnsAboutNewPageInsideSamePage);
+	runTest(resolveLayout_warnsAboutNewPageDeepInsideSamePage);
 	runTest(resolveLayout_warnsAboutNestedSamePageInsideSamePage);
 	runTest(resolveLayout_emitsWarningsOnErrorsAsWell);
+	runTest(resolveLayoutWithOptions_coalescesWarnings);
 	runTest(resolveLayout_doesNotModifyItsInput);
+	runTest(resolveLayout_processesDeeplyNestedCommands);
+	runTest(resolveLayout_processesManySiblingCommandsInLinearTime);
+	runTest(resolveLayout_appendsManyLinesToTheirParagraph);
+	runTest(resolveLayout_sharesOtherSegmentMarkersOfSegments);
+	runTest(resolveLayout_internsSegmentStyles);
+	runTest(resolveLayout_cachesCustomCommandInterpretationsByName);
+	runTest(resolveLayoutStreaming_passesCompletedBlocksToSink);
+	runTest(resolveLayoutStreaming_abortsOnSinkFailure);
 	runTest(LayoutResolverResult_free_handlesNullInput);
 	runTest(LayoutResolverResult_free_freesSuccessfulResults);
 	runTest(LayoutResolverResult_free_freesErrorResults);
@@ -2602,16 +3010,26 @@ ASTNodePointerVector *otherSegmentMarkers;
 ASTNodePointerVector *content;
 {
 	LayoutLineSegment segment;
+	LayoutSegmentStyle *style = malloc(sizeof(LayoutSegmentStyle));
+	unsigned long i;
+
+	style->id = 0;
+	style->otherSegmentMarkers = NULL;
+	for (i = 0; i < otherSegmentMarkers->size.length; i++) {
+		style->otherSegmentMarkers =
+		    LayoutSegmentMarkerStack_push(style->otherSegmentMarkers,
+						  otherSegmentMarkers->items[i]);
+	}
+	style->contentAlignment = contentAlignment;
+	style->leftIndentationLevel = leftIndentationLevel;
+	style->rightIndentationLevel = rightIndentationLevel;
+	style->fontSizeChange = fontSizeChange;
+	style->fontBoldLevel = fontBoldLevel;
+	style->fontItalicLevel = fontItalicLevel;
+	style->fontUnderlinedLevel = fontUnderlinedLevel;
+	style->fontFixedLevel = fontFixedLevel;
 	segment.causingCommand = causingCommand;
-	segment.contentAlignment = contentAlignment;
-	segment.leftIndentationLevel = leftIndentationLevel;
-	segment.rightIndentationLevel = rightIndentationLevel;
-	segment.fontSizeChange = fontSizeChange;
-	segment.fontBoldLevel = fontBoldLevel;
-	segment.fontItalicLevel = fontItalicLevel;
-	segment.fontUnderlinedLevel = fontUnderlinedLevel;
-	segment.fontFixedLevel = fontFixedLevel;
-	segment.otherSegmentMarkers = otherSegmentMarkers;
+	segment.style = style;
 	segment.content = content;
 	return segment;
 }
@@ -2669,6 +3087,8 @@ unsigned int lineOfCode;
 LayoutLineSegment segment1;
 LayoutLineSegment segment2;
 {
+	const LayoutSegmentStyle *style1 = segment1.style;
+	const LayoutSegmentStyle *style2 = segment2.style;
 	char *failure;
 	char *stringifiedCausingCommand1 =
 	    stringifyASTNode(segment1.causingCommand);
@@ -2681,13 +3101,13 @@ LayoutLineSegment segment2;
 		   (strlen(causingCommandErrorFormat) +
 		    strlen(stringifiedCausingCommand1) +
 		    strlen(stringifiedCausingCommand2) + 1));
-	char *stringifiedContentAlignment1 = segment1.contentAlignment >= 0
-	    && segment1.contentAlignment <
-	    4 ? STRINGIFIED_LAYOUT_CONTENT_ALIGNMENT[segment1.contentAlignment]
+	char *stringifiedContentAlignment1 = style1->contentAlignment >= 0
+	    && style1->contentAlignment <
+	    4 ? STRINGIFIED_LAYOUT_CONTENT_ALIGNMENT[style1->contentAlignment]
 	    : "<UNKNOWN>";
-	char *stringifiedContentAlignment2 = segment2.contentAlignment >= 0
-	    && segment2.contentAlignment <
-	    4 ? STRINGIFIED_LAYOUT_CONTENT_ALIGNMENT[segment2.contentAlignment]
+	char *stringifiedContentAlignment2 = style2->contentAlignment >= 0
+	    && style2->contentAlignment <
+	    4 ? STRINGIFIED_LAYOUT_CONTENT_ALIGNMENT[style2->contentAlignment]
 	    : "<UNKNOWN>";
 	char *contentAlignmentErrorFormat =
 	    "The contentAlignment property is not equal: It is set to %s in 1st segment, but set to %s in 2nd segment";
@@ -2734,6 +3154,8 @@ LayoutLineSegment segment2;
 	char *otherSegmentMarkersErrorFormat =
 	    "The otherSegmentMarkers property are not equal: %s";
 	char *otherSegmentMarkersError;
+	ASTNodePointerVector *otherSegmentMarkers1;
+	ASTNodePointerVector *otherSegmentMarkers2;
 	char *contentErrorFormat = "The content property is not equal: %s";
 	char *contentError;
 
@@ -2752,85 +3174,91 @@ LayoutLineSegment segment2;
 		stringifiedContentAlignment1, stringifiedContentAlignment2);
 	failure =
 	    unit_assert(fileName, lineOfCode,
-			segment1.contentAlignment == segment2.contentAlignment,
+			style1->contentAlignment == style2->contentAlignment,
 			contentAlignmentError);
 	if (failure != NULL) {
 		return failure;
 	}
 
 	sprintf(leftIndentationLevelError, leftIndentationLevelErrorFormat,
-		segment1.leftIndentationLevel, segment2.leftIndentationLevel);
+		style1->leftIndentationLevel, style2->leftIndentationLevel);
 	failure =
 	    unit_assert(fileName, lineOfCode,
-			segment1.leftIndentationLevel ==
-			segment2.leftIndentationLevel,
+			style1->leftIndentationLevel ==
+			style2->leftIndentationLevel,
 			leftIndentationLevelError);
 	if (failure != NULL) {
 		return failure;
 	}
 
 	sprintf(rightIndentationLevelError, rightIndentationLevelErrorFormat,
-		segment1.rightIndentationLevel, segment2.rightIndentationLevel);
+		style1->rightIndentationLevel, style2->rightIndentationLevel);
 	failure =
 	    unit_assert(fileName, lineOfCode,
-			segment1.rightIndentationLevel ==
-			segment2.rightIndentationLevel,
+			style1->rightIndentationLevel ==
+			style2->rightIndentationLevel,
 			rightIndentationLevelError);
 	if (failure != NULL) {
 		return failure;
 	}
 
 	sprintf(fontSizeChangeError, fontSizeChangeErrorFormat,
-		segment1.fontSizeChange, segment2.fontSizeChange);
+		style1->fontSizeChange, style2->fontSizeChange);
 	failure =
 	    unit_assert(fileName, lineOfCode,
-			segment1.fontSizeChange == segment2.fontSizeChange,
+			style1->fontSizeChange == style2->fontSizeChange,
 			fontSizeChangeError);
 	if (failure != NULL) {
 		return failure;
 	}
 
 	sprintf(fontBoldLevelError, fontBoldLevelErrorFormat,
-		segment1.fontBoldLevel, segment2.fontBoldLevel);
+		style1->fontBoldLevel, style2->fontBoldLevel);
 	failure =
 	    unit_assert(fileName, lineOfCode,
-			segment1.fontBoldLevel == segment2.fontBoldLevel,
+			style1->fontBoldLevel == style2->fontBoldLevel,
 			fontBoldLevelError);
 	if (failure != NULL) {
 		return failure;
 	}
 
 	sprintf(fontItalicLevelError, fontItalicLevelErrorFormat,
-		segment1.fontItalicLevel, segment2.fontItalicLevel);
+		style1->fontItalicLevel, style2->fontItalicLevel);
 	failure =
 	    unit_assert(fileName, lineOfCode,
-			segment1.fontItalicLevel == segment2.fontItalicLevel,
+			style1->fontItalicLevel == style2->fontItalicLevel,
 			fontItalicLevelError);
 	if (failure != NULL) {
 		return failure;
 	}
 
 	sprintf(fontUnderlinedLevelError, fontUnderlinedLevelErrorFormat,
-		segment1.fontUnderlinedLevel, segment2.fontUnderlinedLevel);
+		style1->fontUnderlinedLevel, style2->fontUnderlinedLevel);
 	failure =
 	    unit_assert(fileName, lineOfCode,
-			segment1.fontUnderlinedLevel ==
-			segment2.fontUnderlinedLevel, fontUnderlinedLevelError);
+			style1->fontUnderlinedLevel ==
+			style2->fontUnderlinedLevel, fontUnderlinedLevelError);
 	if (failure != NULL) {
 		return failure;
 	}
 
 	failure =
 	    unit_assert(fileName, lineOfCode,
-			segment1.fontFixedLevel == segment2.fontFixedLevel,
+			style1->fontFixedLevel == style2->fontFixedLevel,
 			fontFixedLevelError);
 	if (failure != NULL) {
 		return failure;
 	}
 
+	otherSegmentMarkers1 =
+	    LayoutLineSegment_getOtherSegmentMarkers(&segment1);
+	otherSegmentMarkers2 =
+	    LayoutLineSegment_getOtherSegmentMarkers(&segment2);
 	failure =
-	    ASTNodePointerVector_assertEqual(segment1.otherSegmentMarkers,
-					     segment2.otherSegmentMarkers);
+	    ASTNodePointerVector_assertEqual(otherSegmentMarkers1,
+					     otherSegmentMarkers2);
+	ASTNodePointerVector_free(otherSegmentMarkers1);
+	ASTNodePointerVector_free(otherSegmentMarkers2);
 	if (failure != NULL) {
 		otherSegmentMarkersError =
 		    malloc(sizeof(char) *
@@ -2912,6 +3340,9 @@ ASTNodePointerVector *children;
 	node.tokenIndex = tokenIndex;
 	node.type = type;
 	node.value = value;
+	node.commandId =
+	    type == ASTNodeType_COMMAND ? CommandId_fromName(value) :
+	    CommandId_NONE;
 	node.parent = parent;
 	node.children = children;
 	return node;
@@ -3060,7 +3491,9 @@ static char *STRINGIFIED_ERROR_CODES[] = {
 	"LayoutResolverErrorCode_FONT_UNDERLINED_LEVEL_UNDERFLOW",
 	"LayoutResolverErrorCode_FONT_UNDERLINED_LEVEL_OVERFLOW",
 	"LayoutResolverErrorCode_FONT_FIXED_LEVEL_UNDERFLOW",
-	"LayoutResolverErrorCode_FONT_FIXED_LEVEL_OVERFLOW"
+	"LayoutResolverErrorCode_FONT_FIXED_LEVEL_OVERFLOW",
+	"LayoutResolverErrorCode_OUT_OF_MEMORY_FOR_TRAVERSAL",
+	"LayoutResolverErrorCode_BLOCK_SINK_FAILURE"
 };
 
 static char *STRINGIFIED_AST_NODE_TYPE[] = {
@@ -3096,6 +3529,20 @@ static LayoutResolverResult *process(richtext, customCommandInterpreter,
 const char *richtext;
 CustomCommandLayoutInterpretation customCommandInterpreter(ASTNode *, bool);
 bool caseInsensitiveCommands;
+{
+	ASTNodePointerVector *nodes =
+	    parseNodes(richtext, caseInsensitiveCommands);
+	if (nodes == NULL) {
+		return NULL;
+	}
+
+	return resolveLayout(nodes, customCommandInterpreter,
+			     caseInsensitiveCommands);
+}
+
+static ASTNodePointerVector *parseNodes(richtext, caseInsensitiveCommands)
+const char *richtext;
+bool caseInsensitiveCommands;
 {
 	ParserResult *parserResult;
 	TokenizerResult *tokens = tokenize(string_from(richtext), true, true);
@@ -3109,8 +3556,41 @@ bool caseInsensitiveCommands;
 		return NULL;
 	}
 
-	return resolveLayout(parserResult->result.nodes,
-			     customCommandInterpreter, caseInsensitiveCommands);
+	return parserResult->result.nodes;
+}
+
+static bool sinkBlock(block, context)
+LayoutBlock *block;
+void *context;
+{
+	SunkBlocks *sunkBlocks = context;
+	LayoutParagraph *paragraph;
+	LayoutLine *line;
+	unsigned long paragraphIndex, lineIndex;
+
+	if (sunkBlocks->count == sunkBlocks->limit) {
+		LayoutBlock_freeContent(block);
+		return false;
+	}
+
+	for (paragraphIndex = 0, paragraph = block->paragraphs->items;
+	     paragraphIndex < block->paragraphs->size.length;
+	     paragraphIndex++, paragraph++) {
+		for (lineIndex = 0, line = paragraph->lines->items;
+		     lineIndex < paragraph->lines->size.length;
+		     lineIndex++, line++) {
+			if (sunkBlocks->firstStyle == NULL
+			    && line->segments->size.length > 0) {
+				sunkBlocks->firstStyle =
+				    line->segments->items->style;
+			}
+			sunkBlocks->segments += line->segments->size.length;
+		}
+	}
+	sunkBlocks->types[sunkBlocks->count] = block->type;
+	sunkBlocks->count++;
+	LayoutBlock_freeContent(block);
+	return true;
 }
 
 static ASTNode *makeNode(byteIndex, codepointIndex,
@@ -3150,6 +3630,9 @@ ASTNodePointerVector *children;
 	node->tokenIndex = tokenIndex;
 	node->type = type;
 	node->value = value;
+	node->commandId =
+	    type == ASTNodeType_COMMAND ? CommandId_fromName(value) :
+	    CommandId_NONE;
 	node->parent = parent;
 	node->children = children;
 	return node;
@@ -3212,6 +3695,15 @@ bool caseInsensitive;
 	return CustomCommandLayoutInterpretation_INVALID_COMMAND;
 }
 
+static CustomCommandLayoutInterpretation
+_countingCommandInterpreter(node, caseInsensitive)
+ASTNode *node;
+bool caseInsensitive;
+{
+	interpretedCommands++;
+	return _testingCommandInterpreter(node, caseInsensitive);
+}
+
 static bool string_equals(string1, string2, caseInsensitive)
 string *string1;
 string *string2;
@@ -0,0 +1,81 @@
+#include "../src/ast_node.h"
+#include "../src/ast_node_pointer_vector.h"
+#include "../src/layout_segment_marker_stack.h"
+#include "unit.h"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+START_TEST(LayoutSegmentMarkerStack_push_sharesTheRestOfTheStack)
+{
+	ASTNode markers[3];
+	LayoutSegmentMarkerStack *bottom;
+	LayoutSegmentMarkerStack *first;
+	LayoutSegmentMarkerStack *second;
+
+	bottom = LayoutSegmentMarkerStack_push(NULL, markers);
+	first = LayoutSegmentMarkerStack_push(bottom, markers + 1);
+	second = LayoutSegmentMarkerStack_push(bottom, markers + 2);
+	assert(bottom != NULL && first != NULL && second != NULL,
+	       "Expected the stacks to be created");
+	assert(first->rest == bottom && second->rest == bottom,
+	       "Expected the stacks to share the bottom item");
+	assertUnsignedLongEquals("references", bottom->references, 3);
+	assertUnsignedLongEquals("length",
+				 LayoutSegmentMarkerStack_getLength(second), 2);
+	assertUnsignedLongEquals("empty length",
+				 LayoutSegmentMarkerStack_getLength(NULL), 0);
+
+	LayoutSegmentMarkerStack_release(bottom);
+	LayoutSegmentMarkerStack_release(first);
+	assertUnsignedLongEquals("references", bottom->references, 1);
+	assert(LayoutSegmentMarkerStack_retain(second) == second,
+	       "Expected the retained stack");
+	LayoutSegmentMarkerStack_release(second);
+	LayoutSegmentMarkerStack_release(second);
+	LayoutSegmentMarkerStack_release(NULL);
+END_TEST}
+
+START_TEST(LayoutSegmentMarkerStack_toVector_returnsMarkersFromTheBottom)
+{
+	ASTNode markers[3];
+	LayoutSegmentMarkerStack *stack = NULL;
+	LayoutSegmentMarkerStack *grownStack;
+	ASTNodePointerVector *vector;
+	unsigned long i;
+
+	for (i = 0; i < 3; i++) {
+		grownStack = LayoutSegmentMarkerStack_push(stack, markers + i);
+		LayoutSegmentMarkerStack_release(stack);
+		stack = grownStack;
+	}
+	vector = LayoutSegmentMarkerStack_toVector(stack);
+	assert(vector != NULL, "Expected a vector");
+	assertUnsignedLongEquals("length", vector->size.length, 3);
+	assert(vector->items[0] == markers && vector->items[1] == markers + 1
+	       && vector->items[2] == markers + 2,
+	       "Expected the markers from the bottom to the top");
+	ASTNodePointerVector_free(vector);
+	LayoutSegmentMarkerStack_release(stack);
+
+	vector = LayoutSegmentMarkerStack_toVector(NULL);
+	assert(vector != NULL && vector->size.length == 0,
+	       "Expected an empty vector for the empty stack");
+	ASTNodePointerVector_free(vector);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(LayoutSegmentMarkerStack_push_sharesTheRestOfTheStack);
+	runTest(LayoutSegmentMarkerStack_toVector_returnsMarkersFromTheBottom);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
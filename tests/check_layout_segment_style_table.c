@@ -0,0 +1,123 @@
+#include "../src/ast_node.h"
+#include "../src/layout_content_alignment.h"
+#include "../src/layout_segment_marker_stack.h"
+#include "../src/layout_segment_style.h"
+#include "../src/layout_segment_style_table.h"
+#include "unit.h"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+static LayoutSegmentStyle makeStyle(unsigned short fontBoldLevel,
+				    LayoutSegmentMarkerStack *
+				    otherSegmentMarkers);
+
+START_TEST(LayoutSegmentStyleTable_intern_storesEachStyleOnce)
+{
+	LayoutSegmentStyleTable *table = LayoutSegmentStyleTable_new();
+	ASTNode marker;
+	LayoutSegmentMarkerStack *markers;
+	LayoutSegmentStyle style;
+	const LayoutSegmentStyle *plain;
+	const LayoutSegmentStyle *bold;
+	const LayoutSegmentStyle *marked;
+
+	assert(table != NULL, "Expected a style table");
+	markers = LayoutSegmentMarkerStack_push(NULL, &marker);
+	style = makeStyle(0, NULL);
+	plain = LayoutSegmentStyleTable_intern(table, &style);
+	style = makeStyle(1, NULL);
+	bold = LayoutSegmentStyleTable_intern(table, &style);
+	style = makeStyle(0, markers);
+	marked = LayoutSegmentStyleTable_intern(table, &style);
+	assert(plain != NULL && bold != NULL && marked != NULL,
+	       "Expected the styles to be interned");
+	assert(plain != bold && plain != marked && bold != marked,
+	       "Expected distinct styles");
+	assert(plain != &style && marked->otherSegmentMarkers == markers,
+	       "Expected a copy of the style");
+	assertUnsignedLongEquals("references", markers->references, 2);
+
+	style = makeStyle(1, NULL);
+	style.id = 42;
+	assert(LayoutSegmentStyleTable_intern(table, &style) == bold,
+	       "Expected the interned style");
+	assertUnsignedLongEquals("length",
+				 LayoutSegmentStyleTable_getLength(table), 3);
+	assert(LayoutSegmentStyleTable_get(table, 0) == plain
+	       && LayoutSegmentStyleTable_get(table, 1) == bold
+	       && LayoutSegmentStyleTable_get(table, 2) == marked
+	       && LayoutSegmentStyleTable_get(table, 3) == NULL,
+	       "Expected the styles by the order of their first use");
+	assertUnsignedLongEquals("id", bold->id, 1);
+
+	LayoutSegmentMarkerStack_release(markers);
+	LayoutSegmentStyleTable_free(table);
+	LayoutSegmentStyleTable_free(NULL);
+END_TEST}
+
+START_TEST(LayoutSegmentStyleTable_intern_keepsStylesInPlaceOnGrowth)
+{
+	LayoutSegmentStyleTable *table = LayoutSegmentStyleTable_new();
+	LayoutSegmentStyle style;
+	const LayoutSegmentStyle *first;
+	unsigned short level;
+
+	style = makeStyle(0, NULL);
+	first = LayoutSegmentStyleTable_intern(table, &style);
+	for (level = 1; level < 1000; level++) {
+		style = makeStyle(level, NULL);
+		assert(LayoutSegmentStyleTable_intern(table, &style) != NULL,
+		       "Expected the style to be interned");
+	}
+	assertUnsignedLongEquals("length",
+				 LayoutSegmentStyleTable_getLength(table),
+				 1000);
+	for (level = 0; level < 1000; level++) {
+		style = makeStyle(level, NULL);
+		assert(LayoutSegmentStyleTable_intern(table, &style) ==
+		       LayoutSegmentStyleTable_get(table, level),
+		       "Expected the interned styles to be found");
+	}
+	assert(LayoutSegmentStyleTable_get(table, 0) == first,
+	       "Expected the style not to be moved");
+	assertUnsignedLongEquals("length",
+				 LayoutSegmentStyleTable_getLength(table),
+				 1000);
+	LayoutSegmentStyleTable_free(table);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(LayoutSegmentStyleTable_intern_storesEachStyleOnce);
+	runTest(LayoutSegmentStyleTable_intern_keepsStylesInPlaceOnGrowth);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
+
+static LayoutSegmentStyle makeStyle(fontBoldLevel, otherSegmentMarkers)
+unsigned short fontBoldLevel;
+LayoutSegmentMarkerStack *otherSegmentMarkers;
+{
+	LayoutSegmentStyle style;
+
+	style.id = 0;
+	style.contentAlignment = LayoutContentAlignment_DEFAULT;
+	style.leftIndentationLevel = 0;
+	style.rightIndentationLevel = 0;
+	style.fontSizeChange = 0;
+	style.fontBoldLevel = fontBoldLevel;
+	style.fontItalicLevel = 0;
+	style.fontUnderlinedLevel = 0;
+	style.fontFixedLevel = 0;
+	style.otherSegmentMarkers = otherSegmentMarkers;
+	return style;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "../src/ast_node.h"
 #include "../src/ast_node_pointer_vector.h"
 #include "../src/ast_node_type.h"
@@ -26,6 +27,11 @@ static ParserResult *parseStringToResult(const char *input,
 static ASTNodePointerVector *parseString(const char *input,
 					 bool caseInsensitiveCommands);
 
+static string *nestedCommands(unsigned long depth);
+
+static bool nodesEqual(ASTNodePointerVector * nodes1,
+		       ASTNodePointerVector * nodes2, ASTNode * parent);
+
 static char *_assert_node(char *filename, unsigned int line,
 			  unsigned int nodeOrdinalNumber, ASTNode * node,
 			  unsigned long byteIndex, unsigned long codepointIndex,
@@ -322,6 +328,361 @@ START_TEST(parse_rejectsInvalidTokenType)
 		     ParserErrorCode_UNSUPPORTED_TOKEN_TYPE);
 END_TEST}
 
+START_TEST(parseAndConsumeTokens_movesTokenValuesIntoNodes)
+{
+	string *input =
+	    string_from("<bold>foo <ISO-8859-2>\243</ISO-8859-2></bold>");
+	TokenizerOptions options;
+	TokenizerResult *tokenizerResult;
+	ParserResult *result;
+	ASTNode **nodePointer;
+	options.useValueViews = true;
+	options.presizeTokens = false;
+	options.tokens = NULL;
+	options.lazyCodepointIndexes = false;
+	options.threadCount = 0;
+	options.warningPolicy.type = WarningPolicyType_RECORD_ALL;
+	options.warningPolicy.limit = 0;
+	tokenizerResult = tokenizeWithOptions(input, false, false, &options);
+	assert(tokenizerResult != NULL
+	       && tokenizerResult->type == TokenizerResultType_SUCCESS,
+	       "Expected tokenization to succeed");
+	result = parseAndConsumeTokens(tokenizerResult, false, NULL);
+	assert(result != NULL
+	       && result->type == ParserResultType_SUCCESS,
+	       "Expected parsing to succeed");
+	assert(tokenizerResult->result.tokens == NULL
+	       && tokenizerResult->valueViews == NULL,
+	       "Expected the tokens to be consumed");
+	assert(result->valueViews != NULL,
+	       "Expected the value views to be taken over");
+	TokenizerResult_free(tokenizerResult);
+
+	nodePointer = result->result.nodes->items;
+	assert_node(1, *nodePointer, 0, 0, 0, ASTNodeType_COMMAND, "bold");
+	assert((*nodePointer)->isValueView, "Expected a value view");
+	nodePointer = (*nodePointer)->children->items;
+	assert_node(2, *nodePointer, 6, 6, 1, ASTNodeType_TEXT, "foo");
+	assert_node(3, *(nodePointer + 1), 9, 9, 2, ASTNodeType_WHITESPACE,
+		    " ");
+	assert_node(4, *(nodePointer + 2), 10, 10, 3, ASTNodeType_COMMAND,
+		    "ISO-8859-2");
+	nodePointer = (*(nodePointer + 2))->children->items;
+	assert_node(5, *nodePointer, 22, 22, 4, ASTNodeType_TEXT,
+		    "\305\201");
+	assert(!(*nodePointer)->isValueView,
+	       "Expected the transcoded value to be owned by the node");
+	ParserResult_free(result);
+	string_free(input);
+END_TEST}
+
+START_TEST(parseAndConsumeTokens_consumesTokensOnError)
+{
+	TokenizerResult *tokenizerResult =
+	    tokenize(string_from("<foo><bar>baz</foo></bar>"), true, true);
+	ParserResult *result = parseAndConsumeTokens(NULL, false, NULL);
+	assert(result != NULL
+	       && result->type == ParserResultType_ERROR
+	       && result->result.error.code == ParserErrorCode_NULL_TOKENS,
+	       "Expected NULL_TOKENS error for NULL tokenizer result");
+	ParserResult_free(result);
+
+	result = parseAndConsumeTokens(tokenizerResult, false, NULL);
+	assert(result != NULL
+	       && result->type == ParserResultType_ERROR,
+	       "Expected error result");
+	assert_error(result->result.error, 13, 13, 3,
+		     ParserErrorCode_IMPROPERLY_BALANCED_COMMAND);
+	assert(tokenizerResult->result.tokens == NULL,
+	       "Expected the tokens to be consumed");
+	TokenizerResult_free(tokenizerResult);
+	ParserResult_free(result);
+END_TEST}
+
+START_TEST(parseWithOptions_allocatesNodesInArena)
+{
+	TokenizerResult *tokenizerResult =
+	    tokenize(string_from("<bold>a<nl><x>b </x></bold> c<lt><np>"),
+		     true, true);
+	ParserOptions options;
+	ParserResult *heapResult;
+	ParserResult *arenaResult;
+	ASTNode **nodePointer;
+	ASTNode *bold;
+	options.useArena = true;
+	options.maxNestingDepth = 0;
+	heapResult = parse(tokenizerResult->result.tokens, false);
+	arenaResult =
+	    parseWithOptions(tokenizerResult->result.tokens, false, &options);
+	assert(arenaResult != NULL
+	       && arenaResult->type == ParserResultType_SUCCESS,
+	       "Expected parsing to succeed");
+	assert(arenaResult->arena != NULL && heapResult->arena == NULL,
+	       "Expected only the arena result to have an arena");
+	assert(nodesEqual(heapResult->result.nodes, arenaResult->result.nodes,
+			  NULL), "Expected the same nodes as without arena");
+
+	nodePointer = arenaResult->result.nodes->items;
+	bold = *nodePointer;
+	assert(bold->children->size.length == 3
+	       && bold->children->items[0] > bold
+	       && bold->children->items[1] > bold->children->items[0]
+	       && bold->children->items[2] > bold->children->items[1],
+	       "Expected the nodes to be placed in document order");
+	assert(bold->children->items[1]->children != NULL
+	       && bold->children->items[1]->children->size.length == 0,
+	       "Expected an empty children vector for the nl command");
+	ParserResult_free(heapResult);
+	ParserResult_free(arenaResult);
+
+	arenaResult = parseWithOptions(tokenizerResult->result.tokens, false,
+				       NULL);
+	assert(arenaResult->arena == NULL,
+	       "Expected no arena without options");
+	ParserResult_free(arenaResult);
+	TokenizerResult_free(tokenizerResult);
+END_TEST}
+
+START_TEST(parseWithOptions_freesArenaOnError)
+{
+	TokenizerResult *tokenizerResult =
+	    tokenize(string_from("<foo><bar>baz</foo></bar>"), true, true);
+	ParserOptions options;
+	ParserResult *result;
+	options.useArena = true;
+	options.maxNestingDepth = 0;
+	result =
+	    parseWithOptions(tokenizerResult->result.tokens, false, &options);
+	assert(result != NULL
+	       && result->type == ParserResultType_ERROR,
+	       "Expected error result");
+	assert_error(result->result.error, 13, 13, 3,
+		     ParserErrorCode_IMPROPERLY_BALANCED_COMMAND);
+	assert(result->arena == NULL, "Expected the arena to be freed");
+	ParserResult_free(result);
+
+	result = parseAndConsumeTokens(tokenizerResult, false, &options);
+	assert(result != NULL
+	       && result->type == ParserResultType_ERROR,
+	       "Expected error result");
+	ParserResult_free(result);
+	TokenizerResult_free(tokenizerResult);
+END_TEST}
+
+START_TEST(parse_setsSiblingIndexesOfNodes)
+{
+	TokenizerResult *tokenizerResult =
+	    tokenize(string_from("a <b>c<nl>d</b><e><f></f>g</e>"), true,
+		     true);
+	ParserOptions options;
+	ParserResult *result;
+	ASTNodePointerVector *nodes;
+	unsigned long variant;
+
+	for (variant = 0; variant < 2; variant++) {
+		options.useArena = variant == 1;
+		options.maxNestingDepth = 0;
+		result = parseWithOptions(tokenizerResult->result.tokens, false,
+					  &options);
+		nodes = result->result.nodes;
+		assertUnsignedLongEquals("root nodes", nodes->size.length, 4);
+		assertUnsignedLongEquals("index of a",
+					 nodes->items[0]->siblingIndex, 0);
+		assertUnsignedLongEquals("index of <b>",
+					 nodes->items[2]->siblingIndex, 2);
+		assertUnsignedLongEquals("index of <e>",
+					 nodes->items[3]->siblingIndex, 3);
+		assertUnsignedLongEquals("index of d",
+					 nodes->items[2]->children->items[2]->
+					 siblingIndex, 2);
+		assertUnsignedLongEquals("index of g",
+					 nodes->items[3]->children->items[1]->
+					 siblingIndex, 1);
+		ParserResult_free(result);
+	}
+	TokenizerResult_free(tokenizerResult);
+END_TEST}
+
+START_TEST(parseWithOptions_failsOnExceedingMaxNestingDepth)
+{
+	TokenizerResult *tokenizerResult =
+	    tokenize(string_from("<a><b><nl>c</b><d><e>f</e></d></a>"), true,
+		     true);
+	ParserOptions options;
+	ParserResult *result;
+	options.useArena = false;
+	options.maxNestingDepth = 2;
+	result =
+	    parseWithOptions(tokenizerResult->result.tokens, false, &options);
+	assert(result != NULL
+	       && result->type == ParserResultType_ERROR,
+	       "Expected error result");
+	assert_error(result->result.error, 18, 18, 6,
+		     ParserErrorCode_MAX_NESTING_DEPTH_EXCEEDED);
+	ParserResult_free(result);
+
+	options.useArena = true;
+	result =
+	    parseWithOptions(tokenizerResult->result.tokens, false, &options);
+	assert(result != NULL
+	       && result->type == ParserResultType_ERROR,
+	       "Expected error result with arena");
+	assert_error(result->result.error, 18, 18, 6,
+		     ParserErrorCode_MAX_NESTING_DEPTH_EXCEEDED);
+	ParserResult_free(result);
+	TokenizerResult_free(tokenizerResult);
+
+	/* The limit is not exceeded by an empty command */
+	tokenizerResult = tokenize(string_from("<a><b><nl>c</b></a>"), true,
+				   true);
+	result =
+	    parseWithOptions(tokenizerResult->result.tokens, false, &options);
+	assert(result != NULL
+	       && result->type == ParserResultType_SUCCESS,
+	       "Expected parsing to succeed");
+	ParserResult_free(result);
+	TokenizerResult_free(tokenizerResult);
+
+	result = tokenizeAndParse(string_from("x<a><b><c></c></b></a>"), false,
+				  true, NULL, &options, &tokenizerResult);
+	assert(result != NULL
+	       && result->type == ParserResultType_ERROR,
+	       "Expected error result from tokenizeAndParse");
+	assert_error(result->result.error, 7, 7, 3,
+		     ParserErrorCode_MAX_NESTING_DEPTH_EXCEEDED);
+	ParserResult_free(result);
+	TokenizerResult_free(tokenizerResult);
+END_TEST}
+
+START_TEST(parse_processesDeeplyNestedCommands)
+{
+	unsigned long depth = 1000000;
+	string *input = nestedCommands(depth);
+	TokenizerResult *tokenizerResult = tokenize(input, false, false);
+	ParserOptions options;
+	ParserResult *result;
+	ASTNodePointerVector *nodes;
+	unsigned long level;
+	unsigned long variant;
+
+	for (variant = 0; variant < 2; variant++) {
+		options.useArena = variant == 1;
+		options.maxNestingDepth = depth;
+		result = parseWithOptions(tokenizerResult->result.tokens, false,
+					  &options);
+		assert(result != NULL
+		       && result->type == ParserResultType_SUCCESS,
+		       "Expected parsing to succeed");
+		nodes = result->result.nodes;
+		for (level = 0; level < depth; level++) {
+			if (nodes->size.length != 1
+			    || nodes->items[0]->type != ASTNodeType_COMMAND) {
+				break;
+			}
+			nodes = nodes->items[0]->children;
+		}
+		assertUnsignedLongEquals("depth", level, depth);
+		assert(nodes->size.length == 1
+		       && nodes->items[0]->type == ASTNodeType_TEXT,
+		       "Expected the text in the deepest command");
+		ParserResult_free(result);
+
+		options.maxNestingDepth = depth - 1;
+		result = parseWithOptions(tokenizerResult->result.tokens, false,
+					  &options);
+		assert(result != NULL
+		       && result->type == ParserResultType_ERROR,
+		       "Expected error result");
+		assert_error(result->result.error, (depth - 1) * 3,
+			     (depth - 1) * 3, depth - 1,
+			     ParserErrorCode_MAX_NESTING_DEPTH_EXCEEDED);
+		ParserResult_free(result);
+	}
+
+	TokenizerResult_free(tokenizerResult);
+	string_free(input);
+END_TEST}
+
+START_TEST(tokenizeAndParse_buildsSameNodesAsParse)
+{
+	string *input =
+	    string_from("<bold>foo <ISO-8859-2>\243<nl></ISO-8859-2></bold> x");
+	TokenizerResult *tokenizerResult = tokenize(input, false, false);
+	TokenizerResult *fusedTokenizerResult;
+	ParserOptions options;
+	ParserResult *expectedResult;
+	ParserResult *result;
+	expectedResult = parse(tokenizerResult->result.tokens, false);
+	options.useArena = true;
+	options.maxNestingDepth = 0;
+	result = tokenizeAndParse(input, false, false, NULL, &options,
+				  &fusedTokenizerResult);
+	assert(result != NULL
+	       && result->type == ParserResultType_SUCCESS,
+	       "Expected parsing to succeed");
+	assert(fusedTokenizerResult != NULL
+	       && fusedTokenizerResult->type == TokenizerResultType_SUCCESS
+	       && fusedTokenizerResult->result.tokens->size.length == 0,
+	       "Expected tokenization to succeed without storing the tokens");
+	assert(result->arena != NULL, "Expected the nodes in an arena");
+	assert(nodesEqual(expectedResult->result.nodes, result->result.nodes,
+			  NULL), "Expected the same nodes as parse");
+	ParserResult_free(result);
+	TokenizerResult_free(fusedTokenizerResult);
+
+	result = tokenizeAndParse(input, false, false, NULL, NULL,
+				  &fusedTokenizerResult);
+	assert(nodesEqual(expectedResult->result.nodes, result->result.nodes,
+			  NULL), "Expected the same nodes without arena");
+	ParserResult_free(result);
+	TokenizerResult_free(fusedTokenizerResult);
+
+	assert(tokenizeAndParse(NULL, false, false, NULL, NULL,
+				&fusedTokenizerResult) == NULL
+	       && fusedTokenizerResult == NULL, "Expected NULL for NULL input");
+	ParserResult_free(expectedResult);
+	TokenizerResult_free(tokenizerResult);
+	string_free(input);
+END_TEST}
+
+START_TEST(tokenizeAndParse_reportsSameErrors)
+{
+	TokenizerResult *tokenizerResult;
+	ParserResult *result;
+	result = tokenizeAndParse(string_from("<foo><bar>baz</foo></bar>"),
+				  false, true, NULL, NULL, &tokenizerResult);
+	assert(result != NULL
+	       && result->type == ParserResultType_ERROR,
+	       "Expected error result");
+	assert_error(result->result.error, 13, 13, 3,
+		     ParserErrorCode_IMPROPERLY_BALANCED_COMMAND);
+	ParserResult_free(result);
+	TokenizerResult_free(tokenizerResult);
+
+	result = tokenizeAndParse(string_from("a <b><nl>c"), false, true, NULL,
+				  NULL, &tokenizerResult);
+	assert(result != NULL
+	       && result->type == ParserResultType_ERROR,
+	       "Expected error result");
+	assert_error(result->result.error, 2, 2, 2,
+		     ParserErrorCode_UNTERMINATED_COMMAND);
+	ParserResult_free(result);
+	TokenizerResult_free(tokenizerResult);
+
+	/* The tokenizer error follows the parser error */
+	result = tokenizeAndParse(string_from("</foo> <ISO-8859-2>x</US-ASCII>"),
+				  false, true, NULL, NULL, &tokenizerResult);
+	assert(result == NULL, "Expected no parser result");
+	assert(tokenizerResult != NULL
+	       && tokenizerResult->type == TokenizerResultType_ERROR
+	       && tokenizerResult->result.error.byteIndex == 30
+	       && tokenizerResult->result.error.codepointIndex == 30
+	       && tokenizerResult->result.error.code ==
+	       TokenizerErrorCode_UNBALANCED_ENCODING_COMMANDS,
+	       "Expected the tokenizer error");
+	TokenizerResult_free(tokenizerResult);
+END_TEST}
+
 START_TEST(ParserResult_free_acceptsNull)
 {
 	ParserResult_free(NULL);
@@ -355,6 +716,15 @@ static void all_tests()
 	runTest(parse_rejectsUnpairedCommandEnds);
 	runTest(parse_improperlyBalancedCommands);
 	runTest(parse_rejectsInvalidTokenType);
+	runTest(parseAndConsumeTokens_movesTokenValuesIntoNodes);
+	runTest(parseAndConsumeTokens_consumesTokensOnError);
+	runTest(parseWithOptions_allocatesNodesInArena);
+	runTest(parseWithOptions_freesArenaOnError);
+	runTest(parse_setsSiblingIndexesOfNodes);
+	runTest(parseWithOptions_failsOnExceedingMaxNestingDepth);
+	runTest(parse_processesDeeplyNestedCommands);
+	runTest(tokenizeAndParse_buildsSameNodesAsParse);
+	runTest(tokenizeAndParse_reportsSameErrors);
 	runTest(ParserResult_free_acceptsNull);
 	runTest(ParserResult_free_acceptsSuccessfulParsingResult);
 	runTest(ParserResult_free_acceptsErrorParsingResult);
@@ -392,6 +762,61 @@ bool caseInsensitiveCommands;
 	return parserResult->result.nodes;
 }
 
+/*
+ * Returns the text "a" enclosed in the specified number of nested x commands.
+ */
+static string *nestedCommands(depth)
+unsigned long depth;
+{
+	string *input = string_new(depth * 7 + 1);
+	unsigned char *content = input->content;
+	unsigned long i;
+
+	for (i = 0; i < depth; i++, content += 3) {
+		memcpy(content, "<x>", 3);
+	}
+	*content = 'a';
+	content++;
+	for (i = 0; i < depth; i++, content += 4) {
+		memcpy(content, "</x>", 4);
+	}
+	return input;
+}
+
+static bool nodesEqual(nodes1, nodes2, parent)
+ASTNodePointerVector *nodes1;
+ASTNodePointerVector *nodes2;
+ASTNode *parent;
+{
+	ASTNode *node1;
+	ASTNode *node2;
+	unsigned long i;
+
+	if (nodes1 == NULL || nodes2 == NULL) {
+		return nodes1 == nodes2;
+	}
+	if (nodes1->size.length != nodes2->size.length) {
+		return false;
+	}
+
+	for (i = 0; i < nodes1->size.length; i++) {
+		node1 = nodes1->items[i];
+		node2 = nodes2->items[i];
+		if (node1->byteIndex != node2->byteIndex
+		    || node1->codepointIndex != node2->codepointIndex
+		    || node1->tokenIndex != node2->tokenIndex
+		    || node1->type != node2->type
+		    || node1->commandId != node2->commandId
+		    || string_compare(node1->value, node2->value) != 0
+		    || node2->parent != parent
+		    || !nodesEqual(node1->children, node2->children, node2)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 static char *STRINGIFIED_NODE_TYPE[] = {
 	"ASTNodeType_COMMAND",
 	"ASTNodeType_TEXT",
@@ -470,13 +895,13 @@ char *value;
 	}
 
 	valueString = string_from(value);
-	errorFormat = "Expected the %u. node's value to be %s, but was %s";
+	errorFormat = "Expected the %u. node's value to be %s, but was %.*s";
 	errorMessage =
 	    malloc(sizeof(char) *
 		   (strlen(errorFormat) + 20 + valueString->length +
 		    node->value->length + 1));
 	sprintf(errorMessage, errorFormat, nodeOrdinalNumber, value,
-		node->value->content);
+		(int)node->value->length, node->value->content);
 	errorMessage =
 	    unit_assert(filename, line,
 			string_compare(node->value, valueString) == 0,
@@ -498,7 +923,8 @@ static char *STRINGIFIED_ERROR_CODE[] = {
 	"ParserErrorCode_OUT_OF_MEMORY_FOR_STRINGS",
 	"ParserErrorCode_OUT_OF_MEMORY_FOR_NODES",
 	"ParserErrorCode_UNSUPPORTED_TOKEN_TYPE",
-	"ParserErrorCode_INTERNAL_ASSERTION_FAILED"
+	"ParserErrorCode_INTERNAL_ASSERTION_FAILED",
+	"ParserErrorCode_MAX_NESTING_DEPTH_EXCEEDED"
 };
 
 static char *_assert_error(fileName, line, error, byteIndex, codepointIndex,
@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../src/bool.h"
+#include "../src/layout_resolver.h"
+#include "../src/output_renderer.h"
+#include "../src/parser.h"
+#include "../src/string.h"
+#include "../src/text_renderer.h"
+#include "../src/tokenizer.h"
+#include "unit.h"
+
+/*
+   This file does not bother to free heap-allocated memory because it's a suite
+   of unit tests, ergo it's not a big deal.
+ */
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+static char *render(const char *richtext, bool caseInsensitiveCommands);
+
+START_TEST(renderText_rendersTextOfLines)
+{
+	assertCStringEquals("rendered text",
+			    render("<Bold>Hello</Bold>\nworld<nl>!", true),
+			    "Hello world\n!\n");
+	assertCStringEquals("rendered text",
+			    render("a<Paragraph>b</Paragraph>", true),
+			    "a\n\nb\n");
+END_TEST}
+
+START_TEST(renderText_rendersLessThanCommands)
+{
+	assertCStringEquals("rendered text",
+			    render("<Bold>Hello</Bold> <lt>world", true),
+			    "Hello <world\n");
+	assertCStringEquals("rendered text", render("<LT>a<lt>", true),
+			    "<a<\n");
+	assertCStringEquals("rendered text",
+			    render("<LT></LT>a<lt>", false), "a<\n");
+END_TEST}
+
+static void all_tests()
+{
+	runTest(renderText_rendersTextOfLines);
+	runTest(renderText_rendersLessThanCommands);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
+
+static char *render(richtext, caseInsensitiveCommands)
+const char *richtext;
+bool caseInsensitiveCommands;
+{
+	TokenizerResult *tokens;
+	ParserResult *parserResult;
+	LayoutResolverResult *layout;
+	OutputRendererResult *result;
+	string *output;
+	char *text;
+
+	tokens = tokenize(string_from(richtext), caseInsensitiveCommands, true);
+	if (tokens == NULL || tokens->type != TokenizerResultType_SUCCESS) {
+		return "(tokenizing failed)";
+	}
+	parserResult = parse(tokens->result.tokens, caseInsensitiveCommands);
+	if (parserResult == NULL
+	    || parserResult->type != ParserResultType_SUCCESS) {
+		return "(parsing failed)";
+	}
+	layout = resolveLayout(parserResult->result.nodes, NULL,
+			       caseInsensitiveCommands);
+	if (layout == NULL
+	    || layout->type != LayoutResolverResultType_SUCCESS) {
+		return "(resolving the layout failed)";
+	}
+
+	result = renderText(layout->result.blocks, &caseInsensitiveCommands);
+	if (result == NULL
+	    || result->type != OutputRendererResultType_SUCCESS) {
+		return "(rendering failed)";
+	}
+
+	output = result->result.output;
+	text = malloc(output->length + 1);
+	memcpy(text, output->content, output->length);
+	text[output->length] = '\0';
+	return text;
+}
@@ -1,5 +1,8 @@
+#include <stdio.h>
 #include <string.h>
 #include "../src/bool.h"
+#include "../src/codepoint_index.h"
+#include "../src/command_id.h"
 #include "../src/tokenizer.h"
 #include "../src/string.h"
 #include "../src/token.h"
@@ -29,6 +32,12 @@ static char *_assertToken(char *fileName, unsigned int lineOfCode,
 			  unsigned long byteIndex, unsigned long codepointIndex,
 			  TokenType type, char *value);
 
+static TokenizerResult *tokenizeInChunks(string *input,
+					 unsigned long chunkLength);
+
+static bool tokenizerResultsEqual(TokenizerResult *result1,
+				  TokenizerResult *result2);
+
 static char *STRINGIFIED_TOKEN_TYPE[] = {
 	"TokenType_COMMAND_START",
 	"TokenType_COMMAND_END",
@@ -302,6 +311,29 @@ START_TEST(tokenize_processesCommandEnd)
 	assertToken(2, token + 1, 6, 6, TokenType_TEXT, "a");
 END_TEST}
 
+START_TEST(tokenize_identifiesCommands)
+{
+	TokenizerResult *result =
+	    tokenize(string_from("<Bold>a <x-foo></BOLD>"), true, true);
+	Token *token;
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 5, "Expected 5 tokens");
+	token = result->result.tokens->items;
+
+	assertUnsignedLongEquals("1st token command", token->commandId,
+				 CommandId_BOLD);
+	assertUnsignedLongEquals("2nd token command", (token + 1)->commandId,
+				 CommandId_NONE);
+	assertUnsignedLongEquals("3rd token command", (token + 2)->commandId,
+				 CommandId_NONE);
+	assertUnsignedLongEquals("4th token command", (token + 3)->commandId,
+				 CommandId_CUSTOM);
+	assertUnsignedLongEquals("5th token command", (token + 4)->commandId,
+				 CommandId_BOLD | CommandId_CASE_MISMATCH);
+END_TEST}
+
 START_TEST(tokenize_emitsWarningsForInvalidUtf8CharactersButTreatsThemAsText)
 {
 	TokenizerResult *result =
@@ -354,6 +386,50 @@ START_TEST(tokenize_emitsWarningsForUnexpectedContinuationBytes)
 	assertToken(1, token, 0, 0, TokenType_TEXT, "a\201b\226\300c");
 END_TEST}
 
+START_TEST(tokenize_emitsWarningsForIllFormedUtf8Sequences)
+{
+	char *z10 = "\305\276\305\276\305\276\305\276\305\276";
+	char text[100];
+	char input[120];
+	TokenizerResult *result;
+	TokenizerWarning *warning;
+	Token *token;
+
+	/*
+	   The well-formed characters span multiple blocks validated at once,
+	   the ill-formed sequences are truncated characters, an overlong lead
+	   byte, a stray continuation byte and a truncated trailing character.
+	 */
+	sprintf(text, "%s%s%s%s%s%s%s%s\342\202z\360\237\230\200\301\277\341",
+		z10, z10, z10, z10, z10, z10, z10, z10);
+	sprintf(input, "%s a\360\237", text);
+	result = tokenize(string_from(input), true, true);
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->warnings != NULL
+	       && result->warnings->size.length == 5, "Expected 5 warnings");
+	assert(result->result.tokens != NULL
+	       && result->result.tokens->size.length == 3, "Expected 3 tokens");
+	warning = result->warnings->items;
+	token = result->result.tokens->items;
+
+	assertWarning(1, warning, 80, 40,
+		      TokenizerWarningCode_INVALID_UTF8_CHARACTER);
+	assertWarning(2, warning + 1, 87, 43,
+		      TokenizerWarningCode_INVALID_UTF8_CHARACTER);
+	assertWarning(3, warning + 2, 88, 44,
+		      TokenizerWarningCode_UNEXPECTED_UTF8_CONTINUATION_BYTE);
+	assertWarning(4, warning + 3, 89, 45,
+		      TokenizerWarningCode_INVALID_UTF8_CHARACTER);
+	assertWarning(5, warning + 4, 92, 48,
+		      TokenizerWarningCode_INVALID_UTF8_CHARACTER);
+
+	assertToken(1, token, 0, 0, TokenType_TEXT, text);
+	assertToken(2, token + 1, 90, 46, TokenType_WHITESPACE, " ");
+	assertToken(3, token + 2, 91, 47, TokenType_TEXT, "a\360\237");
+END_TEST}
+
 START_TEST(tokenize_rejectsCommandStartDelimiterInsideACommand)
 {
 	TokenizerResult *result = tokenize(string_from("<a<b>"), true, true);
@@ -532,6 +608,577 @@ END_TEST}
 #undef assert_nth_token
 #undef assert_token
 
+START_TEST(tokenize_transcodesTrailingText)
+{
+	TokenizerResult *result =
+	    tokenize(string_from("<ISO-8859-2>\243"), false, false);
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 2, "Expected 2 tokens");
+	assertToken(2, result->result.tokens->items + 1, 12, 12, TokenType_TEXT,
+		    "Ł");
+END_TEST}
+
+START_TEST(tokenize_emitsSingleTokenForCrLfInSingleByteEncodings)
+{
+	TokenizerResult *result =
+	    tokenize(string_from("<ISO-8859-2>\243\r\nb"), false, true);
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 4, "Expected 4 tokens");
+	assertToken(3, result->result.tokens->items + 2, 13, 13,
+		    TokenType_WHITESPACE, "\r\n");
+	assertToken(4, result->result.tokens->items + 3, 15, 15, TokenType_TEXT,
+		    "b");
+END_TEST}
+
+START_TEST(tokenize_tracksPositionsAcrossLongRunsOfText)
+{
+	char *a10 = "aaaaaaaaaa";
+	char *b10 = "bbbbbbbbbb";
+	char *c11 = "ccccccccccc";
+	char input[160];
+	char firstText[100];
+	TokenizerResult *result;
+	Token *tokens;
+
+	/*
+	   The runs of text are long enough to span multiple blocks processed at
+	   once by the tokenizer.
+	 */
+	sprintf(firstText, "%s%s%s%s\305\276%s%s%s%s", a10, a10, a10, a10, b10,
+		b10, b10, b10);
+	sprintf(input, "%s\342\200\203%s%s%s<bold>d", firstText, c11, c11,
+		c11);
+	result = tokenize(string_from(input), false, true);
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 5, "Expected 5 tokens");
+	tokens = result->result.tokens->items;
+	assertToken(1, tokens, 0, 0, TokenType_TEXT, firstText);
+	assertToken(2, tokens + 1, 82, 81, TokenType_WHITESPACE,
+		    "\342\200\203");
+	assertToken(3, tokens + 2, 85, 82, TokenType_TEXT,
+		    "ccccccccccccccccccccccccccccccccc");
+	assertToken(4, tokens + 3, 118, 115, TokenType_COMMAND_START, "bold");
+	assertToken(5, tokens + 4, 124, 121, TokenType_TEXT, "d");
+END_TEST}
+
+START_TEST(tokenizeWithOptions_referencesInputWhenUsingValueViews)
+{
+	string *input = string_from("<b>foo</b>\302\240bar");
+	TokenizerOptions options;
+	TokenizerResult *result;
+	Token *token;
+
+	options.useValueViews = true;
+	options.presizeTokens = false;
+	options.tokens = NULL;
+	options.lazyCodepointIndexes = false;
+	options.threadCount = 0;
+	options.warningPolicy.type = WarningPolicyType_RECORD_ALL;
+	result = tokenizeWithOptions(input, true, true, &options);
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 5, "Expected 5 tokens");
+	token = result->result.tokens->items;
+
+	assertToken(1, token, 0, 0, TokenType_COMMAND_START, "b");
+	assert(token->isValueView
+	       && token->value->content == input->content + 1,
+	       "Expected the 1st token's value to reference the input");
+	token++;
+	assertToken(2, token, 3, 3, TokenType_TEXT, "foo");
+	assert(token->isValueView
+	       && token->value->content == input->content + 3,
+	       "Expected the 2nd token's value to reference the input");
+	token++;
+	assertToken(3, token, 6, 6, TokenType_COMMAND_END, "b");
+	assert(token->isValueView
+	       && token->value->content == input->content + 8,
+	       "Expected the 3rd token's value to reference the input");
+	token++;
+	assertToken(4, token, 10, 10, TokenType_WHITESPACE, "\302\240");
+	assert(token->isValueView
+	       && token->value->content == input->content + 10,
+	       "Expected the 4th token's value to reference the input");
+	token++;
+	assertToken(5, token, 12, 11, TokenType_TEXT, "bar");
+	assert(token->isValueView
+	       && token->value->content == input->content + 12,
+	       "Expected the 5th token's value to reference the input");
+
+	TokenizerResult_free(result);
+END_TEST}
+
+START_TEST(tokenizeWithOptions_copiesOnlyTranscodedValuesWhenUsingValueViews)
+{
+	string *input = string_from("a<ISO-8859-2>b \243</ISO-8859-2>");
+	TokenizerOptions options;
+	TokenizerResult *result;
+	Token *token;
+
+	options.useValueViews = true;
+	options.presizeTokens = false;
+	options.tokens = NULL;
+	options.lazyCodepointIndexes = false;
+	options.threadCount = 0;
+	options.warningPolicy.type = WarningPolicyType_RECORD_ALL;
+	result = tokenizeWithOptions(input, false, false, &options);
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 6, "Expected 6 tokens");
+	token = result->result.tokens->items;
+
+	assertToken(1, token, 0, 0, TokenType_TEXT, "a");
+	assert(token->isValueView, "Expected the 1st token to be a view");
+	token++;
+	assertToken(2, token, 1, 1, TokenType_COMMAND_START, "ISO-8859-2");
+	assert(token->isValueView, "Expected the 2nd token to be a view");
+	token++;
+	assertToken(3, token, 13, 13, TokenType_TEXT, "b");
+	assert(token->isValueView, "Expected the 3rd token to be a view");
+	token++;
+	assertToken(4, token, 14, 14, TokenType_WHITESPACE, " ");
+	assert(token->isValueView, "Expected the 4th token to be a view");
+	token++;
+	assertToken(5, token, 15, 15, TokenType_TEXT, "Ł");
+	assert(!token->isValueView,
+	       "Expected the 5th token to own its transcoded value");
+	token++;
+	assertToken(6, token, 16, 16, TokenType_COMMAND_END, "ISO-8859-2");
+	assert(token->isValueView, "Expected the 6th token to be a view");
+
+	TokenizerResult_free(result);
+END_TEST}
+
+START_TEST(tokenizeWithOptions_acceptsNullOptions)
+{
+	TokenizerResult *result =
+	    tokenizeWithOptions(string_from("foo"), true, true, NULL);
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 1, "Expected 1 token");
+	assert(!result->result.tokens->items->isValueView,
+	       "Expected the token to own its value");
+	TokenizerResult_free(result);
+END_TEST}
+
+START_TEST(estimateTokenCount_returnsUpperBoundOfTokenCount)
+{
+	char *inputs[5];
+	unsigned long i;
+	string *input;
+	TokenizerResult *result;
+	unsigned long estimate;
+
+	inputs[0] = "";
+	inputs[1] = "foo bar baz";
+	inputs[2] = "<bold>foo</bold>\r\n<lt>a> b\342\200\203c \302\240";
+	inputs[3] = "  \t<ISO-8859-2>\240\243\240</ISO-8859-2>x";
+	inputs[4] = "a<b>c<d><e>f</e>g</d>h\n";
+
+	assert(estimateTokenCount(NULL) == 0,
+	       "Expected 0 estimated tokens for NULL input");
+	for (i = 0; i < 5; i++) {
+		input = string_from(inputs[i]);
+		result = tokenize(input, false, true);
+		estimate = estimateTokenCount(input);
+		assert(result->result.tokens->size.length <= estimate,
+		       "Expected the estimate to be an upper bound");
+		assert(estimate <= 2 * result->result.tokens->size.length + 1,
+		       "Expected the estimate to be a tight upper bound");
+		TokenizerResult_free(result);
+	}
+END_TEST}
+
+START_TEST(tokenizeWithOptions_presizesTokenVector)
+{
+	string *input = string_from("<bold>foo</bold> bar\r\nbaz");
+	TokenizerOptions options;
+	TokenizerResult *expected = tokenize(input, false, true);
+	TokenizerResult *result;
+
+	options.useValueViews = false;
+	options.presizeTokens = true;
+	options.tokens = NULL;
+	options.lazyCodepointIndexes = false;
+	options.threadCount = 0;
+	options.warningPolicy.type = WarningPolicyType_RECORD_ALL;
+	result = tokenizeWithOptions(input, false, true, &options);
+	assert(tokenizerResultsEqual(expected, result),
+	       "Expected the same result as from tokenize");
+	assertUnsignedLongEquals("token vector capacity",
+				 result->result.tokens->size.capacity,
+				 estimateTokenCount(input));
+	TokenizerResult_free(result);
+	TokenizerResult_free(expected);
+END_TEST}
+
+START_TEST(tokenizeWithOptions_computesCodepointIndexesLazily)
+{
+	static char *parts[] = {
+		"P\305\231\303\255li\305\241 ", "\342\202z\r\n\200",
+		"<b>\360\237\230\200</b> "
+	};
+	char input[9000];
+	TokenizerOptions options;
+	TokenizerResult *expected;
+	TokenizerResult *result;
+	Token *token;
+	unsigned long i;
+
+	/* Long enough to span multiple checkpoints of the codepoint index */
+	input[0] = '\0';
+	for (i = 0; i < 3 * 300; i++) {
+		strcat(input, parts[i % 3]);
+		if (i == 3 * 150) {
+			strcat(input, "<ISO-8859-2>\243\240x\r\n</ISO-8859-2>");
+		}
+	}
+
+	options.useValueViews = true;
+	options.presizeTokens = false;
+	options.tokens = NULL;
+	options.lazyCodepointIndexes = true;
+	options.threadCount = 0;
+	options.warningPolicy.type = WarningPolicyType_RECORD_ALL;
+	expected = tokenize(string_from(input), false, true);
+	result = tokenizeWithOptions(string_from(input), false, true, &options);
+	assert(expected->type == TokenizerResultType_SUCCESS
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful results");
+	assertUnsignedLongEquals("token count",
+				 result->result.tokens->size.length,
+				 expected->result.tokens->size.length);
+	assertUnsignedLongEquals("warning count", result->warnings->size.length,
+				 expected->warnings->size.length);
+	for (i = 0; i < expected->warnings->size.length; i++) {
+		assertWarning(i + 1, result->warnings->items + i,
+			      expected->warnings->items[i].byteIndex,
+			      expected->warnings->items[i].codepointIndex,
+			      expected->warnings->items[i].code);
+	}
+
+	/* The later checkpoints are already known to the earlier queries */
+	for (i = expected->result.tokens->size.length; i > 0; i--) {
+		token = expected->result.tokens->items + i - 1;
+		assertUnsignedLongEquals("token codepoint index",
+					 CodepointIndex_of
+					 (result->lazyCodepointIndex,
+					  token->byteIndex),
+					 token->codepointIndex);
+		token = result->result.tokens->items + i - 1;
+		assertUnsignedLongEquals("lazy token codepoint index",
+					 token->codepointIndex, 0);
+	}
+
+	TokenizerResult_free(result);
+	TokenizerResult_free(expected);
+END_TEST}
+
+START_TEST(tokenizeWithOptions_computesErrorCodepointIndexLazily)
+{
+	string *input = string_from("\305\276lu\305\245ou\304\215k\303\275 <b");
+	TokenizerOptions options;
+	TokenizerResult *result;
+
+	options.useValueViews = false;
+	options.presizeTokens = false;
+	options.tokens = NULL;
+	options.lazyCodepointIndexes = true;
+	options.threadCount = 0;
+	options.warningPolicy.type = WarningPolicyType_RECORD_ALL;
+	result = tokenizeWithOptions(input, false, true, &options);
+	assert(result->type == TokenizerResultType_ERROR,
+	       "Expected an error result");
+	assertUnsignedLongEquals("error byte index",
+				 result->result.error.byteIndex, 16);
+	assertUnsignedLongEquals("error codepoint index",
+				 result->result.error.codepointIndex, 12);
+	assertUnsignedLongEquals("codepoint index of the error",
+				 CodepointIndex_of(result->lazyCodepointIndex,
+						   result->result.error.
+						   byteIndex), 12);
+	TokenizerResult_free(result);
+END_TEST}
+
+START_TEST(tokenizeWithOptions_appliesWarningPolicies)
+{
+	string *input = string_from("a\377\376 b \200\200\377 c");
+	TokenizerOptions options;
+	TokenizerResult *result;
+	TokenizerWarning *warnings;
+	TokenizerWarningCode INVALID =
+	    TokenizerWarningCode_INVALID_UTF8_CHARACTER;
+	TokenizerWarningCode CONTINUATION =
+	    TokenizerWarningCode_UNEXPECTED_UTF8_CONTINUATION_BYTE;
+
+	options.useValueViews = false;
+	options.presizeTokens = false;
+	options.tokens = NULL;
+	options.lazyCodepointIndexes = false;
+	options.threadCount = 0;
+	options.warningPolicy.type = WarningPolicyType_COALESCE_RUNS;
+	options.warningPolicy.limit = 0;
+	result = tokenizeWithOptions(input, false, true, &options);
+	assert(result->warnings->size.length == 3, "Expected 3 warnings");
+	warnings = result->warnings->items;
+	assertWarning(1, warnings, 1, 1, INVALID);
+	assert(warnings[0].count == 2 && warnings[0].lastByteIndex == 2
+	       && warnings[0].lastCodepointIndex == 2,
+	       "Expected a run of 2 invalid characters");
+	assertWarning(2, warnings + 1, 6, 6, CONTINUATION);
+	assert(warnings[1].count == 2 && warnings[1].lastByteIndex == 7,
+	       "Expected a run of 2 continuation bytes");
+	assertWarning(3, warnings + 2, 8, 8, INVALID);
+	assert(warnings[2].count == 1 && warnings[2].lastByteIndex == 8,
+	       "Expected a single invalid character");
+	TokenizerResult_free(result);
+
+	options.warningPolicy.type = WarningPolicyType_COUNT_ONLY;
+	result = tokenizeWithOptions(input, false, true, &options);
+	assert(result->warnings->size.length == 2, "Expected 2 warnings");
+	warnings = result->warnings->items;
+	assertWarning(1, warnings, 1, 1, INVALID);
+	assert(warnings[0].count == 3 && warnings[0].lastByteIndex == 8,
+	       "Expected 3 invalid characters");
+	assertWarning(2, warnings + 1, 6, 6, CONTINUATION);
+	assert(warnings[1].count == 2, "Expected 2 continuation bytes");
+	TokenizerResult_free(result);
+
+	options.warningPolicy.type = WarningPolicyType_RECORD_FIRST;
+	options.warningPolicy.limit = 2;
+	result = tokenizeWithOptions(input, false, true, &options);
+	assert(result->warnings->size.length == 2, "Expected 2 warnings");
+	assertWarning(2, result->warnings->items + 1, 2, 2,
+		      INVALID);
+	TokenizerResult_free(result);
+END_TEST}
+
+START_TEST(tokenizeWithOptions_tokenizesInParallelLikeSerially)
+{
+	static char input[4 * 65536];
+	static char *parts[] = { "Caf\303\251 <bold>bar</bold>\r\n",
+		"x\226y <ISO-8859-2>\243\240 z ", "a <lt> c ",
+		"</ISO-8859-2>\342\200\203 "
+	};
+	TokenizerOptions options;
+	TokenizerResult *expected;
+	TokenizerResult *result;
+	string *richtext;
+	unsigned long length;
+	unsigned long i;
+	unsigned int error;
+	unsigned int variant;
+
+	/* The ISO-8859-2 section spans the boundaries of the chunks */
+	for (error = 0; error < 3; error++) {
+		input[0] = '\0';
+		length = 0;
+		for (i = 0; length < sizeof(input) - 100; i++) {
+			if (i < 1998 || i > 6002 || i % 2 == 0) {
+				strcat(input + length, parts[i % 4]);
+			} else {
+				strcat(input + length, parts[0]);
+			}
+			if (error == 1 && i == 5000) {
+				strcat(input + length, "<b<c");
+			}
+			length += strlen(input + length);
+		}
+		if (error == 2) {
+			strcat(input + length, " <unterminated");
+		}
+		richtext = string_from(input);
+
+		for (variant = 0; variant < 4; variant++) {
+			options.useValueViews = variant % 2 == 0;
+			options.presizeTokens = variant % 2 == 1;
+			options.tokens = NULL;
+			options.lazyCodepointIndexes = variant >= 2;
+			options.threadCount = 0;
+			options.warningPolicy.type = variant == 3 ?
+			    WarningPolicyType_COALESCE_RUNS :
+			    WarningPolicyType_RECORD_ALL;
+			expected = tokenizeWithOptions(richtext, false, true,
+						       &options);
+			options.threadCount = 4;
+			result = tokenizeWithOptions(richtext, false, true,
+						     &options);
+			assert(tokenizerResultsEqual(expected, result),
+			       "Expected the same result as from serial code");
+			TokenizerResult_free(result);
+			TokenizerResult_free(expected);
+		}
+	}
+END_TEST}
+
+START_TEST(TokenizerResult_recycleTokens_allowsReusingTokenVector)
+{
+	TokenizerOptions options;
+	TokenizerResult *result;
+	TokenVector *tokens;
+
+	assert(TokenizerResult_recycleTokens(NULL) == NULL,
+	       "Expected NULL for NULL result");
+	result = tokenize(string_from("<a"), false, true);
+	assert(TokenizerResult_recycleTokens(result) == NULL,
+	       "Expected NULL for error result");
+	TokenizerResult_free(result);
+
+	result = tokenize(string_from("foo bar baz"), false, true);
+	tokens = TokenizerResult_recycleTokens(result);
+	assert(tokens != NULL && tokens->size.length == 0,
+	       "Expected an emptied token vector");
+	assert(result->result.tokens == NULL,
+	       "Expected the result to no longer reference the tokens");
+	TokenizerResult_free(result);
+
+	options.useValueViews = false;
+	options.presizeTokens = true;
+	options.tokens = tokens;
+	options.lazyCodepointIndexes = false;
+	options.threadCount = 0;
+	options.warningPolicy.type = WarningPolicyType_RECORD_ALL;
+	result = tokenizeWithOptions(string_from("a b"), false, true, &options);
+	assert(result->type == TokenizerResultType_SUCCESS
+	       && result->result.tokens == tokens,
+	       "Expected the provided token vector to be used");
+	assert(tokens->size.length == 3, "Expected 3 tokens");
+	assertToken(3, tokens->items + 2, 2, 2, TokenType_TEXT, "b");
+	TokenizerResult_free(result);
+END_TEST}
+
+START_TEST(TokenizerState_emitsTokensIncrementally)
+{
+	TokenizerState *state = TokenizerState_new(false, true);
+	TokenizerResult *result;
+
+	result = TokenizerState_feed(state, string_from("foo b"));
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 2, "Expected 2 tokens");
+	assertToken(1, result->result.tokens->items, 0, 0, TokenType_TEXT,
+		    "foo");
+	assertToken(2, result->result.tokens->items + 1, 3, 3,
+		    TokenType_WHITESPACE, " ");
+	TokenizerResult_free(result);
+
+	result = TokenizerState_feed(state, string_from("ar<b"));
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 1, "Expected 1 token");
+	assertToken(3, result->result.tokens->items, 4, 4, TokenType_TEXT,
+		    "bar");
+	TokenizerResult_free(result);
+
+	result = TokenizerState_feed(state, string_from("old>baz"));
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 1, "Expected 1 token");
+	assertToken(4, result->result.tokens->items, 7, 7,
+		    TokenType_COMMAND_START, "bold");
+	TokenizerResult_free(result);
+
+	result = TokenizerState_finish(state);
+	assert(result != NULL
+	       && result->type == TokenizerResultType_SUCCESS,
+	       "Expected successful result");
+	assert(result->result.tokens->size.length == 1, "Expected 1 token");
+	assertToken(5, result->result.tokens->items, 13, 13, TokenType_TEXT,
+		    "baz");
+	TokenizerResult_free(result);
+
+	assert(TokenizerState_feed(state, string_from("a")) == NULL,
+	       "Expected NULL result for input fed after finishing");
+	assert(TokenizerState_finish(state) == NULL,
+	       "Expected NULL result for finishing the tokenizer twice");
+	TokenizerState_free(state);
+END_TEST}
+
+START_TEST(TokenizerState_emitsSameTokensRegardlessOfChunking)
+{
+	char *inputs[4];
+	unsigned long inputIndex;
+	unsigned long chunkLength;
+	string *input;
+	TokenizerResult *expected;
+	TokenizerResult *streamed;
+
+	inputs[0] = "Caf\303\251\r\nfoo\342\200\203<bold>bar</bold>\r x";
+	inputs[1] =
+	    "<ISO-8859-2>\243\240\263</ISO-8859-2> \360\237\230\200\226x\370\r";
+	inputs[2] = "a\226<b<c";
+	inputs[3] = "text <ISO-8859-1>\243</ISO-8859-1> <unterminated";
+
+	for (inputIndex = 0; inputIndex < 4; inputIndex++) {
+		input = string_from(inputs[inputIndex]);
+		expected = tokenize(input, false, true);
+		for (chunkLength = 1; chunkLength <= input->length;
+		     chunkLength++) {
+			streamed = tokenizeInChunks(input, chunkLength);
+			assert(tokenizerResultsEqual(expected, streamed),
+			       "Expected the same result as from tokenize");
+			TokenizerResult_free(streamed);
+		}
+		TokenizerResult_free(expected);
+	}
+END_TEST}
+
+START_TEST(TokenizerState_keepsReturningTheEncounteredError)
+{
+	TokenizerState *state = TokenizerState_new(true, true);
+	TokenizerResult *result;
+
+	result = TokenizerState_feed(state, string_from("a <b<c"));
+	assert(result != NULL
+	       && result->type == TokenizerResultType_ERROR,
+	       "Expected an error result");
+	assert(result->result.error.byteIndex == 4
+	       && result->result.error.code ==
+	       TokenizerErrorCode_UNEXPECTED_COMMAND_START,
+	       "Expected UNEXPECTED_COMMAND_START error at byte 4");
+	TokenizerResult_free(result);
+
+	result = TokenizerState_feed(state, string_from("d>"));
+	assert(result != NULL
+	       && result->type == TokenizerResultType_ERROR
+	       && result->result.error.byteIndex == 4,
+	       "Expected the same error result");
+	TokenizerResult_free(result);
+
+	result = TokenizerState_finish(state);
+	assert(result != NULL
+	       && result->type == TokenizerResultType_ERROR
+	       && result->result.error.byteIndex == 4,
+	       "Expected the same error result");
+	TokenizerResult_free(result);
+	TokenizerState_free(state);
+END_TEST}
+
+START_TEST(TokenizerState_acceptsNullInput)
+{
+	TokenizerState *state = TokenizerState_new(true, true);
+	assert(TokenizerState_feed(NULL, string_from("a")) == NULL,
+	       "Expected NULL result for NULL state");
+	assert(TokenizerState_feed(state, NULL) == NULL,
+	       "Expected NULL result for NULL chunk");
+	assert(TokenizerState_finish(NULL) == NULL,
+	       "Expected NULL result for NULL state");
+	TokenizerState_free(state);
+	TokenizerState_free(NULL);
+END_TEST}
+
 START_TEST(TokenizerResult_free_acceptsNull)
 {
 	TokenizerResult_free(NULL);
@@ -555,9 +1202,11 @@ static void all_tests()
 	runTest(tokenize_recognizesAllThreeByteWhitespaceAsSingleTokens);
 	runTest(tokenize_processesCommandStarts);
 	runTest(tokenize_processesCommandEnd);
+	runTest(tokenize_identifiesCommands);
 	runTest
 	    (tokenize_emitsWarningsForInvalidUtf8CharactersButTreatsThemAsText);
 	runTest(tokenize_emitsWarningsForUnexpectedContinuationBytes);
+	runTest(tokenize_emitsWarningsForIllFormedUtf8Sequences);
 	runTest(tokenize_rejectsCommandStartDelimiterInsideACommand);
 	runTest(tokenize_rejectsUnterminatedCommand);
 	runTest(tokenize_returnsEncounteredWarningsOnError);
@@ -565,6 +1214,24 @@ static void all_tests()
 	runTest(tokenize_rejectsUnexpectedEncodingEndCommands);
 	runTest(tokenize_respectsCommandsCaseSensitivity);
 	runTest(tokenize_normalizesInputToUtf8);
+	runTest(tokenize_transcodesTrailingText);
+	runTest(tokenize_emitsSingleTokenForCrLfInSingleByteEncodings);
+	runTest(tokenize_tracksPositionsAcrossLongRunsOfText);
+	runTest(tokenizeWithOptions_referencesInputWhenUsingValueViews);
+	runTest
+	    (tokenizeWithOptions_copiesOnlyTranscodedValuesWhenUsingValueViews);
+	runTest(tokenizeWithOptions_acceptsNullOptions);
+	runTest(estimateTokenCount_returnsUpperBoundOfTokenCount);
+	runTest(tokenizeWithOptions_presizesTokenVector);
+	runTest(tokenizeWithOptions_computesCodepointIndexesLazily);
+	runTest(tokenizeWithOptions_computesErrorCodepointIndexLazily);
+	runTest(tokenizeWithOptions_appliesWarningPolicies);
+	runTest(tokenizeWithOptions_tokenizesInParallelLikeSerially);
+	runTest(TokenizerResult_recycleTokens_allowsReusingTokenVector);
+	runTest(TokenizerState_emitsTokensIncrementally);
+	runTest(TokenizerState_emitsSameTokensRegardlessOfChunking);
+	runTest(TokenizerState_keepsReturningTheEncounteredError);
+	runTest(TokenizerState_acceptsNullInput);
 	runTest(TokenizerResult_free_acceptsNull);
 	runTest(TokenizerResult_free_freesSuccessfulResult);
 }
@@ -667,3 +1334,121 @@ char *value;
 					  string_from(value)) == 0,
 			   errorMessage);
 }
+
+/*
+   Feeds the input to a streaming tokenizer in chunks of the specified length
+   and merges the returned results into a single one.
+ */
+static TokenizerResult *tokenizeInChunks(input, chunkLength)
+string *input;
+unsigned long chunkLength;
+{
+	TokenizerState *state = TokenizerState_new(false, true);
+	TokenizerResult *merged = malloc(sizeof(TokenizerResult));
+	TokenizerResult *result;
+	string chunk;
+	unsigned long chunkStart = 0;
+	unsigned long i;
+	bool isFinished = false;
+
+	merged->type = TokenizerResultType_SUCCESS;
+	merged->result.tokens = TokenVector_new(0, 0);
+	merged->warnings = TokenizerWarningVector_new(0, 0);
+	merged->valueViews = NULL;
+	merged->lazyCodepointIndex = NULL;
+
+	while (!isFinished) {
+		if (chunkStart < input->length) {
+			chunk.content = input->content + chunkStart;
+			chunk.length = input->length - chunkStart;
+			if (chunk.length > chunkLength) {
+				chunk.length = chunkLength;
+			}
+			chunkStart += chunk.length;
+			result = TokenizerState_feed(state, &chunk);
+		} else {
+			result = TokenizerState_finish(state);
+			isFinished = true;
+		}
+
+		for (i = 0; i < result->warnings->size.length; i++) {
+			merged->warnings =
+			    TokenizerWarningVector_append(merged->warnings,
+							  result->warnings->
+							  items + i);
+		}
+		if (result->type == TokenizerResultType_ERROR) {
+			merged->type = TokenizerResultType_ERROR;
+			merged->result.error = result->result.error;
+			break;
+		}
+		/* The merged result takes over the values of the tokens */
+		for (i = 0; i < result->result.tokens->size.length; i++) {
+			merged->result.tokens =
+			    TokenVector_append(merged->result.tokens,
+					       result->result.tokens->items +
+					       i);
+		}
+	}
+
+	TokenizerState_free(state);
+	return merged;
+}
+
+static bool tokenizerResultsEqual(result1, result2)
+TokenizerResult *result1;
+TokenizerResult *result2;
+{
+	TokenizerWarning *warning1 = result1->warnings->items;
+	TokenizerWarning *warning2 = result2->warnings->items;
+	Token *token1;
+	Token *token2;
+	unsigned long i;
+
+	if (result1->type != result2->type
+	    || result1->warnings->size.length !=
+	    result2->warnings->size.length) {
+		return false;
+	}
+
+	for (i = 0; i < result1->warnings->size.length;
+	     i++, warning1++, warning2++) {
+		if (warning1->byteIndex != warning2->byteIndex
+		    || warning1->codepointIndex != warning2->codepointIndex
+		    || warning1->code != warning2->code
+		    || warning1->count != warning2->count
+		    || warning1->lastByteIndex != warning2->lastByteIndex
+		    || warning1->lastCodepointIndex !=
+		    warning2->lastCodepointIndex) {
+			return false;
+		}
+	}
+
+	if (result1->type == TokenizerResultType_ERROR) {
+		return result1->result.error.byteIndex ==
+		    result2->result.error.byteIndex
+		    && result1->result.error.codepointIndex ==
+		    result2->result.error.codepointIndex
+		    && result1->result.error.code ==
+		    result2->result.error.code;
+	}
+
+	if (result1->result.tokens->size.length !=
+	    result2->result.tokens->size.length) {
+		return false;
+	}
+
+	token1 = result1->result.tokens->items;
+	token2 = result2->result.tokens->items;
+	for (i = 0; i < result1->result.tokens->size.length;
+	     i++, token1++, token2++) {
+		if (token1->byteIndex != token2->byteIndex
+		    || token1->codepointIndex != token2->codepointIndex
+		    || token1->type != token2->type
+		    || string_compare(token1->value, token2->value) != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
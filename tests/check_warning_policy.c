@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include "../src/bool.h"
+#include "../src/typed_vector.h"
+#include "../src/vector.h"
+#include "../src/warning_policy.h"
+#include "unit.h"
+
+typedef struct TestWarning {
+	int code;
+	unsigned long count;
+} TestWarning;
+
+Vector_ofType(TestWarning)
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+static TestWarningVector *recordWarnings(WarningPolicy *policy, char *codes);
+
+static bool mergeTestWarnings(void *recordedWarning, const void *warning);
+
+static char *describeWarnings(TestWarningVector *warnings);
+
+START_TEST(WarningPolicy_record_recordsAllWarningsByDefault)
+{
+	WarningPolicy policy;
+	TestWarningVector *warnings = recordWarnings(NULL, "aaba");
+
+	assertCStringEquals("warnings", describeWarnings(warnings), "a1a1b1a1");
+	TestWarningVector_free(warnings);
+
+	policy.type = WarningPolicyType_RECORD_ALL;
+	policy.limit = 1;
+	warnings = recordWarnings(&policy, "aaba");
+	assertCStringEquals("warnings", describeWarnings(warnings), "a1a1b1a1");
+	TestWarningVector_free(warnings);
+
+	assert(WarningPolicy_record(&policy, NULL, &policy, mergeTestWarnings)
+	       == NULL, "Expected NULL for NULL warnings");
+END_TEST}
+
+START_TEST(WarningPolicy_record_recordsFirstWarnings)
+{
+	WarningPolicy policy;
+	TestWarningVector *warnings;
+
+	policy.type = WarningPolicyType_RECORD_FIRST;
+	policy.limit = 3;
+	warnings = recordWarnings(&policy, "abaab");
+	assertCStringEquals("warnings", describeWarnings(warnings), "a1b1a1");
+	TestWarningVector_free(warnings);
+
+	policy.limit = 0;
+	warnings = recordWarnings(&policy, "ab");
+	assertCStringEquals("warnings", describeWarnings(warnings), "");
+	TestWarningVector_free(warnings);
+END_TEST}
+
+START_TEST(WarningPolicy_record_coalescesRuns)
+{
+	WarningPolicy policy;
+	TestWarningVector *warnings;
+
+	policy.type = WarningPolicyType_COALESCE_RUNS;
+	policy.limit = 0;
+	warnings = recordWarnings(&policy, "aaabccca");
+	assertCStringEquals("warnings", describeWarnings(warnings), "a3b1c3a1");
+	TestWarningVector_free(warnings);
+END_TEST}
+
+START_TEST(WarningPolicy_record_countsWarningsByCode)
+{
+	WarningPolicy policy;
+	TestWarningVector *warnings;
+
+	policy.type = WarningPolicyType_COUNT_ONLY;
+	policy.limit = 0;
+	warnings = recordWarnings(&policy, "abcabacaa");
+	assertCStringEquals("warnings", describeWarnings(warnings), "a5b2c2");
+	TestWarningVector_free(warnings);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(WarningPolicy_record_recordsAllWarningsByDefault);
+	runTest(WarningPolicy_record_recordsFirstWarnings);
+	runTest(WarningPolicy_record_coalescesRuns);
+	runTest(WarningPolicy_record_countsWarningsByCode);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
+
+static TestWarningVector *recordWarnings(policy, codes)
+WarningPolicy *policy;
+char *codes;
+{
+	TestWarningVector *warnings = TestWarningVector_new(0, 0);
+	TestWarning warning;
+
+	for (; *codes != '\0'; codes++) {
+		warning.code = *codes;
+		warning.count = 1;
+		warnings = (TestWarningVector *)
+		    WarningPolicy_record(policy, (Vector *) warnings, &warning,
+					 mergeTestWarnings);
+	}
+
+	return warnings;
+}
+
+static bool mergeTestWarnings(recordedWarning, warning)
+void *recordedWarning;
+const void *warning;
+{
+	TestWarning *recorded = recordedWarning;
+	const TestWarning *merged = warning;
+
+	if (recorded->code != merged->code) {
+		return false;
+	}
+
+	recorded->count += merged->count;
+	return true;
+}
+
+static char *describeWarnings(warnings)
+TestWarningVector *warnings;
+{
+	static char description[64];
+	unsigned long i;
+
+	description[0] = '\0';
+	for (i = 0; i < warnings->size.length; i++) {
+		sprintf(description + 2 * i, "%c%lu", warnings->items[i].code,
+			warnings->items[i].count);
+	}
+
+	return description;
+}
+
+Vector_ofTypeImplementation(TestWarning)
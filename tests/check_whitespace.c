@@ -0,0 +1,124 @@
+#include <string.h>
+#include "../src/bool.h"
+#include "../src/whitespace.h"
+#include "unit.h"
+
+unsigned int tests_run = 0;
+unsigned int tests_failed = 0;
+
+static void all_tests(void);
+
+int main(void);
+
+static unsigned long getExpectedLength(unsigned char *bytes, bool isUtf8);
+
+static char *UTF8_WHITESPACE[] = {
+	" ", "\t", "\n", "\v", "\f", "\r\n", "\r",
+	"\302\205",		/* next line */
+	"\302\240",		/* no-break space */
+	"\341\232\200",		/* ogham space mark */
+	"\342\200\200",		/* en quad */
+	"\342\200\201",		/* em quad */
+	"\342\200\202",		/* en space */
+	"\342\200\203",		/* em space */
+	"\342\200\204",		/* three-per-em space */
+	"\342\200\205",		/* four-per-em space */
+	"\342\200\206",		/* six-per-em space */
+	"\342\200\207",		/* figure space */
+	"\342\200\210",		/* punctuation space */
+	"\342\200\211",		/* thin space */
+	"\342\200\212",		/* hair space */
+	"\342\200\250",		/* line separator */
+	"\342\200\251",		/* paragraph separator */
+	"\342\200\257",		/* narrow no-break space */
+	"\342\201\237",		/* medium mathematical space */
+	"\343\200\200",		/* ideographic space */
+	NULL
+};
+
+static char *SINGLE_BYTE_WHITESPACE[] = {
+	" ", "\t", "\n", "\v", "\f", "\r\n", "\r", "\240", NULL
+};
+
+START_TEST(getWhitespaceLength_returns0ForNullOrEmptyInput)
+{
+	assertUnsignedLongEquals("length for NULL",
+				 getWhitespaceLength(NULL, 3, true), 0);
+	assertUnsignedLongEquals("length for empty input",
+				 getWhitespaceLength((unsigned char *)" ", 0,
+						     true), 0);
+END_TEST}
+
+START_TEST(getWhitespaceLength_recognizesExactlyTheListedWhitespace)
+{
+	unsigned char bytes[3];
+	unsigned int byte1, byte2, byte3;
+	unsigned int isUtf8;
+
+	/*
+	   The third byte is relevant only for the three-byte UTF-8 sequences
+	   starting with 0xE1-0xE3.
+	 */
+	for (isUtf8 = 0; isUtf8 <= 1; isUtf8++) {
+		for (byte1 = 0; byte1 < 256; byte1++) {
+			for (byte2 = 0; byte2 < 256; byte2++) {
+				for (byte3 = 0; byte3 < 256; byte3++) {
+					bytes[0] = byte1;
+					bytes[1] = byte2;
+					bytes[2] = byte3;
+					assertUnsignedLongEquals
+					    ("whitespace length",
+					     getWhitespaceLength(bytes, 3,
+								 isUtf8),
+					     getExpectedLength(bytes, isUtf8));
+					if (byte1 < 0xE1 || byte1 > 0xE3) {
+						break;
+					}
+				}
+			}
+		}
+	}
+END_TEST}
+
+START_TEST(getWhitespaceLength_ignoresBytesBeyondTheInput)
+{
+	assertUnsignedLongEquals("length for CR",
+				 getWhitespaceLength((unsigned char *)"\r\n",
+						     1, true), 1);
+	assertUnsignedLongEquals("length for truncated em space",
+				 getWhitespaceLength((unsigned char *)
+						     "\342\200\203", 2, true),
+				 0);
+	assertUnsignedLongEquals("length for truncated no-break space",
+				 getWhitespaceLength((unsigned char *)
+						     "\302\240", 1, true), 0);
+END_TEST}
+
+static void all_tests()
+{
+	runTest(getWhitespaceLength_returns0ForNullOrEmptyInput);
+	runTest(getWhitespaceLength_recognizesExactlyTheListedWhitespace);
+	runTest(getWhitespaceLength_ignoresBytesBeyondTheInput);
+}
+
+int main()
+{
+	runTestSuite(all_tests);
+	return tests_failed;
+}
+
+static unsigned long getExpectedLength(bytes, isUtf8)
+unsigned char *bytes;
+bool isUtf8;
+{
+	char **whitespace = isUtf8 ? UTF8_WHITESPACE : SINGLE_BYTE_WHITESPACE;
+
+	/* The list is ordered so that CRLF is matched before CR */
+	for (; *whitespace != NULL; whitespace++) {
+		if (memcmp(bytes, *whitespace, strlen(*whitespace)) == 0) {
+			return strlen(*whitespace);
+		}
+	}
+
+	return 0;
+}
@@ -1,8 +1,10 @@
+#include <string.h>
 #include "../../src/ast_node.h"
 #include "../../src/ast_node_pointer_vector.h"
 #include "../../src/ast_node_type.h"
 #include "../../src/json/ast_node.h"
 #include "../../src/json/json_encoder.h"
+#include "../../src/json/json_value.h"
 #include "../unit.h"
 
 /*
@@ -116,6 +118,67 @@ START_TEST(ASTNodePointerVector_toJSON_serializesNodesInInputVectorRecursively)
 	       "Expected the provided nodes to be serialized to JSON recursively");
 END_TEST}
 
+START_TEST(ASTNodePointerVector_toJSON_serializesDeeplyNestedNodes)
+{
+	unsigned long depth = 1000000;
+	ASTNode *nodeArray = malloc(sizeof(ASTNode) * (depth + 1));
+	ASTNode *node;
+	ASTNodePointerVector *nodes = ASTNodePointerVector_new(0, 0);
+	JSONValue *json;
+	JSONValue *children;
+	JSONObjectProperty *property;
+	string *childrenKey = string_from("children");
+	string *serialized;
+	unsigned long i;
+
+	for (i = 0; i <= depth; i++) {
+		node = nodeArray + i;
+		node->byteIndex = i * 3;
+		node->codepointIndex = i * 3;
+		node->tokenIndex = i;
+		node->type = i < depth ? ASTNodeType_COMMAND : ASTNodeType_TEXT;
+		node->value = string_from("x");
+		node->parent = i > 0 ? node - 1 : NULL;
+		node->children = NULL;
+		if (i > 0) {
+			node->parent->children =
+			    ASTNodePointerVector_of1(node);
+		}
+	}
+	nodes = ASTNodePointerVector_append(nodes, &nodeArray);
+
+	json = ASTNodePointerVector_toJSON(nodes);
+	assert(json != NULL, "Expected the nodes to be serialized");
+	children = json;
+	for (i = 0; i < depth; i++) {
+		if (children->type != JSONValueType_ARRAY
+		    || children->value.array->size.length != 1) {
+			break;
+		}
+		property = children->value.array->items[0]->value.object->items;
+		/* The children are the last property of a node */
+		property += children->value.array->items[0]->value.object->
+		    size.length - 1;
+		if (string_compare(property->key, childrenKey) != 0) {
+			break;
+		}
+		children = property->value;
+	}
+	assertUnsignedLongEquals("depth", i, depth);
+	assert(children->value.array->size.length == 1,
+	       "Expected the deepest node");
+
+	serialized = JSON_encode(json);
+	assert(serialized != NULL, "Expected the JSON to be encoded");
+	assert(serialized->length > depth * 2
+	       && memcmp(serialized->content, "[{\"byteIndex\":0,", 16) == 0
+	       && memcmp(serialized->content + serialized->length - 4, "}]}]",
+			 4) == 0, "Expected the deeply nested JSON");
+	string_free(serialized);
+	/* The JSON owns the values of the nodes */
+	JSONValue_freeRecursive(json);
+END_TEST}
+
 START_TEST(ASTNode_toJSON_returnsJsonNullForNullInput)
 {
 	JSONValue *result;
@@ -175,6 +238,7 @@ static void all_tests()
 	runTest(ASTNodePointerVector_toJSON_returnsNullPointerForNullInput);
 	runTest
 	    (ASTNodePointerVector_toJSON_serializesNodesInInputVectorRecursively);
+	runTest(ASTNodePointerVector_toJSON_serializesDeeplyNestedNodes);
 	runTest(ASTNode_toJSON_returnsJsonNullForNullInput);
 	runTest(ASTNode_toJSON_serializedNodeIncludingChildrenRecursively);
 }
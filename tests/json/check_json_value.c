@@ -392,7 +392,13 @@ START_TEST(JSONValue_freeRecursive_freesNestedObjectsAndArrays)
 	JSONValue *arr = JSONValue_newArray();
 
 	JSONValue_setObjectProperty(obj1, string_from("x"), arr);
+	JSONValue_setObjectProperty(obj1, string_from("y"),
+				    JSONValue_newString(string_from("y")));
 	JSONValue_pushToArray(arr, obj2);
+	JSONValue_pushToArray(arr, JSONValue_newArray());
+	JSONValue_pushToArray(arr, JSONValue_newNumber(1));
+	JSONValue_setObjectProperty(obj2, string_from("z"),
+				    JSONValue_newString(string_from("z")));
 
 	JSONValue_freeRecursive(obj1);
 END_TEST}
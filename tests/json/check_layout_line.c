@@ -1,6 +1,7 @@
 #include "../../src/json/layout_line.h"
 #include "../../src/json/json_encoder.h"
 #include "../../src/layout_content_alignment.h"
+#include "../../src/layout_segment_style.h"
 #include "../../src/layout_line.h"
 #include "../../src/layout_line_vector.h"
 #include "../../src/ast_node.h"
@@ -34,6 +35,7 @@ START_TEST(LayoutLine_toJSON_encodesTheProvidedLine)
 	LayoutLine line;
 	ASTNode causingCommand;
 	LayoutLineSegment segment;
+	LayoutSegmentStyle style;
 	char *serializedCommand;
 	char *serializedSegmentTemplate, *serializedSegment;
 	char *serializedLineTemplate, *serializedLine;
@@ -48,15 +50,17 @@ START_TEST(LayoutLine_toJSON_encodesTheProvidedLine)
 	causingCommand.children = ASTNodePointerVector_new(0, 0);
 
 	segment.causingCommand = &causingCommand;
-	segment.contentAlignment = LayoutContentAlignment_CENTER;
-	segment.leftIndentationLevel = 3;
-	segment.rightIndentationLevel = -2;
-	segment.fontSizeChange = 4;
-	segment.fontBoldLevel = 5;
-	segment.fontItalicLevel = 1;
-	segment.fontUnderlinedLevel = 7;
-	segment.fontFixedLevel = 9;
-	segment.otherSegmentMarkers = ASTNodePointerVector_new(0, 0);
+	segment.style = &style;
+	style.id = 0;
+	style.contentAlignment = LayoutContentAlignment_CENTER;
+	style.leftIndentationLevel = 3;
+	style.rightIndentationLevel = -2;
+	style.fontSizeChange = 4;
+	style.fontBoldLevel = 5;
+	style.fontItalicLevel = 1;
+	style.fontUnderlinedLevel = 7;
+	style.fontFixedLevel = 9;
+	style.otherSegmentMarkers = NULL;
 	segment.content = ASTNodePointerVector_new(0, 0);
 
 	line.causingCommand = &causingCommand;
@@ -2,9 +2,11 @@
 #include "../../src/json/layout_line_segment.h"
 #include "../../src/json/json_encoder.h"
 #include "../../src/layout_content_alignment.h"
+#include "../../src/layout_segment_style.h"
 #include "../../src/ast_node.h"
 #include "../../src/ast_node_pointer_vector.h"
 #include "../../src/ast_node_type.h"
+#include "../../src/layout_segment_marker_stack.h"
 #include "../../src/string.h"
 #include "../unit.h"
 
@@ -31,6 +33,7 @@ END_TEST}
 START_TEST(LayoutLineSegment_toJSON_encodesProvidedSegment)
 {
 	LayoutLineSegment segment;
+	LayoutSegmentStyle style;
 	ASTNode causingCommand, *marker, *content;
 	JSONValue *result;
 	string *serialized, *expected;
@@ -64,15 +67,18 @@ START_TEST(LayoutLineSegment_toJSON_encodesProvidedSegment)
 	causingCommand.children = ASTNodePointerVector_of1(content);
 
 	segment.causingCommand = &causingCommand;
-	segment.contentAlignment = LayoutContentAlignment_CENTER;
-	segment.leftIndentationLevel = 3;
-	segment.rightIndentationLevel = -2;
-	segment.fontSizeChange = 4;
-	segment.fontBoldLevel = 5;
-	segment.fontItalicLevel = 1;
-	segment.fontUnderlinedLevel = 7;
-	segment.fontFixedLevel = 9;
-	segment.otherSegmentMarkers = ASTNodePointerVector_of1(marker);
+	segment.style = &style;
+	style.id = 0;
+	style.contentAlignment = LayoutContentAlignment_CENTER;
+	style.leftIndentationLevel = 3;
+	style.rightIndentationLevel = -2;
+	style.fontSizeChange = 4;
+	style.fontBoldLevel = 5;
+	style.fontItalicLevel = 1;
+	style.fontUnderlinedLevel = 7;
+	style.fontFixedLevel = 9;
+	style.otherSegmentMarkers =
+	    LayoutSegmentMarkerStack_push(NULL, marker);
 	segment.content = ASTNodePointerVector_of1(content);
 
 	result = LayoutLineSegment_toJSON(&segment);
@@ -116,6 +122,7 @@ START_TEST(LayoutLineSegmentVector_toJSON_serializedAllSegments)
 {
 
 	LayoutLineSegment segment1, segment2;
+	LayoutSegmentStyle style1, style2;
 	ASTNode causingCommand, *marker, *content;
 	LayoutLineSegmentVector *segments;
 	JSONValue *result;
@@ -155,27 +162,33 @@ START_TEST(LayoutLineSegmentVector_toJSON_serializedAllSegments)
 	causingCommand.children = ASTNodePointerVector_of1(content);
 
 	segment1.causingCommand = &causingCommand;
-	segment1.contentAlignment = LayoutContentAlignment_CENTER;
-	segment1.leftIndentationLevel = 3;
-	segment1.rightIndentationLevel = -2;
-	segment1.fontSizeChange = 4;
-	segment1.fontBoldLevel = 5;
-	segment1.fontItalicLevel = 1;
-	segment1.fontUnderlinedLevel = 7;
-	segment1.fontFixedLevel = 9;
-	segment1.otherSegmentMarkers = ASTNodePointerVector_of1(marker);
+	segment1.style = &style1;
+	style1.id = 0;
+	style1.contentAlignment = LayoutContentAlignment_CENTER;
+	style1.leftIndentationLevel = 3;
+	style1.rightIndentationLevel = -2;
+	style1.fontSizeChange = 4;
+	style1.fontBoldLevel = 5;
+	style1.fontItalicLevel = 1;
+	style1.fontUnderlinedLevel = 7;
+	style1.fontFixedLevel = 9;
+	style1.otherSegmentMarkers =
+	    LayoutSegmentMarkerStack_push(NULL, marker);
 	segment1.content = ASTNodePointerVector_of1(content);
 
 	segment2.causingCommand = &causingCommand;
-	segment2.contentAlignment = LayoutContentAlignment_JUSTIFY_RIGHT;
-	segment2.leftIndentationLevel = -1;
-	segment2.rightIndentationLevel = 8;
-	segment2.fontSizeChange = 0;
-	segment2.fontBoldLevel = 3;
-	segment2.fontItalicLevel = 4;
-	segment2.fontUnderlinedLevel = 2;
-	segment2.fontFixedLevel = 6;
-	segment2.otherSegmentMarkers = ASTNodePointerVector_of1(marker);
+	segment2.style = &style2;
+	style2.id = 0;
+	style2.contentAlignment = LayoutContentAlignment_JUSTIFY_RIGHT;
+	style2.leftIndentationLevel = -1;
+	style2.rightIndentationLevel = 8;
+	style2.fontSizeChange = 0;
+	style2.fontBoldLevel = 3;
+	style2.fontItalicLevel = 4;
+	style2.fontUnderlinedLevel = 2;
+	style2.fontFixedLevel = 6;
+	style2.otherSegmentMarkers =
+	    LayoutSegmentMarkerStack_push(NULL, marker);
 	segment2.content = ASTNodePointerVector_of1(content);
 
 	segments = LayoutLineSegmentVector_of2(segment1, segment2);
@@ -199,20 +212,20 @@ START_TEST(LayoutLineSegmentVector_toJSON_serializedAllSegments)
 		   13 + 20 + 20 + 20 + 20 + 20 + 20 + 20 +
 		   strlen(serializedMarker) + strlen(serializedContent) + 1);
 	sprintf(serializedSegment1, serializedSegmentTemplate, serializedCause,
-		"CENTER", segment1.leftIndentationLevel,
-		segment1.rightIndentationLevel, segment1.fontSizeChange,
-		segment1.fontBoldLevel, segment1.fontItalicLevel,
-		segment1.fontUnderlinedLevel, segment1.fontFixedLevel,
+		"CENTER", style1.leftIndentationLevel,
+		style1.rightIndentationLevel, style1.fontSizeChange,
+		style1.fontBoldLevel, style1.fontItalicLevel,
+		style1.fontUnderlinedLevel, style1.fontFixedLevel,
 		serializedMarker, serializedContent);
 	serializedSegment2 =
 	    malloc(strlen(serializedSegmentTemplate) + strlen(serializedCause) +
 		   13 + 20 + 20 + 20 + 20 + 20 + 20 + 20 +
 		   strlen(serializedMarker) + strlen(serializedContent) + 1);
 	sprintf(serializedSegment2, serializedSegmentTemplate, serializedCause,
-		"JUSTIFY_RIGHT", segment2.leftIndentationLevel,
-		segment2.rightIndentationLevel, segment2.fontSizeChange,
-		segment2.fontBoldLevel, segment2.fontItalicLevel,
-		segment2.fontUnderlinedLevel, segment2.fontFixedLevel,
+		"JUSTIFY_RIGHT", style2.leftIndentationLevel,
+		style2.rightIndentationLevel, style2.fontSizeChange,
+		style2.fontBoldLevel, style2.fontItalicLevel,
+		style2.fontUnderlinedLevel, style2.fontFixedLevel,
 		serializedMarker, serializedContent);
 
 	serializedSegments =
@@ -1,4 +1,6 @@
 #include "../../src/bool.h"
+#include "../../src/utf8/iso_8859_1.h"
+#include "../../src/utf8/iso_8859_2.h"
 #include "../../src/utf8/utf8_encoder.h"
 #include "../../src/string.h"
 #include "../unit.h"
@@ -209,6 +211,73 @@ START_TEST(transcodeSingleByteEncodingToUtf8_handlesMultibyteCodepointsInOutput)
 	       "Expected the result to contain all longer UTF-8 sequences");
 END_TEST}
 
+START_TEST(transcodeSingleByteEncodingToUtf8Buffer_usesTable)
+{
+	string *input = string_from("\251ern\341 ovce \271\354 \350");
+	unsigned char output[32];
+	unsigned long length;
+	length =
+	    transcodeSingleByteEncodingToUtf8Buffer(input,
+						    getIso88592Utf8Table(),
+						    output, sizeof(output));
+	assertUnsignedLongEquals("output length", length, 20);
+	assert(memcmp(output, "Šerná ovce šě č", 20) == 0,
+	       "Expected the ISO-8859-2 text to be transcoded");
+END_TEST}
+
+START_TEST(transcodeSingleByteEncodingToUtf8Buffer_truncatesOutput)
+{
+	string *input = string_from("ab\251c");
+	unsigned char output[8];
+	const Utf8Character *table = getIso88592Utf8Table();
+
+	memset(output, '-', sizeof(output));
+	assertUnsignedLongEquals("output length",
+				 transcodeSingleByteEncodingToUtf8Buffer(input,
+									 table,
+									 output,
+									 3),
+				 5);
+	assert(memcmp(output, "ab--", 4) == 0,
+	       "Expected the output to be truncated before the Š");
+
+	memset(output, '-', sizeof(output));
+	assertUnsignedLongEquals("output length",
+				 transcodeSingleByteEncodingToUtf8Buffer(input,
+									 table,
+									 output,
+									 1),
+				 5);
+	assert(memcmp(output, "a-", 2) == 0,
+	       "Expected the output to be truncated inside the ASCII run");
+
+	assertUnsignedLongEquals("output length without output buffer",
+				 transcodeSingleByteEncodingToUtf8Buffer(input,
+									 table,
+									 NULL,
+									 0),
+				 5);
+END_TEST}
+
+START_TEST(transcodeSingleByteEncodingToUtf8UsingTable_matchesDecoderOutput)
+{
+	string *input = string_new(1024), *tableOutput, *decoderOutput;
+	unsigned long i;
+
+	for (i = 0; i < input->length; i++) {
+		*(input->content + i) = (i * 7) % 256;
+	}
+	tableOutput =
+	    transcodeSingleByteEncodingToUtf8UsingTable(input,
+							getIso88591Utf8Table
+							());
+	decoderOutput =
+	    transcodeSingleByteEncodingToUtf8(input, NULL, identityDecoder);
+	assert(tableOutput != NULL
+	       && string_compare(tableOutput, decoderOutput) == 0,
+	       "Expected the same output as when using a decoder");
+END_TEST}
+
 static void all_tests()
 {
 	runTest(getEncodedCodepointLength_returns1ForFirst127Codepoints);
@@ -227,6 +296,10 @@ static void all_tests()
 	    (transcodeSingleByteEncodingToUtf8_invokesDecoderWithContextAndEveryByte);
 	runTest
 	    (transcodeSingleByteEncodingToUtf8_handlesMultibyteCodepointsInOutput);
+	runTest(transcodeSingleByteEncodingToUtf8Buffer_usesTable);
+	runTest(transcodeSingleByteEncodingToUtf8Buffer_truncatesOutput);
+	runTest
+	    (transcodeSingleByteEncodingToUtf8UsingTable_matchesDecoderOutput);
 }
 
 int main()